@@ -10,6 +10,21 @@
 #define _CONSTANTS_H_
 
 #define APP_SIGNATURE "application/x-vnd.Haiku-IndexServer"
+#define SEARCHAPP_SIGNATURE "application/x-vnd.Haiku-ContentSearch"
+
+// Written to an index directory after each complete batch of changes.
+#define BEACON_PUBLISHED_FILE "published"
+
+// Big growing text files are indexed in chunks, each a document whose path
+// is the file's, this, and the offset the chunk starts at. Real paths never
+// have an empty component, so nothing else looks like that.
+#define BEACON_CHUNK_SEPARATOR "//"
+
+// bulkindex builds in this directory at the root of the volume, and lists
+// every file and directory it saw in this file next to the index, one
+// path to a line.
+#define BEACON_BULK_DIRECTORY ".bulkindex"
+#define BEACON_BULK_NAMES_FILE "names.txt"
 
 enum BeaconMessage {
 	BEACON_UPDATE_INDEX =	'updt',
@@ -18,6 +33,12 @@ enum BeaconMessage {
 	BEACON_REINDEX =		'ridx',
 	BEACON_COMMIT =			'cmit',
 	BEACON_EXCLUDE =		'xcld',
+	BEACON_NAME_QUERY =		'nmqy',
+	BEACON_FLUSH =			'flsh',
+	BEACON_METRICS =		'mtrc',
+	BEACON_TRACE =			'trce',
+	BEACON_SWAP_INDEX =		'swap',
+	BEACON_REINDEX_PROGRESS =	'ripg',
 } ;
 
 enum ErrorCode {
@@ -26,4 +47,10 @@ enum ErrorCode {
 	BEACON_FIRST_RUN = 		'frst',
 } ;
 
+enum NameMatchMode {
+	BEACON_MATCH_PREFIX,
+	BEACON_MATCH_SUBSTRING,
+	BEACON_MATCH_GLOB,
+} ;
+
 #endif /* _CONSTANTS_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "BitPacking.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+
+const int32 kLanes = 4 ;
+const int32 kValuesPerLane = kBlockSize / kLanes ;
+
+
+static inline uint32
+bit_mask(int32 bits)
+{
+	return bits >= 32 ? 0xffffffff : (1U << bits) - 1 ;
+}
+
+
+int32
+max_bits(const uint32* values, int32 count)
+{
+	uint32 all = 0 ;
+	for (int32 i = 0 ; i < count ; i++)
+		all |= values[i] ;
+
+	int32 bits = 0 ;
+	while (all != 0) {
+		bits++ ;
+		all >>= 1 ;
+	}
+
+	return bits ;
+}
+
+
+void
+pack_block(const uint32* in, uint32* out, int32 bits)
+{
+	if (bits == 0)
+		return ;
+
+	memset(out, 0, kLanes * bits * sizeof(uint32)) ;
+	uint32 mask = bit_mask(bits) ;
+
+	for (int32 lane = 0 ; lane < kLanes ; lane++) {
+		int32 position = 0 ;
+		for (int32 i = 0 ; i < kValuesPerLane ; i++) {
+			uint32 value = in[kLanes * i + lane] & mask ;
+			int32 word = position >> 5 ;
+			int32 shift = position & 31 ;
+
+			out[kLanes * word + lane] |= value << shift ;
+			if (shift + bits > 32)
+				out[kLanes * (word + 1) + lane] |= value >> (32 - shift) ;
+
+			position += bits ;
+		}
+	}
+}
+
+
+void
+unpack_block_scalar(const uint32* in, uint32* out, int32 bits)
+{
+	if (bits == 0) {
+		memset(out, 0, kBlockSize * sizeof(uint32)) ;
+		return ;
+	}
+
+	uint32 mask = bit_mask(bits) ;
+	for (int32 lane = 0 ; lane < kLanes ; lane++) {
+		int32 position = 0 ;
+		for (int32 i = 0 ; i < kValuesPerLane ; i++) {
+			int32 word = position >> 5 ;
+			int32 shift = position & 31 ;
+
+			uint32 value = in[kLanes * word + lane] >> shift ;
+			if (shift + bits > 32)
+				value |= in[kLanes * (word + 1) + lane] << (32 - shift) ;
+			out[kLanes * i + lane] = value & mask ;
+
+			position += bits ;
+		}
+	}
+}
+
+
+#ifdef __SSE2__
+
+static void
+unpack_block_sse2(const uint32* in, uint32* out, int32 bits)
+{
+	const __m128i *source = (const __m128i*)in ;
+	__m128i *destination = (__m128i*)out ;
+	__m128i mask = _mm_set1_epi32(bit_mask(bits)) ;
+	__m128i current = _mm_loadu_si128(source++) ;
+	int32 shift = 0 ;
+
+	// All four lanes sit at the same bit offset, so each step yields
+	// values 4i to 4i + 3 in one go.
+	for (int32 i = 0 ; i < kValuesPerLane ; i++) {
+		__m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift)) ;
+
+		shift += bits ;
+		if (shift >= 32 && i + 1 < kValuesPerLane) {
+			__m128i next = _mm_loadu_si128(source++) ;
+			shift -= 32 ;
+			if (shift > 0) {
+				value = _mm_or_si128(value, _mm_sll_epi32(next,
+					_mm_cvtsi32_si128(bits - shift))) ;
+			}
+			current = next ;
+		}
+
+		_mm_storeu_si128(destination++, _mm_and_si128(value, mask)) ;
+	}
+}
+
+#endif
+
+
+void
+unpack_block(const uint32* in, uint32* out, int32 bits)
+{
+#ifdef __SSE2__
+	if (bits > 0) {
+		unpack_block_sse2(in, out, bits) ;
+		return ;
+	}
+#endif
+	unpack_block_scalar(in, out, bits) ;
+}
+
+
+size_t
+vbyte_encode(const uint32* in, int32 count, uint8* out)
+{
+	uint8 *start = out ;
+	for (int32 i = 0 ; i < count ; i++) {
+		uint32 value = in[i] ;
+		while (value >= 0x80) {
+			*out++ = (value & 0x7f) | 0x80 ;
+			value >>= 7 ;
+		}
+		*out++ = value ;
+	}
+
+	return out - start ;
+}
+
+
+size_t
+vbyte_decode(const uint8* in, const uint8* end, int32 count, uint32* out)
+{
+	// A 32 bit value takes at most five bytes, more is damage.
+	const uint8 *start = in ;
+	for (int32 i = 0 ; i < count ; i++) {
+		uint32 value = 0 ;
+		int32 shift = 0 ;
+		while (in < end && (*in & 0x80) && shift < 28) {
+			value |= (uint32)(*in++ & 0x7f) << shift ;
+			shift += 7 ;
+		}
+		if (in == end || (*in & 0x80))
+			return 0 ;
+		value |= (uint32)*in++ << shift ;
+		out[i] = value ;
+	}
+
+	return in - start ;
+}
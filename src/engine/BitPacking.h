@@ -0,0 +1,41 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _BIT_PACKING_H_
+#define _BIT_PACKING_H_
+
+#include "EngineDefs.h"
+
+#include <stddef.h>
+
+
+// Posting lists are stored in blocks of kBlockSize integers, all packed
+// with the same number of bits. The layout is four interleaved lanes:
+// value i goes to lane i % 4, and word w of lane l is stored at 4 * w + l.
+// That lets one SSE2 register unpack four values at a time, while the
+// scalar code reads the very same bytes.
+const int32 kBlockSize = 128 ;
+
+// Number of bits needed to store the largest of count values.
+int32 max_bits(const uint32* values, int32 count) ;
+
+// Packs kBlockSize values into 4 * bits words.
+void pack_block(const uint32* in, uint32* out, int32 bits) ;
+
+// Unpacks kBlockSize values from 4 * bits words.
+void unpack_block(const uint32* in, uint32* out, int32 bits) ;
+void unpack_block_scalar(const uint32* in, uint32* out, int32 bits) ;
+
+// Variable byte coding for blocks with fewer than kBlockSize values.
+// Returns the number of bytes written or read. Decoding never reads at or
+// past end, and returns 0 if the values don't fit before it.
+size_t vbyte_encode(const uint32* in, int32 count, uint8* out) ;
+size_t vbyte_decode(const uint8* in, const uint8* end, int32 count,
+	uint32* out) ;
+
+#endif /* _BIT_PACKING_H_ */
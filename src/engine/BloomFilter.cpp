@@ -0,0 +1,149 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "BloomFilter.h"
+#include "Checksum.h"
+
+#include <math.h>
+#include <string.h>
+
+
+const int32 kMaxHashCount = 16 ;
+const uint32 kBlockBits = kBloomBlockSize * 8 ;
+
+
+uint64
+bloom_hash(const char* key)
+{
+	return hash64(key, strlen(key), 0x5bd1e995) ;
+}
+
+
+int32
+bloom_bits_for_rate(double falsePositiveRate)
+{
+	if (falsePositiveRate <= 0 || falsePositiveRate >= 1)
+		return 10 ;
+
+	// An ideal filter needs log2(1 / rate) / ln(2) bits per key.
+	return (int32)ceil(-log(falsePositiveRate) / (M_LN2 * M_LN2)) ;
+}
+
+
+// The upper half of a hash picks its block.
+static inline uint32
+block_for(uint64 hash, uint32 blockCount)
+{
+	return (uint32)(((hash >> 32) * blockCount) >> 32) ;
+}
+
+
+// The bits a hash sets in its block, 9 bits of a rehash of it at a time.
+// Stepping through the block instead lets keys that share a step and a
+// start collide completely, which fills filters with many bits per key
+// a lot faster than it should.
+class BloomProbe {
+	public:
+		BloomProbe(uint64 hash)
+			: fState(hash),
+			  fLeft(0)
+		{
+		}
+
+		uint32 Next()
+		{
+			if (fLeft == 0) {
+				// The SplitMix64 step.
+				fState += 0x9e3779b97f4a7c15ULL ;
+				fBits = fState ;
+				fBits = (fBits ^ (fBits >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+				fBits = (fBits ^ (fBits >> 27)) * 0x94d049bb133111ebULL ;
+				fBits ^= fBits >> 31 ;
+				fLeft = 64 / 9 ;
+			}
+
+			uint32 bit = (uint32)(fBits % kBlockBits) ;
+			fBits /= kBlockBits ;
+			fLeft-- ;
+			return bit ;
+		}
+
+	private:
+		uint64	fState ;
+		uint64	fBits ;
+		int32	fLeft ;
+} ;
+
+
+BloomFilterBuilder::BloomFilterBuilder(uint32 keyCount, int32 bitsPerKey)
+{
+	if (bitsPerKey < 1)
+		bitsPerKey = 1 ;
+
+	uint64 bits = (uint64)keyCount * bitsPerKey ;
+	uint32 blockCount = (uint32)((bits + kBlockBits - 1) / kBlockBits) ;
+	if (blockCount == 0)
+		blockCount = 1 ;
+
+	// ln(2) hashes per bit per key is best for a plain filter. Blocks fill
+	// up unevenly, so rounding down does a little better here.
+	int32 hashCount = (int32)(bitsPerKey * M_LN2) ;
+	if (hashCount < 1)
+		hashCount = 1 ;
+	if (hashCount > kMaxHashCount)
+		hashCount = kMaxHashCount ;
+
+	fData.resize(sizeof(bloom_filter_header)
+		+ (size_t)blockCount * kBloomBlockSize) ;
+	bloom_filter_header header ;
+	header.blockCount = blockCount ;
+	header.hashCount = hashCount ;
+	memcpy(&fData[0], &header, sizeof(header)) ;
+}
+
+
+void
+BloomFilterBuilder::Add(uint64 hash)
+{
+	bloom_filter_header header ;
+	memcpy(&header, &fData[0], sizeof(header)) ;
+
+	uint8 *block = &fData[sizeof(header)]
+		+ (size_t)block_for(hash, header.blockCount) * kBloomBlockSize ;
+	BloomProbe probe(hash) ;
+	for (uint32 i = 0 ; i < header.hashCount ; i++) {
+		uint32 bit = probe.Next() ;
+		block[bit / 8] |= 1 << (bit % 8) ;
+	}
+}
+
+
+bool
+bloom_may_contain(const void* data, size_t size, uint64 hash)
+{
+	bloom_filter_header header ;
+	if (size < sizeof(header))
+		return true ;
+	memcpy(&header, data, sizeof(header)) ;
+
+	if (header.blockCount == 0 || header.hashCount == 0
+		|| header.hashCount > (uint32)kMaxHashCount
+		|| (size - sizeof(header)) / kBloomBlockSize < header.blockCount)
+		return true ;
+
+	const uint8 *block = (const uint8*)data + sizeof(header)
+		+ (size_t)block_for(hash, header.blockCount) * kBloomBlockSize ;
+	BloomProbe probe(hash) ;
+	for (uint32 i = 0 ; i < header.hashCount ; i++) {
+		uint32 bit = probe.Next() ;
+		if ((block[bit / 8] & (1 << (bit % 8))) == 0)
+			return false ;
+	}
+
+	return true ;
+}
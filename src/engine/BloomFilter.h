@@ -0,0 +1,59 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _BLOOM_FILTER_H_
+#define _BLOOM_FILTER_H_
+
+#include "EngineDefs.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+
+// A Bloom filter split into blocks of one cache line each, so that a
+// lookup costs a single cache miss. A key hashes to one block and sets a
+// few bits in it. With 10 bits per key about 1% of keys that were never
+// added still seem to be there, and each 5 bits more divide that by
+// about ten.
+//
+//	header		bloom_filter_header
+//	blocks		blockCount blocks of kBloomBlockSize bytes
+const size_t kBloomBlockSize = 64 ;
+
+struct bloom_filter_header {
+	uint32		blockCount ;
+	uint32		hashCount ;
+} ;
+
+
+uint64 bloom_hash(const char* key) ;
+
+// Bits per key for a given rate of false positives, 0.01 for 1%.
+int32 bloom_bits_for_rate(double falsePositiveRate) ;
+
+
+class BloomFilterBuilder {
+	public:
+		BloomFilterBuilder(uint32 keyCount, int32 bitsPerKey) ;
+
+		void Add(uint64 hash) ;
+
+		const void* Data() const { return &fData[0] ; }
+		size_t Size() const { return fData.size() ; }
+
+	private:
+		std::vector<uint8>	fData ;
+} ;
+
+
+// Whether a filter written by BloomFilterBuilder may have the key with
+// this hash. Damaged filters answer yes to everything.
+bool bloom_may_contain(const void* data, size_t size, uint64 hash) ;
+
+#endif /* _BLOOM_FILTER_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "Checksum.h"
+
+#include <string.h>
+
+
+// Eight tables, so that eight bytes go in with one lookup each instead of
+// one byte at a time ("slicing by 8"). Whole segments are checked when an
+// index is opened, so this is worth the 8 KB.
+static uint32 sCRCTables[8][256] ;
+
+
+static struct crc_tables_initializer {
+	crc_tables_initializer()
+	{
+		for (uint32 i = 0 ; i < 256 ; i++) {
+			uint32 crc = i ;
+			for (int32 bit = 0 ; bit < 8 ; bit++)
+				crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1))) ;
+			sCRCTables[0][i] = crc ;
+		}
+
+		for (uint32 i = 0 ; i < 256 ; i++) {
+			uint32 crc = sCRCTables[0][i] ;
+			for (int32 table = 1 ; table < 8 ; table++) {
+				crc = (crc >> 8) ^ sCRCTables[0][crc & 0xff] ;
+				sCRCTables[table][i] = crc ;
+			}
+		}
+	}
+} sCRCTablesInitializer ;
+
+
+uint64
+hash64(const void* data, size_t length, uint64 seed)
+{
+	const uint64 kMultiplier = 0xc6a4a7935bd1e995ULL ;
+	const int kShift = 47 ;
+
+	const uint8 *bytes = (const uint8*)data ;
+	uint64 hash = seed ^ (length * kMultiplier) ;
+
+	const uint8 *end = bytes + (length & ~(size_t)7) ;
+	for ( ; bytes < end ; bytes += 8) {
+		uint64 value ;
+		memcpy(&value, bytes, sizeof(value)) ;
+		value *= kMultiplier ;
+		value ^= value >> kShift ;
+		value *= kMultiplier ;
+		hash ^= value ;
+		hash *= kMultiplier ;
+	}
+
+	uint64 tail = 0 ;
+	for (size_t i = 0 ; i < (length & 7) ; i++)
+		tail |= (uint64)bytes[i] << (i * 8) ;
+	if ((length & 7) != 0) {
+		hash ^= tail ;
+		hash *= kMultiplier ;
+	}
+
+	hash ^= hash >> kShift ;
+	hash *= kMultiplier ;
+	hash ^= hash >> kShift ;
+	return hash ;
+}
+
+
+uint32
+update_crc32(uint32 crc, const void* data, size_t length)
+{
+	const uint8 *bytes = (const uint8*)data ;
+	crc = ~crc ;
+
+	while (length >= 8) {
+		uint32 first = crc ^ (bytes[0] | bytes[1] << 8 | bytes[2] << 16
+			| (uint32)bytes[3] << 24) ;
+		uint32 second = bytes[4] | bytes[5] << 8 | bytes[6] << 16
+			| (uint32)bytes[7] << 24 ;
+		crc = sCRCTables[7][first & 0xff]
+			^ sCRCTables[6][(first >> 8) & 0xff]
+			^ sCRCTables[5][(first >> 16) & 0xff]
+			^ sCRCTables[4][first >> 24]
+			^ sCRCTables[3][second & 0xff]
+			^ sCRCTables[2][(second >> 8) & 0xff]
+			^ sCRCTables[1][(second >> 16) & 0xff]
+			^ sCRCTables[0][second >> 24] ;
+		bytes += 8 ;
+		length -= 8 ;
+	}
+
+	while (length > 0) {
+		crc = (crc >> 8) ^ sCRCTables[0][(crc ^ *bytes++) & 0xff] ;
+		length-- ;
+	}
+
+	return ~crc ;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include "EngineDefs.h"
+
+#include <stddef.h>
+
+
+// The CRC-32 of zlib and PNG. Data given in pieces gives the same result
+// as all of it at once, if each piece goes in with the CRC of the ones
+// before; the first starts with 0.
+uint32 update_crc32(uint32 crc, const void* data, size_t length) ;
+
+inline uint32
+compute_crc32(const void* data, size_t length)
+{
+	return update_crc32(0, data, length) ;
+}
+
+// MurmurHash64A, a quick 64 bit hash that is no good against anyone
+// picking the data on purpose. Data given in pieces can be hashed by
+// passing the hash of one piece as the seed of the next, which isn't the
+// same as hashing all of it at once.
+uint64 hash64(const void* data, size_t length, uint64 seed) ;
+
+#endif /* _CHECKSUM_H_ */
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _ENGINE_DEFS_H_
+#define _ENGINE_DEFS_H_
+
+// The native engine only uses the C++ and POSIX libraries, so that it can
+// be built and benchmarked away from Haiku. Elsewhere, these stand in for
+// the few Haiku types and error codes it needs.
+
+#if defined(__HAIKU__) || defined(__BEOS__)
+#	include <SupportDefs.h>
+#	include <Errors.h>
+#else
+#	include <stdint.h>
+#	include <sys/types.h>
+
+typedef int8_t		int8 ;
+typedef uint8_t		uint8 ;
+typedef int16_t		int16 ;
+typedef uint16_t	uint16 ;
+typedef int32_t		int32 ;
+typedef uint32_t	uint32 ;
+typedef int64_t		int64 ;
+typedef uint64_t	uint64 ;
+typedef int32		status_t ;
+
+#	define B_OK					0
+#	define B_ERROR				(-1)
+#	define B_NO_MEMORY			(-2147483647 - 1)
+#	define B_IO_ERROR			(-2147483647)
+#	define B_BAD_VALUE			(-2147483647 + 4)
+#	define B_NO_INIT			(-2147483647 + 12)
+#	define B_BAD_DATA			(-2147483647 + 15)
+#	define B_ENTRY_NOT_FOUND	(-2147459069)
+#endif
+
+#endif /* _ENGINE_DEFS_H_ */
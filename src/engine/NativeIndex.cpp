@@ -0,0 +1,1423 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "NativeIndex.h"
+#include "Checksum.h"
+#include "WordTokenizer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+
+const int32 kManifestVersion = 1 ;
+const int32 kDefaultMaxFieldLength = 10000 ;
+const int32 kDefaultMaxBufferedDocuments = 10000 ;
+const int32 kDefaultMergeFactor = 4 ;
+const int32 kDefaultPathFilterBits = 10 ;
+
+// BM25 with the usual constants.
+const float kK1 = 1.2f ;
+const float kB = 0.75f ;
+
+
+struct merge_document {
+	const char	*path ;
+	int32		source ;
+	uint32		doc ;
+} ;
+
+
+static bool
+path_less(const merge_document& first, const merge_document& second)
+{
+	int compare = strcmp(first.path, second.path) ;
+	if (compare != 0)
+		return compare < 0 ;
+	if (first.source != second.source)
+		return first.source < second.source ;
+	return first.doc < second.doc ;
+}
+
+
+static bool
+pending_path_less(const std::pair<const char*, uint32>& first,
+	const std::pair<const char*, uint32>& second)
+{
+	return strcmp(first.first, second.first) < 0 ;
+}
+
+
+// Orders hits best first, and keeps equal scores in document order.
+static bool
+better_hit(const native_hit& first, const native_hit& second)
+{
+	if (first.score != second.score)
+		return first.score > second.score ;
+	if (first.segment != second.segment)
+		return first.segment < second.segment ;
+	return first.doc < second.doc ;
+}
+
+
+static bool
+has_suffix(const char* name, const char* suffix)
+{
+	size_t length = strlen(name), suffixLength = strlen(suffix) ;
+	return length >= suffixLength
+		&& strcmp(name + length - suffixLength, suffix) == 0 ;
+}
+
+
+NativeIndex::NativeIndex()
+	: fOpen(false),
+	  fGeneration(0),
+	  fCounter(0),
+	  fMaxFieldLength(kDefaultMaxFieldLength),
+	  fMaxBufferedDocuments(kDefaultMaxBufferedDocuments),
+	  fMergeFactor(kDefaultMergeFactor),
+	  fPathFilterBits(kDefaultPathFilterBits),
+	  fRecovery(false),
+	  fChanged(false),
+	  fDamagedCount(0),
+	  fLostPathsKnown(true),
+	  fLivePending(0)
+{
+}
+
+
+NativeIndex::~NativeIndex()
+{
+	Close() ;
+}
+
+
+bool
+NativeIndex::Exists(const char* directory)
+{
+	std::string path(directory) ;
+	path += "/" NATIVE_MANIFEST_FILE ;
+
+	struct stat st ;
+	return stat(path.c_str(), &st) == 0 ;
+}
+
+
+status_t
+NativeIndex::Open(const char* directory, bool create)
+{
+	Close() ;
+	fDirectory = directory ;
+
+	if (!Exists(directory)) {
+		if (!create)
+			return B_ENTRY_NOT_FOUND ;
+		if (mkdir(directory, 0777) != 0 && errno != EEXIST)
+			return B_IO_ERROR ;
+
+		// Nothing is written until the first commit.
+		fGeneration = 0 ;
+		fCounter = 0 ;
+		fOpen = true ;
+		return B_OK ;
+	}
+
+	segment_list segments, damaged ;
+	status_t status = ReadManifest(&segments, &damaged, &fGeneration,
+		&fCounter) ;
+	if (status != B_OK) {
+		FreeSegments(&segments) ;
+		FreeSegments(&damaged) ;
+		return status ;
+	}
+
+	fSegments = segments ;
+	fOpen = true ;
+
+	if (fRecovery && !damaged.empty())
+		Quarantine(damaged) ;
+	FreeSegments(&damaged) ;
+	return B_OK ;
+}
+
+
+void
+NativeIndex::Close()
+{
+	FreeSegments(&fSegments) ;
+	fPending.clear() ;
+	fPendingPaths.clear() ;
+	fPendingTerms.clear() ;
+	fPendingPostings.clear() ;
+	fLivePending = 0 ;
+	fChanged = false ;
+	fDamagedCount = 0 ;
+	fLostPaths.clear() ;
+	fLostPathsKnown = true ;
+	fOpen = false ;
+}
+
+
+status_t
+NativeIndex::Refresh()
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	// Most of the time nothing has been committed since the last look.
+	FILE *file = fopen(FilePath(NATIVE_MANIFEST_FILE).c_str(), "r") ;
+	if (file == NULL)
+		return B_ENTRY_NOT_FOUND ;
+	char line[64] ;
+	long long current = -1 ;
+	while (fgets(line, sizeof(line), file) != NULL
+		&& sscanf(line, "generation %lld", &current) != 1)
+		;
+	fclose(file) ;
+	if (current == fGeneration)
+		return B_OK ;
+
+	segment_list segments, damaged ;
+	int64 generation ;
+	uint32 counter ;
+	status_t status = ReadManifest(&segments, &damaged, &generation,
+		&counter) ;
+	FreeSegments(&damaged) ;
+	if (status != B_OK) {
+		// Most likely a merge removed a segment under us, the next try
+		// will see the manifest that goes with it.
+		FreeSegments(&segments) ;
+		return status ;
+	}
+
+	FreeSegments(&fSegments) ;
+	fSegments = segments ;
+	fGeneration = generation ;
+	fCounter = counter ;
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::ReadManifest(segment_list* segments, segment_list* damaged,
+	int64* generation, uint32* counter)
+{
+	std::string path = FilePath(NATIVE_MANIFEST_FILE) ;
+	FILE *file = fopen(path.c_str(), "r") ;
+	if (file == NULL)
+		return B_ENTRY_NOT_FOUND ;
+
+	char line[512], name[256], deletions[256] ;
+	int32 version = 0 ;
+	long long value ;
+	unsigned int number ;
+	status_t status = B_OK ;
+	*generation = 0 ;
+	*counter = 0 ;
+
+	while (status == B_OK && fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "native %d", &version) == 1)
+			continue ;
+		if (sscanf(line, "generation %lld", &value) == 1) {
+			*generation = value ;
+			continue ;
+		}
+		if (sscanf(line, "counter %u", &number) == 1) {
+			*counter = number ;
+			continue ;
+		}
+		if (sscanf(line, "segment %255s %255s", name, deletions) != 2) {
+			status = B_BAD_DATA ;
+			break ;
+		}
+
+		segment_info *info = new segment_info ;
+		info->name = name ;
+		info->deletions = strcmp(deletions, "-") == 0 ? "" : deletions ;
+		info->reader = NULL ;
+		info->deletedCount = 0 ;
+		info->dirty = false ;
+		segments->push_back(info) ;
+
+		// Segments never change, so one we have open already can be
+		// shared with the new list.
+		for (size_t i = 0 ; i < fSegments.size() ; i++) {
+			if (fSegments[i]->name == info->name
+				&& fSegments[i]->reader != NULL) {
+				info->reader = fSegments[i]->reader ;
+				fSegments[i]->reader = NULL ;
+				break ;
+			}
+		}
+
+		if (info->reader == NULL) {
+			info->reader = new SegmentReader ;
+			std::string segmentPath = FilePath(info->name + ".seg") ;
+			status = info->reader->Open(segmentPath.c_str(), fRecovery) ;
+		}
+		if (status == B_OK)
+			status = LoadDeletions(info) ;
+
+		// A missing file is only damage when nobody else could have
+		// removed it, otherwise it may be a merge going on.
+		if (status == B_BAD_DATA
+			|| (fRecovery && status == B_ENTRY_NOT_FOUND)) {
+			segments->pop_back() ;
+			damaged->push_back(info) ;
+			status = B_OK ;
+		}
+	}
+
+	fclose(file) ;
+
+	if (status == B_OK && version != kManifestVersion)
+		status = B_BAD_DATA ;
+
+	if (status != B_OK) {
+		ReturnReaders(segments) ;
+		ReturnReaders(damaged) ;
+	}
+
+	return status ;
+}
+
+
+void
+NativeIndex::ReturnReaders(segment_list* segments)
+{
+	// Give back what was borrowed from the current list.
+	for (size_t i = 0 ; i < segments->size() ; i++) {
+		segment_info *info = (*segments)[i] ;
+		for (size_t j = 0 ; j < fSegments.size() ; j++) {
+			if (fSegments[j]->name == info->name
+				&& fSegments[j]->reader == NULL) {
+				fSegments[j]->reader = info->reader ;
+				info->reader = NULL ;
+				break ;
+			}
+		}
+	}
+}
+
+
+void
+NativeIndex::Quarantine(const segment_list& damaged)
+{
+	// The paths are needed before the files go, since the damaged
+	// segment itself can't be trusted to tell them.
+	for (size_t i = 0 ; i < damaged.size() ; i++) {
+		std::vector<std::string> paths ;
+		if (read_path_list(FilePath(damaged[i]->name + ".pth").c_str(),
+				&paths) == B_OK)
+			fLostPaths.insert(fLostPaths.end(), paths.begin(), paths.end()) ;
+		else
+			fLostPathsKnown = false ;
+	}
+	fDamagedCount += damaged.size() ;
+
+	// Without the damaged segments. Should this fail, they are found
+	// again the next time the index is opened.
+	fGeneration++ ;
+	if (WriteManifest() != B_OK) {
+		fGeneration-- ;
+		return ;
+	}
+
+	// Kept for a look at what went wrong, RemoveUnusedFiles() leaves them.
+	for (size_t i = 0 ; i < damaged.size() ; i++) {
+		const segment_info *info = damaged[i] ;
+		const char *files[] = { ".seg", ".pth" } ;
+		for (size_t j = 0 ; j < sizeof(files) / sizeof(files[0]) ; j++) {
+			std::string path = FilePath(info->name + files[j]) ;
+			rename(path.c_str(), (path + ".damaged").c_str()) ;
+		}
+		if (!info->deletions.empty()) {
+			std::string path = FilePath(info->deletions) ;
+			rename(path.c_str(), (path + ".damaged").c_str()) ;
+		}
+	}
+}
+
+
+status_t
+NativeIndex::WriteManifest()
+{
+	std::string path = FilePath(NATIVE_MANIFEST_FILE) ;
+	std::string tempPath = path + ".tmp" ;
+
+	FILE *file = fopen(tempPath.c_str(), "w") ;
+	if (file == NULL)
+		return B_IO_ERROR ;
+
+	fprintf(file, "native %d\n", (int)kManifestVersion) ;
+	fprintf(file, "generation %lld\n", (long long)fGeneration) ;
+	fprintf(file, "counter %u\n", (unsigned int)fCounter) ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		segment_info *info = fSegments[i] ;
+		fprintf(file, "segment %s %s\n", info->name.c_str(),
+			info->deletions.empty() ? "-" : info->deletions.c_str()) ;
+	}
+
+	bool failed = ferror(file) || fflush(file) != 0
+		|| fsync(fileno(file)) != 0 ;
+	if (fclose(file) != 0 || failed) {
+		unlink(tempPath.c_str()) ;
+		return B_IO_ERROR ;
+	}
+
+	// The rename is the commit: readers either see all of it or none.
+	if (rename(tempPath.c_str(), path.c_str()) != 0)
+		return B_IO_ERROR ;
+
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::LoadDeletions(segment_info* info)
+{
+	size_t size = (info->reader->CountDocuments() + 7) / 8 ;
+	info->deleted.assign(size, 0) ;
+	info->deletedCount = 0 ;
+	if (info->deletions.empty())
+		return B_OK ;
+
+	FILE *file = fopen(FilePath(info->deletions).c_str(), "rb") ;
+	if (file == NULL)
+		return B_ENTRY_NOT_FOUND ;
+
+	// Deletions written before they had a checksum end with the bitmap.
+	size_t read = size > 0 ? fread(&info->deleted[0], 1, size, file) : 0 ;
+	uint32 checksum ;
+	bool hasChecksum = fread(&checksum, sizeof(checksum), 1, file) == 1 ;
+	fclose(file) ;
+	if (read != size || (hasChecksum && checksum
+			!= (size > 0 ? compute_crc32(&info->deleted[0], size) : 0)))
+		return B_BAD_DATA ;
+
+	for (uint32 doc = 0 ; doc < info->reader->CountDocuments() ; doc++) {
+		if (IsDeleted(info, doc))
+			info->deletedCount++ ;
+	}
+
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::WriteDeletions(segment_info* info)
+{
+	char name[256] ;
+	snprintf(name, sizeof(name), "%s_%lld.del", info->name.c_str(),
+		(long long)fGeneration) ;
+
+	FILE *file = fopen(FilePath(name).c_str(), "wb") ;
+	if (file == NULL)
+		return B_IO_ERROR ;
+
+	size_t size = info->deleted.size() ;
+	uint32 checksum = size > 0 ? compute_crc32(&info->deleted[0], size) : 0 ;
+	bool failed = (size > 0 && fwrite(&info->deleted[0], 1, size, file)
+			!= size)
+		|| fwrite(&checksum, sizeof(checksum), 1, file) != 1
+		|| fflush(file) != 0 || fsync(fileno(file)) != 0 ;
+	if (fclose(file) != 0 || failed) {
+		unlink(FilePath(name).c_str()) ;
+		return B_IO_ERROR ;
+	}
+
+	info->deletions = name ;
+	info->dirty = false ;
+	return B_OK ;
+}
+
+
+void
+NativeIndex::RemoveUnusedFiles()
+{
+	DIR *dir = opendir(fDirectory.c_str()) ;
+	if (dir == NULL)
+		return ;
+
+	// Readers that still have a removed segment mapped keep it alive
+	// until they move on.
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		const char *name = entry->d_name ;
+		if (name[0] != '_' || (!has_suffix(name, ".seg")
+			&& !has_suffix(name, ".del") && !has_suffix(name, ".pth")))
+			continue ;
+
+		bool used = false ;
+		for (size_t i = 0 ; i < fSegments.size() && !used ; i++) {
+			used = fSegments[i]->name + ".seg" == name
+				|| fSegments[i]->name + ".pth" == name
+				|| fSegments[i]->deletions == name ;
+		}
+
+		if (!used)
+			unlink(FilePath(name).c_str()) ;
+	}
+
+	closedir(dir) ;
+}
+
+
+void
+NativeIndex::FreeSegments(segment_list* segments)
+{
+	for (size_t i = 0 ; i < segments->size() ; i++) {
+		delete (*segments)[i]->reader ;
+		delete (*segments)[i] ;
+	}
+	segments->clear() ;
+}
+
+
+bool
+NativeIndex::IsDeleted(const segment_info* info, uint32 doc) const
+{
+	// Numbers past the end only come from damage, nothing is there.
+	if (doc / 8 >= info->deleted.size())
+		return true ;
+
+	return (info->deleted[doc / 8] & (1 << (doc % 8))) != 0 ;
+}
+
+
+bool
+NativeIndex::Delete(segment_info* info, uint32 doc)
+{
+	if (IsDeleted(info, doc))
+		return false ;
+
+	info->deleted[doc / 8] |= 1 << (doc % 8) ;
+	info->deletedCount++ ;
+	info->dirty = true ;
+	return true ;
+}
+
+
+status_t
+NativeIndex::AddDocument(const native_document* document)
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	// A document replaces whatever was indexed for its path before.
+	RemovePath(document->path) ;
+
+	uint32 index = fPending.size() ;
+	fPending.push_back(pending_document()) ;
+	pending_document &pending = fPending.back() ;
+	pending.path = document->path ;
+	pending.mimeType = document->mimeType != NULL ? document->mimeType : "" ;
+	pending.excerpt = document->excerpt != NULL ? document->excerpt : "" ;
+	pending.size = document->size ;
+	pending.modified = document->modified ;
+	pending.removed = false ;
+
+	WordTokenizer tokenizer(document->text, document->textLength) ;
+	const char *token ;
+	size_t length ;
+	uint32 total = 0 ;
+	while ((int32)total < fMaxFieldLength
+		&& (token = tokenizer.Next(&length)) != NULL) {
+		std::pair<std::map<std::string, uint32>::iterator, bool> term
+			= fPendingTerms.insert(std::make_pair(std::string(token, length),
+				(uint32)fPendingPostings.size())) ;
+		if (term.second)
+			fPendingPostings.push_back(std::vector<uint32>()) ;
+
+		// Postings are (document, frequency) pairs, and this document is
+		// always the last one of them.
+		std::vector<uint32> &postings = fPendingPostings[term.first->second] ;
+		if (!postings.empty() && postings[postings.size() - 2] == index)
+			postings.back()++ ;
+		else {
+			postings.push_back(index) ;
+			postings.push_back(1) ;
+		}
+		total++ ;
+	}
+	pending.length = total ;
+
+	fPendingPaths[pending.path] = index ;
+	fLivePending++ ;
+	fChanged = true ;
+
+	if ((int32)fLivePending >= fMaxBufferedDocuments)
+		return Flush() ;
+
+	return B_OK ;
+}
+
+
+int32
+NativeIndex::RemovePath(const char* path)
+{
+	// Most paths removed are of files that are new, or were never indexed,
+	// and the filters rule out nearly every segment for them.
+	uint64 hash = bloom_hash(path) ;
+	int32 removed = 0 ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		SegmentReader *reader = fSegments[i]->reader ;
+		if (!reader->MayHavePath(hash))
+			continue ;
+
+		uint32 doc = reader->LowerBound(path) ;
+		if (doc < reader->CountDocuments()
+			&& strcmp(reader->PathAt(doc), path) == 0
+			&& Delete(fSegments[i], doc))
+			removed++ ;
+	}
+
+	std::map<std::string, uint32>::iterator pending = fPendingPaths.find(path) ;
+	if (pending != fPendingPaths.end()) {
+		fPending[pending->second].removed = true ;
+		fPendingPaths.erase(pending) ;
+		fLivePending-- ;
+		removed++ ;
+	}
+
+	if (removed > 0)
+		fChanged = true ;
+	return removed ;
+}
+
+
+int32
+NativeIndex::RemoveSubtree(const char* path)
+{
+	// Documents are in path order, so everything under a directory is one
+	// run of documents in each segment.
+	std::string prefix(path) ;
+	if (prefix.empty() || prefix[prefix.size() - 1] != '/')
+		prefix += "/" ;
+
+	int32 removed = 0 ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		SegmentReader *reader = fSegments[i]->reader ;
+		for (uint32 doc = reader->LowerBound(prefix.c_str()) ;
+			doc < reader->CountDocuments()
+				&& strncmp(reader->PathAt(doc), prefix.c_str(),
+					prefix.size()) == 0 ; doc++) {
+			if (Delete(fSegments[i], doc))
+				removed++ ;
+		}
+	}
+
+	std::map<std::string, uint32>::iterator pending
+		= fPendingPaths.lower_bound(prefix) ;
+	while (pending != fPendingPaths.end()
+		&& pending->first.compare(0, prefix.size(), prefix) == 0) {
+		fPending[pending->second].removed = true ;
+		fPendingPaths.erase(pending++) ;
+		fLivePending-- ;
+		removed++ ;
+	}
+
+	if (removed > 0)
+		fChanged = true ;
+	return removed ;
+}
+
+
+status_t
+NativeIndex::Commit()
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	status_t status = Flush() ;
+	if (status == B_OK)
+		status = Merge() ;
+	if (status != B_OK)
+		return status ;
+
+	// The first commit writes a manifest even for an empty index.
+	if (!fChanged && fGeneration > 0)
+		return B_OK ;
+
+	fGeneration++ ;
+
+	for (size_t i = 0 ; i < fSegments.size() ; ) {
+		segment_info *info = fSegments[i] ;
+		if (info->deletedCount == info->reader->CountDocuments()) {
+			delete info->reader ;
+			delete info ;
+			fSegments.erase(fSegments.begin() + i) ;
+			continue ;
+		}
+
+		if (info->dirty && (status = WriteDeletions(info)) != B_OK)
+			break ;
+		i++ ;
+	}
+
+	if (status == B_OK)
+		status = WriteManifest() ;
+	if (status != B_OK) {
+		fGeneration-- ;
+		return status ;
+	}
+
+	RemoveUnusedFiles() ;
+	fChanged = false ;
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::AddIndex(const char* directory)
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	segment_list taken ;
+	status_t status = TakeSegments(directory, &taken) ;
+	if (status != B_OK)
+		return status ;
+
+	AppendSegments(taken, NULL) ;
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::ReplaceSubtree(const char* path, const char* directory,
+	uint64 since)
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	// Nothing is removed until the segments are ours.
+	segment_list taken ;
+	status_t status = TakeSegments(directory, &taken) ;
+	if (status != B_OK)
+		return status ;
+
+	std::string prefix(path) ;
+	if (prefix.empty() || prefix[prefix.size() - 1] != '/')
+		prefix += "/" ;
+
+	// Whatever changed since the other index was made has been indexed
+	// here since, and stays.
+	std::set<std::string> kept ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		SegmentReader *reader = fSegments[i]->reader ;
+		for (uint32 doc = reader->LowerBound(prefix.c_str()) ;
+			doc < reader->CountDocuments()
+				&& strncmp(reader->PathAt(doc), prefix.c_str(),
+					prefix.size()) == 0 ; doc++) {
+			if (IsDeleted(fSegments[i], doc))
+				continue ;
+
+			stored_document document ;
+			if (reader->GetDocument(doc, &document) == B_OK && since > 0
+				&& document.modified >= since)
+				kept.insert(document.path) ;
+			else
+				Delete(fSegments[i], doc) ;
+		}
+	}
+
+	std::map<std::string, uint32>::iterator pending
+		= fPendingPaths.lower_bound(prefix) ;
+	for ( ; pending != fPendingPaths.end()
+		&& pending->first.compare(0, prefix.size(), prefix) == 0 ; pending++)
+		kept.insert(pending->first) ;
+
+	AppendSegments(taken, &kept) ;
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::Optimize()
+{
+	if (!fOpen)
+		return B_NO_INIT ;
+
+	status_t status = Flush() ;
+	if (status != B_OK)
+		return status ;
+
+	if (fSegments.size() > 1
+		|| (fSegments.size() == 1 && fSegments[0]->deletedCount > 0)) {
+		segment_list all(fSegments) ;
+		status = MergeSegments(all) ;
+	}
+
+	return status ;
+}
+
+
+status_t
+NativeIndex::TakeSegments(const char* directory, segment_list* taken)
+{
+	NativeIndex source ;
+	status_t status = source.Open(directory, false) ;
+	if (status != B_OK)
+		return status ;
+
+	// Segments are moved under new names, with the deletions they had.
+	for (size_t i = 0 ; i < source.fSegments.size() ; i++) {
+		segment_info *from = source.fSegments[i] ;
+		segment_info *info = new segment_info ;
+		info->name = NextName() ;
+		info->reader = new SegmentReader ;
+		info->dirty = from->deletedCount > 0 ;
+
+		// The list of paths is only needed to recover from damage, it may
+		// not be there.
+		std::string segmentPath = FilePath(info->name + ".seg") ;
+		if (rename(source.FilePath(from->name + ".seg").c_str(),
+				segmentPath.c_str()) != 0)
+			status = B_IO_ERROR ;
+		else {
+			rename(source.FilePath(from->name + ".pth").c_str(),
+				FilePath(info->name + ".pth").c_str()) ;
+			taken->push_back(info) ;
+			status = info->reader->Open(segmentPath.c_str(), false) ;
+			if (status == B_OK && info->reader->CountDocuments()
+					!= from->reader->CountDocuments())
+				status = B_BAD_DATA ;
+		}
+
+		if (status != B_OK) {
+			if (taken->empty() || taken->back() != info) {
+				delete info->reader ;
+				delete info ;
+			}
+			break ;
+		}
+
+		info->deleted = from->deleted ;
+		info->deletedCount = from->deletedCount ;
+	}
+
+	if (status != B_OK) {
+		// Put back what was moved already.
+		const char *files[] = { ".seg", ".pth" } ;
+		for (size_t i = 0 ; i < taken->size() ; i++) {
+			for (size_t j = 0 ; j < sizeof(files) / sizeof(files[0]) ; j++) {
+				rename(FilePath((*taken)[i]->name + files[j]).c_str(),
+					source.FilePath(source.fSegments[i]->name
+						+ files[j]).c_str()) ;
+			}
+		}
+		FreeSegments(taken) ;
+	}
+
+	return status ;
+}
+
+
+void
+NativeIndex::AppendSegments(const segment_list& taken,
+	const std::set<std::string>* kept)
+{
+	for (size_t i = 0 ; i < taken.size() ; i++) {
+		segment_info *info = taken[i] ;
+		SegmentReader *reader = info->reader ;
+		for (uint32 doc = 0 ; doc < reader->CountDocuments() ; doc++) {
+			if (IsDeleted(info, doc))
+				continue ;
+
+			if (kept == NULL)
+				RemovePath(reader->PathAt(doc)) ;
+			else if (kept->find(reader->PathAt(doc)) != kept->end())
+				Delete(info, doc) ;
+		}
+	}
+
+	fSegments.insert(fSegments.end(), taken.begin(), taken.end()) ;
+	fChanged = true ;
+}
+
+
+void
+NativeIndex::SetMaxFieldLength(int32 length)
+{
+	fMaxFieldLength = length ;
+}
+
+
+void
+NativeIndex::SetMaxBufferedDocuments(int32 count)
+{
+	fMaxBufferedDocuments = count > 0 ? count : 1 ;
+}
+
+
+void
+NativeIndex::SetMergeFactor(int32 factor)
+{
+	fMergeFactor = factor > 1 ? factor : 2 ;
+}
+
+
+void
+NativeIndex::SetPathFilterBits(int32 bitsPerPath)
+{
+	fPathFilterBits = bitsPerPath > 0 ? bitsPerPath : 0 ;
+}
+
+
+void
+NativeIndex::SetRecovery(bool recover)
+{
+	fRecovery = recover ;
+}
+
+
+status_t
+NativeIndex::TakeLostPaths(native_path_callback callback, void* cookie)
+{
+	for (size_t i = 0 ; i < fLostPaths.size() ; i++)
+		callback(fLostPaths[i].c_str(), cookie) ;
+
+	status_t status = fLostPathsKnown ? B_OK : B_BAD_DATA ;
+	fLostPaths.clear() ;
+	fLostPathsKnown = true ;
+	return status ;
+}
+
+
+status_t
+NativeIndex::Flush()
+{
+	if (fLivePending == 0) {
+		fPending.clear() ;
+		fPendingPaths.clear() ;
+		fPendingTerms.clear() ;
+		fPendingPostings.clear() ;
+		return B_OK ;
+	}
+
+	// Number the documents in path order.
+	std::vector<std::pair<const char*, uint32> > order ;
+	for (uint32 i = 0 ; i < fPending.size() ; i++) {
+		if (!fPending[i].removed)
+			order.push_back(std::make_pair(fPending[i].path.c_str(), i)) ;
+	}
+	std::sort(order.begin(), order.end(), pending_path_less) ;
+
+	std::vector<uint32> numbers(fPending.size(), kEndDoc) ;
+	for (uint32 i = 0 ; i < order.size() ; i++)
+		numbers[order[i].second] = i ;
+
+	std::string name = NextName() ;
+	SegmentWriter writer ;
+	writer.SetPathFilter(fPathFilterBits) ;
+	writer.SetPathList(FilePath(name + ".pth").c_str()) ;
+	status_t status = writer.Open(FilePath(name + ".seg").c_str()) ;
+
+	for (uint32 i = 0 ; status == B_OK && i < order.size() ; i++) {
+		const pending_document &pending = fPending[order[i].second] ;
+		stored_document document ;
+		document.path = pending.path.c_str() ;
+		document.mimeType = pending.mimeType.c_str() ;
+		document.excerpt = pending.excerpt.c_str() ;
+		document.size = pending.size ;
+		document.modified = pending.modified ;
+		document.length = pending.length ;
+		status = writer.AddDocument(&document) ;
+	}
+
+	std::vector<std::pair<uint32, uint32> > postings ;
+	std::vector<uint32> docs, freqs ;
+	std::map<std::string, uint32>::iterator term ;
+	for (term = fPendingTerms.begin() ; status == B_OK
+		&& term != fPendingTerms.end() ; term++) {
+		const std::vector<uint32> &pending = fPendingPostings[term->second] ;
+		postings.clear() ;
+		for (size_t i = 0 ; i < pending.size() ; i += 2) {
+			if (numbers[pending[i]] != kEndDoc) {
+				postings.push_back(std::make_pair(numbers[pending[i]],
+					pending[i + 1])) ;
+			}
+		}
+		if (postings.empty())
+			continue ;
+
+		std::sort(postings.begin(), postings.end()) ;
+		docs.resize(postings.size()) ;
+		freqs.resize(postings.size()) ;
+		for (size_t i = 0 ; i < postings.size() ; i++) {
+			docs[i] = postings[i].first ;
+			freqs[i] = postings[i].second ;
+		}
+		status = writer.AddTerm(term->first.c_str(), &docs[0], &freqs[0],
+			docs.size()) ;
+	}
+
+	if (status == B_OK)
+		status = writer.Finish() ;
+	else
+		writer.Abort() ;
+
+	segment_info *info = new segment_info ;
+	info->name = name ;
+	info->reader = new SegmentReader ;
+	info->dirty = false ;
+	if (status == B_OK)
+		status = info->reader->Open(FilePath(name + ".seg").c_str(),
+			false) ;
+	if (status == B_OK)
+		status = LoadDeletions(info) ;
+	if (status != B_OK) {
+		delete info->reader ;
+		delete info ;
+		return status ;
+	}
+
+	fSegments.push_back(info) ;
+	fPending.clear() ;
+	fPendingPaths.clear() ;
+	fPendingTerms.clear() ;
+	fPendingPostings.clear() ;
+	fLivePending = 0 ;
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::Merge()
+{
+	// Segments are grouped into levels by size, a level being fMergeFactor
+	// times bigger than the one below. Whenever a level fills up, its
+	// segments become one segment of the next level, so every document
+	// is rewritten about log(documents) times in all.
+	while (true) {
+		std::map<int32, segment_list> levels ;
+		for (size_t i = 0 ; i < fSegments.size() ; i++) {
+			segment_info *info = fSegments[i] ;
+			uint32 live = info->reader->CountDocuments() - info->deletedCount ;
+			int32 level = 0 ;
+			for (uint64 size = fMergeFactor ; size <= live ;
+				size *= fMergeFactor)
+				level++ ;
+			levels[level].push_back(info) ;
+		}
+
+		segment_list *full = NULL ;
+		std::map<int32, segment_list>::iterator level ;
+		for (level = levels.begin() ; level != levels.end() ; level++) {
+			if ((int32)level->second.size() >= fMergeFactor) {
+				full = &level->second ;
+				break ;
+			}
+		}
+		if (full == NULL)
+			break ;
+
+		full->resize(fMergeFactor) ;
+		status_t status = MergeSegments(*full) ;
+		if (status != B_OK)
+			return status ;
+	}
+
+	// Rewrite segments that are mostly deleted documents, which is what
+	// removing a big subtree leaves behind.
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		segment_info *info = fSegments[i] ;
+		if (info->deletedCount > 0
+			&& info->deletedCount * 2 > info->reader->CountDocuments()
+			&& info->deletedCount < info->reader->CountDocuments()) {
+			segment_list single(1, info) ;
+			status_t status = MergeSegments(single) ;
+			if (status != B_OK)
+				return status ;
+			i = (size_t)-1 ;
+		}
+	}
+
+	return B_OK ;
+}
+
+
+status_t
+NativeIndex::MergeSegments(const segment_list& segments)
+{
+	// Live documents of all segments, merged into path order.
+	std::vector<merge_document> documents ;
+	std::vector<std::vector<uint32> > numbers(segments.size()) ;
+	for (size_t i = 0 ; i < segments.size() ; i++) {
+		SegmentReader *reader = segments[i]->reader ;
+		numbers[i].assign(reader->CountDocuments(), kEndDoc) ;
+		for (uint32 doc = 0 ; doc < reader->CountDocuments() ; doc++) {
+			// What can't be read anymore is left behind.
+			stored_document stored ;
+			if (IsDeleted(segments[i], doc)
+				|| reader->GetDocument(doc, &stored) != B_OK)
+				continue ;
+
+			merge_document document ;
+			document.path = stored.path ;
+			document.source = i ;
+			document.doc = doc ;
+			documents.push_back(document) ;
+		}
+	}
+	std::sort(documents.begin(), documents.end(), path_less) ;
+
+	std::string name = NextName() ;
+	SegmentWriter writer ;
+	writer.SetPathFilter(fPathFilterBits) ;
+	writer.SetPathList(FilePath(name + ".pth").c_str()) ;
+	status_t status = B_OK ;
+	if (!documents.empty())
+		status = writer.Open(FilePath(name + ".seg").c_str()) ;
+
+	for (uint32 i = 0 ; status == B_OK && i < documents.size() ; i++) {
+		stored_document document ;
+		segments[documents[i].source]->reader->GetDocument(documents[i].doc,
+			&document) ;
+		numbers[documents[i].source][documents[i].doc] = i ;
+		status = writer.AddDocument(&document) ;
+	}
+
+	// Walk the term dictionaries side by side. Numbers only grow within a
+	// segment, so a term's postings need sorting only when it comes from
+	// more than one.
+	std::vector<uint32> positions(segments.size(), 0) ;
+	std::vector<std::pair<uint32, uint32> > postings ;
+	std::vector<uint32> docs, freqs ;
+	PostingIterator iterator ;
+
+	while (status == B_OK && !documents.empty()) {
+		const char *text = NULL ;
+		for (size_t i = 0 ; i < segments.size() ; i++) {
+			SegmentReader *reader = segments[i]->reader ;
+			if (positions[i] < reader->CountTerms() && (text == NULL
+				|| strcmp(reader->TermAt(positions[i]), text) < 0))
+				text = reader->TermAt(positions[i]) ;
+		}
+		if (text == NULL)
+			break ;
+
+		std::string term(text) ;
+		int32 sources = 0 ;
+		postings.clear() ;
+		for (size_t i = 0 ; i < segments.size() ; i++) {
+			SegmentReader *reader = segments[i]->reader ;
+			if (positions[i] >= reader->CountTerms()
+				|| term != reader->TermAt(positions[i]))
+				continue ;
+
+			size_t before = postings.size() ;
+			reader->GetPostings(positions[i]++, &iterator) ;
+			for (uint32 doc = iterator.Doc() ; doc != kEndDoc ;
+				doc = iterator.Next()) {
+				if (numbers[i][doc] != kEndDoc) {
+					postings.push_back(std::make_pair(numbers[i][doc],
+						iterator.Freq())) ;
+				}
+			}
+			if (postings.size() > before)
+				sources++ ;
+		}
+		if (postings.empty())
+			continue ;
+
+		if (sources > 1)
+			std::sort(postings.begin(), postings.end()) ;
+		docs.resize(postings.size()) ;
+		freqs.resize(postings.size()) ;
+		for (size_t i = 0 ; i < postings.size() ; i++) {
+			docs[i] = postings[i].first ;
+			freqs[i] = postings[i].second ;
+		}
+		status = writer.AddTerm(term.c_str(), &docs[0], &freqs[0],
+			docs.size()) ;
+	}
+
+	segment_info *info = NULL ;
+	if (!documents.empty()) {
+		if (status == B_OK)
+			status = writer.Finish() ;
+		else
+			writer.Abort() ;
+
+		info = new segment_info ;
+		info->name = name ;
+		info->reader = new SegmentReader ;
+		info->dirty = false ;
+		if (status == B_OK)
+			status = info->reader->Open(FilePath(name + ".seg").c_str(),
+				false) ;
+		if (status == B_OK)
+			status = LoadDeletions(info) ;
+		if (status != B_OK) {
+			delete info->reader ;
+			delete info ;
+			return status ;
+		}
+	}
+
+	for (size_t i = 0 ; i < segments.size() ; i++) {
+		fSegments.erase(std::find(fSegments.begin(), fSegments.end(),
+			segments[i])) ;
+		delete segments[i]->reader ;
+		delete segments[i] ;
+	}
+	if (info != NULL)
+		fSegments.push_back(info) ;
+
+	fChanged = true ;
+	return B_OK ;
+}
+
+
+std::string
+NativeIndex::NextName()
+{
+	char name[32] ;
+	snprintf(name, sizeof(name), "_%u", (unsigned int)fCounter++) ;
+	return name ;
+}
+
+
+std::string
+NativeIndex::FilePath(const std::string& name) const
+{
+	return fDirectory + "/" + name ;
+}
+
+
+uint32
+NativeIndex::CountDocuments() const
+{
+	uint32 count = 0 ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++)
+		count += fSegments[i]->reader->CountDocuments()
+			- fSegments[i]->deletedCount ;
+
+	return count ;
+}
+
+
+int32
+NativeIndex::Search(const native_clause* clauses, int32 clauseCount,
+	native_filter filter, void* cookie, native_hit* hits, int32 maxHits)
+{
+	if (maxHits <= 0 || clauseCount <= 0)
+		return 0 ;
+
+	// Statistics are taken over the whole index, so that scores can be
+	// compared between segments.
+	uint64 documents = 0, totalLength = 0 ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		documents += fSegments[i]->reader->CountDocuments() ;
+		totalLength += fSegments[i]->reader->TotalLength() ;
+	}
+	if (documents == 0)
+		return 0 ;
+
+	std::vector<float> weights(clauseCount + 1) ;
+	bool positive = false ;
+	for (int32 i = 0 ; i < clauseCount ; i++) {
+		uint64 docFreq = 0 ;
+		for (size_t j = 0 ; j < fSegments.size() ; j++) {
+			int32 term = fSegments[j]->reader->FindTerm(clauses[i].term) ;
+			if (term >= 0)
+				docFreq += fSegments[j]->reader->DocFreq(term) ;
+		}
+
+		if (clauses[i].occur == NATIVE_MUST && docFreq == 0)
+			return 0 ;
+		if (clauses[i].occur != NATIVE_MUST_NOT)
+			positive = true ;
+
+		weights[i] = log(1 + (documents - docFreq + 0.5)
+			/ (docFreq + 0.5)) ;
+	}
+	if (!positive)
+		return 0 ;
+
+	// The average length goes in last.
+	weights[clauseCount] = (float)totalLength / documents ;
+
+	std::vector<native_hit> heap ;
+	heap.reserve(maxHits) ;
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		SearchSegment(i, clauses, clauseCount, &weights[0], filter, cookie,
+			&heap, maxHits) ;
+	}
+
+	std::sort(heap.begin(), heap.end(), better_hit) ;
+	for (size_t i = 0 ; i < heap.size() ; i++)
+		hits[i] = heap[i] ;
+
+	return heap.size() ;
+}
+
+
+void
+NativeIndex::SearchSegment(int32 index, const native_clause* clauses,
+	int32 clauseCount, const float* weights, native_filter filter,
+	void* cookie, std::vector<native_hit>* heap, int32 maxHits)
+{
+	const segment_info *info = fSegments[index] ;
+	const SegmentReader *reader = info->reader ;
+	float averageLength = weights[clauseCount] ;
+
+	std::vector<PostingIterator> iterators(clauseCount) ;
+	std::vector<std::pair<uint32, int32> > must ;
+	std::vector<int32> should, mustNot ;
+
+	for (int32 i = 0 ; i < clauseCount ; i++) {
+		int32 term = reader->FindTerm(clauses[i].term) ;
+		if (term < 0) {
+			if (clauses[i].occur == NATIVE_MUST)
+				return ;
+			continue ;
+		}
+
+		reader->GetPostings(term, &iterators[i]) ;
+		if (clauses[i].occur == NATIVE_MUST)
+			must.push_back(std::make_pair(reader->DocFreq(term), i)) ;
+		else if (clauses[i].occur == NATIVE_SHOULD)
+			should.push_back(i) ;
+		else
+			mustNot.push_back(i) ;
+	}
+	if (must.empty() && should.empty())
+		return ;
+
+	// The rarest required term leads, the others catch up with it.
+	std::sort(must.begin(), must.end()) ;
+
+	uint32 doc ;
+	if (!must.empty())
+		doc = iterators[must[0].second].Doc() ;
+	else {
+		doc = kEndDoc ;
+		for (size_t i = 0 ; i < should.size() ; i++)
+			doc = std::min(doc, iterators[should[i]].Doc()) ;
+	}
+
+	while (doc != kEndDoc) {
+		uint32 next = kEndDoc ;
+		if (!must.empty()) {
+			uint32 target = doc ;
+			for (size_t i = 1 ; i < must.size() && target == doc ; i++)
+				target = iterators[must[i].second].Advance(doc) ;
+			if (target != doc) {
+				doc = iterators[must[0].second].Advance(target) ;
+				continue ;
+			}
+		}
+
+		// doc matches every required term, add up its score.
+		float length = reader->Length(doc) ;
+		float norm = kK1 * (1 - kB + kB * length / averageLength) ;
+		float score = 0 ;
+
+		for (size_t i = 0 ; i < must.size() ; i++) {
+			PostingIterator &iterator = iterators[must[i].second] ;
+			float freq = iterator.Freq() ;
+			score += weights[must[i].second] * freq * (kK1 + 1)
+				/ (freq + norm) ;
+		}
+
+		for (size_t i = 0 ; i < should.size() ; i++) {
+			PostingIterator &iterator = iterators[should[i]] ;
+			if (!must.empty())
+				iterator.Advance(doc) ;
+			if (iterator.Doc() == doc) {
+				float freq = iterator.Freq() ;
+				score += weights[should[i]] * freq * (kK1 + 1)
+					/ (freq + norm) ;
+				if (must.empty())
+					iterator.Next() ;
+			}
+			if (must.empty())
+				next = std::min(next, iterator.Doc()) ;
+		}
+
+		bool excluded = IsDeleted(info, doc) ;
+		for (size_t i = 0 ; i < mustNot.size() && !excluded ; i++)
+			excluded = iterators[mustNot[i]].Advance(doc) == doc ;
+
+		native_hit hit ;
+		hit.segment = index ;
+		hit.doc = doc ;
+		hit.score = score ;
+
+		// The worst hit so far sits on top of the heap.
+		bool wanted = !excluded && ((int32)heap->size() < maxHits
+			|| better_hit(hit, heap->front())) ;
+		if (wanted && filter != NULL) {
+			stored_document document ;
+			wanted = reader->GetDocument(doc, &document) == B_OK
+				&& filter(&document, cookie) ;
+		}
+
+		if (wanted) {
+			if ((int32)heap->size() == maxHits) {
+				std::pop_heap(heap->begin(), heap->end(), better_hit) ;
+				heap->pop_back() ;
+			}
+			heap->push_back(hit) ;
+			std::push_heap(heap->begin(), heap->end(), better_hit) ;
+		}
+
+		if (!must.empty())
+			doc = iterators[must[0].second].Next() ;
+		else
+			doc = next ;
+	}
+}
+
+
+status_t
+NativeIndex::GetDocument(const native_hit* hit,
+	stored_document* document) const
+{
+	return fSegments[hit->segment]->reader->GetDocument(hit->doc, document) ;
+}
+
+
+void
+NativeIndex::ForEachPath(native_path_callback callback, void* cookie)
+{
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		segment_info *info = fSegments[i] ;
+		for (uint32 doc = 0 ; doc < info->reader->CountDocuments() ; doc++) {
+			const char *path ;
+			if (!IsDeleted(info, doc)
+				&& *(path = info->reader->PathAt(doc)) != '\0')
+				callback(path, cookie) ;
+		}
+	}
+}
+
+
+void
+NativeIndex::ForEachDocument(native_document_callback callback, void* cookie)
+{
+	for (size_t i = 0 ; i < fSegments.size() ; i++) {
+		segment_info *info = fSegments[i] ;
+		for (uint32 doc = 0 ; doc < info->reader->CountDocuments() ; doc++) {
+			stored_document document ;
+			if (!IsDeleted(info, doc)
+				&& info->reader->GetDocument(doc, &document) == B_OK
+				&& *document.path != '\0')
+				callback(&document, cookie) ;
+		}
+	}
+}
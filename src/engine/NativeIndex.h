@@ -0,0 +1,205 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _NATIVE_INDEX_H_
+#define _NATIVE_INDEX_H_
+
+#include "Segment.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+
+// The file listing the segments of a native index. Its presence is what
+// marks a directory as one.
+#define NATIVE_MANIFEST_FILE "segments.nat"
+
+
+struct native_document {
+	const char	*path ;
+	const char	*text ;
+	size_t		textLength ;
+	const char	*excerpt ;
+	const char	*mimeType ;
+	uint64		size ;
+	uint64		modified ;
+} ;
+
+enum native_occur {
+	NATIVE_SHOULD,
+	NATIVE_MUST,
+	NATIVE_MUST_NOT,
+} ;
+
+struct native_clause {
+	const char	*term ;
+	int32		occur ;
+} ;
+
+struct native_hit {
+	int32		segment ;
+	uint32		doc ;
+	float		score ;
+} ;
+
+// Returns false for documents that should be left out of a search.
+typedef bool (*native_filter)(const stored_document* document, void* cookie) ;
+typedef void (*native_path_callback)(const char* path, void* cookie) ;
+typedef void (*native_document_callback)(const stored_document* document,
+	void* cookie) ;
+
+
+// An index made of immutable, memory mapped segments plus a bitmap of
+// deleted documents for each. Changes are buffered in memory and written
+// as a new segment on Commit(), which then publishes the new list of
+// segments by renaming the manifest over the old one. Readers only ever
+// see whole commits, and keep the segments they have open even after a
+// merge has replaced them. Only one process may write to an index.
+//
+// Segments that turn out to be damaged are left out, rather than all of
+// the index. The writer sets them aside for good and learns which paths
+// they had, so that only those have to be indexed again.
+class NativeIndex {
+	public:
+		NativeIndex() ;
+		~NativeIndex() ;
+
+		static bool Exists(const char* directory) ;
+
+		status_t Open(const char* directory, bool create) ;
+		void Close() ;
+		const char* Directory() const { return fDirectory.c_str() ; }
+
+		// The generation of the commit the index is looking at, and a way
+		// to move on to the latest one.
+		int64 Version() const { return fGeneration ; }
+		status_t Refresh() ;
+
+		status_t AddDocument(const native_document* document) ;
+		int32 RemovePath(const char* path) ;
+		int32 RemoveSubtree(const char* path) ;
+		status_t Commit() ;
+
+		// Take over the segments of the index in directory, which has to
+		// be on the same volume and not be used by anyone else. Its files
+		// are moved, the directory is left for the caller to remove. Like
+		// any change, this shows once it is committed, all at once.
+		//
+		// AddIndex() replaces the documents with the same paths, while
+		// ReplaceSubtree() replaces all of those under path, except ones
+		// modified at since or later, which win over those taken over.
+		status_t AddIndex(const char* directory) ;
+		status_t ReplaceSubtree(const char* path, const char* directory,
+			uint64 since) ;
+		// Merges all segments into one.
+		status_t Optimize() ;
+
+		void SetMaxFieldLength(int32 length) ;
+		void SetMaxBufferedDocuments(int32 count) ;
+		void SetMergeFactor(int32 factor) ;
+		// Bits per path in the filter new segments get, so that removing a
+		// path can skip segments that don't have it. 0 leaves it out.
+		void SetPathFilterBits(int32 bitsPerPath) ;
+		// Has Open() check all of every segment, not just its header, and
+		// set damaged ones aside. Only the process that writes to the index
+		// may ask for this.
+		void SetRecovery(bool recover) ;
+
+		// Segments set aside by Open(), and the paths of the documents in
+		// them, which are handed out only once. Returns B_BAD_DATA if some
+		// of the paths aren't known.
+		int32 CountDamagedSegments() const { return fDamagedCount ; }
+		status_t TakeLostPaths(native_path_callback callback, void* cookie) ;
+
+		uint32 CountDocuments() const ;
+		int32 Search(const native_clause* clauses, int32 clauseCount,
+			native_filter filter, void* cookie, native_hit* hits,
+			int32 maxHits) ;
+		status_t GetDocument(const native_hit* hit,
+			stored_document* document) const ;
+		void ForEachPath(native_path_callback callback, void* cookie) ;
+		// Like ForEachPath(), with everything that is stored for each
+		// document. Damaged documents are left out.
+		void ForEachDocument(native_document_callback callback,
+			void* cookie) ;
+
+	private:
+		struct segment_info {
+			std::string				name ;
+			std::string				deletions ;
+			SegmentReader			*reader ;
+			std::vector<uint8>		deleted ;
+			uint32					deletedCount ;
+			bool					dirty ;
+		} ;
+
+		struct pending_document {
+			std::string				path ;
+			std::string				mimeType ;
+			std::string				excerpt ;
+			uint64					size ;
+			uint64					modified ;
+			uint32					length ;
+			bool					removed ;
+		} ;
+
+		typedef std::vector<segment_info*> segment_list ;
+
+		status_t ReadManifest(segment_list* segments, segment_list* damaged,
+			int64* generation, uint32* counter) ;
+		void ReturnReaders(segment_list* segments) ;
+		void Quarantine(const segment_list& damaged) ;
+		status_t WriteManifest() ;
+		status_t LoadDeletions(segment_info* info) ;
+		status_t WriteDeletions(segment_info* info) ;
+		void RemoveUnusedFiles() ;
+		void FreeSegments(segment_list* segments) ;
+
+		bool IsDeleted(const segment_info* info, uint32 doc) const ;
+		bool Delete(segment_info* info, uint32 doc) ;
+		void RemovePending(const std::string& path) ;
+
+		status_t TakeSegments(const char* directory, segment_list* taken) ;
+		void AppendSegments(const segment_list& taken,
+			const std::set<std::string>* kept) ;
+
+		status_t Flush() ;
+		status_t Merge() ;
+		status_t MergeSegments(const segment_list& segments) ;
+		std::string NextName() ;
+		std::string FilePath(const std::string& name) const ;
+
+		void SearchSegment(int32 index, const native_clause* clauses,
+			int32 clauseCount, const float* weights, native_filter filter,
+			void* cookie, std::vector<native_hit>* heap, int32 maxHits) ;
+
+		std::string				fDirectory ;
+		bool					fOpen ;
+		int64					fGeneration ;
+		uint32					fCounter ;
+		segment_list			fSegments ;
+		int32					fMaxFieldLength ;
+		int32					fMaxBufferedDocuments ;
+		int32					fMergeFactor ;
+		int32					fPathFilterBits ;
+		bool					fRecovery ;
+		bool					fChanged ;
+		int32					fDamagedCount ;
+		std::vector<std::string>	fLostPaths ;
+		bool					fLostPathsKnown ;
+
+		std::vector<pending_document>		fPending ;
+		std::map<std::string, uint32>		fPendingPaths ;
+		std::map<std::string, uint32>		fPendingTerms ;
+		std::vector<std::vector<uint32> >	fPendingPostings ;
+		uint32					fLivePending ;
+} ;
+
+#endif /* _NATIVE_INDEX_H_ */
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "PostingList.h"
+
+#include <string.h>
+
+
+static inline uint32
+block_count(uint32 count)
+{
+	return (count + kBlockSize - 1) / kBlockSize ;
+}
+
+
+void
+encode_postings(const uint32* docs, const uint32* freqs, uint32 count,
+	std::vector<uint32>* out)
+{
+	uint32 blocks = block_count(count) ;
+	size_t start = out->size() ;
+	size_t skips = start ;
+	if (blocks > 1)
+		out->resize(start + 2 * blocks) ;
+
+	uint32 gaps[kBlockSize], values[kBlockSize], packed[kBlockSize] ;
+	uint8 bytes[2 * kBlockSize * 5 + 3] ;
+	uint32 previous = (uint32)-1 ;
+
+	for (uint32 block = 0 ; block < blocks ; block++) {
+		uint32 first = block * kBlockSize ;
+		uint32 length = count - first ;
+		if (length > (uint32)kBlockSize)
+			length = kBlockSize ;
+
+		for (uint32 i = 0 ; i < length ; i++) {
+			gaps[i] = docs[first + i] - previous - 1 ;
+			values[i] = freqs[first + i] - 1 ;
+			previous = docs[first + i] ;
+		}
+
+		if (blocks > 1) {
+			(*out)[skips + 2 * block] = previous ;
+			(*out)[skips + 2 * block + 1] = out->size() - start ;
+		}
+
+		if (length == (uint32)kBlockSize) {
+			int32 docBits = max_bits(gaps, length) ;
+			int32 freqBits = max_bits(values, length) ;
+			out->push_back(docBits | (freqBits << 8)) ;
+
+			pack_block(gaps, packed, docBits) ;
+			out->insert(out->end(), packed, packed + 4 * docBits) ;
+			pack_block(values, packed, freqBits) ;
+			out->insert(out->end(), packed, packed + 4 * freqBits) ;
+		} else {
+			size_t size = vbyte_encode(gaps, length, bytes) ;
+			size += vbyte_encode(values, length, bytes + size) ;
+			while (size % 4 != 0)
+				bytes[size++] = 0 ;
+
+			size_t words = out->size() ;
+			out->resize(words + size / 4) ;
+			memcpy(&(*out)[words], bytes, size) ;
+		}
+	}
+}
+
+
+PostingIterator::PostingIterator()
+	: fData(NULL),
+	  fEnd(NULL),
+	  fSkips(NULL),
+	  fFreqData(NULL),
+	  fCount(0),
+	  fDocCount(0),
+	  fBlockCount(0),
+	  fBlock(0),
+	  fBlockLength(0),
+	  fIndex(0),
+	  fDoc(kEndDoc),
+	  fFreqBits(0),
+	  fFreqsDecoded(false)
+{
+}
+
+
+void
+PostingIterator::SetTo(const uint32* data, uint32 count, size_t words,
+	uint32 docCount)
+{
+	fData = data ;
+	fEnd = data + words ;
+	fCount = count ;
+	fDocCount = docCount ;
+	fBlockCount = block_count(count) ;
+	fSkips = fBlockCount > 1 ? data : NULL ;
+	fBlock = 0 ;
+	fDoc = kEndDoc ;
+
+	// No more documents than there are, and room for the skip table.
+	if (count > docCount || (fSkips != NULL && 2 * (size_t)fBlockCount > words))
+		fBlockCount = 0 ;
+
+	if (fBlockCount > 0)
+		LoadBlock(0) ;
+}
+
+
+uint32
+PostingIterator::LastDoc(uint32 block) const
+{
+	if (block == fBlockCount - 1 && fSkips == NULL)
+		return fDocs[fBlockLength - 1] ;
+
+	return fSkips[2 * block] ;
+}
+
+
+void
+PostingIterator::LoadBlock(uint32 block)
+{
+	fBlock = block ;
+	fIndex = 0 ;
+	fBlockLength = fCount - block * kBlockSize ;
+	if (fBlockLength > (uint32)kBlockSize)
+		fBlockLength = kBlockSize ;
+
+	size_t offset = fSkips != NULL ? fSkips[2 * block + 1] : 0 ;
+	if (offset >= (size_t)(fEnd - fData)) {
+		Stop() ;
+		return ;
+	}
+
+	const uint32 *data = fData + offset ;
+	int64 previous = block > 0 ? (int64)fSkips[2 * (block - 1)] : -1 ;
+
+	if (fBlockLength == (uint32)kBlockSize) {
+		int32 docBits = data[0] & 0xff ;
+		fFreqBits = data[0] >> 8 ;
+		if (docBits > 32 || fFreqBits > 32
+			|| 1 + 4 * (docBits + fFreqBits) > fEnd - data) {
+			Stop() ;
+			return ;
+		}
+
+		fFreqData = data + 1 + 4 * docBits ;
+		fFreqsDecoded = false ;
+		unpack_block(data + 1, fDocs, docBits) ;
+	} else {
+		// Short blocks are rare and small, decode all of it right away.
+		const uint8 *end = (const uint8*)fEnd ;
+		size_t size = vbyte_decode((const uint8*)data, end, fBlockLength,
+			fDocs) ;
+		if (size == 0 || vbyte_decode((const uint8*)data + size, end,
+				fBlockLength, fFreqs) == 0) {
+			Stop() ;
+			return ;
+		}
+
+		for (uint32 i = 0 ; i < fBlockLength ; i++)
+			fFreqs[i]++ ;
+		fFreqsDecoded = true ;
+	}
+
+	for (uint32 i = 0 ; i < fBlockLength ; i++) {
+		previous += (int64)fDocs[i] + 1 ;
+		if (previous >= fDocCount) {
+			Stop() ;
+			return ;
+		}
+		fDocs[i] = previous ;
+	}
+
+	// Advance() trusts the skip table to tell where a block ends.
+	if (fSkips != NULL && fDocs[fBlockLength - 1] != fSkips[2 * block]) {
+		Stop() ;
+		return ;
+	}
+
+	fDoc = fDocs[0] ;
+}
+
+
+void
+PostingIterator::Stop()
+{
+	fBlockCount = fBlock + 1 ;
+	fBlockLength = 0 ;
+	fIndex = 0 ;
+	fFreqsDecoded = true ;
+	fDoc = kEndDoc ;
+}
+
+
+uint32
+PostingIterator::Freq()
+{
+	if (!fFreqsDecoded) {
+		unpack_block(fFreqData, fFreqs, fFreqBits) ;
+		for (uint32 i = 0 ; i < fBlockLength ; i++)
+			fFreqs[i]++ ;
+		fFreqsDecoded = true ;
+	}
+
+	return fFreqs[fIndex] ;
+}
+
+
+uint32
+PostingIterator::Next()
+{
+	if (fDoc == kEndDoc)
+		return kEndDoc ;
+
+	if (++fIndex < fBlockLength)
+		return fDoc = fDocs[fIndex] ;
+
+	if (fBlock + 1 < fBlockCount)
+		LoadBlock(fBlock + 1) ;
+	else
+		fDoc = kEndDoc ;
+
+	return fDoc ;
+}
+
+
+uint32
+PostingIterator::Advance(uint32 target)
+{
+	if (fDoc >= target)
+		return fDoc ;
+
+	if (LastDoc(fBlock) < target) {
+		if (fSkips == NULL || fSkips[2 * (fBlockCount - 1)] < target)
+			return fDoc = kEndDoc ;
+
+		// Find the first block that ends at or after target.
+		uint32 low = fBlock + 1, high = fBlockCount - 1 ;
+		while (low < high) {
+			uint32 middle = (low + high) / 2 ;
+			if (fSkips[2 * middle] < target)
+				low = middle + 1 ;
+			else
+				high = middle ;
+		}
+		LoadBlock(low) ;
+		if (fDoc == kEndDoc)
+			return kEndDoc ;
+	}
+
+	// The block ends at or after target, so this stops inside it.
+	while (fDocs[fIndex] < target)
+		fIndex++ ;
+
+	return fDoc = fDocs[fIndex] ;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _POSTING_LIST_H_
+#define _POSTING_LIST_H_
+
+#include "BitPacking.h"
+
+#include <vector>
+
+
+// Returned by PostingIterator once it has run past the last document.
+const uint32 kEndDoc = 0xffffffff ;
+
+
+// A posting list is a run of 32 bit words. Documents and frequencies go
+// in blocks of kBlockSize, documents as gaps, both minus one and bit
+// packed, with a header word holding the two widths. A last, partial
+// block is variable byte coded instead. Lists of more than one block
+// start with a skip table of (last document, offset) pairs, one per block,
+// so that Advance() only decodes the blocks it lands in. The number of
+// documents isn't stored, it comes from the term dictionary.
+//
+// PostingIterator reads nothing outside the words it is given, and never
+// returns a document number past the ones it is told about. A damaged
+// list simply ends where the damage is.
+void encode_postings(const uint32* docs, const uint32* freqs, uint32 count,
+	std::vector<uint32>* out) ;
+
+class PostingIterator {
+	public:
+		PostingIterator() ;
+
+		// The list is in the first words of data, and the documents in it
+		// are all below docCount.
+		void SetTo(const uint32* data, uint32 count, size_t words,
+			uint32 docCount) ;
+
+		uint32 Doc() const { return fDoc ; }
+		uint32 Freq() ;
+		uint32 Count() const { return fCount ; }
+
+		uint32 Next() ;
+		// Moves to the first document at or after target, never backwards.
+		uint32 Advance(uint32 target) ;
+
+	private:
+		void LoadBlock(uint32 block) ;
+		uint32 LastDoc(uint32 block) const ;
+		void Stop() ;
+
+		const uint32	*fData ;
+		const uint32	*fEnd ;
+		const uint32	*fSkips ;
+		const uint32	*fFreqData ;
+		uint32			fCount ;
+		uint32			fDocCount ;
+		uint32			fBlockCount ;
+		uint32			fBlock ;
+		uint32			fBlockLength ;
+		uint32			fIndex ;
+		uint32			fDoc ;
+		int32			fFreqBits ;
+		bool			fFreqsDecoded ;
+		uint32			fDocs[kBlockSize] ;
+		uint32			fFreqs[kBlockSize] ;
+} ;
+
+#endif /* _POSTING_LIST_H_ */
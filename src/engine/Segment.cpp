@@ -0,0 +1,565 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "Segment.h"
+#include "Checksum.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+const uint32 kSegmentMagic = 'BNSG' ;
+const uint32 kSegmentVersion = 3 ;
+
+
+// The stored field after field, or NULL if field doesn't end before end.
+static const char*
+next_field(const char* field, const char* end)
+{
+	if (field == NULL)
+		return NULL ;
+
+	const char *terminator = (const char*)memchr(field, '\0', end - field) ;
+	return terminator != NULL ? terminator + 1 : NULL ;
+}
+
+
+SegmentWriter::SegmentWriter()
+	: fFile(NULL),
+	  fPath(NULL),
+	  fPathListPath(NULL),
+	  fStatus(B_NO_INIT),
+	  fPosition(0),
+	  fChecksum(0),
+	  fPathFilterBits(0)
+{
+	memset(&fHeader, 0, sizeof(fHeader)) ;
+}
+
+
+SegmentWriter::~SegmentWriter()
+{
+	if (fFile != NULL)
+		Abort() ;
+	free(fPath) ;
+	free(fPathListPath) ;
+}
+
+
+void
+SegmentWriter::SetPathFilter(int32 bitsPerPath)
+{
+	fPathFilterBits = bitsPerPath > 0 ? bitsPerPath : 0 ;
+}
+
+
+void
+SegmentWriter::SetPathList(const char* path)
+{
+	free(fPathListPath) ;
+	fPathListPath = strdup(path) ;
+}
+
+
+status_t
+SegmentWriter::Open(const char* path)
+{
+	fFile = fopen(path, "wb") ;
+	if (fFile == NULL)
+		return fStatus = B_IO_ERROR ;
+
+	fPath = strdup(path) ;
+	fStatus = B_OK ;
+
+	// The header is written again once the offsets are known.
+	fHeader.magic = kSegmentMagic ;
+	fHeader.version = kSegmentVersion ;
+	return Write(&fHeader, sizeof(fHeader)) ;
+}
+
+
+status_t
+SegmentWriter::AddDocument(const stored_document* document)
+{
+	if (fStatus != B_OK)
+		return fStatus ;
+
+	fStoredIndex.push_back(fPosition) ;
+	fLengths.push_back(document->length) ;
+	if (fPathFilterBits > 0)
+		fPathHashes.push_back(bloom_hash(document->path)) ;
+	if (fPathListPath != NULL) {
+		fPathList.insert(fPathList.end(), document->path,
+			document->path + strlen(document->path) + 1) ;
+	}
+	fHeader.documentCount++ ;
+	fHeader.totalLength += document->length ;
+
+	Write(&document->size, sizeof(uint64)) ;
+	Write(&document->modified, sizeof(uint64)) ;
+	Write(document->path, strlen(document->path) + 1) ;
+	Write(document->mimeType, strlen(document->mimeType) + 1) ;
+	return Write(document->excerpt, strlen(document->excerpt) + 1) ;
+}
+
+
+status_t
+SegmentWriter::AddTerm(const char* text, const uint32* docs,
+	const uint32* freqs, uint32 count)
+{
+	if (fStatus != B_OK)
+		return fStatus ;
+
+	if (fHeader.postingsOffset == 0) {
+		Align() ;
+		fStoredIndex.push_back(fPosition) ;
+		fHeader.postingsOffset = fPosition ;
+	}
+
+	segment_term term ;
+	term.textOffset = fTermText.size() ;
+	term.docFreq = count ;
+	term.postingsOffset = fPosition ;
+	fTerms.push_back(term) ;
+	fHeader.termCount++ ;
+	fTermText.insert(fTermText.end(), text, text + strlen(text) + 1) ;
+
+	fPostings.clear() ;
+	encode_postings(docs, freqs, count, &fPostings) ;
+	return Write(&fPostings[0], fPostings.size() * sizeof(uint32)) ;
+}
+
+
+status_t
+SegmentWriter::Finish()
+{
+	if (fStatus != B_OK) {
+		Abort() ;
+		return fStatus ;
+	}
+
+	if (fHeader.postingsOffset == 0) {
+		Align() ;
+		fStoredIndex.push_back(fPosition) ;
+		fHeader.postingsOffset = fPosition ;
+	}
+
+	Align() ;
+	fHeader.lengthsOffset = fPosition ;
+	if (!fLengths.empty())
+		Write(&fLengths[0], fLengths.size() * sizeof(uint32)) ;
+
+	Align() ;
+	fHeader.storedIndexOffset = fPosition ;
+	Write(&fStoredIndex[0], fStoredIndex.size() * sizeof(uint64)) ;
+
+	Align() ;
+	fHeader.termIndexOffset = fPosition ;
+	if (!fTerms.empty())
+		Write(&fTerms[0], fTerms.size() * sizeof(segment_term)) ;
+
+	fHeader.termTextOffset = fPosition ;
+	if (!fTermText.empty())
+		Write(&fTermText[0], fTermText.size()) ;
+
+	if (fPathFilterBits > 0) {
+		BloomFilterBuilder filter(fPathHashes.size(), fPathFilterBits) ;
+		for (size_t i = 0 ; i < fPathHashes.size() ; i++)
+			filter.Add(fPathHashes[i]) ;
+
+		Align() ;
+		fHeader.pathFilterOffset = fPosition ;
+		fHeader.pathFilterSize = filter.Size() ;
+		Write(filter.Data(), filter.Size()) ;
+	}
+
+	// The path list has to be there before the segment can be used.
+	if (fStatus == B_OK && fPathListPath != NULL)
+		fStatus = WritePathList() ;
+
+	fHeader.dataChecksum = fChecksum ;
+	fHeader.headerChecksum = compute_crc32(&fHeader,
+		offsetof(segment_header, headerChecksum)) ;
+
+	if (fStatus == B_OK && (fseek(fFile, 0, SEEK_SET) != 0
+		|| fwrite(&fHeader, sizeof(fHeader), 1, fFile) != 1
+		|| fflush(fFile) != 0 || fsync(fileno(fFile)) != 0))
+		fStatus = B_IO_ERROR ;
+
+	if (fclose(fFile) != 0 && fStatus == B_OK)
+		fStatus = B_IO_ERROR ;
+	fFile = NULL ;
+
+	if (fStatus != B_OK) {
+		unlink(fPath) ;
+		if (fPathListPath != NULL)
+			unlink(fPathListPath) ;
+	}
+	return fStatus ;
+}
+
+
+void
+SegmentWriter::Abort()
+{
+	if (fFile != NULL) {
+		fclose(fFile) ;
+		fFile = NULL ;
+		unlink(fPath) ;
+		if (fPathListPath != NULL)
+			unlink(fPathListPath) ;
+	}
+	if (fStatus == B_OK)
+		fStatus = B_ERROR ;
+}
+
+
+status_t
+SegmentWriter::Write(const void* data, size_t length)
+{
+	if (fStatus == B_OK && length > 0
+		&& fwrite(data, 1, length, fFile) != length)
+		fStatus = B_IO_ERROR ;
+
+	// Open() writes the header first, Finish() writes it again later.
+	if (fPosition >= sizeof(fHeader))
+		fChecksum = update_crc32(fChecksum, data, length) ;
+
+	fPosition += length ;
+	return fStatus ;
+}
+
+
+status_t
+SegmentWriter::Align()
+{
+	static const uint8 kPadding[8] = { 0 } ;
+	return Write(kPadding, (8 - fPosition % 8) % 8) ;
+}
+
+
+status_t
+SegmentWriter::WritePathList()
+{
+	FILE *file = fopen(fPathListPath, "wb") ;
+	if (file == NULL)
+		return B_IO_ERROR ;
+
+	uint32 checksum = fPathList.empty() ? 0
+		: compute_crc32(&fPathList[0], fPathList.size()) ;
+	bool failed = (!fPathList.empty() && fwrite(&fPathList[0], 1,
+			fPathList.size(), file) != fPathList.size())
+		|| fwrite(&checksum, sizeof(checksum), 1, file) != 1
+		|| fflush(file) != 0 || fsync(fileno(file)) != 0 ;
+	if (fclose(file) != 0 || failed) {
+		unlink(fPathListPath) ;
+		return B_IO_ERROR ;
+	}
+
+	return B_OK ;
+}
+
+
+//	#pragma mark -
+
+
+SegmentReader::SegmentReader()
+	: fBase(NULL),
+	  fSize(0),
+	  fHeader(NULL),
+	  fLengths(NULL),
+	  fStoredIndex(NULL),
+	  fTerms(NULL),
+	  fTermText(NULL),
+	  fPathFilter(NULL),
+	  fPathFilterSize(0),
+	  fTermTextSize(0)
+{
+}
+
+
+SegmentReader::~SegmentReader()
+{
+	Close() ;
+}
+
+
+status_t
+SegmentReader::Open(const char* path, bool verify)
+{
+	Close() ;
+
+	int fd = open(path, O_RDONLY) ;
+	if (fd < 0)
+		return B_ENTRY_NOT_FOUND ;
+
+	struct stat st ;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(segment_header)) {
+		close(fd) ;
+		return B_BAD_DATA ;
+	}
+
+	// Searches touch little of a segment, let the VM bring in what they do.
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) ;
+	close(fd) ;
+	if (base == MAP_FAILED)
+		return B_NO_MEMORY ;
+
+	fBase = (uint8*)base ;
+	fSize = st.st_size ;
+	fHeader = (const segment_header*)fBase ;
+
+	const segment_header &header = *fHeader ;
+	if (header.magic != kSegmentMagic || header.version != kSegmentVersion
+		|| header.headerChecksum
+			!= compute_crc32(fBase, offsetof(segment_header, headerChecksum))
+		|| header.postingsOffset > header.lengthsOffset
+		|| header.lengthsOffset + header.documentCount * sizeof(uint32)
+			> header.storedIndexOffset
+		|| header.storedIndexOffset
+			+ (header.documentCount + 1) * sizeof(uint64)
+			> header.termIndexOffset
+		|| header.termIndexOffset + header.termCount * sizeof(segment_term)
+			> header.termTextOffset
+		|| header.termTextOffset > fSize
+		|| (verify && header.dataChecksum
+			!= compute_crc32(fBase + sizeof(segment_header),
+				fSize - sizeof(segment_header)))) {
+		Close() ;
+		return B_BAD_DATA ;
+	}
+
+	fLengths = (const uint32*)(fBase + header.lengthsOffset) ;
+	fStoredIndex = (const uint64*)(fBase + header.storedIndexOffset) ;
+	fTerms = (const segment_term*)(fBase + header.termIndexOffset) ;
+	fTermText = (const char*)(fBase + header.termTextOffset) ;
+
+	// Without a usable filter every path has to be looked up.
+	fPathFilter = NULL ;
+	fPathFilterSize = 0 ;
+	if (header.pathFilterSize > 0
+		&& header.pathFilterOffset >= header.termTextOffset
+		&& header.pathFilterOffset <= fSize
+		&& header.pathFilterSize <= fSize - header.pathFilterOffset) {
+		fPathFilter = fBase + header.pathFilterOffset ;
+		fPathFilterSize = header.pathFilterSize ;
+	}
+
+	// The term text runs up to the filter, if there is one. Ending in a
+	// NUL, none of its strings can run past it.
+	fTermTextSize = (fPathFilter != NULL ? header.pathFilterOffset : fSize)
+		- header.termTextOffset ;
+	if (header.termCount > 0
+		&& (fTermTextSize == 0 || fTermText[fTermTextSize - 1] != '\0')) {
+		Close() ;
+		return B_BAD_DATA ;
+	}
+
+	return B_OK ;
+}
+
+
+void
+SegmentReader::Close()
+{
+	if (fBase != NULL)
+		munmap(fBase, fSize) ;
+
+	fBase = NULL ;
+	fHeader = NULL ;
+	fPathFilter = NULL ;
+	fPathFilterSize = 0 ;
+	fTermTextSize = 0 ;
+}
+
+
+int32
+SegmentReader::FindTerm(const char* text) const
+{
+	int32 low = 0, high = (int32)fHeader->termCount - 1 ;
+	while (low <= high) {
+		int32 middle = (low + high) / 2 ;
+		int compare = strcmp(TermAt(middle), text) ;
+		if (compare == 0)
+			return middle ;
+		else if (compare < 0)
+			low = middle + 1 ;
+		else
+			high = middle - 1 ;
+	}
+
+	return -1 ;
+}
+
+
+const char*
+SegmentReader::TermAt(uint32 index) const
+{
+	uint32 offset = fTerms[index].textOffset ;
+	return offset < fTermTextSize ? fTermText + offset : "" ;
+}
+
+
+uint32
+SegmentReader::DocFreq(uint32 index) const
+{
+	return fTerms[index].docFreq ;
+}
+
+
+void
+SegmentReader::GetPostings(uint32 index, PostingIterator* iterator) const
+{
+	// The list may run up to the lengths, and no further.
+	uint64 offset = fTerms[index].postingsOffset ;
+	size_t words = 0 ;
+	if (offset >= fHeader->postingsOffset && offset < fHeader->lengthsOffset
+		&& (offset - fHeader->postingsOffset) % sizeof(uint32) == 0)
+		words = (fHeader->lengthsOffset - offset) / sizeof(uint32) ;
+	else
+		offset = fHeader->postingsOffset ;
+
+	iterator->SetTo((const uint32*)(fBase + offset), fTerms[index].docFreq,
+		words, fHeader->documentCount) ;
+}
+
+
+status_t
+SegmentReader::GetDocument(uint32 doc, stored_document* document) const
+{
+	size_t length ;
+	const char *stored = StoredAt(doc, &length) ;
+	const char *path = NULL, *mimeType = NULL, *excerpt = NULL ;
+	if (stored != NULL) {
+		const char *end = stored + length ;
+		path = stored + 2 * sizeof(uint64) ;
+		mimeType = next_field(path, end) ;
+		excerpt = next_field(mimeType, end) ;
+		if (next_field(excerpt, end) == NULL)
+			excerpt = NULL ;
+	}
+
+	if (excerpt == NULL) {
+		document->path = document->mimeType = document->excerpt = "" ;
+		document->size = document->modified = 0 ;
+		document->length = 0 ;
+		return B_BAD_DATA ;
+	}
+
+	memcpy(&document->size, stored, sizeof(uint64)) ;
+	memcpy(&document->modified, stored + sizeof(uint64), sizeof(uint64)) ;
+	document->path = path ;
+	document->mimeType = mimeType ;
+	document->excerpt = excerpt ;
+	document->length = fLengths[doc] ;
+	return B_OK ;
+}
+
+
+const char*
+SegmentReader::PathAt(uint32 doc) const
+{
+	size_t length ;
+	const char *stored = StoredAt(doc, &length) ;
+	if (stored == NULL || memchr(stored + 2 * sizeof(uint64), '\0',
+			length - 2 * sizeof(uint64)) == NULL)
+		return "" ;
+
+	return stored + 2 * sizeof(uint64) ;
+}
+
+
+uint32
+SegmentReader::LowerBound(const char* path) const
+{
+	uint32 low = 0, high = fHeader->documentCount ;
+	while (low < high) {
+		uint32 middle = (low + high) / 2 ;
+		if (strcmp(PathAt(middle), path) < 0)
+			low = middle + 1 ;
+		else
+			high = middle ;
+	}
+
+	return low ;
+}
+
+
+bool
+SegmentReader::MayHavePath(uint64 hash) const
+{
+	if (fPathFilter == NULL)
+		return true ;
+
+	return bloom_may_contain(fPathFilter, fPathFilterSize, hash) ;
+}
+
+
+const char*
+SegmentReader::StoredAt(uint32 doc, size_t* length) const
+{
+	// A document's fields end where the next one's begin, and all of them
+	// before the postings.
+	if (doc >= fHeader->documentCount)
+		return NULL ;
+
+	uint64 start = fStoredIndex[doc] ;
+	uint64 end = fStoredIndex[doc + 1] ;
+	if (start < sizeof(segment_header) || end > fHeader->postingsOffset
+		|| start + 2 * sizeof(uint64) >= end)
+		return NULL ;
+
+	*length = end - start ;
+	return (const char*)fBase + start ;
+}
+
+
+//	#pragma mark -
+
+
+status_t
+read_path_list(const char* path, std::vector<std::string>* paths)
+{
+	paths->clear() ;
+
+	int fd = open(path, O_RDONLY) ;
+	if (fd < 0)
+		return B_ENTRY_NOT_FOUND ;
+
+	struct stat st ;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(uint32)) {
+		close(fd) ;
+		return B_BAD_DATA ;
+	}
+
+	std::vector<char> data(st.st_size) ;
+	ssize_t bytesRead = read(fd, &data[0], data.size()) ;
+	close(fd) ;
+	if (bytesRead != (ssize_t)data.size())
+		return B_BAD_DATA ;
+
+	size_t size = data.size() - sizeof(uint32) ;
+	uint32 checksum ;
+	memcpy(&checksum, &data[size], sizeof(checksum)) ;
+	if (checksum != (size > 0 ? compute_crc32(&data[0], size) : 0)
+		|| (size > 0 && data[size - 1] != '\0'))
+		return B_BAD_DATA ;
+
+	for (size_t start = 0 ; start < size ; ) {
+		size_t length = strlen(&data[start]) ;
+		paths->push_back(std::string(&data[start], length)) ;
+		start += length + 1 ;
+	}
+
+	return B_OK ;
+}
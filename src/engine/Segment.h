@@ -0,0 +1,173 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+#include "BloomFilter.h"
+#include "PostingList.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+
+// What is kept of a document besides its terms.
+struct stored_document {
+	const char	*path ;
+	const char	*mimeType ;
+	const char	*excerpt ;
+	uint64		size ;
+	uint64		modified ;
+	uint32		length ;
+} ;
+
+
+// A segment is one file, written once and never changed:
+//
+//	header			segment_header
+//	stored			per document: size, modification time, then path,
+//					MIME type and excerpt, each with a terminating NUL
+//	postings		one posting list per term, see PostingList.h
+//	lengths			number of terms in each document
+//	stored index	offset of each document's stored fields, plus the end
+//	term index		segment_term for each term, sorted by text
+//	term text		the text of all terms, NUL terminated
+//	path filter		a Bloom filter of all paths, see BloomFilter.h
+//
+// Documents are numbered in path order, so a directory's files make up one
+// range of numbers. Everything is in host byte order.
+//
+// The paths are also written to a file of their own, NUL terminated and
+// followed by their CRC-32, so that a damaged segment still tells which
+// documents it had.
+struct segment_header {
+	uint32		magic ;
+	uint32		version ;
+	uint32		documentCount ;
+	uint32		termCount ;
+	uint64		totalLength ;
+	uint64		postingsOffset ;
+	uint64		lengthsOffset ;
+	uint64		storedIndexOffset ;
+	uint64		termIndexOffset ;
+	uint64		termTextOffset ;
+	uint64		pathFilterOffset ;
+	uint64		pathFilterSize ;
+	uint32		dataChecksum ;		// CRC-32 of all after the header
+	uint32		headerChecksum ;	// CRC-32 of the header up to here
+} ;
+
+struct segment_term {
+	uint32		textOffset ;
+	uint32		docFreq ;
+	uint64		postingsOffset ;
+} ;
+
+
+class SegmentWriter {
+	public:
+		SegmentWriter() ;
+		~SegmentWriter() ;
+
+		// Paths get a filter with this many bits each, none if it is 0.
+		void SetPathFilter(int32 bitsPerPath) ;
+		// Where the list of paths goes, none if this isn't called.
+		void SetPathList(const char* path) ;
+
+		status_t Open(const char* path) ;
+
+		// All documents are added first, in path order, then all terms,
+		// in strcmp() order, with the numbers of the documents they are in.
+		status_t AddDocument(const stored_document* document) ;
+		status_t AddTerm(const char* text, const uint32* docs,
+			const uint32* freqs, uint32 count) ;
+
+		status_t Finish() ;
+		void Abort() ;
+
+	private:
+		status_t Write(const void* data, size_t length) ;
+		status_t Align() ;
+		status_t WritePathList() ;
+
+		FILE					*fFile ;
+		char					*fPath ;
+		char					*fPathListPath ;
+		status_t				fStatus ;
+		uint64					fPosition ;
+		uint32					fChecksum ;
+		segment_header			fHeader ;
+		std::vector<uint32>		fLengths ;
+		std::vector<uint64>		fStoredIndex ;
+		std::vector<segment_term>	fTerms ;
+		std::vector<char>		fTermText ;
+		std::vector<uint32>		fPostings ;
+		int32					fPathFilterBits ;
+		std::vector<uint64>		fPathHashes ;
+		std::vector<char>		fPathList ;
+} ;
+
+
+class SegmentReader {
+	public:
+		SegmentReader() ;
+		~SegmentReader() ;
+
+		// Returns B_BAD_DATA for a damaged segment. Only the header is
+		// checked unless verify is set, which reads all of the file.
+		// Damage found later never leads outside the file: a term or
+		// document that can't be read is empty, and postings end early.
+		status_t Open(const char* path, bool verify) ;
+		void Close() ;
+
+		uint32 CountDocuments() const { return fHeader->documentCount ; }
+		uint32 CountTerms() const { return fHeader->termCount ; }
+		uint64 TotalLength() const { return fHeader->totalLength ; }
+
+		// Returns the index of a term, or -1 if no document has it.
+		int32 FindTerm(const char* text) const ;
+		const char* TermAt(uint32 index) const ;
+		uint32 DocFreq(uint32 index) const ;
+		void GetPostings(uint32 index, PostingIterator* iterator) const ;
+
+		uint32 Length(uint32 doc) const
+			{ return doc < fHeader->documentCount ? fLengths[doc] : 0 ; }
+		// Returns B_BAD_DATA, and an empty document, if it is damaged.
+		status_t GetDocument(uint32 doc, stored_document* document) const ;
+		const char* PathAt(uint32 doc) const ;
+
+		// First document whose path is not less than path.
+		uint32 LowerBound(const char* path) const ;
+
+		// False if no document has the path with this bloom_hash(), true
+		// if one may.
+		bool MayHavePath(uint64 hash) const ;
+
+	private:
+		uint8					*fBase ;
+		size_t					fSize ;
+		const segment_header	*fHeader ;
+		const uint32			*fLengths ;
+		const uint64			*fStoredIndex ;
+		const segment_term		*fTerms ;
+		const char				*fTermText ;
+		const uint8				*fPathFilter ;
+		size_t					fPathFilterSize ;
+		size_t					fTermTextSize ;
+
+		const char* StoredAt(uint32 doc, size_t* length) const ;
+} ;
+
+
+// Reads a list of paths written by SegmentWriter::SetPathList(). Returns
+// B_BAD_DATA if it is damaged, in which case paths is left empty.
+status_t read_path_list(const char* path, std::vector<std::string>* paths) ;
+
+#endif /* _SEGMENT_H_ */
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "TextScanner.h"
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+
+#define S	CHAR_SPACE
+#define A	CHAR_ALPHA
+#define D	CHAR_DIGIT
+#define P	CHAR_PUNCTUATION
+#define J	CHAR_JOINER
+#define H	CHAR_HIGH
+#define C	CHAR_CONTROL
+
+const uint8 kCharClasses[256] = {
+	S, C, C, C, C, C, C, C, C, S, S, S, S, S, C, C,
+	C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,
+	S, P, P, P, P, P, J, J, P, P, P, P, J, J, J, J,
+	D, D, D, D, D, D, D, D, D, D, P, P, P, P, P, P,
+	J, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	A, A, A, A, A, A, A, A, A, A, A, P, P, P, P, J,
+	P, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	A, A, A, A, A, A, A, A, A, A, A, P, P, P, P, C,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+	H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+} ;
+
+#undef S
+#undef A
+#undef D
+#undef P
+#undef J
+#undef H
+#undef C
+
+
+#ifdef __SSE2__
+
+static inline __m128i
+in_range(__m128i bytes, char low, char high)
+{
+	// Signed compares, so bytes of 0x80 and up never match an ASCII range.
+	return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(low - 1)),
+		_mm_cmplt_epi8(bytes, _mm_set1_epi8(high + 1))) ;
+}
+
+
+static inline __m128i
+equals(__m128i bytes, char value)
+{
+	return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)) ;
+}
+
+
+// Sets every byte of the result that is in one of classes.
+static inline __m128i
+class_mask(__m128i bytes, uint32 classes)
+{
+	__m128i zero = _mm_setzero_si128() ;
+	__m128i alpha = zero, digit = zero, space = zero, high = zero ;
+	if (classes & (CHAR_ALPHA | CHAR_PUNCTUATION)) {
+		alpha = in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)),
+			'a', 'z') ;
+	}
+	if (classes & (CHAR_DIGIT | CHAR_PUNCTUATION))
+		digit = in_range(bytes, '0', '9') ;
+	if (classes & (CHAR_SPACE | CHAR_CONTROL)) {
+		space = _mm_or_si128(equals(bytes, ' '),
+			_mm_or_si128(in_range(bytes, '\t', '\r'), equals(bytes, 0))) ;
+	}
+	if (classes & (CHAR_HIGH | CHAR_CONTROL))
+		high = _mm_cmplt_epi8(bytes, zero) ;
+
+	__m128i mask = zero ;
+	if (classes & CHAR_ALPHA)
+		mask = _mm_or_si128(mask, alpha) ;
+	if (classes & CHAR_DIGIT)
+		mask = _mm_or_si128(mask, digit) ;
+	if (classes & CHAR_SPACE)
+		mask = _mm_or_si128(mask, space) ;
+	if (classes & CHAR_HIGH)
+		mask = _mm_or_si128(mask, high) ;
+
+	if (classes & (CHAR_JOINER | CHAR_PUNCTUATION | CHAR_CONTROL)) {
+		__m128i joiner = _mm_or_si128(
+			_mm_or_si128(_mm_or_si128(equals(bytes, '.'), equals(bytes, ',')),
+				_mm_or_si128(equals(bytes, '-'), equals(bytes, '_'))),
+			_mm_or_si128(_mm_or_si128(equals(bytes, '/'), equals(bytes, '\'')),
+				_mm_or_si128(equals(bytes, '@'), equals(bytes, '&')))) ;
+		__m128i printable = in_range(bytes, '!', '~') ;
+
+		if (classes & CHAR_JOINER)
+			mask = _mm_or_si128(mask, joiner) ;
+		if (classes & CHAR_PUNCTUATION) {
+			// Printable, and none of the others.
+			__m128i other = _mm_or_si128(_mm_or_si128(alpha, digit), joiner) ;
+			mask = _mm_or_si128(mask, _mm_andnot_si128(other, printable)) ;
+		}
+		if (classes & CHAR_CONTROL) {
+			__m128i other = _mm_or_si128(_mm_or_si128(space, high), printable) ;
+			mask = _mm_or_si128(mask,
+				_mm_andnot_si128(other, _mm_set1_epi8(-1))) ;
+		}
+	}
+
+	return mask ;
+}
+
+
+static size_t
+span(const char* text, size_t length, uint32 classes, int match)
+{
+	size_t position = 0 ;
+	while (position + 16 <= length) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(text + position)) ;
+		int bits = _mm_movemask_epi8(class_mask(bytes, classes)) ;
+		if (match)
+			bits = ~bits & 0xffff ;
+		if (bits != 0)
+			return position + lowest_bit(bits) ;
+		position += 16 ;
+	}
+
+	while (position < length
+		&& ((kCharClasses[(uint8)text[position]] & classes) != 0) == match)
+		position++ ;
+
+	return position ;
+}
+
+#else
+
+static size_t
+span(const char* text, size_t length, uint32 classes, int match)
+{
+	size_t position = 0 ;
+	while (position < length
+		&& ((kCharClasses[(uint8)text[position]] & classes) != 0) == match)
+		position++ ;
+
+	return position ;
+}
+
+#endif
+
+
+uint64
+scan_classes(const char* text, size_t length, uint32 classes)
+{
+	if (length > 64)
+		length = 64 ;
+
+	uint64 bits = 0 ;
+	size_t position = 0 ;
+
+#ifdef __SSE2__
+	for ( ; position + 16 <= length ; position += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(text + position)) ;
+		bits |= (uint64)(uint16)_mm_movemask_epi8(class_mask(bytes, classes))
+			<< position ;
+	}
+#endif
+
+	for ( ; position < length ; position++) {
+		if ((kCharClasses[(uint8)text[position]] & classes) != 0)
+			bits |= (uint64)1 << position ;
+	}
+
+	return bits ;
+}
+
+
+size_t
+span_classes(const char* text, size_t length, uint32 classes)
+{
+	return span(text, length, classes, 1) ;
+}
+
+
+size_t
+span_other_classes(const char* text, size_t length, uint32 classes)
+{
+	return span(text, length, classes, 0) ;
+}
+
+
+void
+lowercase_ascii(const char* in, char* out, size_t length)
+{
+	size_t position = 0 ;
+
+#ifdef __SSE2__
+	for ( ; position + 16 <= length ; position += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(in + position)) ;
+		__m128i upper = in_range(bytes, 'A', 'Z') ;
+		bytes = _mm_or_si128(bytes, _mm_and_si128(upper,
+			_mm_set1_epi8(0x20))) ;
+		_mm_storeu_si128((__m128i*)(out + position), bytes) ;
+	}
+#endif
+
+	for ( ; position < length ; position++) {
+		char c = in[position] ;
+		out[position] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c ;
+	}
+}
+
+
+bool
+is_valid_utf8(const char* text, size_t length)
+{
+	const uint8 *bytes = (const uint8*)text ;
+	size_t position = 0 ;
+
+	while (true) {
+		position += span_classes(text + position, length - position,
+			CHAR_ASCII) ;
+		if (position == length)
+			return true ;
+
+		uint8 c = bytes[position] ;
+		size_t size ;
+		uint32 min ;
+		uint32 value ;
+		if (c >= 0xc2 && c <= 0xdf) {
+			size = 2 ;
+			min = 0x80 ;
+			value = c & 0x1f ;
+		} else if (c >= 0xe0 && c <= 0xef) {
+			size = 3 ;
+			min = 0x800 ;
+			value = c & 0x0f ;
+		} else if (c >= 0xf0 && c <= 0xf4) {
+			size = 4 ;
+			min = 0x10000 ;
+			value = c & 0x07 ;
+		} else
+			return false ;
+
+		if (length - position < size)
+			return false ;
+
+		for (size_t i = 1 ; i < size ; i++) {
+			if ((bytes[position + i] & 0xc0) != 0x80)
+				return false ;
+			value = (value << 6) | (bytes[position + i] & 0x3f) ;
+		}
+
+		if (value < min || value > 0x10ffff
+			|| (value >= 0xd800 && value <= 0xdfff))
+			return false ;
+
+		position += size ;
+	}
+}
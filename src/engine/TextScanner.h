@@ -0,0 +1,73 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _TEXT_SCANNER_H_
+#define _TEXT_SCANNER_H_
+
+#include "EngineDefs.h"
+
+#include <stddef.h>
+
+
+// What a byte of UTF-8 text can be, as far as splitting it into words is
+// concerned.
+enum {
+	CHAR_SPACE			= 0x01,	// ASCII white space and NUL
+	CHAR_ALPHA			= 0x02,
+	CHAR_DIGIT			= 0x04,
+	CHAR_PUNCTUATION	= 0x08,	// ASCII punctuation that ends a word
+	CHAR_JOINER			= 0x10,	// . , - _ / ' @ &, which may not
+	CHAR_HIGH			= 0x20,	// any byte of a non-ASCII character
+	CHAR_CONTROL		= 0x40,	// other ASCII control characters
+
+	CHAR_WORD			= CHAR_ALPHA | CHAR_DIGIT | CHAR_HIGH,
+	CHAR_ASCII			= 0xff & ~CHAR_HIGH,
+} ;
+
+extern const uint8 kCharClasses[256] ;
+
+
+// These look at 16 bytes at a time with SSE2 where there is SSE2, and
+// fall back to a table lookup per byte elsewhere.
+
+// Bit i of the result is set if byte i of text is in classes. Looks at
+// no more than 64 bytes.
+uint64 scan_classes(const char* text, size_t length, uint32 classes) ;
+
+// Length of the longest prefix of text made only of bytes in classes.
+size_t span_classes(const char* text, size_t length, uint32 classes) ;
+
+// Length of the longest prefix of text without any byte in classes.
+size_t span_other_classes(const char* text, size_t length, uint32 classes) ;
+
+// Copies length bytes, turning 'A' to 'Z' into 'a' to 'z'. Everything
+// else, UTF-8 sequences included, is left alone.
+void lowercase_ascii(const char* in, char* out, size_t length) ;
+
+// Whether text is well formed UTF-8, without overlong forms, surrogates or
+// anything past U+10FFFF.
+bool is_valid_utf8(const char* text, size_t length) ;
+
+
+// Index of the lowest set bit, which there has to be.
+static inline int32
+lowest_bit(uint64 bits)
+{
+#if __GNUC__ >= 4
+	return __builtin_ctzll(bits) ;
+#else
+	int32 index = 0 ;
+	while ((bits & 1) == 0) {
+		bits >>= 1 ;
+		index++ ;
+	}
+	return index ;
+#endif
+}
+
+#endif /* _TEXT_SCANNER_H_ */
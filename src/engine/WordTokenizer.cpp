@@ -0,0 +1,195 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "WordTokenizer.h"
+#include "TextScanner.h"
+
+#include <string.h>
+
+
+// Up to five bytes of a word packed into a number, so that a switch can
+// compare it against all the stop words at once.
+#define KEY(a, b, c, d, e) \
+	((uint64)(a) | (uint64)(b) << 8 | (uint64)(c) << 16 | (uint64)(d) << 24 \
+		| (uint64)(e) << 32)
+
+
+WordTokenizer::WordTokenizer(const char* text, size_t length)
+	: fText(text),
+	  fEnd(text + length)
+#ifdef __SSE2__
+	  , fWindow(text),
+	  fWindowLength(0),
+	  fWordBits(0)
+#endif
+{
+}
+
+
+const char*
+WordTokenizer::Next(size_t* length)
+{
+	while (fText < fEnd) {
+		size_t size = CopyWord() ;
+
+		// Don't leave half a character at the end of a long word.
+		if (size == (size_t)kMaxTokenLength) {
+			while (size > 0 && ((uint8)fToken[size - 1] & 0xc0) == 0x80)
+				size-- ;
+			if (size > 0 && ((uint8)fToken[size - 1] & 0x80) != 0)
+				size-- ;
+		}
+
+		if (size == 0 || IsStopWord(fToken, size))
+			continue ;
+
+		fToken[size] = '\0' ;
+		*length = size ;
+		return fToken ;
+	}
+
+	return NULL ;
+}
+
+
+#ifdef __SSE2__
+
+// Copies the next word to fToken in lower case, and returns its length, or
+// 0 if there are no more. Words are short, so rather than look at the text
+// again for every one, it is classified and lowercased 64 bytes at a time.
+size_t
+WordTokenizer::CopyWord()
+{
+	// Skip to the start of the word.
+	while (true) {
+		if (fText == fWindow + fWindowLength) {
+			if (fText == fEnd)
+				return 0 ;
+			LoadWindow() ;
+		}
+
+		uint64 bits = fWordBits >> (fText - fWindow) ;
+		if (bits != 0) {
+			fText += lowest_bit(bits) ;
+			break ;
+		}
+		fText = fWindow + fWindowLength ;
+	}
+
+	// And copy it out a window at a time.
+	size_t size = 0 ;
+	while (true) {
+		size_t offset = fText - fWindow ;
+		uint64 bits = ~fWordBits >> offset ;
+		size_t run = bits != 0 ? lowest_bit(bits) : kWindowSize - offset ;
+		if (run > fWindowLength - offset)
+			run = fWindowLength - offset ;
+
+		size_t copy = run ;
+		if (copy > (size_t)kMaxTokenLength - size)
+			copy = kMaxTokenLength - size ;
+		// Whole blocks of 16, which is faster than an exact copy for
+		// words this short. Both buffers have room for the extra.
+		for (size_t i = 0 ; i < copy ; i += 16)
+			memcpy(fToken + size + i, fLowercase + offset + i, 16) ;
+		size += copy ;
+		fText += run ;
+
+		if (fText < fWindow + fWindowLength || fText == fEnd)
+			return size ;
+		LoadWindow() ;
+	}
+}
+
+
+void
+WordTokenizer::LoadWindow()
+{
+	fWindow = fText ;
+	fWindowLength = fEnd - fText ;
+	if (fWindowLength > kWindowSize)
+		fWindowLength = kWindowSize ;
+
+	fWordBits = scan_classes(fWindow, fWindowLength, CHAR_WORD) ;
+	lowercase_ascii(fWindow, fLowercase, fWindowLength) ;
+}
+
+#else
+
+// Without SSE2, a byte at a time is as fast as it gets.
+size_t
+WordTokenizer::CopyWord()
+{
+	while (fText < fEnd && (kCharClasses[(uint8)*fText] & CHAR_WORD) == 0)
+		fText++ ;
+
+	size_t size = 0 ;
+	while (fText < fEnd && (kCharClasses[(uint8)*fText] & CHAR_WORD) != 0) {
+		char c = *fText++ ;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A' ;
+		if (size < (size_t)kMaxTokenLength)
+			fToken[size++] = c ;
+	}
+
+	return size ;
+}
+
+#endif
+
+
+bool
+WordTokenizer::IsStopWord(const char* word, size_t length)
+{
+	if (length > 5)
+		return false ;
+
+	uint64 key = 0 ;
+	for (size_t i = 0 ; i < length ; i++)
+		key |= (uint64)(uint8)word[i] << (i * 8) ;
+
+	// The English stop words StandardAnalyzer leaves out.
+	switch (key) {
+		case KEY('a', 0, 0, 0, 0):
+		case KEY('a', 'n', 0, 0, 0):
+		case KEY('a', 'n', 'd', 0, 0):
+		case KEY('a', 'r', 'e', 0, 0):
+		case KEY('a', 's', 0, 0, 0):
+		case KEY('a', 't', 0, 0, 0):
+		case KEY('b', 'e', 0, 0, 0):
+		case KEY('b', 'u', 't', 0, 0):
+		case KEY('b', 'y', 0, 0, 0):
+		case KEY('f', 'o', 'r', 0, 0):
+		case KEY('i', 'f', 0, 0, 0):
+		case KEY('i', 'n', 0, 0, 0):
+		case KEY('i', 'n', 't', 'o', 0):
+		case KEY('i', 's', 0, 0, 0):
+		case KEY('i', 't', 0, 0, 0):
+		case KEY('n', 'o', 0, 0, 0):
+		case KEY('n', 'o', 't', 0, 0):
+		case KEY('o', 'f', 0, 0, 0):
+		case KEY('o', 'n', 0, 0, 0):
+		case KEY('o', 'r', 0, 0, 0):
+		case KEY('s', 'u', 'c', 'h', 0):
+		case KEY('t', 'h', 'a', 't', 0):
+		case KEY('t', 'h', 'e', 0, 0):
+		case KEY('t', 'h', 'e', 'i', 'r'):
+		case KEY('t', 'h', 'e', 'n', 0):
+		case KEY('t', 'h', 'e', 'r', 'e'):
+		case KEY('t', 'h', 'e', 's', 'e'):
+		case KEY('t', 'h', 'e', 'y', 0):
+		case KEY('t', 'h', 'i', 's', 0):
+		case KEY('t', 'o', 0, 0, 0):
+		case KEY('w', 'a', 's', 0, 0):
+		case KEY('w', 'i', 'l', 'l', 0):
+		case KEY('w', 'i', 't', 'h', 0):
+			return true ;
+		default:
+			return false ;
+	}
+}
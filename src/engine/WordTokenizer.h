@@ -0,0 +1,54 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _WORD_TOKENIZER_H_
+#define _WORD_TOKENIZER_H_
+
+#include "EngineDefs.h"
+
+#include <stddef.h>
+
+
+const int32 kMaxTokenLength = 255 ;
+const size_t kWindowSize = 64 ;
+
+
+// Splits UTF-8 text into lower case words, the way StandardAnalyzer does
+// for plain text: runs of letters and digits, with every non-ASCII
+// character counted as a letter, and English stop words left out.
+class WordTokenizer {
+	public:
+		WordTokenizer(const char* text, size_t length) ;
+
+		// Returns the next word, valid until the next call, or NULL at the
+		// end of the text.
+		const char* Next(size_t* length) ;
+
+		static bool IsStopWord(const char* word, size_t length) ;
+
+	private:
+		size_t CopyWord() ;
+
+		const char	*fText ;
+		const char	*fEnd ;
+
+#ifdef __SSE2__
+		void LoadWindow() ;
+
+		// Which of the bytes from fWindow on are word characters, and
+		// what they are in lower case.
+		const char	*fWindow ;
+		size_t		fWindowLength ;
+		uint64		fWordBits ;
+		char		fLowercase[kWindowSize + 16] ;
+#endif
+
+		char		fToken[kMaxTokenLength + 16] ;
+} ;
+
+#endif /* _WORD_TOKENIZER_H_ */
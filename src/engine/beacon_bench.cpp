@@ -0,0 +1,570 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Runs index_server's pipeline over a generated corpus of files and prints
+// how long each stage took, as JSON. The same options and seed always make
+// the same corpus, so runs of different builds can be compared.
+//
+// The filesystem crawl is a plain directory walk rather than a query, and
+// the Translation Kit is stood in for by a translator that passes plain
+// text through and strips the tags from markup. Text goes through a
+// temporary file on its way to the index, as it does in index_server.
+//
+//	beacon_bench [-f files] [-s mean size] [-z skew] [-d depth]
+//		[-w fan out] [-v vocabulary] [-m markup percent] [-b batch]
+//		[-q queries] [-r seed] directory
+
+#include "NativeIndex.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+
+const int32 kWordsPerLine = 12 ;
+const int32 kMaxHits = 20 ;
+const int32 kQueryKinds = 5 ;
+const char* kQueryKindNames[kQueryKinds] = { "common", "rare", "and",
+	"or", "and3" } ;
+
+
+struct bench_options {
+	int32		files ;
+	int32		meanSize ;
+	double		skew ;
+	int32		depth ;
+	int32		fanOut ;
+	int32		vocabulary ;
+	int32		markupPercent ;
+	int32		batch ;
+	int32		queries ;
+	uint32		seed ;
+} ;
+
+
+static double
+now()
+{
+	struct timespec ts ;
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0 ;
+}
+
+
+static uint32
+next_random(uint32* state)
+{
+	*state = *state * 1103515245 + 12345 ;
+	return *state >> 1 ;
+}
+
+
+static double
+next_fraction(uint32* state)
+{
+	return next_random(state) / 2147483648.0 ;
+}
+
+
+static void
+make_word(int32 rank, char* word)
+{
+	// Distinct, letters only, shorter for more common words.
+	int32 length = 0 ;
+	do {
+		word[length++] = 'a' + rank % 26 ;
+		rank /= 26 ;
+	} while (rank > 0) ;
+	word[length++] = 'q' ;
+	word[length] = '\0' ;
+}
+
+
+// Word ranks follow Zipf's law: rank r turns up in proportion to
+// 1 / r^skew.
+class ZipfSampler {
+	public:
+		ZipfSampler(int32 vocabulary, double skew)
+		{
+			double total = 0 ;
+			for (int32 rank = 0 ; rank < vocabulary ; rank++) {
+				total += 1.0 / pow(rank + 1, skew) ;
+				fCumulative.push_back(total) ;
+			}
+		}
+
+		int32 Next(uint32* state) const
+		{
+			double target = fCumulative.back() * next_fraction(state) ;
+			int32 rank = std::lower_bound(fCumulative.begin(),
+				fCumulative.end(), target) - fCumulative.begin() ;
+			return rank < (int32)fCumulative.size()
+				? rank : fCumulative.size() - 1 ;
+		}
+
+	private:
+		std::vector<double>	fCumulative ;
+} ;
+
+
+static bool
+make_directories(const std::string& path)
+{
+	for (size_t slash = path.find('/', 1) ; ; slash = path.find('/',
+			slash + 1)) {
+		std::string part = path.substr(0, slash) ;
+		if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+			return false ;
+		if (slash == std::string::npos)
+			return true ;
+	}
+}
+
+
+static void
+remove_tree(const std::string& path)
+{
+	DIR *dir = opendir(path.c_str()) ;
+	if (dir == NULL) {
+		unlink(path.c_str()) ;
+		return ;
+	}
+
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0)
+			remove_tree(path + "/" + entry->d_name) ;
+	}
+
+	closedir(dir) ;
+	rmdir(path.c_str()) ;
+}
+
+
+static off_t
+tree_size(const std::string& path)
+{
+	struct stat st ;
+	if (stat(path.c_str(), &st) != 0)
+		return 0 ;
+	if (!S_ISDIR(st.st_mode))
+		return st.st_size ;
+
+	DIR *dir = opendir(path.c_str()) ;
+	if (dir == NULL)
+		return 0 ;
+
+	off_t size = 0 ;
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0)
+			size += tree_size(path + "/" + entry->d_name) ;
+	}
+
+	closedir(dir) ;
+	return size ;
+}
+
+
+static std::string
+describe(const bench_options& options)
+{
+	char description[256] ;
+	snprintf(description, sizeof(description),
+		"files %d size %d skew %g depth %d fan out %d vocabulary %d "
+		"markup %d seed %u\n", (int)options.files, (int)options.meanSize,
+		options.skew, (int)options.depth, (int)options.fanOut,
+		(int)options.vocabulary, (int)options.markupPercent,
+		(unsigned)options.seed) ;
+	return description ;
+}
+
+
+static bool
+read_file(const char* path, std::string* contents)
+{
+	FILE *file = fopen(path, "rb") ;
+	if (file == NULL)
+		return false ;
+
+	char buffer[65536] ;
+	size_t bytesRead ;
+	contents->clear() ;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		contents->append(buffer, bytesRead) ;
+
+	fclose(file) ;
+	return true ;
+}
+
+
+static bool
+write_file(const char* path, const std::string& contents)
+{
+	FILE *file = fopen(path, "wb") ;
+	if (file == NULL)
+		return false ;
+
+	bool written = fwrite(contents.data(), 1, contents.size(), file)
+		== contents.size() ;
+	return fclose(file) == 0 && written ;
+}
+
+
+// Writes the corpus, unless the one already there was made with the same
+// options. Returns the number of bytes written, or -1.
+static off_t
+generate_corpus(const std::string& root, const bench_options& options,
+	const ZipfSampler& sampler)
+{
+	std::string corpus = root + "/corpus" ;
+	std::string marker = root + "/corpus.options" ;
+	std::string description ;
+	if (read_file(marker.c_str(), &description)
+		&& description == describe(options))
+		return 0 ;
+
+	remove_tree(corpus) ;
+	unlink(marker.c_str()) ;
+
+	uint32 state = options.seed ;
+	int32 leaves = 1 ;
+	for (int32 i = 0 ; i < options.depth ; i++)
+		leaves *= options.fanOut ;
+
+	std::set<std::string> directories ;
+	std::string text ;
+	char word[16], name[32] ;
+	off_t written = 0 ;
+	for (int32 i = 0 ; i < options.files ; i++) {
+		std::string path = corpus ;
+		int32 leaf = next_random(&state) % leaves ;
+		for (int32 level = 0 ; level < options.depth ; level++) {
+			snprintf(name, sizeof(name), "/d%d", (int)(leaf
+				% options.fanOut)) ;
+			path += name ;
+			leaf /= options.fanOut ;
+		}
+		if (directories.insert(path).second && !make_directories(path))
+			return -1 ;
+
+		// Sizes spread out like real files, a few much bigger than most.
+		bool markup = (int32)(next_random(&state) % 100)
+			< options.markupPercent ;
+		size_t size = (size_t)(-log(1.0 - next_fraction(&state))
+			* options.meanSize) + 16 ;
+
+		text = markup ? "<html><body>\n<p>" : "" ;
+		for (int32 words = 1 ; text.size() < size ; words++) {
+			make_word(sampler.Next(&state), word) ;
+			bool bold = markup && next_random(&state) % 16 == 0 ;
+			if (bold)
+				text += "<b>" ;
+			text += word ;
+			if (bold)
+				text += "</b>" ;
+			if (words % kWordsPerLine == 0)
+				text += markup ? "</p>\n<p>" : "\n" ;
+			else
+				text += ' ' ;
+		}
+		if (markup)
+			text += "</p>\n</body></html>\n" ;
+
+		snprintf(name, sizeof(name), "/%08d.%s", (int)i,
+			markup ? "html" : "txt") ;
+		path += name ;
+		if (!write_file(path.c_str(), text))
+			return -1 ;
+		written += text.size() ;
+	}
+
+	if (!write_file(marker.c_str(), describe(options)))
+		return -1 ;
+
+	return written ;
+}
+
+
+static void
+crawl(const std::string& path, std::vector<std::string>* files)
+{
+	DIR *dir = opendir(path.c_str()) ;
+	if (dir == NULL)
+		return ;
+
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue ;
+
+		std::string child = path + "/" + entry->d_name ;
+		struct stat st ;
+		if (stat(child.c_str(), &st) != 0)
+			continue ;
+		if (S_ISDIR(st.st_mode))
+			crawl(child, files) ;
+		else if (S_ISREG(st.st_mode))
+			files->push_back(child) ;
+	}
+
+	closedir(dir) ;
+}
+
+
+// Stands in for the Translation Kit.
+static bool
+translate(const std::string& path, const char* textPath, uint64* bytesRead)
+{
+	std::string contents ;
+	if (!read_file(path.c_str(), &contents))
+		return false ;
+	*bytesRead += contents.size() ;
+
+	size_t extension = path.rfind('.') ;
+	if (extension != std::string::npos
+		&& path.compare(extension, std::string::npos, ".html") == 0) {
+		std::string text ;
+		bool inTag = false ;
+		for (size_t i = 0 ; i < contents.size() ; i++) {
+			if (contents[i] == '<')
+				inTag = true ;
+			else if (contents[i] == '>') {
+				inTag = false ;
+				text += ' ' ;
+			} else if (!inTag)
+				text += contents[i] ;
+		}
+		contents.swap(text) ;
+	}
+
+	return write_file(textPath, contents) ;
+}
+
+
+static double
+percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0 ;
+
+	size_t index = (size_t)(fraction * sorted.size()) ;
+	return sorted[index < sorted.size() ? index : sorted.size() - 1] ;
+}
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: beacon_bench [-f files] [-s mean size] "
+		"[-z skew] [-d depth]\n\t[-w fan out] [-v vocabulary] "
+		"[-m markup percent] [-b batch]\n\t[-q queries] [-r seed] "
+		"directory\n") ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	bench_options options ;
+	options.files = 10000 ;
+	options.meanSize = 4096 ;
+	options.skew = 1.0 ;
+	options.depth = 3 ;
+	options.fanOut = 8 ;
+	options.vocabulary = 50000 ;
+	options.markupPercent = 20 ;
+	options.batch = 1000 ;
+	options.queries = 5000 ;
+	options.seed = 42 ;
+
+	int opt ;
+	while ((opt = getopt(argc, argv, "f:s:z:d:w:v:m:b:q:r:")) != -1) {
+		switch (opt) {
+			case 'f': options.files = atoi(optarg) ; break ;
+			case 's': options.meanSize = atoi(optarg) ; break ;
+			case 'z': options.skew = atof(optarg) ; break ;
+			case 'd': options.depth = atoi(optarg) ; break ;
+			case 'w': options.fanOut = atoi(optarg) ; break ;
+			case 'v': options.vocabulary = atoi(optarg) ; break ;
+			case 'm': options.markupPercent = atoi(optarg) ; break ;
+			case 'b': options.batch = atoi(optarg) ; break ;
+			case 'q': options.queries = atoi(optarg) ; break ;
+			case 'r': options.seed = strtoul(optarg, NULL, 10) ; break ;
+			default:
+				usage() ;
+				return 1 ;
+		}
+	}
+	if (optind != argc - 1 || options.files < 0 || options.meanSize < 0
+		|| options.depth < 0 || options.fanOut < 1
+		|| options.vocabulary < 1 || options.batch < 1) {
+		usage() ;
+		return 1 ;
+	}
+
+	std::string root = argv[optind] ;
+	if (!make_directories(root)) {
+		fprintf(stderr, "Could not create %s\n", root.c_str()) ;
+		return 1 ;
+	}
+
+	ZipfSampler sampler(options.vocabulary, options.skew) ;
+	double start = now() ;
+	off_t generated = generate_corpus(root, options, sampler) ;
+	if (generated < 0) {
+		fprintf(stderr, "Could not write the corpus to %s\n", root.c_str()) ;
+		return 1 ;
+	}
+	double generateTime = now() - start ;
+
+	// Crawl.
+	std::vector<std::string> files ;
+	start = now() ;
+	crawl(root + "/corpus", &files) ;
+	std::sort(files.begin(), files.end()) ;
+	double crawlTime = now() - start ;
+
+	// Extract and index, a batch to a commit.
+	std::string indexPath = root + "/index" ;
+	std::string textPath = root + "/text" ;
+	remove_tree(indexPath) ;
+	NativeIndex index ;
+	if (index.Open(indexPath.c_str(), true) != B_OK) {
+		fprintf(stderr, "Could not create %s\n", indexPath.c_str()) ;
+		return 1 ;
+	}
+
+	double extractTime = 0, indexTime = 0, commitTime = 0 ;
+	uint64 bytesRead = 0, textBytes = 0 ;
+	int32 indexed = 0, failed = 0, commits = 0 ;
+	std::string text ;
+	for (size_t i = 0 ; i < files.size() ; i++) {
+		start = now() ;
+		bool extracted = translate(files[i], textPath.c_str(), &bytesRead)
+			&& read_file(textPath.c_str(), &text) ;
+		extractTime += now() - start ;
+		if (!extracted) {
+			failed++ ;
+			continue ;
+		}
+
+		start = now() ;
+		size_t dot = files[i].rfind('.') ;
+		native_document document = { files[i].c_str(), text.c_str(),
+			text.size(), "", files[i].compare(dot, std::string::npos,
+				".html") == 0 ? "text/html" : "text/plain",
+			text.size(), 0 } ;
+		if (index.AddDocument(&document) == B_OK)
+			indexed++ ;
+		else
+			failed++ ;
+		textBytes += text.size() ;
+		indexTime += now() - start ;
+
+		if ((i + 1) % options.batch == 0 || i + 1 == files.size()) {
+			start = now() ;
+			if (index.Commit() != B_OK) {
+				fprintf(stderr, "Commit failed\n") ;
+				return 1 ;
+			}
+			commits++ ;
+			commitTime += now() - start ;
+		}
+	}
+	unlink(textPath.c_str()) ;
+	off_t indexSize = tree_size(indexPath) ;
+
+	// The same mix of queries every time, from common words to rare ones.
+	std::vector<double> latencies[kQueryKinds], all ;
+	uint32 state = options.seed ^ 0x5bd1e995 ;
+	char words[3][16] ;
+	native_clause clauses[3] ;
+	native_hit hits[kMaxHits] ;
+	uint64 found = 0 ;
+	int32 rareStart = options.vocabulary > 1000 ? 1000 : 0 ;
+	for (int32 i = 0 ; i < options.queries ; i++) {
+		int32 kind = i % kQueryKinds ;
+		int32 count = kind < 2 ? 1 : (kind == 4 ? 3 : 2) ;
+		for (int32 j = 0 ; j < count ; j++) {
+			int32 rank ;
+			if (kind == 1 || (j == 1 && kind != 3))
+				rank = rareStart + next_random(&state)
+					% (options.vocabulary - rareStart) ;
+			else
+				rank = next_random(&state) % std::min(options.vocabulary,
+					(int32)100) ;
+			make_word(rank, words[j]) ;
+			clauses[j].term = words[j] ;
+			clauses[j].occur = kind == 3 ? NATIVE_SHOULD : NATIVE_MUST ;
+		}
+
+		start = now() ;
+		found += index.Search(clauses, count, NULL, NULL, hits, kMaxHits) ;
+		double latency = (now() - start) * 1000000 ;
+		latencies[kind].push_back(latency) ;
+		all.push_back(latency) ;
+	}
+
+	printf("{\n") ;
+	printf("  \"options\": {\"files\": %d, \"mean_size\": %d, "
+		"\"skew\": %g, \"depth\": %d, \"fan_out\": %d, \"vocabulary\": %d, "
+		"\"markup_percent\": %d, \"batch\": %d, \"queries\": %d, "
+		"\"seed\": %u},\n", (int)options.files, (int)options.meanSize,
+		options.skew, (int)options.depth, (int)options.fanOut,
+		(int)options.vocabulary, (int)options.markupPercent,
+		(int)options.batch, (int)options.queries, (unsigned)options.seed) ;
+	printf("  \"generate\": {\"bytes\": %lld, \"seconds\": %.3f},\n",
+		(long long)generated, generateTime) ;
+	printf("  \"crawl\": {\"files\": %lu, \"seconds\": %.3f, "
+		"\"files_per_second\": %.0f},\n", (unsigned long)files.size(),
+		crawlTime, crawlTime > 0 ? files.size() / crawlTime : 0) ;
+	printf("  \"extract\": {\"bytes_read\": %llu, \"text_bytes\": %llu, "
+		"\"seconds\": %.3f, \"mb_per_second\": %.1f},\n",
+		(unsigned long long)bytesRead, (unsigned long long)textBytes,
+		extractTime, extractTime > 0
+			? bytesRead / 1048576.0 / extractTime : 0) ;
+	double totalIndexTime = indexTime + commitTime ;
+	printf("  \"index\": {\"documents\": %d, \"failed\": %d, "
+		"\"commits\": %d, \"add_seconds\": %.3f, \"commit_seconds\": %.3f, "
+		"\"documents_per_second\": %.0f, \"mb_per_second\": %.1f, "
+		"\"index_bytes\": %lld, \"bytes_per_text_byte\": %.3f},\n",
+		(int)indexed, (int)failed, (int)commits, indexTime, commitTime,
+		totalIndexTime > 0 ? indexed / totalIndexTime : 0,
+		totalIndexTime > 0 ? textBytes / 1048576.0 / totalIndexTime : 0,
+		(long long)indexSize, textBytes > 0
+			? (double)indexSize / textBytes : 0) ;
+	printf("  \"queries\": {\"hits_per_query\": %.2f",
+		options.queries > 0 ? (double)found / options.queries : 0) ;
+	for (int32 kind = 0 ; kind <= kQueryKinds ; kind++) {
+		std::vector<double> &sorted = kind < kQueryKinds
+			? latencies[kind] : all ;
+		std::sort(sorted.begin(), sorted.end()) ;
+		printf(",\n    \"%s\": {\"count\": %lu, \"p50_us\": %.2f, "
+			"\"p99_us\": %.2f, \"max_us\": %.2f}",
+			kind < kQueryKinds ? kQueryKindNames[kind] : "all",
+			(unsigned long)sorted.size(), percentile(sorted, 0.5),
+			percentile(sorted, 0.99), sorted.empty() ? 0 : sorted.back()) ;
+	}
+	printf("\n  }\n}\n") ;
+
+	return 0 ;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Builds a native index of a synthetic corpus and times searches on it.
+// Word frequencies follow Zipf's law, roughly like real text.
+//
+//	engine_bench [directory [documents [words per document]]]
+
+#include "NativeIndex.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+const int32 kVocabulary = 50000 ;
+const int32 kQueries = 2000 ;
+
+
+static double
+now()
+{
+	struct timeval tv ;
+	gettimeofday(&tv, NULL) ;
+	return tv.tv_sec + tv.tv_usec / 1000000.0 ;
+}
+
+
+static uint32
+next_random(uint32* state)
+{
+	*state = *state * 1103515245 + 12345 ;
+	return *state >> 1 ;
+}
+
+
+static void
+make_word(int32 rank, char* word)
+{
+	// Distinct, letters only, shorter for more common words.
+	int32 length = 0 ;
+	do {
+		word[length++] = 'a' + rank % 26 ;
+		rank /= 26 ;
+	} while (rank > 0) ;
+	word[length++] = 'q' ;
+	word[length] = '\0' ;
+}
+
+
+static off_t
+directory_size(const char* path)
+{
+	DIR *dir = opendir(path) ;
+	if (dir == NULL)
+		return 0 ;
+
+	off_t size = 0 ;
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string file = std::string(path) + "/" + entry->d_name ;
+		struct stat st ;
+		if (entry->d_name[0] != '.' && stat(file.c_str(), &st) == 0)
+			size += st.st_size ;
+	}
+
+	closedir(dir) ;
+	return size ;
+}
+
+
+static void
+time_queries(NativeIndex* index, const char* name, int32 occur,
+	const std::vector<int32>& ranks)
+{
+	char first[16], second[16] ;
+	native_clause clauses[2] ;
+	native_hit hits[20] ;
+	uint64 found = 0 ;
+
+	double start = now() ;
+	for (size_t i = 0 ; i + 1 < ranks.size() ; i += 2) {
+		make_word(ranks[i], first) ;
+		make_word(ranks[i + 1], second) ;
+		clauses[0].term = first ;
+		clauses[0].occur = occur ;
+		clauses[1].term = second ;
+		clauses[1].occur = occur ;
+		found += index->Search(clauses, 2, NULL, NULL, hits, 20) ;
+	}
+	double elapsed = now() - start ;
+
+	printf("%-6s %8.1f us/query, %.1f hits/query\n", name,
+		elapsed * 1000000 / (ranks.size() / 2),
+		(double)found / (ranks.size() / 2)) ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char *directory = argc > 1 ? argv[1] : "/tmp/engine_bench" ;
+	int32 documents = argc > 2 ? atoi(argv[2]) : 100000 ;
+	int32 wordsPerDocument = argc > 3 ? atoi(argv[3]) : 200 ;
+
+	// Zipf's law: the word of rank r turns up in proportion to 1 / r.
+	std::vector<double> cumulative(kVocabulary) ;
+	double total = 0 ;
+	for (int32 rank = 0 ; rank < kVocabulary ; rank++) {
+		total += 1.0 / (rank + 1) ;
+		cumulative[rank] = total ;
+	}
+
+	NativeIndex index ;
+	if (NativeIndex::Exists(directory)) {
+		fprintf(stderr, "%s already holds an index\n", directory) ;
+		return 1 ;
+	}
+	if (index.Open(directory, true) != B_OK) {
+		fprintf(stderr, "Could not create %s\n", directory) ;
+		return 1 ;
+	}
+
+	uint32 state = 42 ;
+	std::string text ;
+	char word[16], path[64] ;
+	uint64 words = 0 ;
+
+	double start = now() ;
+	for (int32 i = 0 ; i < documents ; i++) {
+		text.clear() ;
+		for (int32 j = 0 ; j < wordsPerDocument ; j++) {
+			double target = total * (next_random(&state) / 2147483648.0) ;
+			int32 rank = std::lower_bound(cumulative.begin(),
+				cumulative.end(), target) - cumulative.begin() ;
+			make_word(rank < kVocabulary ? rank : kVocabulary - 1, word) ;
+			text += word ;
+			text += ' ' ;
+		}
+		words += wordsPerDocument ;
+
+		snprintf(path, sizeof(path), "/bench/%03d/%08d.txt", i % 997, i) ;
+		native_document document = { path, text.c_str(), text.size(), "",
+			"text/plain", text.size(), 0 } ;
+		index.AddDocument(&document) ;
+	}
+	if (index.Commit() != B_OK) {
+		fprintf(stderr, "Commit failed\n") ;
+		return 1 ;
+	}
+	double elapsed = now() - start ;
+
+	off_t size = directory_size(directory) ;
+	printf("indexed %d documents, %llu words in %.2f s\n", (int)documents,
+		(unsigned long long)words, elapsed) ;
+	printf("index size %.1f MB, %.2f bytes per word\n",
+		size / 1048576.0, (double)size / words) ;
+
+	// Pairs of words from the common to the rare end.
+	std::vector<int32> common, mixed, rare ;
+	for (int32 i = 0 ; i < kQueries ; i++) {
+		common.push_back(next_random(&state) % 100) ;
+		mixed.push_back(i % 2 == 0 ? next_random(&state) % 100
+			: 100 + next_random(&state) % 5000) ;
+		rare.push_back(1000 + next_random(&state) % 20000) ;
+	}
+
+	printf("\ncommon words\n") ;
+	time_queries(&index, "AND", NATIVE_MUST, common) ;
+	time_queries(&index, "OR", NATIVE_SHOULD, common) ;
+	printf("common and rare words\n") ;
+	time_queries(&index, "AND", NATIVE_MUST, mixed) ;
+	time_queries(&index, "OR", NATIVE_SHOULD, mixed) ;
+	printf("rare words\n") ;
+	time_queries(&index, "AND", NATIVE_MUST, rare) ;
+	time_queries(&index, "OR", NATIVE_SHOULD, rare) ;
+
+	// Paths that were never indexed, like those of new files, which the
+	// path filters should keep out of most segments.
+	start = now() ;
+	for (int32 i = 0 ; i < kQueries ; i++) {
+		snprintf(path, sizeof(path), "/bench/%03d/%08d.new", i % 997, i) ;
+		index.RemovePath(path) ;
+	}
+	elapsed = now() - start ;
+	printf("\nremoving new paths %8.2f us/path\n",
+		elapsed * 1000000 / kQueries) ;
+
+	return 0 ;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Times WordTokenizer against a plain loop over one byte at a time, on
+// the given files or on synthetic text, and checks they find the same
+// words.
+//
+//	tokenizer_bench [file...]
+
+#include "TextScanner.h"
+#include "WordTokenizer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+
+
+const int32 kRounds = 20 ;
+const size_t kSyntheticLength = 16 * 1024 * 1024 ;
+
+
+static double
+now()
+{
+	struct timeval tv ;
+	gettimeofday(&tv, NULL) ;
+	return tv.tv_sec + tv.tv_usec / 1000000.0 ;
+}
+
+
+static void
+make_text(std::string* text)
+{
+	static const char *kWords[] = {
+		"the", "Index", "server", "keeps", "an", "eye", "on", "volumes",
+		"and", "translates", "documents,", "(mostly)", "text.", "Haiku's",
+		"caf\xc3\xa9", "na\xc3\xafve", "2009", "x86", "\xe6\x97\xa5\xe6\x9c\xac",
+		"query:", "\"quoted\"", "e-mail", "BeOS", "with", "a", "lot", "of",
+		"words"
+	} ;
+	const int32 count = sizeof(kWords) / sizeof(kWords[0]) ;
+
+	uint32 state = 1 ;
+	while (text->size() < kSyntheticLength) {
+		state = state * 1103515245 + 12345 ;
+		text->append(kWords[(state >> 16) % count]) ;
+		text->append((state >> 8) % 12 == 0 ? "\n" : " ") ;
+	}
+}
+
+
+// What WordTokenizer did before it used TextScanner.
+static uint64
+count_words_bytewise(const char* text, size_t length, uint64* checksum)
+{
+	const char *end = text + length ;
+	uint64 count = 0 ;
+	while (text < end) {
+		while (text < end && (kCharClasses[(uint8)*text] & CHAR_WORD) == 0)
+			text++ ;
+
+		char word[kMaxTokenLength] ;
+		size_t size = 0 ;
+		while (text < end && (kCharClasses[(uint8)*text] & CHAR_WORD) != 0) {
+			char c = *text++ ;
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A' ;
+			if (size < sizeof(word))
+				word[size++] = c ;
+		}
+
+		if (size > 0 && !WordTokenizer::IsStopWord(word, size)) {
+			count++ ;
+			*checksum += size * 31 + (uint8)word[size - 1] ;
+		}
+	}
+	return count ;
+}
+
+
+static uint64
+count_words(const char* text, size_t length, uint64* checksum)
+{
+	WordTokenizer tokenizer(text, length) ;
+	const char *word ;
+	size_t size ;
+	uint64 count = 0 ;
+	while ((word = tokenizer.Next(&size)) != NULL) {
+		count++ ;
+		*checksum += size * 31 + (uint8)word[size - 1] ;
+	}
+	return count ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	std::string text ;
+	if (argc < 2)
+		make_text(&text) ;
+
+	for (int i = 1 ; i < argc ; i++) {
+		FILE *file = fopen(argv[i], "rb") ;
+		if (file == NULL) {
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(errno)) ;
+			continue ;
+		}
+
+		char buffer[65536] ;
+		size_t bytesRead ;
+		while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			text.append(buffer, bytesRead) ;
+		fclose(file) ;
+	}
+
+	double megabytes = (double)text.size() * kRounds / (1024 * 1024) ;
+	uint64 expectedSum = 0, actualSum = 0, expected = 0, actual = 0 ;
+
+	double start = now() ;
+	for (int32 round = 0 ; round < kRounds ; round++)
+		expected = count_words_bytewise(text.data(), text.size(),
+			&expectedSum) ;
+	double bytewise = now() - start ;
+
+	start = now() ;
+	for (int32 round = 0 ; round < kRounds ; round++)
+		actual = count_words(text.data(), text.size(), &actualSum) ;
+	double scanned = now() - start ;
+
+	printf("%.1f MB, %llu words\n", (double)text.size() / (1024 * 1024),
+		(unsigned long long)actual) ;
+	printf("byte at a time %8.1f MB/s\n", megabytes / bytewise) ;
+#ifdef __SSE2__
+	printf("WordTokenizer  %8.1f MB/s (SSE2)\n", megabytes / scanned) ;
+#else
+	printf("WordTokenizer  %8.1f MB/s\n", megabytes / scanned) ;
+#endif
+
+	if (actual != expected || actualSum != expectedSum) {
+		fprintf(stderr, "different words: %llu and %llu\n",
+			(unsigned long long)expected, (unsigned long long)actual) ;
+		return 1 ;
+	}
+
+	return 0 ;
+}
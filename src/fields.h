@@ -0,0 +1,63 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _FIELDS_H_
+#define _FIELDS_H_
+
+#include <SupportDefs.h>
+
+#include <wchar.h>
+
+
+// Numbers are indexed as fixed width hex so that term order is numeric
+// order, which lets CLucene's field cache sort on them as strings. Each
+// value is also indexed at coarser precisions in a separate "_trie"
+// field, one term every kPrecisionStep bits, so that a range filter only
+// has to visit a few hundred terms however wide the range is.
+const int32 kPrecisionStep = 8 ;
+const int32 kEncodedNumberLength = 18 ;
+
+
+inline void
+encode_number(uint64 value, int32 shift, wchar_t *buffer)
+{
+	static const wchar_t kDigits[] = L"0123456789abcdef" ;
+
+	value >>= shift ;
+	buffer[0] = L'a' + shift / kPrecisionStep ;
+	for (int32 i = 16 ; i > 0 ; i--) {
+		buffer[i] = kDigits[value & 0xf] ;
+		value >>= 4 ;
+	}
+	buffer[17] = 0 ;
+}
+
+
+// Reads back a value encode_number() wrote at full precision. Returns
+// false for anything else.
+inline bool
+decode_number(const wchar_t *buffer, uint64 *value)
+{
+	if (buffer[0] != L'a')
+		return false ;
+
+	*value = 0 ;
+	for (int32 i = 1 ; i <= 16 ; i++) {
+		wchar_t digit = buffer[i] ;
+		if (digit >= L'0' && digit <= L'9')
+			*value = *value << 4 | (digit - L'0') ;
+		else if (digit >= L'a' && digit <= L'f')
+			*value = *value << 4 | (digit - L'a' + 10) ;
+		else
+			return false ;
+	}
+
+	return buffer[17] == 0 ;
+}
+
+#endif /* _FIELDS_H_ */
@@ -7,25 +7,305 @@
  */
 
 #include "BeaconIndex.h"
+#include "CLuceneBackend.h"
+#include "DuplicateFinder.h"
+#include "NativeBackend.h"
+#include "StringPositionIO.h"
 #include "support.h"
+#include "../shared/Metrics.h"
+#include "../shared/Trace.h"
 
+#include <Entry.h>
+#include <Locker.h>
 #include <Node.h>
 #include <NodeInfo.h>
-#include <StringPositionIO.h>
+#include <String.h>
 #include <TranslatorFormats.h>
 
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <unistd.h>
 
-using namespace lucene::util ;
-using namespace lucene::search ;
-using namespace lucene::queryParser ;
+
+const int32 kDefaultExcerptLength = 8 * 1024 ;
+
+// A reindex reports how far it got at most this often.
+const bigtime_t kProgressInterval = 500000 ;
+
+// Chunks end at a line break where there is one in their second half.
+const size_t kChunkSize = 64 * 1024 ;
+
+// Summed over all volumes.
+static MetricGauge sIndexQueueDepth("index_queue_depth", "files") ;
+static MetricGauge sDeleteQueueDepth("delete_queue_depth", "files") ;
+static MetricCounter sDocumentsIndexed("documents_indexed", "documents") ;
+static MetricGauge sDocumentsPerSecond("documents_per_second",
+	"documents/s") ;
+static MetricCounter sBytesRead("bytes_read", "bytes") ;
+static MetricHistogram sCommitLatency("commit_latency") ;
+
+// A translate_time:<type> histogram for each of the first
+// kMaxTranslateMetrics MIME types seen, the rest share the other one, so
+// odd types can't use up the metrics there is room for.
+const int32 kMaxTranslateMetrics = 32 ;
+const int32 kTranslateMetricSlots = 2 * kMaxTranslateMetrics ;
+
+struct translate_metric {
+	char				mimeType[B_MIME_TYPE_LENGTH] ;
+	MetricHistogram		*histogram ;
+} ;
+
+static MetricHistogram sTranslateTimeOther("translate_time:other") ;
+static translate_metric sTranslateMetrics[kTranslateMetricSlots] ;
+static int32 sTranslateMetricCount = 0 ;
+static BLocker sTranslateMetricsLocker("translate metrics") ;
+
+
+static MetricHistogram*
+translate_time(const char *mimeType)
+{
+	uint32 hash = 0 ;
+	for (const char *c = mimeType ; *c != '\0' ; c++)
+		hash = hash * 31 + (uint8)tolower(*c) ;
+
+	MetricHistogram *histogram = &sTranslateTimeOther ;
+	sTranslateMetricsLocker.Lock() ;
+
+	// Open addressing, and never more than half full, so there is always
+	// an empty slot to stop at.
+	int32 slot = hash % kTranslateMetricSlots ;
+	while (sTranslateMetrics[slot].histogram != NULL
+		&& strcasecmp(sTranslateMetrics[slot].mimeType, mimeType) != 0)
+		slot = (slot + 1) % kTranslateMetricSlots ;
+
+	if (sTranslateMetrics[slot].histogram != NULL)
+		histogram = sTranslateMetrics[slot].histogram ;
+	else if (sTranslateMetricCount < kMaxTranslateMetrics) {
+		BString name("translate_time:") ;
+		name << mimeType ;
+		MetricHistogram *found = find_histogram(name.String()) ;
+		// Once all the metrics are taken there is only the other one.
+		if (found != NULL) {
+			strcpy(sTranslateMetrics[slot].mimeType, mimeType) ;
+			sTranslateMetrics[slot].histogram = found ;
+			sTranslateMetricCount++ ;
+			histogram = found ;
+		}
+	}
+
+	sTranslateMetricsLocker.Unlock() ;
+	return histogram ;
+}
+
+
+static int
+compare_paths(const void *first, const void *second)
+{
+	return strcmp(*(const char**)first, *(const char**)second) ;
+}
+
+
+static void
+add_name(const char *path, void *cookie)
+{
+	// Every chunk of a file stands for the file itself.
+	const char *chunk = strstr(path, BEACON_CHUNK_SEPARATOR) ;
+	if (chunk != NULL) {
+		BString filePath(path, chunk - path) ;
+		((NameIndex*)cookie)->AddPath(filePath.String()) ;
+	} else
+		((NameIndex*)cookie)->AddPath(path) ;
+}
+
+
+static void
+requeue_path(const char *path, void *cookie)
+{
+	// Files removed since they were indexed have nothing to add.
+	entry_ref ref ;
+	if (get_ref_for_path(path, &ref) == B_OK)
+		((BeaconIndex*)cookie)->AddDocument(&ref, sample_trace()) ;
+}
+
+
+// A file of the subtree Reindex() works on, as the index has it.
+struct indexed_file {
+	char	*path ;
+	off_t	size ;
+	time_t	modified ;
+	bool	seen ;
+} ;
+
+
+struct subtree_diff {
+	const char	*path ;
+	size_t		length ;
+	// Of indexed_file, sorted by path.
+	BList		files ;
+	int32		queued ;
+	int32		visited ;
+	int32		removed ;
+	const reindex_control	*control ;
+	bigtime_t	lastProgress ;
+} ;
+
+
+static int
+compare_files(const void *first, const void *second)
+{
+	return strcmp((*(const indexed_file**)first)->path,
+		(*(const indexed_file**)second)->path) ;
+}
+
+
+static void
+collect_file(const char *path, off_t size, time_t modified, void *cookie)
+{
+	subtree_diff *diff = (subtree_diff*)cookie ;
+	if (strncmp(path, diff->path, diff->length) != 0
+		|| (path[diff->length] != '/' && path[diff->length] != '\0'))
+		return ;
+
+	// Chunks stand for the file they belong to. They are merged once the
+	// list is sorted.
+	const char *chunk = strstr(path, BEACON_CHUNK_SEPARATOR) ;
+	size_t length = chunk != NULL ? chunk - path : strlen(path) ;
+
+	indexed_file *file = new indexed_file ;
+	file->path = new char[length + 1] ;
+	memcpy(file->path, path, length) ;
+	file->path[length] = '\0' ;
+	file->size = size ;
+	file->modified = modified ;
+	file->seen = false ;
+	diff->files.AddItem(file) ;
+}
+
+
+static void
+delete_file(indexed_file *file)
+{
+	delete[] file->path ;
+	delete file ;
+}
+
+
+static void
+merge_chunks(BList *files)
+{
+	// The chunk indexed last was indexed with what the file is now, if
+	// it didn't change since.
+	int32 kept = 0 ;
+	indexed_file *file ;
+	for (int32 i = 0 ; (file = (indexed_file*)files->ItemAt(i)) != NULL ;
+			i++) {
+		indexed_file *previous = kept > 0
+			? (indexed_file*)files->ItemAt(kept - 1) : NULL ;
+		if (previous == NULL || strcmp(previous->path, file->path) != 0) {
+			files->ReplaceItem(kept++, file) ;
+			continue ;
+		}
+
+		if (file->modified > previous->modified
+			|| (file->modified == previous->modified
+				&& file->size > previous->size)) {
+			previous->modified = file->modified ;
+			previous->size = file->size ;
+		}
+		delete_file(file) ;
+	}
+
+	while (files->CountItems() > kept)
+		files->RemoveItem(files->CountItems() - 1) ;
+}
+
+
+static indexed_file*
+find_file(const BList *files, const char *path)
+{
+	indexed_file key = { (char*)path, 0, 0, false } ;
+	indexed_file *keyPointer = &key ;
+	indexed_file **found = (indexed_file**)bsearch(&keyPointer,
+		files->Items(), files->CountItems(), sizeof(indexed_file*),
+		compare_files) ;
+
+	return found != NULL ? *found : NULL ;
+}
+
+
+static void
+report_progress(subtree_diff *diff, bool force)
+{
+	if (diff->control == NULL || !diff->control->progress.IsValid())
+		return ;
+
+	bigtime_t now = system_time() ;
+	if (!force && now - diff->lastProgress < kProgressInterval)
+		return ;
+	diff->lastProgress = now ;
+
+	BMessage progress(BEACON_REINDEX_PROGRESS) ;
+	progress.AddString("path", diff->path) ;
+	progress.AddInt32("queued", diff->queued) ;
+	progress.AddInt32("visited", diff->visited) ;
+	progress.AddInt32("removed", diff->removed) ;
+
+	// Without waiting, a progress report that doesn't fit is dropped
+	// rather than holding up the crawl.
+	diff->control->progress.SendMessage(&progress, (BHandler*)NULL, 0) ;
+}
+
+
+static bool
+is_cancelled(subtree_diff *diff)
+{
+	return diff->control != NULL && diff->control->cancel != NULL
+		&& atomic_get(diff->control->cancel) != 0 ;
+}
+
+
+static bool
+is_excluded(const entry_ref *ref, const BList *excludeList)
+{
+	if (excludeList == NULL)
+		return false ;
+
+	// The same test as Feeder::Excluded(), so that a crawl leaves out
+	// what the feeder would.
+	BEntry entry(ref) ;
+	BDirectory directory ;
+	entry_ref *excluded ;
+	for (int32 i = 0 ; (excluded = (entry_ref*)excludeList->ItemAt(i)) != NULL
+		; i++) {
+		if (*excluded == *ref)
+			return true ;
+
+		directory.SetTo(excluded) ;
+		if (directory.Contains(&entry))
+			return true ;
+	}
+
+	return false ;
+}
 
 
 BeaconIndex::BeaconIndex(const BVolume *volume)
 	: fStatus(B_NO_INIT),
+	  fBackend(NULL),
 	  fIndexQueue(10),
-	  fDeleteQueue(10)
+	  fTracedPaths(1),
+	  fDeleteQueue(10),
+	  fExcerptLength(kDefaultExcerptLength),
+	  fTextCache(NULL),
+	  fTextCacheSize(0),
+	  fChunkThreshold(0)
 {
+	BMessage settings('sett') ;
+	if (load_settings(&settings) == B_OK)
+		LoadSettings(&settings) ;
+
 	fTranslatorRoster = BTranslatorRoster::Default() ;
 	SetTo(volume) ;
 }
@@ -34,6 +314,9 @@ BeaconIndex::BeaconIndex(const BVolume *volume)
 BeaconIndex::~BeaconIndex()
 {
 	Close() ;
+
+	for (int32 i = 0 ; i < fNativeVolumes.CountItems() ; i++)
+		free(fNativeVolumes.ItemAt(i)) ;
 }
 
 
@@ -59,165 +342,563 @@ BeaconIndex::SetTo(const BVolume *volume)
 	// Empty the queues.
 	fIndexQueueLocker.Lock() ;
 	fDeleteQueueLocker.Lock() ;
+	sIndexQueueDepth.Add(-fIndexQueue.CountItems()) ;
+	sDeleteQueueDepth.Add(-fDeleteQueue.CountItems()) ;
 	fIndexQueue.MakeEmpty() ;
+	fTracedPaths.MakeEmpty() ;
 	fDeleteQueue.MakeEmpty() ;
 	fDeleteQueueLocker.Unlock() ;
 	fIndexQueueLocker.Unlock() ;
 
-	if (!IndexReader::indexExists(fIndexPath.Path())) {
+	fNameIndex.MakeEmpty() ;
+	fChunkedFiles.MakeEmpty() ;
+
+	delete fBackend ;
+	fBackend = CreateBackend() ;
+
+	delete fTextCache ;
+	fTextCache = NULL ;
+	if (fTextCacheSize > 0) {
+		BPath cachePath(fIndexPath.Path(), "text_cache") ;
+		fTextCache = new TextCache(cachePath.Path(), fTextCacheSize) ;
+	}
+
+	if (!fBackend->Exists()) {
 		fStatus = BEACON_FIRST_RUN ;
 		fStatus = FirstRun() ;
 	}
-	else
+	else {
 		fStatus = fIndexPath.InitCheck() ;
+		LoadNames() ;
+		LoadChunkedFiles() ;
+		if (fStatus == B_OK && Recover() == B_BAD_DATA) {
+			fStatus = BEACON_FIRST_RUN ;
+			fStatus = FirstRun() ;
+		}
+	}
 	
 	return fStatus ;
 }
 
 
-IndexWriter*
-BeaconIndex::OpenIndexWriter()
+IndexBackend*
+BeaconIndex::CreateBackend()
 {
-	IndexWriter* indexWriter = NULL ;
-	if (IndexReader::indexExists(fIndexPath.Path())) {
-		try {
-			indexWriter = new IndexWriter(fIndexPath.Path(), &fStandardAnalyzer, 
-				false) ;
-		} catch (CLuceneError &error) {
-			logger->Error("Failed to open IndexWriter on device %d",
-				fIndexVolume.Device()) ;
-			logger->Error("Try deleting the indexes.") ;
-			logger->Error("Failed with CLuceneError: %s", error.what()) ;
-		}
-	} else
-		indexWriter = new IndexWriter(fIndexPath.Path(), &fStandardAnalyzer,
-			true) ;
-	
-	return indexWriter ;
-}
+	// A volume keeps the kind of index it has. New indexes are native on
+	// the volumes named in the settings, so moving a volume over means
+	// deleting its index.
+	if (NativeIndex::Exists(fIndexPath.Path()))
+		return new NativeBackend(fIndexPath.Path(), fIndexVolume.Device()) ;
 
+	CLuceneBackend *backend = new CLuceneBackend(fIndexPath.Path(),
+		fIndexVolume.Device()) ;
+	if (backend->Exists())
+		return backend ;
 
-IndexReader*
-BeaconIndex::OpenIndexReader()
-{
-	IndexReader* indexReader = NULL ;
-	
-	BEntry entry(fIndexPath.Path(), NULL) ;
-	if (!entry.Exists())
-		return indexReader ;
-	
-	if (IndexReader::indexExists(fIndexPath.Path())) {
-		try {
-			indexReader = IndexReader::open(fIndexPath.Path()) ;
-		} catch (CLuceneError &error) {
-			logger->Error("Could not open IndexReader.") ;
-			logger->Error("Failed with error: %s", error.what()) ;
+	char name[B_FILE_NAME_LENGTH] ;
+	if (fIndexVolume.GetName(name) != B_OK)
+		return backend ;
+
+	for (int32 i = 0 ; i < fNativeVolumes.CountItems() ; i++) {
+		if (strcmp((const char*)fNativeVolumes.ItemAt(i), name) == 0) {
+			logger->Always("Using a native index on %s", name) ;
+			delete backend ;
+			return new NativeBackend(fIndexPath.Path(),
+				fIndexVolume.Device()) ;
 		}
 	}
 
-	return indexReader ;
+	return backend ;
 }
 
 
 void
 BeaconIndex::Commit()
 {
+	if (fBackend == NULL)
+		return ;
+
 	fIndexQueueLocker.Lock() ;
 	fDeleteQueueLocker.Lock() ;
+
+	bigtime_t start = system_time() ;
+	int32 removed = fDeleteQueue.CountItems() ;
+	int64 added = 0 ;
+	TraceSpan commitSpan("commit", NULL, TRACE_SAMPLE) ;
 	
-	logger->Verbose("Calling commit on device %d", fIndexVolume.Device()) ;
-	logger->Verbose("%d items in index queue, %d items in delete queue",
+	BEACON_LOG_VERBOSE("Calling commit on device %d", fIndexVolume.Device()) ;
+	BEACON_LOG_VERBOSE("%d items in index queue, %d items in delete queue",
 		fIndexQueue.CountItems(), fDeleteQueue.CountItems()) ;
 	
 	char* path ;
-	Term* term ;
-	wchar_t *wPath ;
+	TraceSpan removeSpan("remove_paths") ;
 
-	IndexReader *reader = OpenIndexReader() ;
-	if (reader == NULL && IndexReader::indexExists(fIndexPath.Path()))
-		return ;
-	else if (reader != NULL && IndexReader::indexExists(fIndexPath.Path())) {
-		// First, remove all duplicates (if they exist).
-		for (int i = 0 ; (path = (char*)fIndexQueue.ItemAt(i)) != NULL ;
-			i++) {
-			wPath = to_wchar(path) ;
-			if (wPath == NULL)
-				continue ;
-			
-			term = new Term(_T("path"), wPath) ;
-			reader->deleteDocuments(term) ;
-			delete term ;
-		}
+	// First, remove all duplicates (if they exist).
+	for (int i = 0 ; (path = (char*)fIndexQueue.ItemAt(i)) != NULL ; i++)
+		fBackend->RemovePath(path) ;
 
-		for (int i = 0 ; (path = (char*)fDeleteQueue.ItemAt(i)) != NULL ;
-			i++) {
-			wPath = to_wchar(path) ;
-			if (wPath == NULL)
-				continue ;
-			
-			term = new Term(_T("path"), wPath) ;
-			reader->deleteDocuments(term) ;
-			
-			delete term ;
-			delete path ;
-			delete wPath ;
-		}
+	for (int i = 0 ; (path = (char*)fDeleteQueue.ItemAt(i)) != NULL ; i++) {
+		fBackend->RemovePath(path) ;
 
-		fDeleteQueue.MakeEmpty() ;
-		reader->close() ;
-		delete reader ;
+		// The path may have been a directory, take everything that
+		// was under it along. The chunks of a file are under it too.
+		fBackend->RemoveSubtree(path) ;
+		fChunkedFiles.RemoveSubtree(path) ;
+		delete path ;
 	}
 
-	IndexWriter *writer = OpenIndexWriter() ;
-	if (writer == NULL) {
-		fStatus = B_ERROR ;
-		return ;
+	fDeleteQueue.MakeEmpty() ;
+	sDeleteQueueDepth.Add(-removed) ;
+	removeSpan.End() ;
+
+	// Add documents in path order, so that files in the same directory get
+	// neighbouring document numbers.
+	fIndexQueue.SortItems(compare_paths) ;
+
+	// Files with the same contents as one before them get its text
+	// rather than being translated again. Such text stays in memory until
+	// its last copy has been added. Copies of files from earlier batches
+	// find their text in the text cache.
+	DuplicateFinder duplicates ;
+	TraceSpan duplicatesSpan("find_duplicates") ;
+	for (int i = 0 ; (path = (char*)fIndexQueue.ItemAt(i)) != NULL ; i++)
+		duplicates.AddFile(path) ;
+	duplicates.Find() ;
+	duplicatesSpan.End() ;
+	if (duplicates.CountCopies() > 0) {
+		BEACON_LOG_VERBOSE("%d files are copies of others, their text is only "
+			"extracted once", duplicates.CountCopies()) ;
+	}
+
+	StringPositionIO text ;
+	char mimeType[B_MIME_TYPE_LENGTH] ;
+	int32 count = fIndexQueue.CountItems() ;
+	bool *extracted = new bool[count] ;
+	bool *chunked = new bool[count] ;
+	StringPositionIO **sharedText = new StringPositionIO*[count] ;
+	for (int i = 0 ; (path = (char*)fIndexQueue.ItemAt(i)) != NULL ; i++) {
+		chunked[i] = ShouldChunk(path) ;
+		sharedText[i] = NULL ;
 	}
-	
-	FileReader *fileReader ;
-	BFile inFile, outFile ;
-	Document *doc ;
-	char tempPath[] = "/boot/var/tmp/index_server" ;
 	
 	for (int i = 0 ; (path = (char*)fIndexQueue.ItemAt(i)) != NULL ; i++) {
-		inFile.SetTo(path, B_READ_ONLY) ;
-		outFile.SetTo(tempPath, B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE) ;
-		
-		if (fTranslatorRoster->Translate(&inFile, NULL, NULL, &outFile, 'TEXT') == B_OK) {
-			inFile.Unset() ; 
-			outFile.Unset() ;
-			
-			fileReader = new FileReader(tempPath, "UTF-8") ;
-
-			wPath = to_wchar(path) ;
-			if (wPath == NULL)
-				continue ;
-
-			doc = new Document ;
-			doc->add(*(new Field(_T("contents"), fileReader, 
-				Field::STORE_NO | Field::INDEX_TOKENIZED))) ;
-			doc->add(*(new Field (_T("path"), wPath,
-				Field::STORE_YES | Field::INDEX_UNTOKENIZED))) ;
-
-			try {
-				writer->addDocument(doc) ;
-			} catch (CLuceneError &error) {
+		TraceSpan documentSpan("document", path,
+			fTracedPaths.HasItem(path) ? TRACE_RECORD : TRACE_NESTED) ;
+		int32 original = duplicates.OriginalOf(i) ;
+		if (chunked[i]) {
+			if (IndexChunks(path, &text) != B_OK)
 				logger->Error("Could not index %s", path) ;
-				logger->Error("%s", error.what()) ;
+
+			// It may still be the last copy of a file that was not.
+			if (original >= 0 && duplicates.LastCopyOf(original) == i) {
+				delete sharedText[original] ;
+				sharedText[original] = NULL ;
 			}
 
 			delete path ;
-			delete wPath ;
+			continue ;
 		}
+
+		if (original >= 0 && chunked[original])
+			original = -1 ;
+		StringPositionIO *documentText = &text ;
+		if (original >= 0)
+			documentText = sharedText[original] ;
+		else if (duplicates.LastCopyOf(i) >= 0)
+			documentText = sharedText[i] = new StringPositionIO ;
+
+		if (original >= 0)
+			extracted[i] = extracted[original] ;
+		else
+			extracted[i] = ExtractText(path, documentText) == B_OK ;
+
+		if (extracted[i]) {
+			index_document document ;
+			document.path = path ;
+			document.text = documentText ;
+			document.excerpt = ReadExcerpt(documentText) ;
+			GetMetadata(path, &document, mimeType) ;
+
+			TraceSpan addSpan("backend_add", mimeType) ;
+			if (fBackend->AddDocument(&document) != B_OK)
+				logger->Error("Could not index %s", path) ;
+			else
+				added++ ;
+
+			delete[] document.excerpt ;
+		}
+
+		if (original >= 0 && duplicates.LastCopyOf(original) == i) {
+			delete sharedText[original] ;
+			sharedText[original] = NULL ;
+		}
+
+		delete path ;
 	}
 
+	delete[] extracted ;
+	delete[] chunked ;
+	delete[] sharedText ;
+
 
 	fIndexQueue.MakeEmpty() ;
-	writer->close() ;
-	delete writer ;
+	fTracedPaths.MakeEmpty() ;
+	sIndexQueueDepth.Add(-count) ;
+	TraceSpan backendSpan("backend_commit") ;
+	if (fBackend->Commit() != B_OK)
+		fStatus = B_ERROR ;
+	backendSpan.End() ;
+
+	TraceSpan saveSpan("save_names") ;
+	SaveNames() ;
+	SaveChunkedFiles() ;
+	saveSpan.End() ;
+
+	// Most calls find nothing to do, and would only bury the real ones.
+	if (count > 0 || removed > 0) {
+		bigtime_t elapsed = system_time() - start ;
+		sCommitLatency.Record(elapsed) ;
+		sDocumentsIndexed.Add(added) ;
+		if (elapsed > 0)
+			sDocumentsPerSecond.Set(added * 1000000 / elapsed) ;
+	}
+
+	fDeleteQueueLocker.Unlock() ;
+	fIndexQueueLocker.Unlock() ;
+}
+
+
+status_t
+BeaconIndex::ReplaceSubtree(const char *path, const char *indexPath,
+	time_t since)
+{
+	if (fBackend == NULL)
+		return B_NO_INIT ;
+
+	// Whatever is queued is newer than what was built, and is indexed
+	// over it by the next commit.
+	fIndexQueueLocker.Lock() ;
+	fDeleteQueueLocker.Lock() ;
+
+	TraceSpan span("replace_subtree", path) ;
+	status_t status = fBackend->ReplaceSubtree(path, indexPath, since) ;
+	if (status == B_OK) {
+		// Big files are in the new index whole, they start over as chunks
+		// the next time they change.
+		fChunkedFiles.RemoveSubtree(path) ;
+		SaveChunkedFiles() ;
+
+		BPath namesPath(indexPath) ;
+		namesPath.GetParent(&namesPath) ;
+		namesPath.Append(BEACON_BULK_NAMES_FILE) ;
+		AddNames(namesPath.Path()) ;
+		SaveNames() ;
+		logger->Always("Took over the index of %s built by bulkindex", path) ;
+	}
 
 	fDeleteQueueLocker.Unlock() ;
 	fIndexQueueLocker.Unlock() ;
+	return status ;
+}
+
+
+status_t
+BeaconIndex::Reindex(const entry_ref *directory, const BList *excludeList,
+	BMessage *reply, const reindex_control *control)
+{
+	if (fStatus != B_OK)
+		return fStatus ;
+
+	BPath path(directory) ;
+	BDirectory dir(directory) ;
+	status_t status = dir.InitCheck() ;
+	if (status != B_OK || (status = path.InitCheck()) != B_OK)
+		return status ;
+
+	// Whatever was queued before goes in first, so that what the index
+	// has is up to date.
+	Commit() ;
+
+	TraceSpan span("reindex", path.Path(), TRACE_SAMPLE) ;
+	bigtime_t start = system_time() ;
+	subtree_diff diff ;
+	diff.path = path.Path() ;
+	diff.length = strlen(path.Path()) ;
+	diff.queued = 0 ;
+	diff.visited = 0 ;
+	diff.removed = 0 ;
+	diff.control = control ;
+	diff.lastProgress = start ;
+
+	// A commit from the indexer's thread may be under way.
+	fIndexQueueLocker.Lock() ;
+	fDeleteQueueLocker.Lock() ;
+	fBackend->ForEachDocument(collect_file, &diff) ;
+	fDeleteQueueLocker.Unlock() ;
+	fIndexQueueLocker.Unlock() ;
+	diff.files.SortItems(compare_files) ;
+	merge_chunks(&diff.files) ;
+
+	// Only new files and those whose size or modification time changed
+	// are indexed again, and only those that are gone are removed.
+	fNameIndex.AddPath(path.Path()) ;
+	if (AddAllDocuments(&dir, excludeList, &diff) == B_CANCELED) {
+		// What wasn't visited isn't gone. The files queued so far go in
+		// with the next commit, if there is one.
+		indexed_file *file ;
+		for (int32 i = 0 ; (file = (indexed_file*)diff.files.ItemAt(i))
+				!= NULL ; i++)
+			delete_file(file) ;
+		logger->Always("Stopped indexing %s again", path.Path()) ;
+		return B_CANCELED ;
+	}
+	report_progress(&diff, true) ;
+
+	BString lastRemoved ;
+	indexed_file *file ;
+	for (int32 i = 0 ; (file = (indexed_file*)diff.files.ItemAt(i)) != NULL ;
+			i++) {
+		if (!file->seen) {
+			diff.removed++ ;
+
+			// A directory that is gone is removed as a whole, what was
+			// under it needs nothing more.
+			if (lastRemoved.Length() == 0
+				|| strncmp(file->path, lastRemoved.String(),
+					lastRemoved.Length()) != 0
+				|| file->path[lastRemoved.Length()] != '/') {
+				BString gone(file->path) ;
+				int32 slash ;
+				while ((slash = gone.FindLast('/')) > (int32)diff.length) {
+					BString parent(gone.String(), slash) ;
+					if (BEntry(parent.String()).Exists())
+						break ;
+					gone = parent ;
+				}
+
+				RemovePath(gone.String()) ;
+				lastRemoved = gone ;
+			}
+		}
+		delete_file(file) ;
+	}
+	int32 indexed = diff.files.CountItems() ;
+	diff.files.MakeEmpty() ;
+
+	Commit() ;
+
+	if (fStatus != B_OK)
+		status = fStatus ;
+	bigtime_t elapsed = system_time() - start ;
+	logger->Always("Indexed %s again: %d files were new or changed, %d were "
+		"indexed before and %d of those are gone, in %Ld ms", path.Path(),
+		diff.queued, indexed, diff.removed, elapsed / 1000) ;
+
+	reply->AddString("path", path.Path()) ;
+	reply->AddInt32("indexed", diff.queued) ;
+	reply->AddInt32("visited", diff.visited) ;
+	reply->AddInt32("previously_indexed", indexed) ;
+	reply->AddInt32("removed", diff.removed) ;
+	reply->AddInt64("elapsed", elapsed) ;
+	return status ;
+}
+
+
+status_t
+BeaconIndex::ExtractText(const char *path, StringPositionIO *text)
+{
+	TraceSpan span("extract_text") ;
+
+	// Plain text is as quick to translate as to read back, it isn't worth
+	// the room in the cache.
+	struct stat st ;
+	char mimeType[B_MIME_TYPE_LENGTH] ;
+	BNode node(path) ;
+	BNodeInfo nodeInfo(&node) ;
+	if (nodeInfo.GetType(mimeType) != B_OK)
+		strcpy(mimeType, "application/octet-stream") ;
+	bool haveStat = node.GetStat(&st) == B_OK ;
+	bool cacheable = fTextCache != NULL && haveStat
+		&& strncmp(mimeType, "text/", 5) != 0 ;
+	node.Unset() ;
+
+	text->SetSize(0) ;
+	text->Seek(0, SEEK_SET) ;
+	text_cache_key key ;
+	if (cacheable) {
+		TraceSpan fetchSpan("text_cache_fetch") ;
+		if (fTextCache->Fetch(path, st.st_size, &key, text) == B_OK)
+			return B_OK ;
+
+		text->SetSize(0) ;
+		text->Seek(0, SEEK_SET) ;
+	}
+
+	// Translated into memory, the chunks the text is written to are
+	// what the backend reads.
+	TraceSpan translateSpan("translate", mimeType) ;
+	bigtime_t start = system_time() ;
+	BFile inFile(path, B_READ_ONLY) ;
+	status_t status = fTranslatorRoster->Translate(&inFile, NULL, NULL,
+		text, 'TEXT') ;
+	inFile.Unset() ;
+
+	translate_time(mimeType)->Record(system_time() - start) ;
+	if (haveStat)
+		sBytesRead.Add(st.st_size) ;
+	translateSpan.End() ;
+
+	if (status == B_OK && cacheable) {
+		TraceSpan storeSpan("text_cache_store") ;
+		fTextCache->Store(path, &key, text) ;
+	}
+
+	return status ;
+}
+
+
+bool
+BeaconIndex::ShouldChunk(const char *path)
+{
+	if (fChunkThreshold <= 0)
+		return false ;
+	if (fChunkedFiles.Contains(path))
+		return true ;
+
+	// Only plain text is its own extracted text, so only it can be read
+	// a piece at a time.
+	BNode node(path) ;
+	struct stat st ;
+	char mimeType[B_MIME_TYPE_LENGTH] ;
+	BNodeInfo nodeInfo(&node) ;
+	return node.GetStat(&st) == B_OK && st.st_size >= fChunkThreshold
+		&& nodeInfo.GetType(mimeType) == B_OK
+		&& strncmp(mimeType, "text/", 5) == 0 ;
+}
+
+
+status_t
+BeaconIndex::IndexChunks(const char *path, StringPositionIO *text)
+{
+	TraceSpan span("index_chunks") ;
+	BFile file(path, B_READ_ONLY) ;
+	struct stat st ;
+	status_t status ;
+	if ((status = file.InitCheck()) != B_OK
+		|| (status = file.GetStat(&st)) != B_OK)
+		return status ;
+
+	// Whatever follows the last full chunk is indexed again every time,
+	// until it is a full chunk itself. So is every chunk from the first
+	// one that changed on.
+	off_t offset = fChunkedFiles.IndexedLength(path, &st) ;
+	BString chunkPath ;
+	if (offset == 0)
+		fBackend->RemoveSubtree(path) ;
+	else {
+		int32 count = fChunkedFiles.CountChunks(path) ;
+		for (int32 i = 0 ; i <= count ; i++) {
+			off_t start = fChunkedFiles.ChunkStart(path, i) ;
+			if (start < offset)
+				continue ;
+
+			chunkPath = "" ;
+			chunkPath << path << BEACON_CHUNK_SEPARATOR << start ;
+			fBackend->RemovePath(chunkPath.String()) ;
+		}
+	}
+	fChunkedFiles.SetIndexedLength(path, &st, offset) ;
+
+	index_document document ;
+	char mimeType[B_MIME_TYPE_LENGTH] ;
+	GetMetadata(path, &document, mimeType) ;
+
+	char *buffer = new char[kChunkSize] ;
+	int32 added = 0 ;
+	while (status == B_OK) {
+		ssize_t length = file.ReadAt(offset, buffer, kChunkSize) ;
+		if (length <= 0)
+			break ;
+		sBytesRead.Add(length) ;
+
+		bool full = (size_t)length == kChunkSize ;
+		if (full) {
+			// Don't cut a word, or a multibyte character, in half. A line
+			// break in the second half is the best place to cut, then any
+			// white space at all.
+			ssize_t end = length ;
+			while (end > length / 2 && buffer[end - 1] != '\n')
+				end-- ;
+			if (end == length / 2) {
+				end = length ;
+				while (end > 0 && !isspace((unsigned char)buffer[end - 1]))
+					end-- ;
+			}
+			if (end == 0) {
+				// A single word as long as a chunk, all there is left is
+				// not to cut a character.
+				end = length - 1 ;
+				while (end > 0 && (buffer[end] & 0xc0) == 0x80)
+					end-- ;
+				if (end == 0)
+					end = length ;
+			}
+			length = end ;
+		}
+
+		text->SetSize(0) ;
+		if (text->WriteAt(0, buffer, length) != length) {
+			status = B_NO_MEMORY ;
+			break ;
+		}
+
+		chunkPath = "" ;
+		chunkPath << path << BEACON_CHUNK_SEPARATOR << offset ;
+		document.path = chunkPath.String() ;
+		document.text = text ;
+		document.excerpt = ReadExcerpt(text) ;
+		status = fBackend->AddDocument(&document) ;
+		delete[] document.excerpt ;
+		added++ ;
+		if (status == B_OK)
+			sDocumentsIndexed.Add() ;
+
+		if (!full)
+			break ;
+		if (status == B_OK)
+			fChunkedFiles.AddChunk(path, &st, offset, buffer, length) ;
+		offset += length ;
+	}
+
+	delete[] buffer ;
+	if (status == B_OK) {
+		fChunkedFiles.SetIndexedLength(path, &st, offset) ;
+		BEACON_LOG_VERBOSE("Indexed %d chunks of %s", added, path) ;
+	}
+
+	return status ;
+}
+
+
+void
+BeaconIndex::GetMetadata(const char *path, index_document *document,
+	char *mimeType)
+{
+	TraceSpan span("metadata") ;
+	document->mimeType = NULL ;
+
+	BNode node(path) ;
+	struct stat st ;
+	if (node.GetStat(&st) != B_OK)
+		return ;
+
+	BNodeInfo nodeInfo(&node) ;
+	if (nodeInfo.GetType(mimeType) != B_OK)
+		strcpy(mimeType, "application/octet-stream") ;
+
+	document->mimeType = mimeType ;
+	document->size = st.st_size ;
+	document->modified = st.st_mtime ;
 }
 
 
@@ -225,6 +906,10 @@ void
 BeaconIndex::Close()
 {
 	fStatus = B_NO_INIT ;
+	delete fBackend ;
+	fBackend = NULL ;
+	delete fTextCache ;
+	fTextCache = NULL ;
 }
 
 
@@ -246,23 +931,32 @@ BeaconIndex::TranslatorAvailable(const entry_ref *e_ref)
 
 
 status_t
-BeaconIndex::AddDocument(const entry_ref *e_ref)
+BeaconIndex::AddDocument(const entry_ref *e_ref, bool traced)
 {
 	if (!(fStatus == B_OK || fStatus == BEACON_FIRST_RUN))
 		return fStatus ;
 	else if (!e_ref)
 		return B_BAD_VALUE ;
-	else if (!TranslatorAvailable(e_ref))
-		return BEACON_NOT_SUPPORTED ;
 	else if (InIndexDirectory(e_ref))
 		return BEACON_FILE_EXCLUDED ;
+
+	// Every file is searchable by name, even if we can't read its contents.
+	BPath path(e_ref) ;
+	fNameIndex.AddPath(path.Path()) ;
+
+	TraceSpan span("identify", path.Path(),
+		traced ? TRACE_RECORD : TRACE_NESTED) ;
+	if (!TranslatorAvailable(e_ref))
+		return BEACON_NOT_SUPPORTED ;
 	
 	fIndexQueueLocker.Lock() ;
 
-	BPath path(e_ref) ;
 	char *str_path = new char[B_PATH_NAME_LENGTH] ;
 	strcpy(str_path, path.Path()) ;
 	fIndexQueue.AddItem(str_path) ;
+	if (traced)
+		fTracedPaths.AddItem(str_path) ;
+	sIndexQueueDepth.Add(1) ;
 	
 	fIndexQueueLocker.Unlock() ;
 
@@ -273,8 +967,6 @@ BeaconIndex::AddDocument(const entry_ref *e_ref)
 status_t
 BeaconIndex::RemoveDocument(const entry_ref* e_ref)
 {
-	fDeleteQueueLocker.Lock() ;
-
 	status_t ret = B_BAD_VALUE ;
 	
 	if (!e_ref)
@@ -284,14 +976,25 @@ BeaconIndex::RemoveDocument(const entry_ref* e_ref)
 	if ((ret = path.InitCheck()) != B_OK)
 		return ret ;
 
-	char* stringPath = new char[B_PATH_NAME_LENGTH] ;
-	strcpy(stringPath, path.Path()) ;
+	return RemovePath(path.Path()) ;
+}
+
+
+status_t
+BeaconIndex::RemovePath(const char *path)
+{
+	fDeleteQueueLocker.Lock() ;
+
+	fNameIndex.RemovePath(path) ;
+
+	char* stringPath = new char[strlen(path) + 1] ;
+	strcpy(stringPath, path) ;
 	fDeleteQueue.AddItem(stringPath) ;
-	ret = B_OK ;
+	sDeleteQueueDepth.Add(1) ;
 	
 	fDeleteQueueLocker.Unlock() ;
 
-	return ret ;
+	return B_OK ;
 }
 
 
@@ -307,6 +1010,38 @@ BeaconIndex::InIndexDirectory(const entry_ref *e_ref)
 }
 
 
+status_t
+BeaconIndex::Recover()
+{
+	// Only the files that were in the damaged parts of the index are
+	// indexed again, unless nobody knows which those were.
+	status_t status = fBackend->Recover(requeue_path, this) ;
+	if (status == B_BAD_DATA) {
+		logger->Error("Indexing all of device %d again, its index is damaged",
+			fIndexVolume.Device()) ;
+
+		// The crawl queues them all anyway.
+		fIndexQueueLocker.Lock() ;
+		for (int32 i = 0 ; i < fIndexQueue.CountItems() ; i++)
+			delete[] (char*)fIndexQueue.ItemAt(i) ;
+		sIndexQueueDepth.Add(-fIndexQueue.CountItems()) ;
+		fIndexQueue.MakeEmpty() ;
+		fTracedPaths.MakeEmpty() ;
+		fIndexQueueLocker.Unlock() ;
+		return status ;
+	}
+
+	int32 count = fIndexQueue.CountItems() ;
+	if (count > 0) {
+		logger->Always("Indexing %d files on device %d again, they were in "
+			"a damaged part of its index", count, fIndexVolume.Device()) ;
+		Commit() ;
+	}
+
+	return status ;
+}
+
+
 status_t
 BeaconIndex::FirstRun()
 {
@@ -326,26 +1061,55 @@ BeaconIndex::FirstRun()
 
 
 status_t
-BeaconIndex::AddAllDocuments(BDirectory *dir)
+BeaconIndex::AddAllDocuments(BDirectory *dir, const BList *excludeList,
+	subtree_diff *diff)
 {
 	entry_ref ref ;
 	BEntry entry ;
 	BDirectory d ;
 	status_t err = B_OK ;
+	if (diff != NULL) {
+		if (is_cancelled(diff))
+			return B_CANCELED ;
+		report_progress(diff, false) ;
+	}
 	
 	while (dir->GetNextRef(&ref) == B_OK) {
 		entry.SetTo(&ref) ;
 		
 		if ((err = entry.InitCheck()) != B_OK)
 			break ;
-		else if (is_hidden(&ref) || entry.IsSymLink())
+		else if (is_hidden(&ref) || entry.IsSymLink()
+			|| is_excluded(&ref, excludeList))
 			continue ;
 
-		if (entry.IsFile())
-			err = AddDocument(&ref) ;
-		else {
+		if (entry.IsFile()) {
+			struct stat st ;
+			BPath path(&ref) ;
+			indexed_file *file = NULL ;
+			if (diff != NULL) {
+				diff->visited++ ;
+				file = find_file(&diff->files, path.Path()) ;
+			}
+			if (file != NULL) {
+				file->seen = true ;
+				if (entry.GetStat(&st) == B_OK && st.st_size == file->size
+					&& st.st_mtime == file->modified) {
+					fNameIndex.AddPath(path.Path()) ;
+					continue ;
+				}
+			}
+
+			err = AddDocument(&ref, sample_trace()) ;
+			if (err == B_OK && diff != NULL)
+				diff->queued++ ;
+		} else {
+			BPath path(&ref) ;
+			fNameIndex.AddPath(path.Path()) ;
+
 			d.SetTo(&ref) ;
-			AddAllDocuments(&d) ;
+			if (AddAllDocuments(&d, excludeList, diff) == B_CANCELED)
+				return B_CANCELED ;
 		}
 	}
 
@@ -353,6 +1117,120 @@ BeaconIndex::AddAllDocuments(BDirectory *dir)
 }
 
 
+int32
+BeaconIndex::FindNames(const char *pattern, int32 mode, BMessage *reply,
+	int32 limit)
+{
+	return fNameIndex.Find(pattern, mode, reply, limit) ;
+}
+
+
+void
+BeaconIndex::LoadSettings(BMessage *settings)
+{
+	int32 excerptLength ;
+	if (settings->FindInt32("excerpt_length", &excerptLength) == B_OK)
+		fExcerptLength = excerptLength ;
+
+	// In megabytes, no cache if it is missing or 0.
+	int32 cacheSize ;
+	if (settings->FindInt32("text_cache_size", &cacheSize) == B_OK)
+		fTextCacheSize = (off_t)cacheSize * 1024 * 1024 ;
+
+	// Text files from this many megabytes up are indexed in chunks, none
+	// are if it is missing or 0.
+	int32 chunkThreshold ;
+	if (settings->FindInt32("chunk_threshold", &chunkThreshold) == B_OK)
+		fChunkThreshold = (off_t)chunkThreshold * 1024 * 1024 ;
+
+	const char *volume ;
+	for (int32 i = 0 ; settings->FindString("native_volumes", i, &volume)
+		== B_OK ; i++)
+		fNativeVolumes.AddItem(strdup(volume)) ;
+}
+
+
+char*
+BeaconIndex::ReadExcerpt(StringPositionIO *text)
+{
+	if (fExcerptLength <= 0)
+		return NULL ;
+
+	TraceSpan span("read_excerpt") ;
+	return read_excerpt(text, fExcerptLength) ;
+}
+
+
+void
+BeaconIndex::LoadNames()
+{
+	BPath namesPath(fIndexPath.Path(), "names") ;
+	if (fNameIndex.ReadFrom(namesPath.Path()) == B_OK)
+		return ;
+
+	// No saved name index, seed it from the paths we have indexed so far.
+	// Names of files without a translator show up after the next crawl.
+	fBackend->ForEachPath(add_name, &fNameIndex) ;
+
+	BEACON_LOG_VERBOSE("Loaded %d names from the index on device %d",
+		fNameIndex.CountNames(), fIndexVolume.Device()) ;
+}
+
+
+void
+BeaconIndex::LoadChunkedFiles()
+{
+	BPath chunksPath(fIndexPath.Path(), "chunks") ;
+	fChunkedFiles.ReadFrom(chunksPath.Path()) ;
+}
+
+
+void
+BeaconIndex::SaveChunkedFiles()
+{
+	if (!fChunkedFiles.IsDirty())
+		return ;
+
+	BPath chunksPath(fIndexPath.Path(), "chunks") ;
+	if (fChunkedFiles.WriteTo(chunksPath.Path()) != B_OK)
+		logger->Error("Could not save the list of chunked files on device %d",
+			fIndexVolume.Device()) ;
+}
+
+
+void
+BeaconIndex::AddNames(const char *listPath)
+{
+	FILE *file = fopen(listPath, "r") ;
+	if (file == NULL)
+		return ;
+
+	char line[B_PATH_NAME_LENGTH + 1] ;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strlen(line) ;
+		if (length > 0 && line[length - 1] == '\n')
+			line[length - 1] = '\0' ;
+		if (line[0] != '\0')
+			fNameIndex.AddPath(line) ;
+	}
+
+	fclose(file) ;
+}
+
+
+void
+BeaconIndex::SaveNames()
+{
+	if (!fNameIndex.IsDirty())
+		return ;
+
+	BPath namesPath(fIndexPath.Path(), "names") ;
+	if (fNameIndex.WriteTo(namesPath.Path()) != B_OK)
+		logger->Error("Could not save the name index on device %d",
+			fIndexVolume.Device()) ;
+}
+
+
 dev_t
 BeaconIndex::Device()
 {
@@ -9,17 +9,30 @@
 #ifndef _BEACON_INDEX_H_
 #define _BEACON_INDEX_H_
 
+#include "ChunkedFiles.h"
+#include "IndexBackend.h"
+#include "NameIndex.h"
+#include "TextCache.h"
+
 #include <Directory.h>
 #include <List.h>
 #include <Locker.h>
+#include <Messenger.h>
 #include <Path.h>
 #include <TranslatorRoster.h>
 #include <Volume.h>
 
-#include <CLucene.h>
-using namespace lucene::index ;
-using namespace lucene::analysis::standard ;
-using namespace lucene::document ;
+struct subtree_diff ;
+
+// How a Reindex() goes is sent to progress, if it is valid, as
+// BEACON_REINDEX_PROGRESS messages: the "path" of the subtree, and how
+// many files were "visited", "queued" to be indexed and "removed" so far.
+// Once cancel is set, it stops at the next directory and returns
+// B_CANCELED, leaving what it didn't get to as it was.
+struct reindex_control {
+	BMessenger		progress ;
+	int32			*cancel ;
+} ;
 
 
 class BeaconIndex {
@@ -28,30 +41,68 @@ class BeaconIndex {
 		~BeaconIndex() ;
 
 		status_t SetTo(const BVolume *volume) ;
-		status_t AddDocument(const entry_ref *e_ref) ;
+		// traced comes from sample_trace() wherever the file was found,
+		// and has its indexing recorded.
+		status_t AddDocument(const entry_ref *e_ref, bool traced) ;
 		status_t RemoveDocument(const entry_ref *e_ref) ;
 		void Commit() ;
+		// Takes over what bulkindex built for path, see IndexBackend.
+		status_t ReplaceSubtree(const char *path, const char *indexPath,
+			time_t since) ;
+		// Brings everything under the directory up to date and commits:
+		// files that are new or changed since they were indexed are
+		// indexed again, and those that are gone are removed. Excluded
+		// directories and files are left out. What happened goes in the
+		// reply.
+		status_t Reindex(const entry_ref *directory, const BList *excludeList,
+			BMessage *reply, const reindex_control *control = NULL) ;
 		void Close() ;
 		status_t InitCheck() ;
 		dev_t Device() ;
+		int32 FindNames(const char *pattern, int32 mode, BMessage *reply,
+			int32 limit) ;
 
 	private:
-		IndexWriter* OpenIndexWriter() ;
-		IndexReader* OpenIndexReader() ;
+		void LoadSettings(BMessage *settings) ;
+		IndexBackend* CreateBackend() ;
 		bool TranslatorAvailable(const entry_ref *e_ref) ;
 		bool InIndexDirectory(const entry_ref *e_ref) ;
+		status_t Recover() ;
 		status_t FirstRun() ;
-		status_t AddAllDocuments(BDirectory *dir) ;
+		// With a diff, files the index has as they are now are skipped.
+		status_t AddAllDocuments(BDirectory *dir,
+			const BList *excludeList = NULL, subtree_diff *diff = NULL) ;
+		status_t RemovePath(const char *path) ;
+		status_t ExtractText(const char *path, StringPositionIO *text) ;
+		bool ShouldChunk(const char *path) ;
+		status_t IndexChunks(const char *path, StringPositionIO *text) ;
+		void LoadNames() ;
+		void SaveNames() ;
+		void AddNames(const char *listPath) ;
+		void LoadChunkedFiles() ;
+		void SaveChunkedFiles() ;
+		char* ReadExcerpt(StringPositionIO *text) ;
+		void GetMetadata(const char *path, index_document *document,
+			char *mimeType) ;
 
 		status_t			fStatus ;
-		StandardAnalyzer	fStandardAnalyzer ;
+		IndexBackend		*fBackend ;
 		BPath				fIndexPath ;
 		BList				fIndexQueue ;
+		// Those paths in fIndexQueue that are traced.
+		BList				fTracedPaths ;
 		BLocker				fIndexQueueLocker ;
 		BList				fDeleteQueue ;
 		BLocker				fDeleteQueueLocker ;
 		BVolume				fIndexVolume ;
 		BTranslatorRoster	*fTranslatorRoster ;
+		NameIndex			fNameIndex ;
+		int32				fExcerptLength ;
+		BList				fNativeVolumes ;
+		TextCache			*fTextCache ;
+		off_t				fTextCacheSize ;
+		ChunkedFiles		fChunkedFiles ;
+		off_t				fChunkThreshold ;
 } ;
 
 #endif /* _BEACON_INDEX_H */
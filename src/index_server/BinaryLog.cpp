@@ -0,0 +1,336 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "BinaryLog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+// One printf() conversion, as much of it as the log needs to know.
+struct log_conversion {
+	const char	*start ;
+	const char	*end ;
+	// 'i' signed, 'u' unsigned, 'c', 'f', 's', 'p', 'n', '%', or 0 for
+	// anything else, which is copied as it is.
+	char		type ;
+	// 0 for int, 1 for long, 2 for long long or long double.
+	int32		size ;
+	// Width and precision given as arguments.
+	int32		stars ;
+} ;
+
+
+static bool
+next_conversion(const char* format, log_conversion* conversion)
+{
+	const char *position = strchr(format, '%') ;
+	if (position == NULL)
+		return false ;
+
+	conversion->start = position++ ;
+	conversion->size = 0 ;
+	conversion->stars = 0 ;
+
+	while (*position != '\0' && strchr("-+ #0'", *position) != NULL)
+		position++ ;
+	for (int32 part = 0 ; part < 2 ; part++) {
+		if (part == 1) {
+			if (*position != '.')
+				break ;
+			position++ ;
+		}
+		if (*position == '*') {
+			conversion->stars++ ;
+			position++ ;
+		} else {
+			while (*position >= '0' && *position <= '9')
+				position++ ;
+		}
+	}
+	while (*position != '\0' && strchr("hlLqjzt", *position) != NULL) {
+		if (*position == 'l' || *position == 'z' || *position == 't')
+			conversion->size++ ;
+		else if (*position != 'h')
+			conversion->size = 2 ;
+		position++ ;
+	}
+	if (conversion->size > 2)
+		conversion->size = 2 ;
+
+	switch (*position) {
+		case 'd':
+		case 'i':
+			conversion->type = 'i' ;
+			break ;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			conversion->type = 'u' ;
+			break ;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			conversion->type = 'f' ;
+			break ;
+		case 'c':
+		case 's':
+		case 'p':
+		case 'n':
+		case '%':
+			conversion->type = *position ;
+			break ;
+		default:
+			conversion->type = 0 ;
+	}
+
+	conversion->end = *position != '\0' ? position + 1 : position ;
+	return true ;
+}
+
+
+static bool
+put(char* buffer, size_t size, size_t* length, const void* data,
+	size_t dataLength)
+{
+	if (*length + dataLength > size)
+		return false ;
+
+	memcpy(buffer + *length, data, dataLength) ;
+	*length += dataLength ;
+	return true ;
+}
+
+
+static bool
+get(const char* arguments, size_t length, size_t* offset, void* data,
+	size_t dataLength)
+{
+	if (*offset + dataLength > length)
+		return false ;
+
+	memcpy(data, arguments + *offset, dataLength) ;
+	*offset += dataLength ;
+	return true ;
+}
+
+
+static void
+append(char* buffer, size_t size, size_t* length, const char* text,
+	size_t textLength)
+{
+	if (*length + textLength >= size)
+		textLength = size - *length - 1 ;
+
+	memcpy(buffer + *length, text, textLength) ;
+	*length += textLength ;
+	buffer[*length] = '\0' ;
+}
+
+
+const char*
+log_class_name(int32 logClass)
+{
+	switch (logClass) {
+		case BEACON_LOG_ERROR:
+			return "ERROR" ;
+		case BEACON_LOG_WARNING:
+			return "WARNING" ;
+		default:
+			return NULL ;
+	}
+}
+
+
+size_t
+encode_log_arguments(const char* format, va_list args, char* buffer,
+	size_t size)
+{
+	size_t length = 0 ;
+	log_conversion conversion ;
+	while (next_conversion(format, &conversion)) {
+		format = conversion.end ;
+
+		for (int32 i = 0 ; i < conversion.stars ; i++) {
+			int64 value = va_arg(args, int) ;
+			if (!put(buffer, size, &length, &value, sizeof(value)))
+				return length ;
+		}
+
+		int64 value ;
+		switch (conversion.type) {
+			case 'i':
+			case 'c':
+				if (conversion.size == 2)
+					value = va_arg(args, long long) ;
+				else if (conversion.size == 1)
+					value = va_arg(args, long) ;
+				else
+					value = va_arg(args, int) ;
+				break ;
+			case 'u':
+				if (conversion.size == 2)
+					value = va_arg(args, unsigned long long) ;
+				else if (conversion.size == 1)
+					value = va_arg(args, unsigned long) ;
+				else
+					value = va_arg(args, unsigned int) ;
+				break ;
+			case 'p':
+				value = (size_t)va_arg(args, void*) ;
+				break ;
+			case 'f':
+			{
+				double number ;
+				if (conversion.size == 2)
+					number = va_arg(args, long double) ;
+				else
+					number = va_arg(args, double) ;
+				if (!put(buffer, size, &length, &number, sizeof(number)))
+					return length ;
+				continue ;
+			}
+			case 's':
+			{
+				const char *string = va_arg(args, const char*) ;
+				if (string == NULL)
+					string = "(null)" ;
+				size_t stringLength = strlen(string) ;
+				if (length + sizeof(uint16) + stringLength > size) {
+					if (length + sizeof(uint16) > size)
+						return length ;
+					stringLength = size - length - sizeof(uint16) ;
+				}
+				uint16 stored = stringLength ;
+				put(buffer, size, &length, &stored, sizeof(stored)) ;
+				put(buffer, size, &length, string, stringLength) ;
+				continue ;
+			}
+			case 'n':
+				va_arg(args, void*) ;
+				continue ;
+			default:
+				continue ;
+		}
+
+		if (!put(buffer, size, &length, &value, sizeof(value)))
+			return length ;
+	}
+
+	return length ;
+}
+
+
+size_t
+decode_log_message(const char* format, const char* arguments, size_t length,
+	char* buffer, size_t size)
+{
+	size_t written = 0 ;
+	size_t offset = 0 ;
+	buffer[0] = '\0' ;
+
+	log_conversion conversion ;
+	while (next_conversion(format, &conversion)) {
+		append(buffer, size, &written, format, conversion.start - format) ;
+		format = conversion.end ;
+
+		if (conversion.type == '%') {
+			append(buffer, size, &written, "%", 1) ;
+			continue ;
+		}
+		if (conversion.type == 0 || conversion.type == 'n') {
+			if (conversion.type == 0)
+				append(buffer, size, &written, conversion.start,
+					conversion.end - conversion.start) ;
+			continue ;
+		}
+
+		// Rebuild the conversion with the widths filled in, for the types
+		// the arguments were stored as.
+		char spec[64] ;
+		size_t specLength = 0 ;
+		bool complete = true ;
+		for (const char *c = conversion.start ; c < conversion.end - 1
+				&& specLength < sizeof(spec) - 24 ; c++) {
+			if (*c == '*') {
+				int64 value ;
+				if (!get(arguments, length, &offset, &value, sizeof(value))) {
+					complete = false ;
+					break ;
+				}
+				specLength += sprintf(spec + specLength, "%d", (int)value) ;
+			} else if (strchr("hlLqjzt", *c) == NULL)
+				spec[specLength++] = *c ;
+		}
+		if (conversion.type == 'i' || conversion.type == 'u') {
+			spec[specLength++] = 'l' ;
+			spec[specLength++] = 'l' ;
+		}
+		spec[specLength++] = *(conversion.end - 1) ;
+		spec[specLength] = '\0' ;
+
+		int result = 0 ;
+		if (conversion.type == 'f') {
+			double number ;
+			if (complete && get(arguments, length, &offset, &number,
+					sizeof(number)))
+				result = snprintf(buffer + written, size - written, spec,
+					number) ;
+			else
+				complete = false ;
+		} else if (conversion.type == 's') {
+			uint16 stringLength ;
+			if (complete && get(arguments, length, &offset, &stringLength,
+					sizeof(stringLength)) && offset + stringLength <= length) {
+				// Strings are never longer than a record.
+				char string[1024] ;
+				size_t copied = stringLength < sizeof(string)
+					? stringLength : sizeof(string) - 1 ;
+				memcpy(string, arguments + offset, copied) ;
+				string[copied] = '\0' ;
+				offset += stringLength ;
+				result = snprintf(buffer + written, size - written, spec,
+					string) ;
+			} else
+				complete = false ;
+		} else {
+			int64 value ;
+			if (!complete || !get(arguments, length, &offset, &value,
+					sizeof(value)))
+				complete = false ;
+			else if (conversion.type == 'p')
+				result = snprintf(buffer + written, size - written, spec,
+					(void*)(size_t)value) ;
+			else if (conversion.type == 'c')
+				result = snprintf(buffer + written, size - written, spec,
+					(int)value) ;
+			else
+				result = snprintf(buffer + written, size - written, spec,
+					(long long)value) ;
+		}
+
+		// The message was cut short when it was logged.
+		if (!complete) {
+			append(buffer, size, &written, "...", 3) ;
+			return written ;
+		}
+
+		if (result > 0)
+			written += (size_t)result < size - written
+				? (size_t)result : size - written - 1 ;
+	}
+
+	append(buffer, size, &written, format, strlen(format)) ;
+	return written ;
+}
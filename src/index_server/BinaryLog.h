@@ -0,0 +1,58 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _BINARY_LOG_H_
+#define _BINARY_LOG_H_
+
+#include <SupportDefs.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+
+
+// A binary log keeps each message as the id of its format string and the
+// raw values of its arguments, which is cheaper than printf() to produce.
+// logdecode turns it back into text. Numbers are in host byte order.
+//
+// Every session starts with the magic and version. It is followed by
+// records, each starting with its type:
+//	'F' uint32 id, uint16 length, format string, the first time it is used
+//	'M' uint32 id, int64 time, uint8 class, uint16 length, arguments
+//	'D' int64 time, uint32 count, for messages that were dropped
+// Times are in microseconds since the epoch. Format ids start over with
+// every session.
+const uint32 kBinaryLogMagic = 'BLOG' ;
+const uint8 kBinaryLogVersion = 1 ;
+
+const uint8 kBinaryLogFormat = 'F' ;
+const uint8 kBinaryLogMessage = 'M' ;
+const uint8 kBinaryLogDropped = 'D' ;
+
+// Longer format strings are cut short.
+const size_t kMaxLogFormatLength = 1024 ;
+
+typedef enum _LogClass {
+	BEACON_LOG_PLAIN,
+	BEACON_LOG_ERROR,
+	BEACON_LOG_WARNING
+} LogClass ;
+
+// What a line of that class starts with, NULL for none.
+const char* log_class_name(int32 logClass) ;
+
+// Copies the arguments format asks for to buffer, for as many as fit.
+// Returns the number of bytes used.
+size_t encode_log_arguments(const char* format, va_list args, char* buffer,
+	size_t size) ;
+
+// Formats a message like vsnprintf() would have, taking the arguments
+// from what encode_log_arguments() made of them. Returns the length.
+size_t decode_log_message(const char* format, const char* arguments,
+	size_t length, char* buffer, size_t size) ;
+
+#endif /* _BINARY_LOG_H_ */
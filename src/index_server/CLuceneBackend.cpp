@@ -0,0 +1,1010 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "CLuceneBackend.h"
+#include "StringPositionIO.h"
+#include "support.h"
+#include "../engine/Checksum.h"
+#include "../shared/SegmentsFile.h"
+#include "../fields.h"
+
+#include <DataIO.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <String.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace lucene::util ;
+
+
+static status_t
+write_text(StringPositionIO *text, const char *path)
+{
+	BFile file(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) ;
+	status_t status = file.InitCheck() ;
+	off_t position = 0 ;
+	const char *data ;
+	size_t length ;
+	while (status == B_OK && (length = text->GetSpan(position, &data)) > 0) {
+		if (file.Write(data, length) != (ssize_t)length)
+			status = B_IO_ERROR ;
+		position += length ;
+	}
+
+	return status ;
+}
+
+
+static void
+read_numbers(IndexReader *reader, const wchar_t *field, uint64 *values)
+{
+	// One pass over the field's terms fills in every document, the full
+	// precision terms are the only ones under the plain field name.
+	Term *start = new Term(field, _T("")) ;
+	TermEnum *terms = reader->terms(start) ;
+	TermDocs *docs = reader->termDocs() ;
+	_CLDECDELETE(start) ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), field) != 0)
+			break ;
+
+		uint64 value ;
+		if (!decode_number(term->text(), &value))
+			continue ;
+
+		docs->seek(term) ;
+		while (docs->next())
+			values[docs->doc()] = value ;
+	} while (terms->next()) ;
+
+	docs->close() ;
+	_CLDELETE(docs) ;
+	terms->close() ;
+	_CLDELETE(terms) ;
+}
+
+
+static bool
+is_damage(CLuceneError &error, int openErrno)
+{
+	// A lock left behind or running out of descriptors says nothing about
+	// the files themselves, trying again later may well work.
+	if (openErrno == EMFILE || openErrno == ENFILE || openErrno == ENOMEM)
+		return false ;
+
+	switch (error.number()) {
+		case CL_ERR_IO:
+			return strstr(error.what(), "Lock obtain timed out") == NULL ;
+		case CL_ERR_Runtime:
+		case CL_ERR_IndexOutOfBounds:
+#ifdef CL_ERR_CorruptIndex
+		case CL_ERR_CorruptIndex:
+#endif
+			return true ;
+		default:
+			return false ;
+	}
+}
+
+
+//	#pragma mark - checksums
+
+
+const int32 kManifestVersion = 1 ;
+
+
+// A file as the manifest lists it.
+struct checksum_entry {
+	BString		name ;
+	off_t		size ;
+	uint32		checksum ;
+} ;
+
+
+static void
+free_checksums(BList *checksums)
+{
+	for (int32 i = 0 ; i < checksums->CountItems() ; i++)
+		delete (checksum_entry*)checksums->ItemAt(i) ;
+	checksums->MakeEmpty() ;
+}
+
+
+static bool
+has_suffix(const char *name, const char *suffix)
+{
+	size_t length = strlen(name) ;
+	size_t suffixLength = strlen(suffix) ;
+	return length >= suffixLength
+		&& strcmp(name + length - suffixLength, suffix) == 0 ;
+}
+
+
+static bool
+belongs_to(const char *fileName, const segment_entry *segment)
+{
+	// "_1.cfs" belongs to "_1" and not to "_10".
+	int32 length = segment->name.Length() ;
+	return strncmp(fileName, segment->name.String(), length) == 0
+		&& fileName[length] == '.' ;
+}
+
+
+static segment_entry*
+segment_of(const BList *segments, const char *fileName)
+{
+	for (int32 i = 0 ; i < segments->CountItems() ; i++) {
+		segment_entry *segment = (segment_entry*)segments->ItemAt(i) ;
+		if (belongs_to(fileName, segment))
+			return segment ;
+	}
+
+	return NULL ;
+}
+
+
+static checksum_entry*
+find_checksum(const BList *checksums, const char *name, off_t size)
+{
+	for (int32 i = 0 ; i < checksums->CountItems() ; i++) {
+		checksum_entry *checksum = (checksum_entry*)checksums->ItemAt(i) ;
+		if (checksum->name == name && checksum->size == size)
+			return checksum ;
+	}
+
+	return NULL ;
+}
+
+
+static status_t
+file_checksum(const char *path, off_t *size, uint32 *checksum)
+{
+	BFile file(path, B_READ_ONLY) ;
+	status_t status = file.InitCheck() ;
+	if (status != B_OK)
+		return status ;
+
+	char buffer[65536] ;
+	ssize_t bytesRead ;
+	*size = 0 ;
+	*checksum = 0 ;
+	while ((bytesRead = file.Read(buffer, sizeof(buffer))) > 0) {
+		*checksum = update_crc32(*checksum, buffer, bytesRead) ;
+		*size += bytesRead ;
+	}
+
+	return bytesRead < 0 ? B_IO_ERROR : B_OK ;
+}
+
+
+static status_t
+read_checksums(const char *directory, BList *checksums, int64 *version)
+{
+	BPath path(directory, CLUCENE_MANIFEST_FILE) ;
+	FILE *file = fopen(path.Path(), "r") ;
+	if (file == NULL)
+		return B_ENTRY_NOT_FOUND ;
+
+	char line[512], name[256] ;
+	int manifestVersion = 0 ;
+	long long value ;
+	unsigned long checksum ;
+	status_t status = B_OK ;
+	*version = 0 ;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "clucene %d", &manifestVersion) == 1)
+			continue ;
+		if (sscanf(line, "version %lld", &value) == 1) {
+			*version = value ;
+			continue ;
+		}
+		if (sscanf(line, "file %255s %lld %lx", name, &value, &checksum)
+				!= 3) {
+			status = B_BAD_DATA ;
+			break ;
+		}
+
+		checksum_entry *entry = new checksum_entry ;
+		entry->name = name ;
+		entry->size = value ;
+		entry->checksum = checksum ;
+		checksums->AddItem(entry) ;
+	}
+
+	fclose(file) ;
+
+	if (status == B_OK && manifestVersion != kManifestVersion)
+		status = B_BAD_DATA ;
+	if (status != B_OK)
+		free_checksums(checksums) ;
+
+	return status ;
+}
+
+
+static bool
+segment_intact(const char *directory, const segment_entry *segment,
+	const BList *checksums, bool current)
+{
+	// Segment files are written once and never changed, save for the
+	// deletions, which may have been written after the checksums. A
+	// segment the manifest doesn't know is newer than it, and taken as
+	// it is.
+	for (int32 i = 0 ; i < checksums->CountItems() ; i++) {
+		checksum_entry *entry = (checksum_entry*)checksums->ItemAt(i) ;
+		if (!belongs_to(entry->name.String(), segment)
+			|| (!current && has_suffix(entry->name.String(), ".del")))
+			continue ;
+
+		BPath path(directory, entry->name.String()) ;
+		off_t size ;
+		uint32 checksum ;
+		if (file_checksum(path.Path(), &size, &checksum) != B_OK
+			|| size != entry->size || checksum != entry->checksum) {
+			logger->Error("%s does not match its checksum", path.Path()) ;
+			return false ;
+		}
+	}
+
+	return true ;
+}
+
+
+static status_t
+for_each_listed_path(const char *path, index_path_callback callback,
+	void *cookie)
+{
+	BFile file(path, B_READ_ONLY) ;
+	off_t size ;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK)
+		return B_ENTRY_NOT_FOUND ;
+	if (size < (off_t)sizeof(uint32))
+		return B_BAD_DATA ;
+
+	char *data = new char[size] ;
+	if (file.ReadAt(0, data, size) != size) {
+		delete[] data ;
+		return B_IO_ERROR ;
+	}
+
+	size -= sizeof(uint32) ;
+	uint32 checksum ;
+	memcpy(&checksum, data + size, sizeof(checksum)) ;
+	if (checksum != compute_crc32(data, size)
+		|| (size > 0 && data[size - 1] != '\0')) {
+		delete[] data ;
+		return B_BAD_DATA ;
+	}
+
+	for (off_t start = 0 ; start < size ; start += strlen(data + start) + 1)
+		callback(data + start, cookie) ;
+
+	delete[] data ;
+	return B_OK ;
+}
+
+
+//	#pragma mark -
+
+
+CLuceneBackend::CLuceneBackend(const char *indexPath, dev_t device)
+	: fIndexPath(indexPath),
+	  fDevice(device),
+	  fReader(NULL),
+	  fWriter(NULL)
+{
+}
+
+
+CLuceneBackend::~CLuceneBackend()
+{
+	CloseIndexReader() ;
+	CloseIndexWriter() ;
+}
+
+
+bool
+CLuceneBackend::Exists()
+{
+	return IndexReader::indexExists(fIndexPath.Path()) ;
+}
+
+
+status_t
+CLuceneBackend::Recover(index_path_callback callback, void *cookie)
+{
+	// Segments that don't match the checksums of the last commit are set
+	// aside, and their documents indexed again. An index CLucene still
+	// can't read after that is moved out of the way by its segments file
+	// and built anew.
+	if (!Exists() || fReader != NULL)
+		return B_OK ;
+
+	CloseIndexWriter() ;
+	if (SetAsideDamagedSegments(callback, cookie) == B_BAD_DATA)
+		return SetAsideIndex() ;
+
+	errno = 0 ;
+	try {
+		fReader = IndexReader::open(fIndexPath.Path()) ;
+		return B_OK ;
+	} catch (CLuceneError &error) {
+		if (!is_damage(error, errno)) {
+			logger->Error("Could not open the index on device %d, trying "
+				"again later: %s", fDevice, error.what()) ;
+			return B_BUSY ;
+		}
+
+		logger->Error("Could not read the index on device %d: %s", fDevice,
+			error.what()) ;
+	}
+
+	return SetAsideIndex() ;
+}
+
+
+status_t
+CLuceneBackend::SetAsideDamagedSegments(index_path_callback callback,
+	void *cookie)
+{
+	// Every file is read once here, which is still far less than indexing
+	// the volume again. B_ENTRY_NOT_FOUND if there are no checksums to go
+	// by, B_BAD_DATA if the damage can't be set aside on its own.
+	BList checksums ;
+	int64 checkedVersion ;
+	status_t status = read_checksums(fIndexPath.Path(), &checksums,
+		&checkedVersion) ;
+	if (status != B_OK)
+		return B_ENTRY_NOT_FOUND ;
+
+	BList segments, damaged ;
+	int64 version ;
+	int32 counter ;
+	status = read_segments(fIndexPath.Path(), &segments, &version, &counter) ;
+	if (status != B_OK) {
+		free_checksums(&checksums) ;
+		return status == B_IO_ERROR ? status : B_BAD_DATA ;
+	}
+
+	for (int32 i = 0 ; i < segments.CountItems() ; ) {
+		segment_entry *segment = (segment_entry*)segments.ItemAt(i) ;
+		if (segment_intact(fIndexPath.Path(), segment, &checksums,
+				version == checkedVersion))
+			i++ ;
+		else
+			damaged.AddItem(segments.RemoveItem(i)) ;
+	}
+	free_checksums(&checksums) ;
+
+	// The paths are needed before the files go, since the damaged
+	// segment itself can't be trusted to tell them.
+	for (int32 i = 0 ; status == B_OK && i < damaged.CountItems() ; i++) {
+		segment_entry *segment = (segment_entry*)damaged.ItemAt(i) ;
+		BString name(segment->name) ;
+		name << CLUCENE_PATHS_SUFFIX ;
+		BPath path(fIndexPath.Path(), name.String()) ;
+		if (for_each_listed_path(path.Path(), callback, cookie) != B_OK) {
+			logger->Error("The paths in %s are not known", path.Path()) ;
+			status = B_BAD_DATA ;
+		}
+	}
+
+	// Without the damaged segments, and a version searchers notice.
+	if (status == B_OK && !damaged.IsEmpty())
+		status = write_segments(fIndexPath.Path(), &segments, version + 1,
+			counter) == B_OK ? B_OK : B_BAD_DATA ;
+
+	// Kept for a look at what went wrong, nothing refers to them anymore.
+	if (status == B_OK && !damaged.IsEmpty()) {
+		BDirectory directory(fIndexPath.Path()) ;
+		BEntry entry ;
+		char name[B_FILE_NAME_LENGTH] ;
+		while (directory.GetNextEntry(&entry) == B_OK) {
+			if (entry.GetName(name) != B_OK
+				|| segment_of(&damaged, name) == NULL
+				|| has_suffix(name, ".damaged"))
+				continue ;
+
+			BString damagedName(name) ;
+			damagedName << ".damaged" ;
+			entry.Rename(damagedName.String(), true) ;
+		}
+
+		logger->Error("Set aside %d damaged segments of the index on device "
+			"%d", (int)damaged.CountItems(), fDevice) ;
+	}
+
+	free_segments(&segments) ;
+	free_segments(&damaged) ;
+	return status ;
+}
+
+
+status_t
+CLuceneBackend::SetAsideIndex()
+{
+	BPath segments(fIndexPath.Path(), "segments") ;
+	BString damaged(segments.Path()) ;
+	damaged << ".damaged" ;
+	if (rename(segments.Path(), damaged.String()) != 0)
+		return B_IO_ERROR ;
+
+	// Nothing refers to the old segment files anymore, and the new index
+	// would start over with their names, which the old checksums would
+	// then be taken for.
+	BPath manifest(fIndexPath.Path(), CLUCENE_MANIFEST_FILE) ;
+	unlink(manifest.Path()) ;
+
+	BDirectory directory(fIndexPath.Path()) ;
+	BEntry entry ;
+	char name[B_FILE_NAME_LENGTH] ;
+	while (directory.GetNextEntry(&entry) == B_OK) {
+		if (entry.GetName(name) == B_OK && name[0] == '_')
+			entry.Remove() ;
+	}
+
+	logger->Error("The index on device %d is damaged", fDevice) ;
+	return B_BAD_DATA ;
+}
+
+
+IndexWriter*
+CLuceneBackend::OpenIndexWriter()
+{
+	if (fWriter != NULL)
+		return fWriter ;
+
+	// CLucene won't have a reader and a writer at the same time.
+	CloseIndexReader() ;
+
+	if (IndexReader::indexExists(fIndexPath.Path())) {
+		try {
+			fWriter = new IndexWriter(fIndexPath.Path(), &fAnalyzer, false) ;
+		} catch (CLuceneError &error) {
+			logger->Error("Failed to open IndexWriter on device %d", fDevice) ;
+			logger->Error("If the index is damaged, it is rebuilt the "
+				"next time index_server starts.") ;
+			logger->Error("Failed with CLuceneError: %s", error.what()) ;
+		}
+	} else
+		fWriter = new IndexWriter(fIndexPath.Path(), &fAnalyzer, true) ;
+
+	return fWriter ;
+}
+
+
+IndexReader*
+CLuceneBackend::OpenIndexReader()
+{
+	if (fReader != NULL)
+		return fReader ;
+
+	CloseIndexWriter() ;
+
+	BEntry entry(fIndexPath.Path(), NULL) ;
+	if (!entry.Exists())
+		return NULL ;
+
+	if (IndexReader::indexExists(fIndexPath.Path())) {
+		try {
+			fReader = IndexReader::open(fIndexPath.Path()) ;
+		} catch (CLuceneError &error) {
+			logger->Error("Could not open IndexReader.") ;
+			logger->Error("Failed with error: %s", error.what()) ;
+		}
+	}
+
+	return fReader ;
+}
+
+
+void
+CLuceneBackend::CloseIndexWriter()
+{
+	if (fWriter == NULL)
+		return ;
+
+	fWriter->close() ;
+	delete fWriter ;
+	fWriter = NULL ;
+}
+
+
+void
+CLuceneBackend::CloseIndexReader()
+{
+	if (fReader == NULL)
+		return ;
+
+	fReader->close() ;
+	delete fReader ;
+	fReader = NULL ;
+}
+
+
+status_t
+CLuceneBackend::RemovePath(const char *path)
+{
+	IndexReader *reader = OpenIndexReader() ;
+	if (reader == NULL)
+		return IndexReader::indexExists(fIndexPath.Path()) ? B_ERROR : B_OK ;
+
+	wchar_t *wPath = to_wchar(path) ;
+	if (wPath == NULL)
+		return B_BAD_VALUE ;
+
+	Term *term = new Term(_T("path"), wPath) ;
+	reader->deleteDocuments(term) ;
+	delete term ;
+	delete[] wPath ;
+
+	return B_OK ;
+}
+
+
+status_t
+CLuceneBackend::RemoveSubtree(const char *path)
+{
+	IndexReader *reader = OpenIndexReader() ;
+	if (reader == NULL)
+		return IndexReader::indexExists(fIndexPath.Path()) ? B_ERROR : B_OK ;
+
+	wchar_t *wPath = to_wchar(path) ;
+	if (wPath == NULL)
+		return B_BAD_VALUE ;
+
+	// Every directory below path is a "dir" term starting with it, so the
+	// work done is proportional to the size of the subtree.
+	int32 length = wcslen(wPath) ;
+	Term *start = new Term(_T("dir"), wPath) ;
+	TermEnum *terms = reader->terms(start) ;
+	_CLDECDELETE(start) ;
+
+	int32 removed = 0 ;
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), _T("dir")) != 0
+			|| wcsncmp(term->text(), wPath, length) != 0)
+			break ;
+
+		// Skip siblings like "/a/bc" when removing "/a/b".
+		const wchar_t *rest = term->text() + length ;
+		if (*rest == 0 || *rest == L'/')
+			removed += reader->deleteDocuments(term) ;
+	} while (terms->next()) ;
+
+	terms->close() ;
+	delete terms ;
+
+	if (removed > 0)
+		BEACON_LOG_VERBOSE("Removed %d documents under %s", removed, path) ;
+
+	delete[] wPath ;
+	return B_OK ;
+}
+
+
+status_t
+CLuceneBackend::ReplaceSubtree(const char *path, const char *indexPath,
+	time_t since)
+{
+	// bulkindex only builds native indexes.
+	return BEACON_NOT_SUPPORTED ;
+}
+
+
+status_t
+CLuceneBackend::AddDocument(const index_document *document)
+{
+	IndexWriter *writer = OpenIndexWriter() ;
+	if (writer == NULL)
+		return B_ERROR ;
+
+	wchar_t *wPath = to_wchar(document->path) ;
+	if (wPath == NULL)
+		return B_BAD_VALUE ;
+
+	// Text is tokenized straight from UTF-8 where the translator left it.
+	// The analyzer gets the text itself, so the field only needs to be
+	// there. What isn't valid UTF-8 goes through CLucene's own Reader,
+	// which reads from a file.
+	Document *doc = new Document ;
+	BPath textPath ;
+	if (fAnalyzer.SetText(document->text)) {
+		doc->add(*(new Field(_T("contents"), _T(""),
+			Field::STORE_NO | Field::INDEX_TOKENIZED))) ;
+	} else {
+		textPath.SetTo(fIndexPath.Path(), "contents.tmp") ;
+		if (write_text(document->text, textPath.Path()) != B_OK) {
+			unlink(textPath.Path()) ;
+			delete doc ;
+			delete[] wPath ;
+			return B_IO_ERROR ;
+		}
+
+		FileReader *fileReader = new FileReader(textPath.Path(), "UTF-8") ;
+		doc->add(*(new Field(_T("contents"), fileReader,
+			Field::STORE_NO | Field::INDEX_TOKENIZED))) ;
+	}
+	doc->add(*(new Field (_T("path"), wPath,
+		Field::STORE_YES | Field::INDEX_UNTOKENIZED))) ;
+
+	// The parent directory, for searches and deletes limited to
+	// a subtree.
+	wchar_t *slash = wcsrchr(wPath, L'/') ;
+	if (slash != NULL && slash != wPath) {
+		*slash = 0 ;
+		doc->add(*(new Field(_T("dir"), wPath,
+			Field::STORE_NO | Field::INDEX_UNTOKENIZED))) ;
+		*slash = L'/' ;
+	}
+
+	// Keep the start of the text around so searchapp can show
+	// why a file matched without translating it again.
+	wchar_t *excerpt = document->excerpt != NULL
+		? to_wchar(document->excerpt) : NULL ;
+	if (excerpt != NULL) {
+		doc->add(*(new Field(_T("excerpt"), excerpt,
+			Field::STORE_YES | Field::INDEX_NO))) ;
+		delete[] excerpt ;
+	}
+
+	AddMetadata(doc, document) ;
+
+	status_t status = B_OK ;
+	try {
+		writer->addDocument(doc) ;
+	} catch (CLuceneError &error) {
+		logger->Error("%s", error.what()) ;
+		status = B_ERROR ;
+	}
+
+	fAnalyzer.UnsetText() ;
+	delete doc ;
+	delete[] wPath ;
+	if (textPath.InitCheck() == B_OK)
+		unlink(textPath.Path()) ;
+	return status ;
+}
+
+
+status_t
+CLuceneBackend::Commit()
+{
+	// Open a writer even with nothing to add, the first commit creates
+	// the index.
+	CloseIndexReader() ;
+	if (OpenIndexWriter() == NULL)
+		return B_ERROR ;
+	CloseIndexWriter() ;
+
+	Publish() ;
+	if (WriteManifest() != B_OK) {
+		logger->Error("Could not write the checksums of the index on device "
+			"%d, it can't be checked on the next start", fDevice) ;
+	}
+	return B_OK ;
+}
+
+
+void
+CLuceneBackend::Publish()
+{
+	// Deletions and additions are separate commits as far as CLucene is
+	// concerned. Searchers only move to a version once it is published
+	// here, so none of them sees a batch half done.
+	int64 version ;
+	try {
+		version = IndexReader::getCurrentVersion(fIndexPath.Path()) ;
+	} catch (CLuceneError &error) {
+		logger->Error("Could not read the index version: %s", error.what()) ;
+		return ;
+	}
+
+	BPath path(fIndexPath.Path(), BEACON_PUBLISHED_FILE) ;
+	BString tempPath(path.Path()) ;
+	tempPath << ".tmp" ;
+
+	BFile file(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) ;
+	if (file.Write(&version, sizeof(version)) != sizeof(version)) {
+		logger->Error("Could not write %s", tempPath.String()) ;
+		return ;
+	}
+	file.Unset() ;
+
+	BEntry entry(tempPath.String()) ;
+	entry.Rename(path.Path(), true) ;
+}
+
+
+status_t
+CLuceneBackend::WriteManifest()
+{
+	// Segment files never change once written, so their checksums carry
+	// over from the last manifest as long as the size does. Deletions are
+	// rewritten in place and always read again.
+	BList segments, previous, checksums ;
+	int64 version, previousVersion ;
+	int32 counter ;
+	status_t status = read_segments(fIndexPath.Path(), &segments, &version,
+		&counter) ;
+	if (status != B_OK)
+		return status ;
+
+	// A segment without a path list can still be checked, only setting it
+	// aside then means indexing the volume again.
+	if (WritePathLists(&segments) != B_OK) {
+		logger->Error("Could not list the paths of the new segments of the "
+			"index on device %d", fDevice) ;
+	}
+
+	read_checksums(fIndexPath.Path(), &previous, &previousVersion) ;
+
+	BDirectory directory(fIndexPath.Path()) ;
+	BEntry entry ;
+	char name[B_FILE_NAME_LENGTH] ;
+	while (status == B_OK && directory.GetNextEntry(&entry) == B_OK) {
+		if (entry.GetName(name) != B_OK || name[0] != '_'
+			|| has_suffix(name, ".damaged"))
+			continue ;
+
+		// Path lists of segments merged away go with them. The others
+		// carry a checksum of their own.
+		bool pathList = has_suffix(name, CLUCENE_PATHS_SUFFIX) ;
+		if (segment_of(&segments, name) == NULL) {
+			if (pathList)
+				entry.Remove() ;
+			continue ;
+		}
+		if (pathList || has_suffix(name, ".tmp"))
+			continue ;
+
+		checksum_entry *checksum = new checksum_entry ;
+		checksum->name = name ;
+		checksums.AddItem(checksum) ;
+
+		off_t size ;
+		checksum_entry *known = NULL ;
+		if (!has_suffix(name, ".del") && entry.GetSize(&size) == B_OK)
+			known = find_checksum(&previous, name, size) ;
+		if (known != NULL) {
+			checksum->size = known->size ;
+			checksum->checksum = known->checksum ;
+			continue ;
+		}
+
+		BPath path(fIndexPath.Path(), name) ;
+		status = file_checksum(path.Path(), &checksum->size,
+			&checksum->checksum) ;
+	}
+
+	free_segments(&segments) ;
+	free_checksums(&previous) ;
+
+	BPath path(fIndexPath.Path(), CLUCENE_MANIFEST_FILE) ;
+	BString tempPath(path.Path()) ;
+	tempPath << ".tmp" ;
+
+	FILE *file = status == B_OK ? fopen(tempPath.String(), "w") : NULL ;
+	if (file != NULL) {
+		fprintf(file, "clucene %d\n", (int)kManifestVersion) ;
+		fprintf(file, "version %lld\n", (long long)version) ;
+		for (int32 i = 0 ; i < checksums.CountItems() ; i++) {
+			checksum_entry *checksum = (checksum_entry*)checksums.ItemAt(i) ;
+			fprintf(file, "file %s %lld %08lx\n", checksum->name.String(),
+				(long long)checksum->size, (unsigned long)checksum->checksum) ;
+		}
+
+		bool failed = ferror(file) || fflush(file) != 0
+			|| fsync(fileno(file)) != 0 ;
+		if (fclose(file) != 0 || failed
+			|| rename(tempPath.String(), path.Path()) != 0)
+			status = B_IO_ERROR ;
+	} else if (status == B_OK)
+		status = B_IO_ERROR ;
+
+	if (status != B_OK)
+		unlink(tempPath.String()) ;
+	free_checksums(&checksums) ;
+	return status ;
+}
+
+
+status_t
+CLuceneBackend::WritePathLists(const BList *segments)
+{
+	// Only new segments need one, from the stored paths of their
+	// documents.
+	IndexReader *reader = NULL ;
+	status_t status = B_OK ;
+	char path[B_PATH_NAME_LENGTH] ;
+	for (int32 i = 0 ; status == B_OK && i < segments->CountItems() ; i++) {
+		segment_entry *segment = (segment_entry*)segments->ItemAt(i) ;
+		BString name(segment->name) ;
+		name << CLUCENE_PATHS_SUFFIX ;
+		BPath listPath(fIndexPath.Path(), name.String()) ;
+		if (BEntry(listPath.Path()).Exists())
+			continue ;
+
+		if (reader == NULL && (reader = OpenIndexReader()) == NULL)
+			return B_ERROR ;
+
+		int32 first = segment->firstDocument ;
+		int32 end = first + segment->documents ;
+		if (end > reader->maxDoc()) {
+			status = B_BAD_DATA ;
+			break ;
+		}
+
+		BMallocIO list ;
+		try {
+			Document document ;
+			for (int32 doc = first ; doc < end ; doc++) {
+				if (reader->isDeleted(doc))
+					continue ;
+
+				document.clear() ;
+				reader->document(doc, &document) ;
+				const TCHAR *wPath = document.get(_T("path")) ;
+				size_t length = wPath != NULL
+					? wcstombs(path, wPath, sizeof(path)) : (size_t)-1 ;
+				if (length != (size_t)-1 && length < sizeof(path))
+					list.Write(path, length + 1) ;
+			}
+		} catch (CLuceneError &error) {
+			logger->Error("Could not read the paths of segment %s: %s",
+				segment->name.String(), error.what()) ;
+			status = B_ERROR ;
+			break ;
+		}
+
+		uint32 checksum = compute_crc32(list.Buffer(), list.BufferLength()) ;
+		list.Write(&checksum, sizeof(checksum)) ;
+
+		BString tempPath(listPath.Path()) ;
+		tempPath << ".tmp" ;
+		BFile file(tempPath.String(),
+			B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) ;
+		if (file.Write(list.Buffer(), list.BufferLength())
+				!= (ssize_t)list.BufferLength()
+			|| file.Sync() != B_OK
+			|| rename(tempPath.String(), listPath.Path()) != 0) {
+			unlink(tempPath.String()) ;
+			status = B_IO_ERROR ;
+		}
+	}
+
+	if (reader != NULL)
+		CloseIndexReader() ;
+	return status ;
+}
+
+
+void
+CLuceneBackend::AddMetadata(Document *doc, const index_document *document)
+{
+	// MIME type, size and modification time go in as untokenized terms,
+	// so filters work off the term dictionary and sorting off the field
+	// cache, without looking at the files themselves. The volume needs no
+	// field of its own, every volume has an index of its own.
+	if (document->mimeType == NULL)
+		return ;
+
+	wchar_t *wMimeType = to_wchar(document->mimeType) ;
+	if (wMimeType != NULL) {
+		doc->add(*(new Field(_T("mime"), wMimeType,
+			Field::STORE_NO | Field::INDEX_UNTOKENIZED))) ;
+		delete[] wMimeType ;
+	}
+
+	AddNumber(doc, _T("size"), document->size) ;
+	AddNumber(doc, _T("mtime"), document->modified) ;
+}
+
+
+void
+CLuceneBackend::AddNumber(Document *doc, const wchar_t *name, uint64 value)
+{
+	wchar_t encoded[kEncodedNumberLength] ;
+	wchar_t trieName[32] ;
+	swprintf(trieName, 32, L"%ls_trie", name) ;
+
+	encode_number(value, 0, encoded) ;
+	doc->add(*(new Field(name, encoded,
+		Field::STORE_NO | Field::INDEX_UNTOKENIZED))) ;
+
+	for (int32 shift = kPrecisionStep ; shift < 64 ; shift += kPrecisionStep) {
+		encode_number(value, shift, encoded) ;
+		doc->add(*(new Field(trieName, encoded,
+			Field::STORE_NO | Field::INDEX_UNTOKENIZED))) ;
+	}
+}
+
+
+void
+CLuceneBackend::ForEachPath(index_path_callback callback, void *cookie)
+{
+	IndexReader *reader = OpenIndexReader() ;
+	if (reader == NULL)
+		return ;
+
+	Term *start = new Term(_T("path"), _T("")) ;
+	TermEnum *terms = reader->terms(start) ;
+	char path[B_PATH_NAME_LENGTH] ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), _T("path")) != 0)
+			break ;
+
+		if (wcstombs(path, term->text(), sizeof(path)) != (size_t)-1)
+			callback(path, cookie) ;
+	} while (terms->next()) ;
+
+	terms->close() ;
+	delete terms ;
+	_CLDECDELETE(start) ;
+	CloseIndexReader() ;
+}
+
+
+void
+CLuceneBackend::ForEachDocument(index_document_callback callback,
+	void *cookie)
+{
+	IndexReader *reader = OpenIndexReader() ;
+	if (reader == NULL)
+		return ;
+
+	// Size and modification time are only indexed, not stored, so they
+	// come from their terms. Documents without them get 0.
+	int32 count = reader->maxDoc() ;
+	uint64 *sizes = new uint64[count] ;
+	uint64 *modified = new uint64[count] ;
+	memset(sizes, 0, count * sizeof(uint64)) ;
+	memset(modified, 0, count * sizeof(uint64)) ;
+	read_numbers(reader, _T("size"), sizes) ;
+	read_numbers(reader, _T("mtime"), modified) ;
+
+	Term *start = new Term(_T("path"), _T("")) ;
+	TermEnum *terms = reader->terms(start) ;
+	TermDocs *docs = reader->termDocs() ;
+	_CLDECDELETE(start) ;
+	char path[B_PATH_NAME_LENGTH] ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), _T("path")) != 0)
+			break ;
+
+		if (wcstombs(path, term->text(), sizeof(path)) == (size_t)-1)
+			continue ;
+
+		docs->seek(term) ;
+		while (docs->next()) {
+			callback(path, sizes[docs->doc()], modified[docs->doc()],
+				cookie) ;
+		}
+	} while (terms->next()) ;
+
+	docs->close() ;
+	_CLDELETE(docs) ;
+	terms->close() ;
+	_CLDELETE(terms) ;
+	delete[] sizes ;
+	delete[] modified ;
+	CloseIndexReader() ;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _CLUCENE_BACKEND_H_
+#define _CLUCENE_BACKEND_H_
+
+#include "ContentAnalyzer.h"
+#include "IndexBackend.h"
+
+#include <List.h>
+#include <Path.h>
+
+#include <CLucene.h>
+using namespace lucene::index ;
+using namespace lucene::analysis::standard ;
+using namespace lucene::document ;
+
+
+// Written next to the index at every commit: the size and CRC-32 of each
+// file of its segments, and the index version they go with.
+#define CLUCENE_MANIFEST_FILE "checksums"
+// Each segment's paths, NUL separated and followed by their CRC-32 like
+// the native index's .pth files, so that the documents of a damaged
+// segment can be indexed again without reading it.
+#define CLUCENE_PATHS_SUFFIX ".paths"
+
+
+// The original index format. Deletes go through an IndexReader and
+// additions through an IndexWriter, and only one of them is open at a
+// time. CLucene keeps no checksums of its own, they are written here on
+// Commit() and checked by Recover().
+class CLuceneBackend : public IndexBackend {
+	public:
+		CLuceneBackend(const char *indexPath, dev_t device) ;
+		virtual ~CLuceneBackend() ;
+
+		virtual bool Exists() ;
+		virtual status_t Recover(index_path_callback callback,
+			void *cookie) ;
+		virtual status_t RemovePath(const char *path) ;
+		virtual status_t RemoveSubtree(const char *path) ;
+		virtual status_t AddDocument(const index_document *document) ;
+		virtual status_t ReplaceSubtree(const char *path,
+			const char *indexPath, time_t since) ;
+		virtual status_t Commit() ;
+		virtual void ForEachPath(index_path_callback callback, void *cookie) ;
+		virtual void ForEachDocument(index_document_callback callback,
+			void *cookie) ;
+
+	private:
+		IndexWriter* OpenIndexWriter() ;
+		IndexReader* OpenIndexReader() ;
+		void CloseIndexWriter() ;
+		void CloseIndexReader() ;
+		void Publish() ;
+		status_t WriteManifest() ;
+		status_t WritePathLists(const BList *segments) ;
+		status_t SetAsideDamagedSegments(index_path_callback callback,
+			void *cookie) ;
+		status_t SetAsideIndex() ;
+		void AddMetadata(Document *doc, const index_document *document) ;
+		void AddNumber(Document *doc, const wchar_t *name, uint64 value) ;
+
+		BPath				fIndexPath ;
+		dev_t				fDevice ;
+		ContentAnalyzer		fAnalyzer ;
+		IndexReader			*fReader ;
+		IndexWriter			*fWriter ;
+} ;
+
+#endif /* _CLUCENE_BACKEND_H_ */
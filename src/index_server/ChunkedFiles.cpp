@@ -0,0 +1,309 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "ChunkedFiles.h"
+#include "../engine/Checksum.h"
+
+#include <Entry.h>
+#include <File.h>
+#include <String.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+const uint32 kChunkedFilesMagic = 'BCHK' ;
+const uint32 kChunkedFilesVersion = 2 ;
+
+
+ChunkedFiles::ChunkedFiles()
+	: fDirty(false)
+{
+}
+
+
+ChunkedFiles::~ChunkedFiles()
+{
+	MakeEmpty() ;
+}
+
+
+bool
+ChunkedFiles::Contains(const char *path)
+{
+	return Find(path) != NULL ;
+}
+
+
+off_t
+ChunkedFiles::IndexedLength(const char *path, const struct stat *st)
+{
+	// Rotated logs differ in their node. Everything else takes reading
+	// what was indexed, which costs far less than indexing it again, and
+	// a change only has what comes after it indexed again.
+	chunked_file *file = Find(path) ;
+	if (file == NULL || file->node != st->st_ino)
+		return 0 ;
+
+	BFile data(path, B_READ_ONLY) ;
+	if (data.InitCheck() != B_OK)
+		return 0 ;
+
+	char *buffer = NULL ;
+	size_t bufferSize = 0 ;
+	off_t start = 0 ;
+	for (int32 i = 0 ; i < file->count ; i++) {
+		indexed_chunk *chunk = &file->chunks[i] ;
+		if (chunk->end > st->st_size)
+			break ;
+
+		size_t length = chunk->end - start ;
+		if (length > bufferSize) {
+			char *grown = (char*)realloc(buffer, length) ;
+			if (grown == NULL)
+				break ;
+			buffer = grown ;
+			bufferSize = length ;
+		}
+
+		if (data.ReadAt(start, buffer, length) != (ssize_t)length
+			|| hash64(buffer, length, start) != chunk->hash)
+			break ;
+		start = chunk->end ;
+	}
+
+	free(buffer) ;
+	return start ;
+}
+
+
+int32
+ChunkedFiles::CountChunks(const char *path)
+{
+	chunked_file *file = Find(path) ;
+	return file != NULL ? file->count : 0 ;
+}
+
+
+off_t
+ChunkedFiles::ChunkStart(const char *path, int32 index)
+{
+	chunked_file *file = Find(path) ;
+	if (file == NULL || index <= 0)
+		return 0 ;
+	if (index > file->count)
+		index = file->count ;
+
+	return file->chunks[index - 1].end ;
+}
+
+
+void
+ChunkedFiles::AddChunk(const char *path, const struct stat *st, off_t start,
+	const void *data, size_t length)
+{
+	chunked_file *file = Set(path, st, start) ;
+	indexed_chunk *chunks = (indexed_chunk*)realloc(file->chunks,
+		(file->count + 1) * sizeof(indexed_chunk)) ;
+	if (chunks == NULL) {
+		// Can't be checked, so the next change starts over.
+		file->node = -1 ;
+		return ;
+	}
+
+	file->chunks = chunks ;
+	file->chunks[file->count].end = start + length ;
+	file->chunks[file->count].hash = hash64(data, length, start) ;
+	file->count++ ;
+}
+
+
+void
+ChunkedFiles::SetIndexedLength(const char *path, const struct stat *st,
+	off_t length)
+{
+	Set(path, st, length) ;
+}
+
+
+void
+ChunkedFiles::RemoveSubtree(const char *path)
+{
+	size_t length = strlen(path) ;
+	for (int32 i = fFiles.CountItems() - 1 ; i >= 0 ; i--) {
+		chunked_file *file = (chunked_file*)fFiles.ItemAt(i) ;
+		if (strncmp(file->path, path, length) != 0
+			|| (file->path[length] != '\0' && file->path[length] != '/'))
+			continue ;
+
+		fFiles.RemoveItem(i) ;
+		Delete(file) ;
+		fDirty = true ;
+	}
+}
+
+
+void
+ChunkedFiles::MakeEmpty()
+{
+	for (int32 i = 0 ; i < fFiles.CountItems() ; i++)
+		Delete((chunked_file*)fFiles.ItemAt(i)) ;
+	fFiles.MakeEmpty() ;
+	fDirty = false ;
+}
+
+
+status_t
+ChunkedFiles::ReadFrom(const char *path)
+{
+	// A list from before the chunks had hashes of their own is dropped,
+	// and the files it had start over.
+	BFile file(path, B_READ_ONLY) ;
+	status_t err ;
+	if ((err = file.InitCheck()) != B_OK)
+		return err ;
+
+	uint32 header[3] ;
+	if (file.Read(header, sizeof(header)) != sizeof(header)
+		|| header[0] != kChunkedFilesMagic
+		|| header[1] != kChunkedFilesVersion)
+		return B_BAD_DATA ;
+
+	MakeEmpty() ;
+	for (uint32 i = 0 ; i < header[2] ; i++) {
+		chunked_file *entry = new chunked_file ;
+		entry->path = NULL ;
+		entry->count = 0 ;
+		entry->chunks = NULL ;
+		fFiles.AddItem(entry) ;
+
+		int64 node ;
+		uint32 counts[2] ;
+		if (file.Read(&node, sizeof(node)) != sizeof(node)
+			|| file.Read(counts, sizeof(counts)) != sizeof(counts)
+			|| counts[1] >= B_PATH_NAME_LENGTH) {
+			MakeEmpty() ;
+			return B_BAD_DATA ;
+		}
+
+		size_t chunksSize = counts[0] * sizeof(indexed_chunk) ;
+		entry->node = node ;
+		entry->path = (char*)malloc(counts[1] + 1) ;
+		entry->chunks = (indexed_chunk*)malloc(chunksSize) ;
+		if (entry->path == NULL || (entry->chunks == NULL && counts[0] > 0)
+			|| file.Read(entry->path, counts[1]) != (ssize_t)counts[1]
+			|| file.Read(entry->chunks, chunksSize) != (ssize_t)chunksSize) {
+			MakeEmpty() ;
+			return B_BAD_DATA ;
+		}
+		entry->path[counts[1]] = '\0' ;
+		entry->count = counts[0] ;
+	}
+
+	return B_OK ;
+}
+
+
+status_t
+ChunkedFiles::WriteTo(const char *path)
+{
+	// Written next to the old list and moved over it once complete, like
+	// the names.
+	BString tempPath(path) ;
+	tempPath << ".tmp" ;
+	BFile file(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE
+		| B_ERASE_FILE) ;
+	status_t err ;
+	if ((err = file.InitCheck()) != B_OK)
+		return err ;
+
+	err = B_IO_ERROR ;
+	uint32 header[3] = { kChunkedFilesMagic, kChunkedFilesVersion,
+		(uint32)fFiles.CountItems() } ;
+	if (file.Write(header, sizeof(header)) != sizeof(header))
+		goto out ;
+
+	for (int32 i = 0 ; i < fFiles.CountItems() ; i++) {
+		chunked_file *entry = (chunked_file*)fFiles.ItemAt(i) ;
+		int64 node = entry->node ;
+		uint32 counts[2] = { (uint32)entry->count,
+			(uint32)strlen(entry->path) } ;
+		size_t chunksSize = entry->count * sizeof(indexed_chunk) ;
+		if (file.Write(&node, sizeof(node)) != sizeof(node)
+			|| file.Write(counts, sizeof(counts)) != sizeof(counts)
+			|| file.Write(entry->path, counts[1]) != (ssize_t)counts[1]
+			|| file.Write(entry->chunks, chunksSize) != (ssize_t)chunksSize)
+			goto out ;
+	}
+
+	if (file.Sync() != B_OK)
+		goto out ;
+
+	file.Unset() ;
+	if (BEntry(tempPath.String()).Rename(path, true) == B_OK) {
+		fDirty = false ;
+		err = B_OK ;
+	}
+
+out:
+	if (err != B_OK)
+		unlink(tempPath.String()) ;
+
+	return err ;
+}
+
+
+bool
+ChunkedFiles::IsDirty()
+{
+	return fDirty ;
+}
+
+
+ChunkedFiles::chunked_file*
+ChunkedFiles::Find(const char *path)
+{
+	// Only big growing files get here, a handful on most volumes.
+	for (int32 i = 0 ; i < fFiles.CountItems() ; i++) {
+		chunked_file *file = (chunked_file*)fFiles.ItemAt(i) ;
+		if (strcmp(file->path, path) == 0)
+			return file ;
+	}
+
+	return NULL ;
+}
+
+
+ChunkedFiles::chunked_file*
+ChunkedFiles::Set(const char *path, const struct stat *st, off_t length)
+{
+	chunked_file *file = Find(path) ;
+	if (file == NULL) {
+		file = new chunked_file ;
+		file->path = strdup(path) ;
+		file->count = 0 ;
+		file->chunks = NULL ;
+		fFiles.AddItem(file) ;
+	}
+
+	file->node = st->st_ino ;
+	while (file->count > 0 && file->chunks[file->count - 1].end > length)
+		file->count-- ;
+	fDirty = true ;
+	return file ;
+}
+
+
+void
+ChunkedFiles::Delete(chunked_file *file)
+{
+	free(file->path) ;
+	free(file->chunks) ;
+	delete file ;
+}
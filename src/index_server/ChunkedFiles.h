@@ -0,0 +1,74 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _CHUNKED_FILES_H_
+#define _CHUNKED_FILES_H_
+
+#include <List.h>
+#include <SupportDefs.h>
+
+#include <sys/stat.h>
+
+
+// Big text files that keep growing, logs mostly, are indexed in chunks,
+// each a document of its own, so that an append only costs what was
+// appended. This remembers the chunks each such file was indexed in, and
+// enough about them to tell whether what was indexed is still there: the
+// node, and a hash of each chunk.
+class ChunkedFiles {
+	public:
+		ChunkedFiles() ;
+		~ChunkedFiles() ;
+
+		bool Contains(const char *path) ;
+		// How far the file is still indexed as it is now: up to the first
+		// chunk that changed. 0 if it has to start over because it is new,
+		// or no longer the file it was.
+		off_t IndexedLength(const char *path, const struct stat *st) ;
+		// Where the chunks indexed last time start, in order. The one
+		// after the last is where the rest of the file, indexed whole,
+		// starts. Those from IndexedLength() on are out of date.
+		int32 CountChunks(const char *path) ;
+		off_t ChunkStart(const char *path, int32 index) ;
+		// Forgets the chunks past length, and adds one that starts there.
+		void AddChunk(const char *path, const struct stat *st, off_t start,
+			const void *data, size_t length) ;
+		// Forgets the chunks past length.
+		void SetIndexedLength(const char *path, const struct stat *st,
+			off_t length) ;
+		// Forgets path and everything below it.
+		void RemoveSubtree(const char *path) ;
+		void MakeEmpty() ;
+
+		status_t ReadFrom(const char *path) ;
+		status_t WriteTo(const char *path) ;
+		bool IsDirty() ;
+
+	private:
+		struct indexed_chunk {
+			off_t		end ;
+			uint64		hash ;
+		} ;
+
+		struct chunked_file {
+			char			*path ;
+			ino_t			node ;
+			int32			count ;
+			indexed_chunk	*chunks ;
+		} ;
+
+		chunked_file* Find(const char *path) ;
+		chunked_file* Set(const char *path, const struct stat *st,
+			off_t length) ;
+		static void Delete(chunked_file *file) ;
+
+		BList			fFiles ;
+		bool			fDirty ;
+} ;
+
+#endif /* _CHUNKED_FILES_H_ */
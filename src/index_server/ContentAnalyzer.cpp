@@ -0,0 +1,441 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "ContentAnalyzer.h"
+#include "StringPositionIO.h"
+#include "../engine/TextScanner.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace lucene::analysis ;
+using namespace lucene::analysis::standard ;
+using namespace lucene::util ;
+
+
+// Longer words are left to StandardTokenizer, which has its own idea of
+// what to do with them.
+const size_t kMaxSimpleWordLength = 255 ;
+
+
+// Wide characters for a piece of valid UTF-8, and how many there are.
+static TCHAR*
+decode_utf8(const char *text, size_t length, size_t *characters)
+{
+	const uint8 *bytes = (const uint8*)text ;
+	TCHAR *decoded = new TCHAR[length + 1] ;
+	size_t count = 0 ;
+
+	for (size_t i = 0 ; i < length ; ) {
+		uint8 c = bytes[i++] ;
+		uint32 value ;
+		int32 following ;
+		if (c < 0x80) {
+			value = c ;
+			following = 0 ;
+		} else if (c < 0xe0) {
+			value = c & 0x1f ;
+			following = 1 ;
+		} else if (c < 0xf0) {
+			value = c & 0x0f ;
+			following = 2 ;
+		} else {
+			value = c & 0x07 ;
+			following = 3 ;
+		}
+
+		while (following-- > 0 && i < length)
+			value = (value << 6) | (bytes[i++] & 0x3f) ;
+
+		decoded[count++] = (TCHAR)value ;
+	}
+
+	decoded[count] = 0 ;
+	*characters = count ;
+	return decoded ;
+}
+
+
+// Bytes at the end of text that start a character they don't finish.
+static size_t
+incomplete_tail(const char *text, size_t length)
+{
+	size_t start = length ;
+	while (start > 0 && length - start < 3
+		&& (text[start - 1] & 0xc0) == 0x80)
+		start-- ;
+	if (start == 0)
+		return 0 ;
+
+	uint8 lead = text[start - 1] ;
+	size_t needed = lead >= 0xf0 ? 4 : (lead >= 0xe0 ? 3
+		: (lead >= 0xc0 ? 2 : 1)) ;
+	size_t have = length - start + 1 ;
+	return have < needed ? have : 0 ;
+}
+
+
+// is_valid_utf8() over all chunks of text, without a NUL in any of them.
+static bool
+is_valid_text(StringPositionIO *text)
+{
+	// A character cut in two by the end of a chunk is checked with the
+	// bytes it goes on with.
+	char joint[8] ;
+	size_t jointLength = 0 ;
+	off_t position = 0 ;
+	const char *data ;
+	size_t length ;
+	while ((length = text->GetSpan(position, &data)) > 0) {
+		position += length ;
+		if (memchr(data, 0, length) != NULL)
+			return false ;
+
+		size_t head = 0 ;
+		if (jointLength > 0) {
+			while (head < length && jointLength < sizeof(joint)
+				&& (data[head] & 0xc0) == 0x80)
+				joint[jointLength++] = data[head++] ;
+			if (!is_valid_utf8(joint, jointLength))
+				return false ;
+			jointLength = 0 ;
+		}
+
+		size_t tail = incomplete_tail(data + head, length - head) ;
+		if (!is_valid_utf8(data + head, length - head - tail))
+			return false ;
+		memcpy(joint, data + length - tail, tail) ;
+		jointLength = tail ;
+	}
+
+	return jointLength == 0 ;
+}
+
+
+class ContentTokenStream : public TokenStream {
+	public:
+		ContentTokenStream(ContentAnalyzer *analyzer, StringPositionIO *text) ;
+		virtual ~ContentTokenStream() ;
+
+		virtual bool next(Token *token) ;
+		virtual void close() ;
+
+	private:
+		size_t LoadSpan() ;
+		bool NextPiece(const char **piece, size_t *length) ;
+		bool Join(const char *data, size_t length) ;
+		int32 NextSimpleWord(const char *piece, size_t length, Token *token) ;
+		void StartComplexPiece(const char *piece, size_t length) ;
+		void EndComplexPiece() ;
+
+		ContentAnalyzer		*fAnalyzer ;
+		StringPositionIO	*fText ;
+		off_t				fSize ;
+		off_t				fPosition ;
+		off_t				fPieceStart ;
+		// Bytes before fPieceStart that don't start a character, token
+		// offsets are in characters.
+		off_t				fExtraBytes ;
+
+		// The chunk fPosition is in.
+		const char			*fSpan ;
+		off_t				fSpanStart ;
+		size_t				fSpanLength ;
+
+		// A piece that didn't end with its chunk.
+		char				*fJoined ;
+		size_t				fJoinedLength ;
+		size_t				fJoinedCapacity ;
+
+		// What is left of a piece StandardAnalyzer is taking care of.
+		TokenStream			*fStream ;
+		Reader				*fReader ;
+		TCHAR				*fWide ;
+		int32				fStreamOffset ;
+
+		char				fLowercase[kMaxSimpleWordLength] ;
+		TCHAR				fWord[kMaxSimpleWordLength + 1] ;
+} ;
+
+
+ContentTokenStream::ContentTokenStream(ContentAnalyzer *analyzer,
+	StringPositionIO *text)
+	:	fAnalyzer(analyzer),
+		fText(text),
+		fPosition(0),
+		fPieceStart(0),
+		fExtraBytes(0),
+		fSpan(NULL),
+		fSpanStart(0),
+		fSpanLength(0),
+		fJoined(NULL),
+		fJoinedLength(0),
+		fJoinedCapacity(0),
+		fStream(NULL),
+		fReader(NULL),
+		fWide(NULL),
+		fStreamOffset(0)
+{
+	text->GetSize(&fSize) ;
+}
+
+
+ContentTokenStream::~ContentTokenStream()
+{
+	close() ;
+}
+
+
+bool
+ContentTokenStream::next(Token *token)
+{
+	while (true) {
+		if (fStream != NULL) {
+			if (fStream->next(token)) {
+				// Offsets are in characters from the start of the piece.
+				token->setStartOffset(token->startOffset() + fStreamOffset) ;
+				token->setEndOffset(token->endOffset() + fStreamOffset) ;
+				return true ;
+			}
+			EndComplexPiece() ;
+		}
+
+		const char *piece ;
+		size_t length ;
+		if (!NextPiece(&piece, &length))
+			return false ;
+
+		int32 result = NextSimpleWord(piece, length, token) ;
+		if (result > 0)
+			return true ;
+		if (result < 0)
+			StartComplexPiece(piece, length) ;
+	}
+}
+
+
+void
+ContentTokenStream::close()
+{
+	EndComplexPiece() ;
+	free(fJoined) ;
+	fJoined = NULL ;
+	fJoinedCapacity = 0 ;
+}
+
+
+// Makes fSpan the chunk fPosition is in, and returns where in it that is.
+size_t
+ContentTokenStream::LoadSpan()
+{
+	if (fPosition < fSpanStart
+		|| fPosition >= fSpanStart + (off_t)fSpanLength) {
+		fSpanLength = fText->GetSpan(fPosition, &fSpan) ;
+		fSpanStart = fPosition ;
+	}
+
+	return fPosition - fSpanStart ;
+}
+
+
+// The next run of bytes between white space, in its chunk if it is all
+// in one.
+bool
+ContentTokenStream::NextPiece(const char **piece, size_t *length)
+{
+	while (true) {
+		if (fPosition >= fSize)
+			return false ;
+
+		size_t offset = LoadSpan() ;
+		size_t spaces = span_classes(fSpan + offset, fSpanLength - offset,
+			CHAR_SPACE) ;
+		fPosition += spaces ;
+		if (offset + spaces < fSpanLength)
+			break ;
+	}
+
+	size_t offset = LoadSpan() ;
+	*piece = fSpan + offset ;
+	*length = span_other_classes(*piece, fSpanLength - offset, CHAR_SPACE) ;
+	fPieceStart = fPosition ;
+	fPosition += *length ;
+	if (offset + *length < fSpanLength || fPosition >= fSize)
+		return true ;
+
+	fJoinedLength = 0 ;
+	if (!Join(*piece, *length))
+		return false ;
+
+	while (fPosition < fSize) {
+		LoadSpan() ;
+		size_t more = span_other_classes(fSpan, fSpanLength, CHAR_SPACE) ;
+		if (!Join(fSpan, more))
+			return false ;
+		fPosition += more ;
+		if (more < fSpanLength)
+			break ;
+	}
+
+	*piece = fJoined ;
+	*length = fJoinedLength ;
+	return true ;
+}
+
+
+bool
+ContentTokenStream::Join(const char *data, size_t length)
+{
+	if (fJoinedLength + length > fJoinedCapacity) {
+		size_t capacity = fJoinedCapacity > 0 ? fJoinedCapacity * 2 : 256 ;
+		while (capacity < fJoinedLength + length)
+			capacity *= 2 ;
+		char *joined = (char*)realloc(fJoined, capacity) ;
+		if (joined == NULL)
+			return false ;
+
+		fJoined = joined ;
+		fJoinedCapacity = capacity ;
+	}
+
+	memcpy(fJoined + fJoinedLength, data, length) ;
+	fJoinedLength += length ;
+	return true ;
+}
+
+
+// A piece is simple when it is an ASCII letter followed by letters and
+// digits, with only punctuation that can't be part of a token before it,
+// and only that or . , ' after it. Returns 1 and sets token for a simple
+// word, 0 for a simple stop word, and -1 for anything else.
+int32
+ContentTokenStream::NextSimpleWord(const char *piece, size_t length,
+	Token *token)
+{
+	size_t start = span_classes(piece, length, CHAR_PUNCTUATION) ;
+	if (start == length
+		|| (kCharClasses[(uint8)piece[start]] & CHAR_ALPHA) == 0)
+		return -1 ;
+
+	size_t wordLength = span_classes(piece + start, length - start,
+		CHAR_ALPHA | CHAR_DIGIT) ;
+	if (wordLength > kMaxSimpleWordLength)
+		return -1 ;
+
+	for (size_t i = start + wordLength ; i < length ; i++) {
+		char c = piece[i] ;
+		if ((kCharClasses[(uint8)c] & CHAR_PUNCTUATION) == 0
+			&& c != '.' && c != ',' && c != '\'')
+			return -1 ;
+	}
+
+	lowercase_ascii(piece + start, fLowercase, wordLength) ;
+	for (size_t i = 0 ; i < wordLength ; i++)
+		fWord[i] = (TCHAR)fLowercase[i] ;
+	fWord[wordLength] = 0 ;
+
+	if (fAnalyzer->IsStopWord(fWord, wordLength))
+		return 0 ;
+
+	// Simple pieces are all ASCII.
+	int32 offset = fPieceStart - fExtraBytes + start ;
+	token->set(fWord, offset, offset + wordLength, _T("<ALPHANUM>")) ;
+	return 1 ;
+}
+
+
+void
+ContentTokenStream::StartComplexPiece(const char *piece, size_t length)
+{
+	size_t characters ;
+	fWide = decode_utf8(piece, length, &characters) ;
+	fReader = new StringReader(fWide, -1, false) ;
+	fStream = fAnalyzer->FallbackAnalyzer()->tokenStream(_T("contents"),
+		fReader) ;
+	fStreamOffset = fPieceStart - fExtraBytes ;
+	fExtraBytes += length - characters ;
+}
+
+
+void
+ContentTokenStream::EndComplexPiece()
+{
+	if (fStream != NULL) {
+		fStream->close() ;
+		_CLDELETE(fStream) ;
+	}
+	_CLDELETE(fReader) ;
+	_CLDELETE_CARRAY(fWide) ;
+}
+
+
+ContentAnalyzer::ContentAnalyzer()
+	:	fText(NULL),
+		fMaxStopWordLength(0)
+{
+	for (int32 i = 0 ; StopAnalyzer::ENGLISH_STOP_WORDS[i] != NULL ; i++) {
+		size_t length = _tcslen(StopAnalyzer::ENGLISH_STOP_WORDS[i]) ;
+		if (length > fMaxStopWordLength)
+			fMaxStopWordLength = length ;
+	}
+}
+
+
+ContentAnalyzer::~ContentAnalyzer()
+{
+}
+
+
+bool
+ContentAnalyzer::SetText(StringPositionIO *text)
+{
+	if (!is_valid_text(text))
+		return false ;
+
+	fText = text ;
+	return true ;
+}
+
+
+void
+ContentAnalyzer::UnsetText()
+{
+	fText = NULL ;
+}
+
+
+TokenStream*
+ContentAnalyzer::tokenStream(const TCHAR *fieldName, Reader *reader)
+{
+	if (fText != NULL && _tcscmp(fieldName, _T("contents")) == 0)
+		return new ContentTokenStream(this, fText) ;
+
+	return fStandardAnalyzer.tokenStream(fieldName, reader) ;
+}
+
+
+bool
+ContentAnalyzer::IsStopWord(const TCHAR *word, size_t length) const
+{
+	if (length > fMaxStopWordLength)
+		return false ;
+
+	for (int32 i = 0 ; StopAnalyzer::ENGLISH_STOP_WORDS[i] != NULL ; i++) {
+		if (_tcscmp(StopAnalyzer::ENGLISH_STOP_WORDS[i], word) == 0)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+StandardAnalyzer*
+ContentAnalyzer::FallbackAnalyzer()
+{
+	return &fStandardAnalyzer ;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _CONTENT_ANALYZER_H_
+#define _CONTENT_ANALYZER_H_
+
+#include <CLucene.h>
+
+#include <SupportDefs.h>
+
+class StringPositionIO ;
+
+
+// Tokenizes the contents of a file straight from UTF-8, instead of
+// converting all of it to wide characters and going through
+// StandardAnalyzer one character at a time.
+//
+// The text is split at white space, which StandardTokenizer never puts
+// inside a token. Pieces that are just an ASCII word with some
+// punctuation around it, which is most of any text, are lowercased and
+// turned into tokens here. Anything else is handed to a StandardAnalyzer,
+// so the tokens come out exactly as they would have before.
+//
+// CLucene only passes analyzers a Reader of wide characters, so the text
+// is given to the analyzer beforehand with SetText(), and the "contents"
+// field is added with an empty value. Other fields, and "contents" when
+// there is no text set, go to the StandardAnalyzer as they are.
+//
+// The text is read a chunk at a time, where the translator put it. Only a
+// piece that goes on past the end of a chunk is copied, to put it
+// together.
+class ContentAnalyzer : public lucene::analysis::Analyzer {
+	public:
+		ContentAnalyzer() ;
+		virtual ~ContentAnalyzer() ;
+
+		// Fails if text isn't valid UTF-8 or has a NUL in it, which only
+		// CLucene's own Reader deals with the same way as before. text
+		// has to stay around, unchanged, until the document has been
+		// added.
+		bool SetText(StringPositionIO *text) ;
+		void UnsetText() ;
+
+		virtual lucene::analysis::TokenStream* tokenStream(
+			const TCHAR *fieldName, lucene::util::Reader *reader) ;
+
+		bool IsStopWord(const TCHAR *word, size_t length) const ;
+		lucene::analysis::standard::StandardAnalyzer* FallbackAnalyzer() ;
+
+	private:
+		lucene::analysis::standard::StandardAnalyzer	fStandardAnalyzer ;
+		StringPositionIO								*fText ;
+		size_t											fMaxStopWordLength ;
+} ;
+
+#endif /* _CONTENT_ANALYZER_H_ */
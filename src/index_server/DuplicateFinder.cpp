@@ -0,0 +1,332 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "DuplicateFinder.h"
+#include "../engine/Checksum.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Files that differ at all mostly differ here already.
+const size_t kHeadSize = 4096 ;
+const size_t kReadSize = 64 * 1024 ;
+// Files a copy is looked for among at once, each has to be open.
+const int32 kMaxCompared = 32 ;
+
+
+DuplicateFinder::DuplicateFinder()
+	: fPaths(NULL),
+	  fEntries(NULL),
+	  fCount(0),
+	  fCapacity(0),
+	  fCopies(0)
+{
+}
+
+
+DuplicateFinder::~DuplicateFinder()
+{
+	for (int32 i = 0 ; i < fCount ; i++)
+		free(fPaths[i]) ;
+	free(fPaths) ;
+	free(fEntries) ;
+}
+
+
+void
+DuplicateFinder::AddFile(const char *path)
+{
+	if (fCount == fCapacity) {
+		int32 capacity = fCapacity > 0 ? fCapacity * 2 : 64 ;
+		char **paths = (char**)realloc(fPaths, capacity * sizeof(char*)) ;
+		if (paths != NULL)
+			fPaths = paths ;
+		file_entry *entries = (file_entry*)realloc(fEntries,
+			capacity * sizeof(file_entry)) ;
+		if (entries != NULL)
+			fEntries = entries ;
+		if (paths == NULL || entries == NULL)
+			return ;
+		fCapacity = capacity ;
+	}
+
+	// Files that can't be looked at are never anybody's copy.
+	struct stat st ;
+	file_entry &entry = fEntries[fCount] ;
+	entry.size = stat(path, &st) == 0 && S_ISREG(st.st_mode)
+		? st.st_size : -1 ;
+	entry.headHash = 0 ;
+	entry.hash = 0 ;
+	entry.index = fCount ;
+	entry.original = -1 ;
+	entry.lastCopy = -1 ;
+	fPaths[fCount++] = strdup(path) ;
+}
+
+
+void
+DuplicateFinder::Find()
+{
+	file_entry **sorted = new file_entry*[fCount] ;
+	for (int32 i = 0 ; i < fCount ; i++)
+		sorted[i] = &fEntries[i] ;
+	qsort(sorted, fCount, sizeof(file_entry*), CompareSizes) ;
+
+	for (int32 start = 0 ; start < fCount ; ) {
+		int32 end = start + 1 ;
+		while (end < fCount && sorted[end]->size == sorted[start]->size)
+			end++ ;
+
+		if (end - start > 1 && sorted[start]->size >= 0)
+			FindInRun(sorted + start, end - start) ;
+		start = end ;
+	}
+
+	delete[] sorted ;
+}
+
+
+int32
+DuplicateFinder::OriginalOf(int32 index)
+{
+	return index >= 0 && index < fCount ? fEntries[index].original : -1 ;
+}
+
+
+int32
+DuplicateFinder::LastCopyOf(int32 index)
+{
+	return index >= 0 && index < fCount ? fEntries[index].lastCopy : -1 ;
+}
+
+
+int32
+DuplicateFinder::CountCopies()
+{
+	return fCopies ;
+}
+
+
+void
+DuplicateFinder::FindInRun(file_entry **run, int32 count)
+{
+	// Files of the same size, first told apart by their beginnings.
+	int32 hashed = 0 ;
+	for (int32 i = 0 ; i < count ; i++) {
+		if (HashFile(run[i], false) == B_OK)
+			run[hashed++] = run[i] ;
+	}
+	qsort(run, hashed, sizeof(file_entry*), CompareHeadHashes) ;
+
+	for (int32 start = 0 ; start < hashed ; ) {
+		int32 end = start + 1 ;
+		while (end < hashed && run[end]->headHash == run[start]->headHash)
+			end++ ;
+		if (end - start == 1) {
+			start = end ;
+			continue ;
+		}
+
+		// Then by all of them, if there is more than the beginning.
+		int32 same = 0 ;
+		for (int32 i = start ; i < end ; i++) {
+			if ((size_t)run[i]->size <= kHeadSize) {
+				run[i]->hash = run[i]->headHash ;
+				run[start + same++] = run[i] ;
+			} else if (HashFile(run[i], true) == B_OK)
+				run[start + same++] = run[i] ;
+		}
+		qsort(run + start, same, sizeof(file_entry*), CompareHashes) ;
+
+		int32 first = start ;
+		for (int32 i = start + 1 ; i <= start + same ; i++) {
+			if (i < start + same && run[i]->hash == run[first]->hash)
+				continue ;
+			if (i - first > 1)
+				FindCopies(run + first, i - first) ;
+			first = i ;
+		}
+
+		start = end ;
+	}
+}
+
+
+void
+DuplicateFinder::FindCopies(file_entry **group, int32 count)
+{
+	// Files with the same hash, in the order they were added. The first
+	// is the original of the others. A hash only says they are likely
+	// the same, the bytes have the last word: the original is read once,
+	// alongside all of them, and those that turn out different go on to
+	// find an original among themselves.
+	bool same[kMaxCompared] ;
+	while (count > 1) {
+		file_entry *original = group[0] ;
+		int32 different = 0 ;
+		for (int32 i = 1 ; i < count ; i += kMaxCompared) {
+			int32 compared = count - i < kMaxCompared ? count - i
+				: kMaxCompared ;
+			CompareContents(original, group + i, compared, same) ;
+
+			for (int32 j = 0 ; j < compared ; j++) {
+				file_entry *entry = group[i + j] ;
+				if (!same[j]) {
+					group[1 + different++] = entry ;
+					continue ;
+				}
+
+				entry->original = original->index ;
+				original->lastCopy = entry->index ;
+				fCopies++ ;
+			}
+		}
+
+		group++ ;
+		count = different ;
+	}
+}
+
+
+status_t
+DuplicateFinder::HashContents(const char *path, off_t size, bool whole,
+	uint64 *hash)
+{
+	int fd = open(path, O_RDONLY) ;
+	if (fd < 0)
+		return B_ENTRY_NOT_FOUND ;
+
+	size_t bufferSize = whole ? kReadSize : kHeadSize ;
+	uint8 *buffer = new uint8[bufferSize] ;
+	*hash = size ;
+	off_t total = 0 ;
+	ssize_t length ;
+	while ((length = read(fd, buffer, bufferSize)) > 0) {
+		*hash = hash64(buffer, length, *hash) ;
+		total += length ;
+		if (!whole)
+			break ;
+	}
+
+	delete[] buffer ;
+	close(fd) ;
+
+	// A file that changed size on the way can't be trusted either way.
+	if (length < 0 || (whole && total != size))
+		return B_IO_ERROR ;
+
+	return B_OK ;
+}
+
+
+status_t
+DuplicateFinder::HashFile(file_entry *entry, bool whole)
+{
+	uint64 hash ;
+	status_t status = HashContents(fPaths[entry->index], entry->size, whole,
+		&hash) ;
+	if (status != B_OK)
+		return status ;
+
+	if (whole)
+		entry->hash = hash ;
+	else
+		entry->headHash = hash ;
+	return B_OK ;
+}
+
+
+void
+DuplicateFinder::CompareContents(file_entry *original,
+	file_entry **candidates, int32 count, bool *same)
+{
+	int originalFd = open(fPaths[original->index], O_RDONLY) ;
+	int fds[kMaxCompared] ;
+	int32 left = 0 ;
+	for (int32 i = 0 ; i < count ; i++) {
+		fds[i] = originalFd >= 0
+			? open(fPaths[candidates[i]->index], O_RDONLY) : -1 ;
+		same[i] = fds[i] >= 0 ;
+		if (same[i])
+			left++ ;
+	}
+
+	uint8 *originalBuffer = new uint8[kReadSize] ;
+	uint8 *buffer = new uint8[kReadSize] ;
+	off_t total = 0 ;
+	while (left > 0) {
+		ssize_t length = read(originalFd, originalBuffer, kReadSize) ;
+		if (length <= 0) {
+			for (int32 i = 0 ; i < count ; i++) {
+				if (same[i]) {
+					same[i] = length == 0 && total == original->size
+						&& read(fds[i], buffer, 1) == 0 ;
+				}
+			}
+			break ;
+		}
+
+		// Regular files are read whole unless they end or fail.
+		for (int32 i = 0 ; i < count ; i++) {
+			if (!same[i])
+				continue ;
+
+			same[i] = read(fds[i], buffer, length) == length
+				&& memcmp(originalBuffer, buffer, length) == 0 ;
+			if (!same[i])
+				left-- ;
+		}
+		total += length ;
+	}
+
+	delete[] originalBuffer ;
+	delete[] buffer ;
+	if (originalFd >= 0)
+		close(originalFd) ;
+	for (int32 i = 0 ; i < count ; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]) ;
+	}
+}
+
+
+int
+DuplicateFinder::CompareSizes(const void *first, const void *second)
+{
+	const file_entry *a = *(const file_entry**)first ;
+	const file_entry *b = *(const file_entry**)second ;
+	if (a->size != b->size)
+		return a->size < b->size ? -1 : 1 ;
+	return a->index - b->index ;
+}
+
+
+int
+DuplicateFinder::CompareHeadHashes(const void *first, const void *second)
+{
+	const file_entry *a = *(const file_entry**)first ;
+	const file_entry *b = *(const file_entry**)second ;
+	if (a->headHash != b->headHash)
+		return a->headHash < b->headHash ? -1 : 1 ;
+	return a->index - b->index ;
+}
+
+
+int
+DuplicateFinder::CompareHashes(const void *first, const void *second)
+{
+	const file_entry *a = *(const file_entry**)first ;
+	const file_entry *b = *(const file_entry**)second ;
+	if (a->hash != b->hash)
+		return a->hash < b->hash ? -1 : 1 ;
+	return a->index - b->index ;
+}
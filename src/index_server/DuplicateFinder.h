@@ -0,0 +1,70 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _DUPLICATE_FINDER_H_
+#define _DUPLICATE_FINDER_H_
+
+#include <SupportDefs.h>
+
+
+// Finds the files of a batch that have the same contents as an earlier
+// one, so that they can share the text extracted from it. A file is only
+// read if another one has the same size, and then only its beginning
+// unless that is the same as well. Files whose hashes match are compared
+// byte for byte before one is taken for a copy. Copies of files from
+// earlier batches are found by the TextCache, which hashes the same way.
+class DuplicateFinder {
+	public:
+		DuplicateFinder() ;
+		~DuplicateFinder() ;
+
+		// Hashes the beginning of a file, or all of it, together with its
+		// size. Fails if the file isn't size bytes long after all.
+		static status_t HashContents(const char *path, off_t size,
+			bool whole, uint64 *hash) ;
+
+		// Files are numbered in the order they are added.
+		void AddFile(const char *path) ;
+		void Find() ;
+
+		// The first file with the same contents, or -1 if it is the first.
+		int32 OriginalOf(int32 index) ;
+		// The last file with the same contents as an original, or -1 if
+		// there are none.
+		int32 LastCopyOf(int32 index) ;
+		int32 CountCopies() ;
+
+	private:
+		struct file_entry {
+			off_t		size ;
+			uint64		headHash ;
+			uint64		hash ;
+			int32		index ;
+			int32		original ;
+			int32		lastCopy ;
+		} ;
+
+		static int CompareSizes(const void *first, const void *second) ;
+		static int CompareHeadHashes(const void *first,
+			const void *second) ;
+		static int CompareHashes(const void *first, const void *second) ;
+
+		status_t HashFile(file_entry *entry, bool whole) ;
+		void FindInRun(file_entry **run, int32 count) ;
+		void FindCopies(file_entry **group, int32 count) ;
+		void CompareContents(file_entry *original, file_entry **candidates,
+			int32 count, bool *same) ;
+
+		char			**fPaths ;
+		file_entry		*fEntries ;
+		int32			fCount ;
+		int32			fCapacity ;
+		int32			fCopies ;
+} ;
+
+#endif /* _DUPLICATE_FINDER_H_ */
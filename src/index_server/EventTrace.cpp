@@ -0,0 +1,205 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "EventTrace.h"
+
+#include <Entry.h>
+#include <NodeMonitor.h>
+#include <OS.h>
+#include <Path.h>
+#include <Query.h>
+
+#include <string.h>
+
+
+const size_t kRecorderBufferSize = 64 * 1024 ;
+
+
+static void
+write_number(FILE* file, uint64 value)
+{
+	uint8 bytes[10] ;
+	int32 length = 0 ;
+	while (value >= 0x80) {
+		bytes[length++] = (value & 0x7f) | 0x80 ;
+		value >>= 7 ;
+	}
+	bytes[length++] = value ;
+	fwrite(bytes, 1, length, file) ;
+}
+
+
+static bool
+read_number(FILE* file, uint64* value)
+{
+	*value = 0 ;
+	for (int32 shift = 0 ; shift < 64 ; shift += 7) {
+		int byte = getc(file) ;
+		if (byte == EOF)
+			return false ;
+
+		*value |= (uint64)(byte & 0x7f) << shift ;
+		if ((byte & 0x80) == 0)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+EventRecorder::EventRecorder()
+	: fFile(NULL),
+	  fLastTime(0)
+{
+}
+
+
+EventRecorder::~EventRecorder()
+{
+	Close() ;
+}
+
+
+status_t
+EventRecorder::Open(const char* path)
+{
+	Close() ;
+
+	fFile = fopen(path, "wb") ;
+	if (fFile == NULL)
+		return B_ERROR ;
+
+	// Storms come in thousands of events a second, they are only written
+	// out when the buffer fills up.
+	setvbuf(fFile, NULL, _IOFBF, kRecorderBufferSize) ;
+
+	bigtime_t startTime = real_time_clock_usecs() ;
+	fwrite(&kEventTraceMagic, sizeof(kEventTraceMagic), 1, fFile) ;
+	fwrite(&kEventTraceVersion, sizeof(kEventTraceVersion), 1, fFile) ;
+	fwrite(&startTime, sizeof(startTime), 1, fFile) ;
+	fLastTime = system_time() ;
+
+	return B_OK ;
+}
+
+
+void
+EventRecorder::Close()
+{
+	if (fFile == NULL)
+		return ;
+
+	fclose(fFile) ;
+	fFile = NULL ;
+}
+
+
+void
+EventRecorder::Record(const BMessage* message)
+{
+	if (fFile == NULL)
+		return ;
+
+	bigtime_t now = system_time() ;
+	int32 opcode ;
+	if (message->FindInt32("opcode", &opcode) != B_OK)
+		return ;
+
+	dev_t device ;
+	if (message->FindInt32("device", &device) != B_OK
+		&& message->FindInt32("new device", &device) != B_OK)
+		device = -1 ;
+
+	// The path is looked up now, removed entries only have their
+	// directory left. Without one the event is kept, to be skipped.
+	BPath path ;
+	off_t size = 0 ;
+	ino_t directory ;
+	const char *name ;
+	if (message->FindInt64("directory", &directory) == B_OK
+		&& message->FindString("name", &name) == B_OK) {
+		entry_ref ref(device, directory, name) ;
+		path.SetTo(&ref) ;
+		if (opcode == B_ENTRY_CREATED && BEntry(&ref).GetSize(&size) != B_OK)
+			size = 0 ;
+	}
+	const char *pathString = path.InitCheck() == B_OK ? path.Path() : "" ;
+	size_t pathLength = strlen(pathString) ;
+
+	putc(message->what == B_QUERY_UPDATE
+		? kEventTraceQueryUpdate : kEventTraceNodeMonitor, fFile) ;
+	write_number(fFile, now - fLastTime) ;
+	write_number(fFile, (uint32)opcode) ;
+	write_number(fFile, (uint32)device) ;
+	write_number(fFile, size) ;
+	write_number(fFile, pathLength) ;
+	fwrite(pathString, 1, pathLength, fFile) ;
+	fLastTime = now ;
+}
+
+
+EventReader::EventReader()
+	: fFile(NULL),
+	  fStartTime(0),
+	  fTime(0)
+{
+}
+
+
+EventReader::~EventReader()
+{
+	if (fFile != NULL)
+		fclose(fFile) ;
+}
+
+
+status_t
+EventReader::Open(const char* path)
+{
+	fFile = fopen(path, "rb") ;
+	if (fFile == NULL)
+		return B_ENTRY_NOT_FOUND ;
+
+	uint32 magic ;
+	uint8 version ;
+	if (fread(&magic, sizeof(magic), 1, fFile) != 1
+		|| fread(&version, sizeof(version), 1, fFile) != 1
+		|| fread(&fStartTime, sizeof(fStartTime), 1, fFile) != 1
+		|| magic != kEventTraceMagic || version != kEventTraceVersion)
+		return B_BAD_DATA ;
+
+	return B_OK ;
+}
+
+
+status_t
+EventReader::Next(recorded_event* event)
+{
+	int kind = getc(fFile) ;
+	if (kind == EOF)
+		return B_ENTRY_NOT_FOUND ;
+	if (kind != kEventTraceQueryUpdate && kind != kEventTraceNodeMonitor)
+		return B_BAD_DATA ;
+
+	uint64 delay, opcode, device, size, length ;
+	if (!read_number(fFile, &delay) || !read_number(fFile, &opcode)
+		|| !read_number(fFile, &device) || !read_number(fFile, &size)
+		|| !read_number(fFile, &length) || length >= B_PATH_NAME_LENGTH
+		|| fread(event->path, 1, length, fFile) != length)
+		return B_BAD_DATA ;
+
+	fTime += delay ;
+	event->time = fTime ;
+	event->what = kind == kEventTraceQueryUpdate
+		? B_QUERY_UPDATE : B_NODE_MONITOR ;
+	event->opcode = (int32)opcode ;
+	event->device = (dev_t)device ;
+	event->size = size ;
+	event->path[length] = '\0' ;
+	return B_OK ;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _EVENT_TRACE_H_
+#define _EVENT_TRACE_H_
+
+#include <Message.h>
+#include <StorageDefs.h>
+#include <SupportDefs.h>
+
+#include <stdio.h>
+
+
+// An event trace keeps the query updates and node monitor messages the
+// Feeder saw, so that eventreplay can feed them to index_server again.
+// Entries are kept by path rather than by node, which means nothing once
+// the volume is gone.
+//
+// The file starts with the magic, a uint8 version and the int64 time the
+// recording started, in microseconds since the epoch. Each event follows
+// as its kind, 'Q' for B_QUERY_UPDATE or 'N' for B_NODE_MONITOR, then
+// variable length unsigned numbers: microseconds since the last event, the
+// opcode, the device, the size of a created file, and the length of the
+// path, which comes last.
+const uint32 kEventTraceMagic = 'BEVT' ;
+const uint8 kEventTraceVersion = 1 ;
+
+const uint8 kEventTraceQueryUpdate = 'Q' ;
+const uint8 kEventTraceNodeMonitor = 'N' ;
+
+struct recorded_event {
+	bigtime_t	time ;
+	uint32		what ;
+	int32		opcode ;
+	dev_t		device ;
+	off_t		size ;
+	char		path[B_PATH_NAME_LENGTH] ;
+} ;
+
+
+class EventRecorder {
+	public:
+		EventRecorder() ;
+		~EventRecorder() ;
+
+		status_t Open(const char* path) ;
+		void Close() ;
+		bool IsOpen() const { return fFile != NULL ; }
+
+		// Does nothing unless open. Only the Feeder's thread calls it.
+		void Record(const BMessage* message) ;
+
+	private:
+		FILE				*fFile ;
+		bigtime_t			fLastTime ;
+} ;
+
+
+class EventReader {
+	public:
+		EventReader() ;
+		~EventReader() ;
+
+		status_t Open(const char* path) ;
+		// When the recording started, in microseconds since the epoch.
+		bigtime_t StartTime() const { return fStartTime ; }
+		// Event times are microseconds since the recording started.
+		// Returns B_ENTRY_NOT_FOUND at the end and B_BAD_DATA if the
+		// trace is damaged.
+		status_t Next(recorded_event* event) ;
+
+	private:
+		FILE				*fFile ;
+		bigtime_t			fStartTime ;
+		bigtime_t			fTime ;
+} ;
+
+#endif /* _EVENT_TRACE_H_ */
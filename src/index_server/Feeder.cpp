@@ -8,24 +8,34 @@
 
 #include "Feeder.h"
 #include "support.h"
+#include "../shared/Metrics.h"
+#include "../shared/Trace.h"
 
 #include <Directory.h>
 #include <FindDirectory.h>
+#include <Messenger.h>
 #include <NodeInfo.h>
 #include <NodeMonitor.h>
 #include <Path.h>
 #include <string.h>
 
 
+static MetricCounter sEvents("feeder_events", "events") ;
+
+
 Feeder::Feeder(BHandler *target)
 	: BLooper("feeder"),
 	  fMonitorRemovableDevices(false),
 	  fQueryList(1),
 	  fIndexQueue(10),
+	  fTracedRefs(1),
 	  fDeleteQueue(10),
 	  fExcludeList(1),
+	  fSavedExcludes(1),
 	  fVolumeList(1),
-	  fUpdateInterval(30 * 1000000)
+	  fUpdateInterval(30 * 1000000),
+	  fFlushDelay(500000),
+	  fFlushRunner(NULL)
 
 {
 	BMessage settings('sett') ;
@@ -45,11 +55,19 @@ Feeder::MessageReceived(BMessage *message)
 {
 	switch (message->what) {
 		case B_QUERY_UPDATE:
+			sEvents.Add() ;
+			fRecorder.Record(message) ;
 			HandleQueryUpdate(message) ;
 			break ;
 		case B_NODE_MONITOR :
+			fRecorder.Record(message) ;
 			HandleDeviceUpdate(message) ;
 			break ;
+		case BEACON_FLUSH:
+			delete fFlushRunner ;
+			fFlushRunner = NULL ;
+			BMessenger(fTarget).SendMessage(BEACON_UPDATE_INDEX) ;
+			break ;
 		default:
 			BLooper :: MessageReceived(message) ;
 	}
@@ -59,6 +77,7 @@ Feeder::MessageReceived(BMessage *message)
 bool
 Feeder::QuitRequested()
 {
+	fRecorder.Close() ;
 	return true ;
 }
 
@@ -75,6 +94,28 @@ Feeder::LoadSettings(BMessage *settings)
 	if (settings->FindInt64("update_interval", &updateInterval) == B_OK)
 		fUpdateInterval = updateInterval ;
 
+	bigtime_t flushDelay ;
+	if (settings->FindInt64("flush_delay", &flushDelay) == B_OK)
+		fFlushDelay = flushDelay ;
+
+	// Directories excluded with indexutil -E, by path.
+	const char *excludePath ;
+	entry_ref ref ;
+	for (int32 i = 0 ; settings->FindString("exclude", i, &excludePath)
+			== B_OK ; i++) {
+		if (get_ref_for_path(excludePath, &ref) == B_OK)
+			Exclude(&ref, true) ;
+	}
+
+	// For eventreplay, the file is started over every time.
+	const char *recordPath ;
+	if (settings->FindString("record_events", &recordPath) == B_OK) {
+		if (fRecorder.Open(recordPath) == B_OK)
+			logger->Always("Recording events to %s", recordPath) ;
+		else
+			logger->Error("Could not record events to %s", recordPath) ;
+	}
+
 }
 
 
@@ -88,6 +129,13 @@ Feeder::SaveSettings(BMessage *settings)
 	if(settings->ReplaceInt64("update_interval", fUpdateInterval) != B_OK)
 		settings->AddInt64("update_interval", fUpdateInterval) ;
 
+	if(settings->ReplaceInt64("flush_delay", fFlushDelay) != B_OK)
+		settings->AddInt64("flush_delay", fFlushDelay) ;
+
+	settings->RemoveName("exclude") ;
+	for (int32 i = 0 ; i < fSavedExcludes.CountItems() ; i++)
+		settings->AddString("exclude", (const char*)fSavedExcludes.ItemAt(i)) ;
+
 }
 
 
@@ -139,6 +187,8 @@ Feeder::AddEntry(entry_ref *ref)
 		&& !Excluded(ref)) {
 			ref_ptr = new entry_ref(*ref) ;
 			fIndexQueue.AddItem((entry_ref*)ref_ptr) ;
+			if (sample_trace())
+				fTracedRefs.AddItem(ref_ptr) ;
 	}
 }
 
@@ -170,8 +220,11 @@ Feeder::RemoveQuery(BVolume *volume)
 
 
 status_t
-Feeder::GetNextUpdate(entry_ref *ref)
+Feeder::GetNextUpdate(entry_ref *ref, bool *traced)
 {
+	bool wasTraced = fTracedRefs.RemoveItem(fIndexQueue.ItemAt(0)) ;
+	if (traced != NULL)
+		*traced = wasTraced ;
 	return GetNextRef(&fIndexQueue, ref) ;
 }
 
@@ -217,6 +270,48 @@ Feeder::GetVolumeList()
 }
 
 
+status_t
+Feeder::Exclude(const entry_ref *ref, bool forever)
+{
+	BEntry entry(ref) ;
+	if (!entry.IsDirectory())
+		return B_NOT_A_DIRECTORY ;
+
+	entry_ref *excludeRef = (entry_ref*)ref ;
+	if (!Excluded(excludeRef)) {
+		fExcludeList.AddItem(new entry_ref(*ref)) ;
+
+		// What is already queued from under it is dropped as well.
+		for (int32 i = fIndexQueue.CountItems() - 1 ; i >= 0 ; i--) {
+			entry_ref *queued = (entry_ref*)fIndexQueue.ItemAt(i) ;
+			if (Excluded(queued)) {
+				fIndexQueue.RemoveItem(i) ;
+				fTracedRefs.RemoveItem(queued) ;
+				delete queued ;
+			}
+		}
+	}
+
+	BPath path(ref) ;
+	if (forever && path.InitCheck() == B_OK) {
+		for (int32 i = 0 ; i < fSavedExcludes.CountItems() ; i++) {
+			if (strcmp((const char*)fSavedExcludes.ItemAt(i), path.Path()) == 0)
+				return B_OK ;
+		}
+		fSavedExcludes.AddItem(strdup(path.Path())) ;
+	}
+
+	return B_OK ;
+}
+
+
+BList*
+Feeder::GetExcludeList()
+{
+	return &fExcludeList ;
+}
+
+
 void
 Feeder::RetrieveStaticRefs(BQuery *query)
 {
@@ -235,6 +330,9 @@ Feeder::HandleQueryUpdate(BMessage *message)
 	const char *name ;
 
 	message->FindInt32("opcode", &opcode) ;
+	if (message->FindString("name", &name) != B_OK)
+		name = NULL ;
+	TraceSpan span("feeder_event", name, TRACE_SAMPLE) ;
 
 	switch (opcode) {
 		case B_ENTRY_CREATED :
@@ -254,6 +352,22 @@ Feeder::HandleQueryUpdate(BMessage *message)
 			fDeleteQueue.AddItem((entry_ref*)ref) ;
 			break ;
 	}
+
+	ScheduleFlush() ;
+}
+
+
+void
+Feeder::ScheduleFlush()
+{
+	// Changes are flushed shortly after they come in instead of waiting
+	// for the next update tick. Everything that arrives in the meantime
+	// goes in the same batch.
+	if (fFlushDelay <= 0 || fFlushRunner != NULL)
+		return ;
+
+	BMessage flush(BEACON_FLUSH) ;
+	fFlushRunner = new BMessageRunner(this, &flush, fFlushDelay, 1) ;
 }
 
 
@@ -297,6 +411,9 @@ Feeder::Excluded(entry_ref *ref)
 	BDirectory excludeDirectory ;
 	BPath path ;
 	for (int i = 0 ; (excludeRef = (entry_ref*)fExcludeList.ItemAt(i)) != NULL ; i++) {
+		if (*excludeRef == *ref)
+			return true ;
+
 		excludeDirectory.SetTo(excludeRef) ;
 		if (excludeDirectory.Contains(&entry))
 			return true ;
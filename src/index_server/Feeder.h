@@ -9,6 +9,8 @@
 #ifndef _FEEDER_H_
 #define _FEEDER_H_
 
+#include "EventTrace.h"
+
 #include <Locker.h>
 #include <Looper.h>
 #include <Message.h>
@@ -28,11 +30,22 @@ class Feeder : public BLooper {
 		// Feeder methods
 		void StartWatching() ;
 		void SaveSettings(BMessage *settings) ;
-		status_t GetNextUpdate(entry_ref *ref) ;
+		// traced tells whether indexing it is recorded, it was decided
+		// when it was queued.
+		status_t GetNextUpdate(entry_ref *ref, bool *traced = NULL) ;
 		status_t GetNextRemoval(entry_ref *ref) ;
 		BList* GetVolumeList() ;
+		// Nothing under the directory is queued any more, and with forever
+		// it stays that way after a restart.
+		status_t Exclude(const entry_ref *ref, bool forever) ;
+		BList* GetExcludeList() ;
+		// True for an excluded directory and everything under it.
+		bool Excluded(entry_ref *ref) ;
 
 	private :
+		// microbench times Excluded() and GetNextRef() on their own.
+		friend class FeederBench ;
+
 		// Feeder methods
 		void LoadSettings(BMessage *settings) ;
 		void AddQuery(BVolume *volume) ;
@@ -41,7 +54,7 @@ class Feeder : public BLooper {
 		void RetrieveStaticRefs(BQuery *query) ;
 		void HandleQueryUpdate(BMessage *message) ;
 		void HandleDeviceUpdate(BMessage *message) ;
-		bool Excluded(entry_ref *ref) ;
+		void ScheduleFlush() ;
 		status_t GetNextRef(BList *list, entry_ref *ref) ;
 
 		// Data members
@@ -49,12 +62,18 @@ class Feeder : public BLooper {
 		BVolumeRoster	fVolumeRoster ;
 		BList			fQueryList ;
 		BList			fIndexQueue ;
+		// Those in fIndexQueue that sample_trace() chose.
+		BList			fTracedRefs ;
 		BList			fDeleteQueue ;
 		BList			fExcludeList ;
+		BList			fSavedExcludes ;
 		BList 			fVolumeList ;
 		bigtime_t		fUpdateInterval ;
 		BMessageRunner	*fMessageRunner ;
+		bigtime_t		fFlushDelay ;
+		BMessageRunner	*fFlushRunner ;
 		BHandler		*fTarget ;
+		EventRecorder	fRecorder ;
 
 } ;
 
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _INDEX_BACKEND_H_
+#define _INDEX_BACKEND_H_
+
+#include <SupportDefs.h>
+
+#include <time.h>
+
+class StringPositionIO ;
+
+
+// A document as BeaconIndex hands it over: the text has already been
+// translated to UTF-8, into memory. Backends read it where it is, a chunk
+// at a time, and never change it.
+struct index_document {
+	const char			*path ;
+	StringPositionIO	*text ;
+	const char			*excerpt ;
+	// NULL if the file couldn't be looked at, in which case size and
+	// modified mean nothing either.
+	const char	*mimeType ;
+	off_t		size ;
+	time_t		modified ;
+} ;
+
+typedef void (*index_path_callback)(const char *path, void *cookie) ;
+typedef void (*index_document_callback)(const char *path, off_t size,
+	time_t modified, void *cookie) ;
+
+
+// Keeps the documents of one volume. BeaconIndex decides what goes in and
+// when, a backend only knows how to store it. Changes become visible to
+// searchapp as a whole, on Commit(). A damaged index is dealt with once,
+// by Recover(), before anything else is done with it.
+class IndexBackend {
+	public:
+		virtual ~IndexBackend() {}
+
+		virtual bool Exists() = 0 ;
+		// Sets aside what is damaged and hands over the paths of the
+		// documents that went with it, so that they can be indexed again.
+		// Returns B_BAD_DATA if it can't tell which those are.
+		virtual status_t Recover(index_path_callback callback,
+			void *cookie) = 0 ;
+		virtual status_t RemovePath(const char *path) = 0 ;
+		virtual status_t RemoveSubtree(const char *path) = 0 ;
+		virtual status_t AddDocument(const index_document *document) = 0 ;
+		// Everything under path becomes what the index bulkindex built in
+		// indexPath has, save for files modified at since or later, and
+		// is committed right away. BEACON_NOT_SUPPORTED if the backend
+		// can't take it.
+		virtual status_t ReplaceSubtree(const char *path,
+			const char *indexPath, time_t since) = 0 ;
+		virtual status_t Commit() = 0 ;
+		virtual void ForEachPath(index_path_callback callback,
+			void *cookie) = 0 ;
+		// Like ForEachPath(), with the size and modification time each
+		// document was indexed with.
+		virtual void ForEachDocument(index_document_callback callback,
+			void *cookie) = 0 ;
+} ;
+
+#endif /* _INDEX_BACKEND_H_ */
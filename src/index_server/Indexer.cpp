@@ -9,6 +9,8 @@
 #include "Indexer.h"
 #include "support.h"
 #include "Logger.h"
+#include "../shared/Metrics.h"
+#include "../shared/Trace.h"
 
 #include <Directory.h>
 #include <Entry.h>
@@ -20,8 +22,31 @@
 using namespace lucene::document ;
 
 
+// What a reindex thread works on. It has copies of everything, the
+// indexer goes on while it runs.
+struct reindex_job {
+	BMessage	*message ;
+	BList		indexes ;
+	BList		excludeList ;
+	entry_ref	ref ;
+	bool		all ;
+	reindex_control	control ;
+} ;
+
+
+static void
+delete_job(reindex_job *job)
+{
+	for (int i = 0 ; i < job->excludeList.CountItems() ; i++)
+		delete (entry_ref*)job->excludeList.ItemAt(i) ;
+	delete job ;
+}
+
+
 Indexer::Indexer()
-	: BApplication(APP_SIGNATURE)
+	: BApplication(APP_SIGNATURE),
+	  fReindexThread(-1),
+	  fReindexCancel(0)
 {
 	logger->Always("Starting application.") ;
 	BMessage settings('sett') ;
@@ -62,6 +87,39 @@ Indexer::MessageReceived(BMessage *message)
 		case B_NODE_MONITOR:
 			HandleDeviceUpdate(message) ;
 			break ;
+		case B_QUERY_UPDATE:
+			// Replayed by eventreplay. The feeder takes them right away, so
+			// that the next BEACON_UPDATE_INDEX picks them up.
+			if (fQueryFeeder->Lock()) {
+				fQueryFeeder->MessageReceived(message) ;
+				fQueryFeeder->Unlock() ;
+			}
+			break ;
+		case BEACON_NAME_QUERY:
+			HandleNameQuery(message) ;
+			break ;
+		case BEACON_METRICS:
+		{
+			BMessage reply(B_REPLY) ;
+			archive_metrics(&reply) ;
+			message->SendReply(&reply) ;
+			break ;
+		}
+		case BEACON_TRACE:
+			HandleTrace(message) ;
+			break ;
+		case BEACON_SWAP_INDEX:
+			HandleSwapIndex(message) ;
+			break ;
+		case BEACON_REINDEX:
+			HandleReindex(message) ;
+			break ;
+		case BEACON_COMMIT:
+			HandleCommit(message) ;
+			break ;
+		case BEACON_EXCLUDE:
+			HandleExclude(message) ;
+			break ;
 		default :
 			BApplication::MessageReceived(message) ;
 	}
@@ -71,15 +129,18 @@ Indexer::MessageReceived(BMessage *message)
 bool
 Indexer::QuitRequested()
 {
+	// Start from the saved settings so that keys only read by the indexes
+	// survive a restart.
 	BMessage settings('sett') ;
+	load_settings(&settings) ;
 	fQueryFeeder->SaveSettings(&settings) ;
 	SaveSettings(&settings) ;
 	save_settings(&settings) ;
 	
 	fQueryFeeder->PostMessage(B_QUIT_REQUESTED) ;
+	WaitForReindex() ;
 
 	BeaconIndex *index ;
-	status_t exitValue ;
 	for (int i = 0 ; (index = (BeaconIndex*)fIndexList.ItemAt(i))
 		!= NULL ; i++)
 		index->Close() ;
@@ -98,23 +159,29 @@ Indexer::SaveSettings(BMessage *settings)
 void
 Indexer::LoadSettings(BMessage *settings)
 {
+	// Off unless asked for, indexutil -T can turn it on for a while.
+	int32 traceSampling ;
+	if (settings->FindInt32("trace_sample_every", &traceSampling) == B_OK)
+		set_trace_sampling(traceSampling) ;
 }
 
 
 void
-Indexer::UpdateIndex()
+Indexer::UpdateIndex(BeaconIndex *only)
 {
 	BeaconIndex *index = NULL ;
 	entry_ref* e_ref = new entry_ref ;
 	dev_t device = -1 ;
+	bool traced ;
+	TraceSpan span("update_index", NULL, TRACE_SAMPLE) ;
 	
 	// Get updates.
-	while(fQueryFeeder->GetNextUpdate(e_ref) == B_OK) {
+	while(fQueryFeeder->GetNextUpdate(e_ref, &traced) == B_OK) {
 		if(index == NULL || index->Device() != e_ref->device)
 			index = FindIndex(e_ref->device) ;
 
 		if(index != NULL) {
-			index->AddDocument(e_ref) ;
+			index->AddDocument(e_ref, traced) ;
 			e_ref = new entry_ref ;
 		}
 	}
@@ -134,9 +201,12 @@ Indexer::UpdateIndex()
 		}
 	}
 
-	// Call Commit() on all indexes.
-	for (int i = 0 ; (index = (BeaconIndex*)fIndexList.ItemAt(i)) ; i++)
-		index->Commit() ;
+	// Call Commit() on all indexes, the others keep their queues for the
+	// next update if only one is asked for.
+	for (int i = 0 ; (index = (BeaconIndex*)fIndexList.ItemAt(i)) ; i++) {
+		if (only == NULL || index == only)
+			index->Commit() ;
+	}
 }
 
 
@@ -163,12 +233,276 @@ Indexer::HandleDeviceUpdate(BMessage *message)
 			logger->Always("Device unmounted. Device ID %d", device) ;
 			index = FindIndex(device) ;
 			fIndexList.RemoveItem(index) ;
+			// A reindex may still be using it.
+			if (fReindexIndexes.HasItem(index))
+				WaitForReindex() ;
 			delete index ;
 			break ;
 	}
 }
 
 
+void
+Indexer::HandleNameQuery(BMessage *message)
+{
+	const char *pattern ;
+	int32 mode, limit ;
+	BMessage reply(B_REPLY) ;
+
+	if (message->FindString("pattern", &pattern) != B_OK) {
+		reply.AddInt32("error", B_BAD_VALUE) ;
+		message->SendReply(&reply) ;
+		return ;
+	}
+	if (message->FindInt32("mode", &mode) != B_OK)
+		mode = BEACON_MATCH_SUBSTRING ;
+	if (message->FindInt32("limit", &limit) != B_OK)
+		limit = 100 ;
+
+	BeaconIndex *index ;
+	int32 count = 0 ;
+	for (int i = 0 ; (index = (BeaconIndex*)fIndexList.ItemAt(i)) != NULL
+		&& count != limit ; i++)
+		count += index->FindNames(pattern, mode, &reply, limit - count) ;
+
+	message->SendReply(&reply) ;
+}
+
+
+void
+Indexer::HandleTrace(BMessage *message)
+{
+	BMessage reply(B_REPLY) ;
+	status_t status = B_OK ;
+
+	int32 sampleEvery ;
+	if (message->FindInt32("sample_every", &sampleEvery) == B_OK) {
+		set_trace_sampling(sampleEvery) ;
+		if (sampleEvery > 0)
+			logger->Always("Tracing one in %d sampled spans", sampleEvery) ;
+		else
+			logger->Always("Tracing off") ;
+	}
+
+	const char *path ;
+	if (message->FindString("path", &path) == B_OK
+		&& (status = write_trace(path)) != B_OK)
+		logger->Error("Could not write the trace to %s", path) ;
+
+	reply.AddInt32("error", status) ;
+	message->SendReply(&reply) ;
+}
+
+
+void
+Indexer::HandleSwapIndex(BMessage *message)
+{
+	BMessage reply(B_REPLY) ;
+	const char *path, *indexPath ;
+	int64 since ;
+	status_t status = B_BAD_VALUE ;
+
+	if (message->FindString("path", &path) == B_OK
+		&& message->FindString("index", &indexPath) == B_OK
+		&& message->FindInt64("since", &since) == B_OK) {
+		BeaconIndex *index = FindIndex(path) ;
+		status = index != NULL
+			? index->ReplaceSubtree(path, indexPath, since) : B_ENTRY_NOT_FOUND ;
+	}
+
+	reply.AddInt32("error", status) ;
+	message->SendReply(&reply) ;
+}
+
+
+void
+Indexer::HandleReindex(BMessage *message)
+{
+	BMessage reply(B_REPLY) ;
+	status_t status = B_OK ;
+
+	// One at a time, a second one would only redo what the first does.
+	thread_info info ;
+	if (fReindexThread >= 0
+		&& get_thread_info(fReindexThread, &info) == B_OK) {
+		reply.AddInt32("error", B_BUSY) ;
+		message->SendReply(&reply) ;
+		return ;
+	}
+
+	// Without a path, or with indexutil -rall, every volume is gone over.
+	const char *path ;
+	BeaconIndex *index ;
+	reindex_job *job = new reindex_job ;
+	job->message = NULL ;
+	job->all = message->FindString("volume", &path) != B_OK
+		|| strcmp(path, "all") == 0 ;
+	if (job->all)
+		job->indexes.AddList(&fIndexList) ;
+	else if ((status = get_ref_for_path(path, &job->ref)) == B_OK) {
+		if ((index = FindIndex(job->ref.device)) != NULL)
+			job->indexes.AddItem(index) ;
+		else
+			status = B_ENTRY_NOT_FOUND ;
+	}
+
+	// Changes the feeder has waiting go in first. The crawl works from a
+	// copy of the excluded directories, the feeder can't wait for it.
+	if (status == B_OK)
+		UpdateIndex() ;
+	if (status == B_OK && fQueryFeeder->Lock()) {
+		if (!job->all && fQueryFeeder->Excluded(&job->ref))
+			status = BEACON_FILE_EXCLUDED ;
+
+		BList *feederList = fQueryFeeder->GetExcludeList() ;
+		for (int i = 0 ; i < feederList->CountItems() ; i++) {
+			entry_ref *excluded = (entry_ref*)feederList->ItemAt(i) ;
+			job->excludeList.AddItem(new entry_ref(*excluded)) ;
+		}
+		fQueryFeeder->Unlock() ;
+	}
+
+	// The crawl gets a thread of its own, so that updates and name
+	// queries go on meanwhile. It reports its progress to whoever asked,
+	// and replies once it is done.
+	if (status == B_OK) {
+		job->message = DetachCurrentMessage() ;
+		job->control.progress = job->message->ReturnAddress() ;
+		job->control.cancel = &fReindexCancel ;
+		fReindexCancel = 0 ;
+		fReindexIndexes.MakeEmpty() ;
+		fReindexIndexes.AddList(&job->indexes) ;
+		fReindexThread = spawn_thread(Reindex, "reindex", B_LOW_PRIORITY,
+			job) ;
+		if (fReindexThread < B_OK)
+			status = fReindexThread ;
+		else if ((status = resume_thread(fReindexThread)) == B_OK)
+			return ;
+		else
+			kill_thread(fReindexThread) ;
+		fReindexThread = -1 ;
+	}
+
+	reply.AddInt32("error", status) ;
+	message->SendReply(&reply) ;
+	delete job->message ;
+	delete_job(job) ;
+}
+
+
+int32
+Indexer::Reindex(void *data)
+{
+	reindex_job *job = (reindex_job*)data ;
+	BMessage reply(B_REPLY) ;
+	status_t status = B_OK ;
+	entry_ref ref = job->ref ;
+
+	BeaconIndex *index ;
+	for (int i = 0 ; status == B_OK
+		&& (index = (BeaconIndex*)job->indexes.ItemAt(i)) != NULL ; i++) {
+		BVolume volume(index->Device()) ;
+		BDirectory root ;
+		BEntry entry ;
+		if (job->all && (volume.GetRootDirectory(&root) != B_OK
+				|| root.GetEntry(&entry) != B_OK
+				|| entry.GetRef(&ref) != B_OK))
+			continue ;
+
+		status = index->Reindex(&ref, &job->excludeList, &reply,
+			&job->control) ;
+	}
+
+	reply.AddInt32("error", status) ;
+	job->message->SendReply(&reply) ;
+	delete job->message ;
+	delete_job(job) ;
+	return B_OK ;
+}
+
+
+void
+Indexer::WaitForReindex()
+{
+	// It stops at the next directory, rather than going through a whole
+	// volume first.
+	status_t exitValue ;
+	atomic_set(&fReindexCancel, 1) ;
+	if (fReindexThread >= 0)
+		wait_for_thread(fReindexThread, &exitValue) ;
+	fReindexThread = -1 ;
+	fReindexIndexes.MakeEmpty() ;
+}
+
+
+void
+Indexer::HandleCommit(BMessage *message)
+{
+	BMessage reply(B_REPLY) ;
+	status_t status = B_OK ;
+	BeaconIndex *index = NULL ;
+
+	const char *path ;
+	if (message->FindString("volume", &path) == B_OK
+		&& strcmp(path, "all") != 0
+		&& (index = FindIndex(path)) == NULL)
+		status = B_ENTRY_NOT_FOUND ;
+
+	if (status == B_OK) {
+		bigtime_t start = system_time() ;
+		UpdateIndex(index) ;
+		reply.AddInt64("elapsed", system_time() - start) ;
+	}
+
+	reply.AddInt32("error", status) ;
+	message->SendReply(&reply) ;
+}
+
+
+void
+Indexer::HandleExclude(BMessage *message)
+{
+	BMessage reply(B_REPLY) ;
+	const char *path ;
+	bool forever ;
+	entry_ref ref ;
+	BeaconIndex *index = NULL ;
+
+	status_t status = message->FindString("volume", &path) ;
+	if (status == B_OK)
+		status = get_ref_for_path(path, &ref) ;
+	if (status == B_OK && (index = FindIndex(ref.device)) == NULL)
+		status = B_ENTRY_NOT_FOUND ;
+	if (message->FindBool("forever", &forever) != B_OK)
+		forever = false ;
+
+	if (status == B_OK && fQueryFeeder->Lock()) {
+		status = fQueryFeeder->Exclude(&ref, forever) ;
+		fQueryFeeder->Unlock() ;
+	}
+
+	// What was indexed under it goes away with the next commit, which
+	// is now.
+	if (status == B_OK) {
+		index->RemoveDocument(&ref) ;
+		UpdateIndex(index) ;
+		logger->Always("Excluded %s%s", path,
+			forever ? "" : " until the next restart") ;
+
+		if (forever && fQueryFeeder->Lock()) {
+			BMessage settings('sett') ;
+			load_settings(&settings) ;
+			fQueryFeeder->SaveSettings(&settings) ;
+			fQueryFeeder->Unlock() ;
+			save_settings(&settings) ;
+		}
+	}
+
+	reply.AddInt32("error", status) ;
+	message->SendReply(&reply) ;
+}
+
+
 BeaconIndex*
 Indexer::FindIndex(dev_t device)
 {
@@ -183,6 +517,11 @@ Indexer::FindIndex(dev_t device)
 
 
 BeaconIndex*
-Indexer::FindIndex(char* path)
+Indexer::FindIndex(const char* path)
 {
+	entry_ref ref ;
+	if (get_ref_for_path(path, &ref) != B_OK)
+		return NULL ;
+
+	return FindIndex(ref.device) ;
 }
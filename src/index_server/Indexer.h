@@ -31,13 +31,25 @@ class Indexer : public BApplication {
 	private :
 		void SaveSettings(BMessage *message) ;
 		void LoadSettings(BMessage *message) ;
-		void UpdateIndex() ;
+		void UpdateIndex(BeaconIndex *only = NULL) ;
 		void HandleDeviceUpdate(BMessage *message) ;
+		void HandleNameQuery(BMessage *message) ;
+		void HandleTrace(BMessage *message) ;
+		void HandleSwapIndex(BMessage *message) ;
+		void HandleReindex(BMessage *message) ;
+		void HandleCommit(BMessage *message) ;
+		void HandleExclude(BMessage *message) ;
+		static int32 Reindex(void *data) ;
+		void WaitForReindex() ;
 		BeaconIndex* FindIndex(dev_t device) ;
-		BeaconIndex* FindIndex(char* path) ;
+		BeaconIndex* FindIndex(const char* path) ;
 
 		Feeder 				*fQueryFeeder ;
 		BList				fIndexList ;
+		thread_id			fReindexThread ;
+		// Those the reindex works on, and set to stop it.
+		BList				fReindexIndexes ;
+		int32				fReindexCancel ;
 } ;
 
 #endif /* _INDEXER_H_ */
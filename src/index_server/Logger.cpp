@@ -7,29 +7,124 @@
  */
 
 #include "Logger.h"
+#include "BinaryLog.h"
 
 #include <ctime>
+#include <string.h>
 
 
-Logger::Logger(const char* path, DebugLevel level, bool replace)
+// A power of two. Commit can log a line per file, so the buffer holds a
+// few hundred lines before the flusher has to catch up.
+const int32 kRecordCount = 1024 ;
+const int32 kRecordTextSize = 500 ;
+const size_t kBatchSize = 64 * 1024 ;
+const bigtime_t kFlushInterval = 100000 ;
+const uint32 kInitialFormatCapacity = 64 ;
+
+
+// A slot is free for the producer whose position matches its sequence,
+// and full for the consumer once the sequence is one past that. This is
+// Dmitry Vyukov's bounded queue, with Haiku's atomic functions.
+struct log_record {
+	int32		sequence ;
+	int32		length ;
+	bigtime_t	time ;
+	// Binary records keep the arguments in text, and need the format
+	// and the class written out separately.
+	const char	*format ;
+	int32		logClass ;
+	char		text[kRecordTextSize] ;
+} ;
+
+
+struct log_format {
+	const char	*format ;
+	uint32		id ;
+} ;
+
+
+// Positions wrap around, only their differences matter.
+static inline int32
+position_difference(int32 first, int32 second)
+{
+	return (int32)((uint32)first - (uint32)second) ;
+}
+
+
+static inline int32
+next_position(int32 position, int32 count)
+{
+	return (int32)((uint32)position + (uint32)count) ;
+}
+
+
+Logger::Logger(const char* path, DebugLevel level, bool replace,
+	bool binary)
 	: fStatus(B_NO_INIT),
-	  fDebugLevel(level)
+	  fDebugLevel(level),
+	  fBinary(binary),
+	  fPolicy(BEACON_LOG_DROP),
+	  fRecords(NULL),
+	  fEnqueuePosition(0),
+	  fDequeuePosition(0),
+	  fDropped(0),
+	  fLogFileLocker("log file"),
+	  fFlusher(-1),
+	  fFlushSem(-1),
+	  fQuitting(0),
+	  fBatch(NULL),
+	  fBatchLength(0),
+	  fCachedSecond(-1),
+	  fFormats(NULL),
+	  fFormatCount(0),
+	  fFormatCapacity(0)
 {
 	if(replace)
 		fLogFile = fopen(path, "w") ;
 	else
 		fLogFile = fopen(path, "a") ;
 	
-	if (fLogFile)
-		fStatus = B_OK ;
-	else
+	if (fLogFile == NULL) {
 		fStatus = B_ERROR ;
+		return ;
+	}
+
+	fRecords = new log_record[kRecordCount] ;
+	for (int32 i = 0 ; i < kRecordCount ; i++)
+		fRecords[i].sequence = i ;
+	fBatch = new char[kBatchSize] ;
+
+	if (fBinary) {
+		fFormatCapacity = kInitialFormatCapacity ;
+		fFormats = new log_format[fFormatCapacity] ;
+		memset(fFormats, 0, fFormatCapacity * sizeof(log_format)) ;
+
+		fwrite(&kBinaryLogMagic, sizeof(kBinaryLogMagic), 1, fLogFile) ;
+		fwrite(&kBinaryLogVersion, sizeof(kBinaryLogVersion), 1, fLogFile) ;
+	}
+
+	// Messages are timed with system_time(), which needs no syscall.
+	fBootTime = (bigtime_t)real_time_clock() * 1000000 - system_time() ;
+
+	// Without a flusher, each message is written out right away.
+	fFlushSem = create_sem(0, "log flush") ;
+	if (fFlushSem >= B_OK) {
+		fFlusher = spawn_thread(FlushLoop, "log flusher", B_LOW_PRIORITY,
+			this) ;
+		if (fFlusher >= B_OK && resume_thread(fFlusher) != B_OK)
+			fFlusher = -1 ;
+	}
+
+	fStatus = B_OK ;
 }
 
 
 Logger::~Logger()
 {
-	fclose(fLogFile) ;
+	Close() ;
+	delete[] fRecords ;
+	delete[] fBatch ;
+	delete[] fFormats ;
 }
 
 
@@ -43,7 +138,32 @@ Logger::InitCheck()
 void
 Logger::Close()
 {
+	if (fLogFile == NULL)
+		return ;
+
+	fStatus = B_NO_INIT ;
+	if (fFlusher >= B_OK) {
+		atomic_set(&fQuitting, 1) ;
+		release_sem(fFlushSem) ;
+		status_t result ;
+		wait_for_thread(fFlusher, &result) ;
+		fFlusher = -1 ;
+	}
+	if (fFlushSem >= B_OK) {
+		delete_sem(fFlushSem) ;
+		fFlushSem = -1 ;
+	}
+
+	Flush() ;
 	fclose(fLogFile) ;
+	fLogFile = NULL ;
+}
+
+
+void
+Logger::SetOverflowPolicy(LogOverflowPolicy policy)
+{
+	atomic_set(&fPolicy, policy) ;
 }
 
 
@@ -55,7 +175,8 @@ Logger::Always(const char* format, ...)
 
 	va_list args ;
 	va_start(args, format) ;
-	SimpleMesssage(format, args) ;
+	Enqueue(BEACON_LOG_PLAIN, format, args) ;
+	va_end(args) ;
 }
 
 
@@ -68,34 +189,35 @@ Logger::Debug(const char* format, ...)
 	if(fDebugLevel != BEACON_DEBUG_NORMAL) {
 		va_list args ;
 		va_start(args, format) ;
-		SimpleMesssage(format, args) ;
+		Enqueue(BEACON_LOG_PLAIN, format, args) ;
+		va_end(args) ;
 	}
 }
 
 
 void
-Logger::MessageClass(const char* msgclass, const char* format, va_list args)
+Logger::Error(const char* format, ...)
 {
 	if(fStatus != B_OK)
 		return ;
-
-	WriteTime() ;
-	fprintf(fLogFile, "%s: ", msgclass) ;
-	vfprintf(fLogFile, format, args) ;
-	fprintf(fLogFile, "\n") ;
-	fflush(fLogFile) ;
+	
+	va_list args ;
+	va_start(args, format) ;
+	Enqueue(BEACON_LOG_ERROR, format, args) ;
+	va_end(args) ;
 }
 
 
 void
-Logger::Error(const char* format, ...)
+Logger::Warning(const char* format, ...)
 {
 	if(fStatus != B_OK)
 		return ;
 	
 	va_list args ;
 	va_start(args, format) ;
-	MessageClass("ERROR", format, args) ;
+	Enqueue(BEACON_LOG_WARNING, format, args) ;
+	va_end(args) ;
 }
 
 
@@ -108,28 +230,241 @@ Logger::Verbose(const char* format, ...)
 	if(fDebugLevel == BEACON_DEBUG_VERBOSE) {
 		va_list args ;
 		va_start(args, format) ;
-		SimpleMesssage(format, args) ;
+		Enqueue(BEACON_LOG_PLAIN, format, args) ;
+		va_end(args) ;
 	}
 }
 
 
 void
-Logger::WriteTime()
+Logger::Enqueue(int32 logClass, const char* format, va_list args)
 {
-	time_t unixTime = real_time_clock() ;
-	struct tm *timeInfo = localtime(&unixTime) ;
+	// Claim a slot by moving the enqueue position past it.
+	int32 position = atomic_get(&fEnqueuePosition) ;
+	log_record *record ;
+	while (true) {
+		record = &fRecords[position & (kRecordCount - 1)] ;
+		int32 difference = position_difference(
+			atomic_get(&record->sequence), position) ;
+		if (difference == 0) {
+			int32 previous = atomic_test_and_set(&fEnqueuePosition,
+				next_position(position, 1), position) ;
+			if (previous == position)
+				break ;
+			position = previous ;
+		} else if (difference < 0) {
+			// Full, the flusher hasn't got to this slot since last time.
+			if (atomic_get(&fPolicy) == BEACON_LOG_DROP
+				|| fFlusher < B_OK) {
+				atomic_add(&fDropped, 1) ;
+				return ;
+			}
+			release_sem_etc(fFlushSem, 1, B_DO_NOT_RESCHEDULE) ;
+			snooze(1000) ;
+			position = atomic_get(&fEnqueuePosition) ;
+		} else
+			position = atomic_get(&fEnqueuePosition) ;
+	}
 
-	fprintf(fLogFile, "[%02d:%02d:%02d] ", timeInfo->tm_hour, timeInfo->tm_min,
-		timeInfo->tm_sec) ;
-	fflush(fLogFile) ;
+	record->time = system_time() ;
+	if (fBinary) {
+		record->format = format ;
+		record->logClass = logClass ;
+		record->length = encode_log_arguments(format, args, record->text,
+			kRecordTextSize) ;
+	} else {
+		int length = 0 ;
+		const char *name = log_class_name(logClass) ;
+		if (name != NULL)
+			length = snprintf(record->text, kRecordTextSize, "%s: ", name) ;
+		int written = vsnprintf(record->text + length,
+			kRecordTextSize - length, format, args) ;
+		if (written > 0)
+			length += written ;
+		record->length = length < kRecordTextSize
+			? length : kRecordTextSize - 1 ;
+	}
+
+	// Handing the slot to the flusher is the last thing done with it.
+	atomic_set(&record->sequence, next_position(position, 1)) ;
+
+	if (fFlusher < B_OK) {
+		fLogFileLocker.Lock() ;
+		Flush() ;
+		fLogFileLocker.Unlock() ;
+	} else if (position_difference(position,
+			atomic_get(&fDequeuePosition)) == kRecordCount / 2) {
+		// Half full, don't wait for the flusher's next round.
+		release_sem_etc(fFlushSem, 1, B_DO_NOT_RESCHEDULE) ;
+	}
+}
+
+
+void
+Logger::Flush()
+{
+	if (fLogFile == NULL)
+		return ;
+
+	int32 dropped = atomic_set(&fDropped, 0) ;
+	if (dropped > 0 && fBinary) {
+		bigtime_t time = fBootTime + system_time() ;
+		uint32 count = dropped ;
+		Append(&kBinaryLogDropped, sizeof(kBinaryLogDropped)) ;
+		Append(&time, sizeof(time)) ;
+		Append(&count, sizeof(count)) ;
+	} else if (dropped > 0) {
+		WriteTime(system_time()) ;
+		fBatchLength += snprintf(fBatch + fBatchLength,
+			kBatchSize - fBatchLength,
+			"%ld messages were dropped, the log couldn't keep up\n",
+			(long)dropped) ;
+	}
+
+	while (true) {
+		int32 position = fDequeuePosition ;
+		log_record *record = &fRecords[position & (kRecordCount - 1)] ;
+		if (atomic_get(&record->sequence) != next_position(position, 1))
+			break ;
+
+		if (fBatchLength + kRecordTextSize + kMaxLogFormatLength + 32
+				> kBatchSize)
+			WriteBatch() ;
+
+		WriteRecord(record) ;
+		atomic_set(&record->sequence, next_position(position, kRecordCount)) ;
+		atomic_set(&fDequeuePosition, next_position(position, 1)) ;
+	}
+
+	WriteBatch() ;
+}
+
+
+void
+Logger::WriteTime(bigtime_t time)
+{
+	// Lines come in bursts, most of them within the same second.
+	bigtime_t second = (fBootTime + time) / 1000000 ;
+	if (second != fCachedSecond) {
+		time_t unixTime = second ;
+		struct tm timeInfo ;
+		localtime_r(&unixTime, &timeInfo) ;
+		snprintf(fCachedTime, sizeof(fCachedTime), "[%02d:%02d:%02d] ",
+			timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec) ;
+		fCachedSecond = second ;
+	}
+
+	Append(fCachedTime, strlen(fCachedTime)) ;
 }
 
 
 void
-Logger::SimpleMesssage(const char* format, va_list args)
+Logger::WriteRecord(log_record* record)
 {
-	WriteTime() ;
-	vfprintf(fLogFile, format, args) ;
-	fprintf(fLogFile, "\n") ;
+	if (!fBinary) {
+		WriteTime(record->time) ;
+		Append(record->text, record->length) ;
+		Append("\n", 1) ;
+		return ;
+	}
+
+	bool isNew ;
+	uint32 id = FormatId(record->format, &isNew) ;
+	if (isNew) {
+		size_t length = strlen(record->format) ;
+		uint16 storedLength = length < kMaxLogFormatLength
+			? length : kMaxLogFormatLength ;
+		Append(&kBinaryLogFormat, sizeof(kBinaryLogFormat)) ;
+		Append(&id, sizeof(id)) ;
+		Append(&storedLength, sizeof(storedLength)) ;
+		Append(record->format, storedLength) ;
+	}
+
+	bigtime_t time = fBootTime + record->time ;
+	uint8 logClass = record->logClass ;
+	uint16 length = record->length ;
+	Append(&kBinaryLogMessage, sizeof(kBinaryLogMessage)) ;
+	Append(&id, sizeof(id)) ;
+	Append(&time, sizeof(time)) ;
+	Append(&logClass, sizeof(logClass)) ;
+	Append(&length, sizeof(length)) ;
+	Append(record->text, length) ;
+}
+
+
+void
+Logger::Append(const void* data, size_t length)
+{
+	memcpy(fBatch + fBatchLength, data, length) ;
+	fBatchLength += length ;
+}
+
+
+uint32
+Logger::FormatId(const char* format, bool* isNew)
+{
+	uint32 mask = fFormatCapacity - 1 ;
+	uint32 slot = ((size_t)format >> 3) * 2654435761UL & mask ;
+	while (fFormats[slot].format != NULL) {
+		if (fFormats[slot].format == format) {
+			*isNew = false ;
+			return fFormats[slot].id ;
+		}
+		slot = (slot + 1) & mask ;
+	}
+
+	*isNew = true ;
+	uint32 id = fFormatCount++ ;
+	fFormats[slot].format = format ;
+	fFormats[slot].id = id ;
+
+	// Keep the table at most half full.
+	if (fFormatCount * 2 > fFormatCapacity) {
+		log_format *formats = fFormats ;
+		uint32 capacity = fFormatCapacity ;
+		fFormatCapacity *= 2 ;
+		fFormats = new log_format[fFormatCapacity] ;
+		memset(fFormats, 0, fFormatCapacity * sizeof(log_format)) ;
+		mask = fFormatCapacity - 1 ;
+		for (uint32 i = 0 ; i < capacity ; i++) {
+			if (formats[i].format == NULL)
+				continue ;
+			slot = ((size_t)formats[i].format >> 3) * 2654435761UL & mask ;
+			while (fFormats[slot].format != NULL)
+				slot = (slot + 1) & mask ;
+			fFormats[slot] = formats[i] ;
+		}
+		delete[] formats ;
+	}
+
+	return id ;
+}
+
+
+void
+Logger::WriteBatch()
+{
+	if (fBatchLength == 0)
+		return ;
+
+	fwrite(fBatch, 1, fBatchLength, fLogFile) ;
 	fflush(fLogFile) ;
+	fBatchLength = 0 ;
+}
+
+
+int32
+Logger::FlushLoop(void* data)
+{
+	Logger *logger = (Logger*)data ;
+	while (atomic_get(&logger->fQuitting) == 0) {
+		acquire_sem_etc(logger->fFlushSem, 1, B_RELATIVE_TIMEOUT,
+			kFlushInterval) ;
+
+		logger->fLogFileLocker.Lock() ;
+		logger->Flush() ;
+		logger->fLogFileLocker.Unlock() ;
+	}
+
+	return B_OK ;
 }
@@ -13,6 +13,7 @@
 #include <SupportDefs.h>
 #include <OS.h>
 
+#include <stdarg.h>
 #include <stdio.h>
 
 
@@ -22,14 +23,37 @@ typedef enum _DebugLevel {
 	BEACON_DEBUG_VERBOSE
 } DebugLevel ;
 
+// What a message does when the log has fallen too far behind.
+typedef enum _LogOverflowPolicy {
+	BEACON_LOG_DROP,
+	BEACON_LOG_BLOCK
+} LogOverflowPolicy ;
+
+struct log_record ;
+struct log_format ;
+
+
+// Messages are formatted by the thread logging them into a ring buffer
+// that any number of threads can add to without locking, and written to
+// the file in batches by a thread of the logger's own. So logging costs
+// about one snprintf(), or less for a binary log, and lines from
+// different threads never mix.
 class Logger {
 	public:
+		// A binary log is written for logdecode to read, see BinaryLog.h.
 		Logger(const char* path, DebugLevel level = BEACON_DEBUG_NORMAL,
-			bool replace = true) ;
+			bool replace = true, bool binary = false) ;
 		~Logger() ;
 
 		status_t InitCheck() ;
+		// Writes out what is still in the buffer.
 		void Close() ;
+		// Dropping, the default, counts the messages that didn't fit and
+		// says so in the log. Blocking waits until there is room.
+		void SetOverflowPolicy(LogOverflowPolicy policy) ;
+		bool IsEnabled(DebugLevel level) const
+			{ return level <= fDebugLevel ; }
+
 		void Always(const char* format, ...) ;
 		void Debug(const char* format, ...) ;
 		void Verbose(const char* format, ...) ;
@@ -37,14 +61,74 @@ class Logger {
 		void Warning(const char* format, ...) ;
 
 	private:
-		void WriteTime() ;
-		void SimpleMesssage(const char* format, va_list args) ;
-		void MessageClass(const char* msgclass, const char* format, va_list args) ;
+		void Enqueue(int32 logClass, const char* format, va_list args) ;
+		void Flush() ;
+		void WriteTime(bigtime_t time) ;
+		void WriteRecord(log_record* record) ;
+		void WriteBatch() ;
+		void Append(const void* data, size_t length) ;
+		uint32 FormatId(const char* format, bool* isNew) ;
+		static int32 FlushLoop(void* data) ;
 		
 		FILE		*fLogFile ;
 		status_t	fStatus ;
 		DebugLevel	fDebugLevel ;
+		bool		fBinary ;
+		int32		fPolicy ;
+
+		log_record	*fRecords ;
+		int32		fEnqueuePosition ;
+		int32		fDequeuePosition ;
+		int32		fDropped ;
+
+		// Only taken by whoever empties the buffer, the flusher thread
+		// unless it couldn't be started.
 		BLocker		fLogFileLocker ;
+		thread_id	fFlusher ;
+		sem_id		fFlushSem ;
+		int32		fQuitting ;
+
+		char		*fBatch ;
+		size_t		fBatchLength ;
+		bigtime_t	fBootTime ;
+		bigtime_t	fCachedSecond ;
+		char		fCachedTime[16] ;
+
+		// The ids binary records use for the format strings seen so far,
+		// hashed by address.
+		log_format	*fFormats ;
+		uint32		fFormatCount ;
+		uint32		fFormatCapacity ;
 } ;
 
+
+// The level messages have to be at least as important as to be compiled
+// in at all, one of DebugLevel. What isn't compiled in costs nothing, not
+// even its arguments, and neither does what the logger is set to leave
+// out. Release builds set it to 1, so only debug builds can log verbose
+// messages.
+#ifndef BEACON_LOG_LEVEL
+#define BEACON_LOG_LEVEL 2
+#endif
+
+// A loop rather than an if, so that an else after the statement can't be
+// taken for ours.
+#if BEACON_LOG_LEVEL >= 1
+#define BEACON_LOG_DEBUG \
+	for (bool _logOn = logger->IsEnabled(BEACON_DEBUG) ; _logOn ; \
+		_logOn = false) logger->Debug
+#else
+#define BEACON_LOG_DEBUG \
+	for (bool _logOn = false ; _logOn ; _logOn = false) logger->Debug
+#endif
+
+#if BEACON_LOG_LEVEL >= 2
+#define BEACON_LOG_VERBOSE \
+	for (bool _logOn = logger->IsEnabled(BEACON_DEBUG_VERBOSE) ; _logOn ; \
+		_logOn = false) logger->Verbose
+#else
+#define BEACON_LOG_VERBOSE \
+	for (bool _logOn = false ; _logOn ; _logOn = false) logger->Verbose
+#endif
+
 #endif /* _LOGGER_H_ */
@@ -0,0 +1,866 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "NameIndex.h"
+#include "support.h"
+
+#include <Entry.h>
+#include <File.h>
+#include <String.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+
+const uint32 kNameIndexMagic = 'NIDX' ;
+const uint32 kNameIndexVersion = 1 ;
+
+const uint32 kNodeRemoved = 0x01 ;
+const uint32 kNodeFile = 0x02 ;
+
+// Small trees aren't worth compacting.
+const int32 kMinCompactNodes = 4096 ;
+
+
+static const char *sSortPool = NULL ;
+
+
+static int
+compare_names(const void *a, const void *b)
+{
+	return strcasecmp(sSortPool + *(const uint32*)a,
+		sSortPool + *(const uint32*)b) ;
+}
+
+
+static uint32
+hash_name(const char *name, int32 length)
+{
+	uint32 hash = 2166136261U ;
+	for (int32 i = 0 ; i < length ; i++) {
+		hash ^= (uint8)name[i] ;
+		hash *= 16777619U ;
+	}
+
+	return hash ;
+}
+
+
+static uint32
+hash_child(int32 parent, int32 name)
+{
+	uint32 hash = (uint32)parent * 0x9e3779b1U ;
+	hash ^= (uint32)name + 0x7f4a7c15U + (hash << 6) + (hash >> 2) ;
+	return hash ;
+}
+
+
+static bool
+contains_nocase(const char *name, const char *pattern)
+{
+	size_t length = strlen(pattern) ;
+	if (length == 0)
+		return true ;
+
+	for ( ; *name != '\0' ; name++) {
+		if (strncasecmp(name, pattern, length) == 0)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+static bool
+glob_match(const char *name, const char *pattern)
+{
+	const char *starName = NULL ;
+	const char *starPattern = NULL ;
+
+	while (*name != '\0') {
+		if (*pattern == '*') {
+			starPattern = ++pattern ;
+			starName = name ;
+			continue ;
+		}
+
+		bool matched = false ;
+		if (*pattern == '?')
+			matched = true ;
+		else if (*pattern == '[') {
+			const char *p = pattern + 1 ;
+			bool negate = (*p == '!' || *p == '^') ;
+			if (negate)
+				p++ ;
+
+			bool inSet = false ;
+			for ( ; *p != '\0' && *p != ']' ; p++) {
+				char c = tolower(*name) ;
+				if (p[1] == '-' && p[2] != '\0' && p[2] != ']') {
+					if (c >= tolower(p[0]) && c <= tolower(p[2]))
+						inSet = true ;
+					p += 2 ;
+				} else if (c == tolower(*p))
+					inSet = true ;
+			}
+
+			if (*p == ']') {
+				matched = (inSet != negate) ;
+				if (matched) {
+					pattern = p + 1 ;
+					name++ ;
+					continue ;
+				}
+			}
+		} else if (*pattern != '\0' && tolower(*pattern) == tolower(*name))
+			matched = true ;
+
+		if (matched) {
+			pattern++ ;
+			name++ ;
+		} else if (starPattern != NULL) {
+			pattern = starPattern ;
+			name = ++starName ;
+		} else
+			return false ;
+	}
+
+	while (*pattern == '*')
+		pattern++ ;
+
+	return *pattern == '\0' ;
+}
+
+
+NameIndex::NameIndex()
+	: fNodes(NULL),
+	  fNodeCount(0),
+	  fNodeCapacity(0),
+	  fNodeBuckets(NULL),
+	  fNodeBucketCount(0),
+	  fEntries(NULL),
+	  fEntryCount(0),
+	  fEntryCapacity(0),
+	  fEntryBuckets(NULL),
+	  fEntryBucketCount(0),
+	  fPool(NULL),
+	  fPoolLength(0),
+	  fPoolCapacity(0),
+	  fSorted(NULL),
+	  fSortedCount(0),
+	  fSortedValid(false),
+	  fCompactedCount(0),
+	  fRemovedCount(0),
+	  fDirty(false)
+{
+	MakeEmpty() ;
+}
+
+
+NameIndex::~NameIndex()
+{
+	free(fNodes) ;
+	free(fNodeBuckets) ;
+	free(fEntries) ;
+	free(fEntryBuckets) ;
+	free(fPool) ;
+	free(fSorted) ;
+}
+
+
+void
+NameIndex::MakeEmpty()
+{
+	fLocker.Lock() ;
+
+	fNodeCount = 0 ;
+	fEntryCount = 0 ;
+	fPoolLength = 0 ;
+	fSortedValid = false ;
+	RehashNodes(64) ;
+	RehashEntries(64) ;
+
+	// Node 0 is the root directory, its name is the empty string.
+	int32 root = InternName("", 0, true) ;
+	AddChild(-1, root) ;
+	fCompactedCount = fNodeCount ;
+	fRemovedCount = 0 ;
+	fDirty = false ;
+
+	fLocker.Unlock() ;
+}
+
+
+int32
+NameIndex::CountNames()
+{
+	return fNodeCount - 1 ;
+}
+
+
+bool
+NameIndex::IsDirty()
+{
+	return fDirty ;
+}
+
+
+status_t
+NameIndex::AddPath(const char* path)
+{
+	if (path == NULL)
+		return B_BAD_VALUE ;
+
+	fLocker.Lock() ;
+	if (fRemovedCount > 0 && fNodeCount >= kMinCompactNodes
+		&& fNodeCount >= 2 * fCompactedCount)
+		Compact() ;
+
+	int32 node = Lookup(path, true) ;
+	if (node > 0) {
+		fNodes[node].flags |= kNodeFile ;
+		fDirty = true ;
+	}
+	fLocker.Unlock() ;
+
+	return node < 0 ? B_NO_MEMORY : B_OK ;
+}
+
+
+status_t
+NameIndex::RemovePath(const char* path)
+{
+	if (path == NULL)
+		return B_BAD_VALUE ;
+
+	fLocker.Lock() ;
+	int32 node = Lookup(path, false) ;
+	if (node > 0) {
+		// Children of a removed directory stay in the tree but are
+		// hidden by IsVisible() and dropped the next time we are written.
+		fNodes[node].flags |= kNodeRemoved ;
+		fRemovedCount++ ;
+		fDirty = true ;
+	}
+	fLocker.Unlock() ;
+
+	return node > 0 ? B_OK : B_ENTRY_NOT_FOUND ;
+}
+
+
+int32
+NameIndex::Find(const char* pattern, int32 mode, BMessage* reply,
+	int32 limit)
+{
+	if (pattern == NULL || reply == NULL)
+		return 0 ;
+
+	fLocker.Lock() ;
+
+	if (!fSortedValid)
+		SortNames() ;
+
+	// Prefix and glob lookups only need to look at the run of sorted names
+	// starting with the literal part of the pattern.
+	size_t prefixLength = 0 ;
+	if (mode == BEACON_MATCH_PREFIX)
+		prefixLength = strlen(pattern) ;
+	else if (mode == BEACON_MATCH_GLOB)
+		prefixLength = strcspn(pattern, "*?[") ;
+
+	int32 first = 0 ;
+	if (prefixLength > 0) {
+		int32 low = 0, high = fSortedCount ;
+		while (low < high) {
+			int32 middle = (low + high) / 2 ;
+			const char *name = NameAt(fNodes[fSorted[middle]].name) ;
+			if (strncasecmp(name, pattern, prefixLength) < 0)
+				low = middle + 1 ;
+			else
+				high = middle ;
+		}
+		first = low ;
+	}
+
+	char path[B_PATH_NAME_LENGTH] ;
+	int32 count = 0 ;
+	int32 lastName = -1 ;
+	bool lastMatched = false ;
+
+	for (int32 i = first ; i < fSortedCount ; i++) {
+		int32 node = fSorted[i] ;
+		int32 name = fNodes[node].name ;
+		const char *nodeName = NameAt(name) ;
+
+		if (prefixLength > 0
+			&& strncasecmp(nodeName, pattern, prefixLength) != 0)
+			break ;
+
+		// Equal names are adjacent, so each distinct name is matched once.
+		if (name != lastName) {
+			lastName = name ;
+			lastMatched = Matches(nodeName, pattern, mode) ;
+		}
+
+		if (!lastMatched || !IsVisible(node)
+			|| !BuildPath(node, path, sizeof(path)))
+			continue ;
+
+		reply->AddString("path", path) ;
+		if (++count == limit)
+			break ;
+	}
+
+	fLocker.Unlock() ;
+	return count ;
+}
+
+
+status_t
+NameIndex::ReadFrom(const char* path)
+{
+	BFile file(path, B_READ_ONLY) ;
+	status_t err ;
+	if ((err = file.InitCheck()) != B_OK)
+		return err ;
+
+	uint32 header[5] ;
+	if (file.Read(header, sizeof(header)) != sizeof(header)
+		|| header[0] != kNameIndexMagic || header[1] != kNameIndexVersion)
+		return B_BAD_DATA ;
+
+	int32 nodeCount = header[2] ;
+	int32 entryCount = header[3] ;
+	uint32 poolLength = header[4] ;
+
+	fLocker.Lock() ;
+
+	fNodeCount = fEntryCount = 0 ;
+	fPoolLength = 0 ;
+	fSortedValid = false ;
+
+	err = B_NO_MEMORY ;
+	while (fNodeCapacity < nodeCount)
+		if (GrowNodes() != B_OK)
+			goto out ;
+	while (fEntryCapacity < entryCount)
+		if (GrowEntries() != B_OK)
+			goto out ;
+	if (GrowPool(poolLength) != B_OK)
+		goto out ;
+
+	err = B_BAD_DATA ;
+	for (int32 i = 0 ; i < nodeCount ; i++) {
+		int32 node[3] ;
+		if (file.Read(node, sizeof(node)) != sizeof(node))
+			goto out ;
+		fNodes[i].parent = node[0] ;
+		fNodes[i].name = node[1] ;
+		fNodes[i].flags = node[2] ;
+		fNodes[i].generation = 0 ;
+		fNodes[i].parentGeneration = 0 ;
+	}
+
+	for (int32 i = 0 ; i < entryCount ; i++) {
+		uint32 entry[2] ;
+		if (file.Read(entry, sizeof(entry)) != sizeof(entry))
+			goto out ;
+		fEntries[i].offset = entry[0] ;
+		fEntries[i].length = entry[1] ;
+	}
+
+	if (file.Read(fPool, poolLength) != (ssize_t)poolLength)
+		goto out ;
+
+	fNodeCount = nodeCount ;
+	fEntryCount = entryCount ;
+	fPoolLength = poolLength ;
+	RehashNodes(fNodeBucketCount) ;
+	RehashEntries(fEntryBucketCount) ;
+	fCompactedCount = fNodeCount ;
+	fRemovedCount = 0 ;
+	fDirty = false ;
+	err = B_OK ;
+
+out:
+	fLocker.Unlock() ;
+	if (err != B_OK)
+		MakeEmpty() ;
+
+	return err ;
+}
+
+
+status_t
+NameIndex::WriteTo(const char* path)
+{
+	// Written next to the old one and moved over it once complete, so a
+	// crash or a full disk leaves the old names rather than half of them.
+	BString tempPath(path) ;
+	tempPath << ".tmp" ;
+	BFile file(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE
+		| B_ERASE_FILE) ;
+	status_t err ;
+	if ((err = file.InitCheck()) != B_OK)
+		return err ;
+
+	fLocker.Lock() ;
+
+	// Only what is alive is written, and nodes come out numbered the way
+	// they are read back in.
+	Compact() ;
+
+	err = B_IO_ERROR ;
+	uint32 header[5] = { kNameIndexMagic, kNameIndexVersion,
+		(uint32)fNodeCount, (uint32)fEntryCount, fPoolLength } ;
+	if (file.Write(header, sizeof(header)) != sizeof(header))
+		goto out ;
+
+	for (int32 i = 0 ; i < fNodeCount ; i++) {
+		int32 node[3] = { fNodes[i].parent, fNodes[i].name,
+			(int32)fNodes[i].flags } ;
+		if (file.Write(node, sizeof(node)) != sizeof(node))
+			goto out ;
+	}
+
+	for (int32 i = 0 ; i < fEntryCount ; i++) {
+		uint32 entry[2] = { fEntries[i].offset, fEntries[i].length } ;
+		if (file.Write(entry, sizeof(entry)) != sizeof(entry))
+			goto out ;
+	}
+
+	if (file.Write(fPool, fPoolLength) != (ssize_t)fPoolLength
+		|| file.Sync() != B_OK)
+		goto out ;
+
+	file.Unset() ;
+	if (BEntry(tempPath.String()).Rename(path, true) == B_OK) {
+		fDirty = false ;
+		err = B_OK ;
+	}
+
+out:
+	fLocker.Unlock() ;
+	if (err != B_OK)
+		unlink(tempPath.String()) ;
+
+	return err ;
+}
+
+
+int32
+NameIndex::Lookup(const char* path, bool create)
+{
+	int32 node = 0 ;
+	const char *component = path ;
+
+	while (*component != '\0') {
+		while (*component == '/')
+			component++ ;
+		if (*component == '\0')
+			break ;
+
+		int32 length = strcspn(component, "/") ;
+		int32 name = InternName(component, length, create) ;
+		if (name < 0)
+			return -1 ;
+
+		int32 child = FindChild(node, name) ;
+		if (child < 0) {
+			if (!create || (child = AddChild(node, name)) < 0)
+				return -1 ;
+		} else if (create && !IsLive(child))
+			Revive(child) ;
+
+		node = child ;
+		component += length ;
+	}
+
+	return node ;
+}
+
+
+int32
+NameIndex::FindChild(int32 parent, int32 name)
+{
+	uint32 bucket = hash_child(parent, name) & (fNodeBucketCount - 1) ;
+	for (int32 node = fNodeBuckets[bucket] ; node >= 0 ;
+		node = fNodes[node].next) {
+		if (fNodes[node].parent == parent && fNodes[node].name == name)
+			return node ;
+	}
+
+	return -1 ;
+}
+
+
+int32
+NameIndex::AddChild(int32 parent, int32 name)
+{
+	if (fNodeCount == fNodeCapacity && GrowNodes() != B_OK)
+		return -1 ;
+
+	if (fNodeCount >= fNodeBucketCount)
+		RehashNodes(fNodeBucketCount * 2) ;
+
+	int32 node = fNodeCount++ ;
+	fNodes[node].parent = parent ;
+	fNodes[node].name = name ;
+	fNodes[node].flags = 0 ;
+	fNodes[node].generation = 0 ;
+	fNodes[node].parentGeneration = parent >= 0
+		? fNodes[parent].generation : 0 ;
+
+	uint32 bucket = hash_child(parent, name) & (fNodeBucketCount - 1) ;
+	fNodes[node].next = fNodeBuckets[bucket] ;
+	fNodeBuckets[bucket] = node ;
+
+	fSortedValid = false ;
+	return node ;
+}
+
+
+int32
+NameIndex::InternName(const char* name, int32 length, bool create)
+{
+	uint32 hash = hash_name(name, length) ;
+	uint32 bucket = hash & (fEntryBucketCount - 1) ;
+	for (int32 entry = fEntryBuckets[bucket] ; entry >= 0 ;
+		entry = fEntries[entry].next) {
+		if (fEntries[entry].length == (uint32)length
+			&& memcmp(fPool + fEntries[entry].offset, name, length) == 0)
+			return entry ;
+	}
+
+	if (!create)
+		return -1 ;
+
+	if ((fEntryCount == fEntryCapacity && GrowEntries() != B_OK)
+		|| GrowPool(fPoolLength + length + 1) != B_OK)
+		return -1 ;
+
+	if (fEntryCount >= fEntryBucketCount) {
+		RehashEntries(fEntryBucketCount * 2) ;
+		bucket = hash & (fEntryBucketCount - 1) ;
+	}
+
+	int32 entry = fEntryCount++ ;
+	fEntries[entry].offset = fPoolLength ;
+	fEntries[entry].length = length ;
+	fEntries[entry].next = fEntryBuckets[bucket] ;
+	fEntryBuckets[bucket] = entry ;
+
+	memcpy(fPool + fPoolLength, name, length) ;
+	fPool[fPoolLength + length] = '\0' ;
+	fPoolLength += length + 1 ;
+
+	return entry ;
+}
+
+
+void
+NameIndex::Revive(int32 node)
+{
+	// Whatever lived below the node before it was removed is gone. A new
+	// generation hides all of it at once, the children come back one by
+	// one as they are added again.
+	name_node *revived = &fNodes[node] ;
+	revived->flags &= ~kNodeRemoved ;
+	revived->generation++ ;
+	revived->parentGeneration = fNodes[revived->parent].generation ;
+	fRemovedCount++ ;
+}
+
+
+const char*
+NameIndex::NameAt(int32 name)
+{
+	return fPool + fEntries[name].offset ;
+}
+
+
+bool
+NameIndex::IsLive(int32 node)
+{
+	// Only says something about the node itself, not its ancestors.
+	return node == 0 || ((fNodes[node].flags & kNodeRemoved) == 0
+		&& fNodes[node].parentGeneration
+			== fNodes[fNodes[node].parent].generation) ;
+}
+
+
+bool
+NameIndex::IsVisible(int32 node)
+{
+	for ( ; node > 0 ; node = fNodes[node].parent) {
+		if (!IsLive(node))
+			return false ;
+	}
+
+	return true ;
+}
+
+
+bool
+NameIndex::BuildPath(int32 node, char* buffer, size_t size)
+{
+	// Fill the buffer from the end, walking up towards the root.
+	size_t position = size - 1 ;
+	buffer[position] = '\0' ;
+
+	for ( ; node > 0 ; node = fNodes[node].parent) {
+		uint32 length = fEntries[fNodes[node].name].length ;
+		if (position < length + 1)
+			return false ;
+
+		position -= length ;
+		memcpy(buffer + position, NameAt(fNodes[node].name), length) ;
+		buffer[--position] = '/' ;
+	}
+
+	memmove(buffer, buffer + position, size - position) ;
+	return true ;
+}
+
+
+void
+NameIndex::SortNames()
+{
+	// Sort the distinct names once, then bucket the nodes by the rank of
+	// their name. This keeps the sort proportional to the number of
+	// distinct names rather than the number of paths.
+	uint32 *offsets = (uint32*)malloc(fEntryCount * sizeof(uint32)) ;
+	int32 *rank = (int32*)malloc(fEntryCount * sizeof(int32)) ;
+	int32 *start = (int32*)calloc(fEntryCount + 1, sizeof(int32)) ;
+	int32 *sorted = (int32*)realloc(fSorted, fNodeCount * sizeof(int32)) ;
+	if (offsets == NULL || rank == NULL || start == NULL || sorted == NULL) {
+		free(offsets) ;
+		free(rank) ;
+		free(start) ;
+		if (sorted != NULL)
+			fSorted = sorted ;
+		fSortedCount = 0 ;
+		return ;
+	}
+	fSorted = sorted ;
+
+	for (int32 i = 0 ; i < fEntryCount ; i++)
+		offsets[i] = fEntries[i].offset ;
+
+	sSortPool = fPool ;
+	qsort(offsets, fEntryCount, sizeof(uint32), compare_names) ;
+	sSortPool = NULL ;
+
+	// Entries are laid out in the pool in creation order, so a binary
+	// search over the entry offsets maps a sorted offset back to its entry.
+	for (int32 i = 0 ; i < fEntryCount ; i++) {
+		int32 low = 0, high = fEntryCount - 1 ;
+		while (low < high) {
+			int32 middle = (low + high) / 2 ;
+			if (fEntries[middle].offset < offsets[i])
+				low = middle + 1 ;
+			else
+				high = middle ;
+		}
+		rank[low] = i ;
+	}
+
+	// Skip the root node, it has no name to match.
+	for (int32 node = 1 ; node < fNodeCount ; node++)
+		start[rank[fNodes[node].name] + 1]++ ;
+	for (int32 i = 0 ; i < fEntryCount ; i++)
+		start[i + 1] += start[i] ;
+	for (int32 node = 1 ; node < fNodeCount ; node++)
+		fSorted[start[rank[fNodes[node].name]]++] = node ;
+
+	fSortedCount = fNodeCount - 1 ;
+	fSortedValid = true ;
+
+	free(offsets) ;
+	free(rank) ;
+	free(start) ;
+}
+
+
+void
+NameIndex::Compact()
+{
+	int32 *map = (int32*)malloc(fNodeCount * sizeof(int32)) ;
+	int32 *entryMap = (int32*)malloc(fEntryCount * sizeof(int32)) ;
+	if (map == NULL || entryMap == NULL) {
+		free(map) ;
+		free(entryMap) ;
+		return ;
+	}
+
+	// Parents always come before their children, so one pass finds the
+	// dead, and another moves the living down without overwriting any
+	// node it still has to look at.
+	int32 count = 0 ;
+	for (int32 i = 0 ; i < fNodeCount ; i++) {
+		int32 parent = fNodes[i].parent ;
+		map[i] = !IsLive(i) || (parent >= 0 && map[parent] < 0)
+			? -1 : count++ ;
+	}
+
+	memset(entryMap, 0xff, fEntryCount * sizeof(int32)) ;
+	for (int32 i = 0 ; i < fNodeCount ; i++) {
+		if (map[i] < 0)
+			continue ;
+
+		name_node *node = &fNodes[map[i]] ;
+		*node = fNodes[i] ;
+		node->parent = node->parent >= 0 ? map[node->parent] : -1 ;
+		node->generation = node->parentGeneration = 0 ;
+		entryMap[node->name] = 0 ;
+	}
+	fNodeCount = count ;
+
+	// Entries stay in pool order, which SortNames() depends on.
+	int32 entryCount = 0 ;
+	uint32 poolLength = 0 ;
+	for (int32 i = 0 ; i < fEntryCount ; i++) {
+		if (entryMap[i] < 0)
+			continue ;
+
+		name_entry *entry = &fEntries[entryCount] ;
+		*entry = fEntries[i] ;
+		memmove(fPool + poolLength, fPool + entry->offset, entry->length + 1) ;
+		entry->offset = poolLength ;
+		poolLength += entry->length + 1 ;
+		entryMap[i] = entryCount++ ;
+	}
+	fEntryCount = entryCount ;
+	fPoolLength = poolLength ;
+
+	for (int32 i = 0 ; i < fNodeCount ; i++)
+		fNodes[i].name = entryMap[fNodes[i].name] ;
+
+	free(map) ;
+	free(entryMap) ;
+
+	RehashNodes(fNodeBucketCount) ;
+	RehashEntries(fEntryBucketCount) ;
+	fSortedValid = false ;
+	fCompactedCount = fNodeCount ;
+	fRemovedCount = 0 ;
+}
+
+
+bool
+NameIndex::Matches(const char* name, const char* pattern, int32 mode)
+{
+	switch (mode) {
+		case BEACON_MATCH_PREFIX:
+			return strncasecmp(name, pattern, strlen(pattern)) == 0 ;
+		case BEACON_MATCH_SUBSTRING:
+			return contains_nocase(name, pattern) ;
+		case BEACON_MATCH_GLOB:
+			return glob_match(name, pattern) ;
+	}
+
+	return false ;
+}
+
+
+status_t
+NameIndex::GrowNodes()
+{
+	int32 capacity = fNodeCapacity > 0 ? fNodeCapacity * 2 : 256 ;
+	name_node *nodes = (name_node*)realloc(fNodes,
+		capacity * sizeof(name_node)) ;
+	if (nodes == NULL)
+		return B_NO_MEMORY ;
+
+	fNodes = nodes ;
+	fNodeCapacity = capacity ;
+	return B_OK ;
+}
+
+
+status_t
+NameIndex::GrowEntries()
+{
+	int32 capacity = fEntryCapacity > 0 ? fEntryCapacity * 2 : 256 ;
+	name_entry *entries = (name_entry*)realloc(fEntries,
+		capacity * sizeof(name_entry)) ;
+	if (entries == NULL)
+		return B_NO_MEMORY ;
+
+	fEntries = entries ;
+	fEntryCapacity = capacity ;
+	return B_OK ;
+}
+
+
+status_t
+NameIndex::GrowPool(uint32 length)
+{
+	if (length <= fPoolCapacity)
+		return B_OK ;
+
+	uint32 capacity = fPoolCapacity > 0 ? fPoolCapacity : 4096 ;
+	while (capacity < length)
+		capacity *= 2 ;
+
+	char *pool = (char*)realloc(fPool, capacity) ;
+	if (pool == NULL)
+		return B_NO_MEMORY ;
+
+	fPool = pool ;
+	fPoolCapacity = capacity ;
+	return B_OK ;
+}
+
+
+void
+NameIndex::RehashNodes(int32 count)
+{
+	while (count < fNodeCount)
+		count *= 2 ;
+
+	int32 *buckets = (int32*)realloc(fNodeBuckets, count * sizeof(int32)) ;
+	if (buckets == NULL)
+		return ;
+
+	fNodeBuckets = buckets ;
+	fNodeBucketCount = count ;
+	memset(fNodeBuckets, 0xff, count * sizeof(int32)) ;
+
+	for (int32 node = 0 ; node < fNodeCount ; node++) {
+		uint32 bucket = hash_child(fNodes[node].parent, fNodes[node].name)
+			& (count - 1) ;
+		fNodes[node].next = fNodeBuckets[bucket] ;
+		fNodeBuckets[bucket] = node ;
+	}
+}
+
+
+void
+NameIndex::RehashEntries(int32 count)
+{
+	while (count < fEntryCount)
+		count *= 2 ;
+
+	int32 *buckets = (int32*)realloc(fEntryBuckets, count * sizeof(int32)) ;
+	if (buckets == NULL)
+		return ;
+
+	fEntryBuckets = buckets ;
+	fEntryBucketCount = count ;
+	memset(fEntryBuckets, 0xff, count * sizeof(int32)) ;
+
+	for (int32 entry = 0 ; entry < fEntryCount ; entry++) {
+		uint32 bucket = hash_name(fPool + fEntries[entry].offset,
+			fEntries[entry].length) & (count - 1) ;
+		fEntries[entry].next = fEntryBuckets[bucket] ;
+		fEntryBuckets[bucket] = entry ;
+	}
+}
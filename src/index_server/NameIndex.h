@@ -0,0 +1,106 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _NAME_INDEX_H_
+#define _NAME_INDEX_H_
+
+#include <Locker.h>
+#include <Message.h>
+#include <SupportDefs.h>
+
+
+// A memory resident index over every file name and path component on a
+// volume. Paths are stored as a tree of nodes, each node pointing at an
+// interned name in a single string pool, so a path costs one node per
+// component and repeated names ("src", "Makefile") are stored once.
+//
+// Removing a path only marks its node. Once the tree has doubled since it
+// was last compacted and something was removed in the meantime, the dead
+// nodes and the names only they used are dropped.
+class NameIndex {
+	public:
+		NameIndex() ;
+		~NameIndex() ;
+
+		status_t AddPath(const char* path) ;
+		status_t RemovePath(const char* path) ;
+		void MakeEmpty() ;
+		int32 CountNames() ;
+
+		int32 Find(const char* pattern, int32 mode, BMessage* reply,
+			int32 limit) ;
+
+		status_t ReadFrom(const char* path) ;
+		status_t WriteTo(const char* path) ;
+		bool IsDirty() ;
+
+	private:
+		// A node whose parentGeneration isn't its parent's generation
+		// belongs to an earlier life of the parent, before it was removed
+		// and added again, and is as good as removed.
+		struct name_node {
+			int32	parent ;
+			int32	name ;
+			int32	next ;
+			uint32	flags ;
+			uint32	generation ;
+			uint32	parentGeneration ;
+		} ;
+
+		struct name_entry {
+			uint32	offset ;
+			uint32	length ;
+			int32	next ;
+		} ;
+
+		int32 Lookup(const char* path, bool create) ;
+		int32 FindChild(int32 parent, int32 name) ;
+		int32 AddChild(int32 parent, int32 name) ;
+		int32 InternName(const char* name, int32 length, bool create) ;
+		void Revive(int32 node) ;
+		const char* NameAt(int32 name) ;
+		bool IsLive(int32 node) ;
+		bool IsVisible(int32 node) ;
+		bool BuildPath(int32 node, char* buffer, size_t size) ;
+		void SortNames() ;
+		void Compact() ;
+		bool Matches(const char* name, const char* pattern, int32 mode) ;
+		status_t GrowNodes() ;
+		status_t GrowEntries() ;
+		status_t GrowPool(uint32 length) ;
+		void RehashNodes(int32 count) ;
+		void RehashEntries(int32 count) ;
+
+		name_node		*fNodes ;
+		int32			fNodeCount ;
+		int32			fNodeCapacity ;
+		int32			*fNodeBuckets ;
+		int32			fNodeBucketCount ;
+
+		name_entry		*fEntries ;
+		int32			fEntryCount ;
+		int32			fEntryCapacity ;
+		int32			*fEntryBuckets ;
+		int32			fEntryBucketCount ;
+
+		char			*fPool ;
+		uint32			fPoolLength ;
+		uint32			fPoolCapacity ;
+
+		int32			*fSorted ;
+		int32			fSortedCount ;
+		bool			fSortedValid ;
+
+		int32			fCompactedCount ;
+		int32			fRemovedCount ;
+
+		bool			fDirty ;
+		BLocker			fLocker ;
+} ;
+
+#endif /* _NAME_INDEX_H_ */
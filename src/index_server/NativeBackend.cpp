@@ -0,0 +1,242 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "NativeBackend.h"
+#include "StringPositionIO.h"
+#include "support.h"
+
+#include <String.h>
+
+#include <stdio.h>
+
+
+struct document_visit {
+	index_document_callback	callback ;
+	void					*cookie ;
+} ;
+
+
+static void
+visit_document(const stored_document *document, void *cookie)
+{
+	document_visit *visit = (document_visit*)cookie ;
+	visit->callback(document->path, document->size, document->modified,
+		visit->cookie) ;
+}
+
+
+NativeBackend::NativeBackend(const char *indexPath, dev_t device)
+	: fIndexPath(indexPath),
+	  fDevice(device),
+	  fOpen(false)
+{
+	// index_server is the only writer, so it may set damaged segments
+	// aside.
+	fIndex.SetRecovery(true) ;
+
+	BMessage settings('sett') ;
+	if (load_settings(&settings) == B_OK)
+		LoadSettings(&settings) ;
+}
+
+
+NativeBackend::~NativeBackend()
+{
+	fIndex.Close() ;
+}
+
+
+bool
+NativeBackend::Exists()
+{
+	return NativeIndex::Exists(fIndexPath.Path()) ;
+}
+
+
+status_t
+NativeBackend::Recover(index_path_callback callback, void *cookie)
+{
+	status_t status = OpenIndex() ;
+	if (status == B_BAD_DATA) {
+		// Without a manifest no segment can be trusted. Moving it away
+		// makes for a new index, which removes the old segments when it
+		// is first committed.
+		BPath manifest(fIndexPath.Path(), NATIVE_MANIFEST_FILE) ;
+		BString damaged(manifest.Path()) ;
+		damaged << ".damaged" ;
+		rename(manifest.Path(), damaged.String()) ;
+		return B_BAD_DATA ;
+	}
+	if (status != B_OK)
+		return status ;
+
+	if (fIndex.CountDamagedSegments() > 0) {
+		logger->Error("Set aside %d damaged segments of the native index "
+			"on device %d", fIndex.CountDamagedSegments(), fDevice) ;
+	}
+
+	return fIndex.TakeLostPaths(callback, cookie) ;
+}
+
+
+void
+NativeBackend::LoadSettings(BMessage *settings)
+{
+	// The path filters can be sized either way, a false positive rate of
+	// 0.01 being the same as 10 bits per path.
+	int32 bits ;
+	float rate ;
+	if (settings->FindInt32("path_filter_bits", &bits) == B_OK)
+		fIndex.SetPathFilterBits(bits) ;
+	else if (settings->FindFloat("path_filter_false_positives", &rate)
+			== B_OK)
+		fIndex.SetPathFilterBits(bloom_bits_for_rate(rate)) ;
+}
+
+
+status_t
+NativeBackend::OpenIndex()
+{
+	if (fOpen)
+		return B_OK ;
+
+	status_t status = fIndex.Open(fIndexPath.Path(), true) ;
+	if (status != B_OK) {
+		logger->Error("Could not open the native index on device %d: %s",
+			fDevice, strerror(status)) ;
+		return status ;
+	}
+
+	fOpen = true ;
+	return B_OK ;
+}
+
+
+status_t
+NativeBackend::RemovePath(const char *path)
+{
+	status_t status = OpenIndex() ;
+	if (status != B_OK)
+		return status ;
+
+	fIndex.RemovePath(path) ;
+	return B_OK ;
+}
+
+
+status_t
+NativeBackend::RemoveSubtree(const char *path)
+{
+	status_t status = OpenIndex() ;
+	if (status != B_OK)
+		return status ;
+
+	int32 removed = fIndex.RemoveSubtree(path) ;
+	if (removed > 0)
+		BEACON_LOG_VERBOSE("Removed %d documents under %s", removed, path) ;
+
+	return B_OK ;
+}
+
+
+status_t
+NativeBackend::AddDocument(const index_document *document)
+{
+	status_t status = OpenIndex() ;
+	if (status != B_OK)
+		return status ;
+
+	return AddToIndex(&fIndex, document) ;
+}
+
+
+status_t
+NativeBackend::AddToIndex(NativeIndex *index, const index_document *document)
+{
+	// Text that fits in one chunk is used where it is. Longer text is
+	// made one string, just as much of it as is indexed.
+	StringPositionIO *source = document->text ;
+	size_t length = source->Length() ;
+	const char *text ;
+	char *copy = NULL ;
+	if (length > kMaxTextLength) {
+		length = kMaxTextLength ;
+		copy = new char[length + 1] ;
+		source->ReadAt(0, copy, length) ;
+		copy[length] = '\0' ;
+		text = copy ;
+	} else if ((text = source->Content()) == NULL)
+		return B_NO_MEMORY ;
+
+	native_document nativeDocument ;
+	nativeDocument.path = document->path ;
+	nativeDocument.text = text ;
+	nativeDocument.textLength = length ;
+	nativeDocument.excerpt = document->excerpt ;
+	nativeDocument.mimeType = document->mimeType ;
+	nativeDocument.size = document->mimeType != NULL ? document->size : 0 ;
+	nativeDocument.modified = document->mimeType != NULL
+		? document->modified : 0 ;
+
+	status_t status = index->AddDocument(&nativeDocument) ;
+	delete[] copy ;
+	return status ;
+}
+
+
+status_t
+NativeBackend::ReplaceSubtree(const char *path, const char *indexPath,
+	time_t since)
+{
+	status_t status = OpenIndex() ;
+	if (status != B_OK)
+		return status ;
+
+	// The manifest written by the commit swaps it all in at once.
+	status = fIndex.ReplaceSubtree(path, indexPath, since) ;
+	if (status == B_OK)
+		status = Commit() ;
+	else
+		logger->Error("Could not take over the index in %s on device %d: %s",
+			indexPath, fDevice, strerror(status)) ;
+
+	return status ;
+}
+
+
+status_t
+NativeBackend::Commit()
+{
+	status_t status = OpenIndex() ;
+	if (status != B_OK)
+		return status ;
+
+	status = fIndex.Commit() ;
+	if (status != B_OK)
+		logger->Error("Could not commit the native index on device %d: %s",
+			fDevice, strerror(status)) ;
+
+	return status ;
+}
+
+
+void
+NativeBackend::ForEachPath(index_path_callback callback, void *cookie)
+{
+	if (OpenIndex() == B_OK)
+		fIndex.ForEachPath(callback, cookie) ;
+}
+
+
+void
+NativeBackend::ForEachDocument(index_document_callback callback, void *cookie)
+{
+	document_visit visit = { callback, cookie } ;
+	if (OpenIndex() == B_OK)
+		fIndex.ForEachDocument(visit_document, &visit) ;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _NATIVE_BACKEND_H_
+#define _NATIVE_BACKEND_H_
+
+#include "IndexBackend.h"
+#include "../engine/NativeIndex.h"
+
+#include <Message.h>
+#include <Path.h>
+
+
+// Only the first 10000 words of a file are indexed anyway, like CLucene
+// does by default, so there is no need to look at all of a huge one.
+const off_t kMaxTextLength = 1024 * 1024 ;
+
+
+// Block compressed posting lists in memory mapped segments, see
+// engine/NativeIndex.h. Smaller than a CLucene index and quicker to
+// intersect, but it keeps no positions, so there are no phrase queries.
+class NativeBackend : public IndexBackend {
+	public:
+		NativeBackend(const char *indexPath, dev_t device) ;
+		virtual ~NativeBackend() ;
+
+		virtual bool Exists() ;
+		virtual status_t Recover(index_path_callback callback,
+			void *cookie) ;
+		virtual status_t RemovePath(const char *path) ;
+		virtual status_t RemoveSubtree(const char *path) ;
+		virtual status_t AddDocument(const index_document *document) ;
+		virtual status_t ReplaceSubtree(const char *path,
+			const char *indexPath, time_t since) ;
+		virtual status_t Commit() ;
+		virtual void ForEachPath(index_path_callback callback, void *cookie) ;
+		virtual void ForEachDocument(index_document_callback callback,
+			void *cookie) ;
+
+		// Adds document to index as AddDocument() does, for bulkindex,
+		// whose indexes are not a volume's.
+		static status_t AddToIndex(NativeIndex *index,
+			const index_document *document) ;
+
+	private:
+		void LoadSettings(BMessage *settings) ;
+		status_t OpenIndex() ;
+
+		BPath				fIndexPath ;
+		dev_t				fDevice ;
+		NativeIndex			fIndex ;
+		bool				fOpen ;
+} ;
+
+#endif /* _NATIVE_BACKEND_H_ */
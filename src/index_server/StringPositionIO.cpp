@@ -8,70 +8,175 @@
 
 #include "StringPositionIO.h"
 
+#include <Locker.h>
+
+#include <cstdlib>
 #include <cstring>
-#include <cstdio>
+
+
+// 4 MB, enough for the text of most documents without holding on to the
+// memory a huge one needed.
+const int32 kMaxPooledChunks = 64 ;
+
+static BLocker sPoolLocker("string io pool") ;
+static char *sPool[kMaxPooledChunks] ;
+static int32 sPoolCount = 0 ;
+
+
+static char*
+allocate_chunk()
+{
+	char *chunk = NULL ;
+	sPoolLocker.Lock() ;
+	if (sPoolCount > 0)
+		chunk = sPool[--sPoolCount] ;
+	sPoolLocker.Unlock() ;
+
+	return chunk != NULL ? chunk : (char*)malloc(kStringChunkSize) ;
+}
+
+
+static void
+free_chunk(char *chunk)
+{
+	sPoolLocker.Lock() ;
+	if (sPoolCount < kMaxPooledChunks) {
+		sPool[sPoolCount++] = chunk ;
+		chunk = NULL ;
+	}
+	sPoolLocker.Unlock() ;
+
+	free(chunk) ;
+}
 
 
 StringPositionIO::StringPositionIO()
-	: offset(0)
+	: fChunks(NULL),
+	  fChunkCount(0),
+	  fChunkCapacity(0),
+	  fSize(0),
+	  fPosition(0),
+	  fFlat(NULL)
 {
 }
 
 
+StringPositionIO::~StringPositionIO()
+{
+	FreeChunks(0) ;
+	free(fChunks) ;
+	free(fFlat) ;
+}
+
+
 ssize_t
 StringPositionIO::Read(void* buffer, size_t numBytes)
 {
-	content.CopyInto((char*)buffer, offset, numBytes) ;
+	ssize_t bytesRead = ReadAt(fPosition, buffer, numBytes) ;
+	if (bytesRead > 0)
+		fPosition += bytesRead ;
+
+	return bytesRead ;
 }
 
 
 ssize_t
 StringPositionIO::ReadAt(off_t position, void* buffer, size_t numBytes)
 {
-	content.CopyInto((char*)buffer, position, numBytes) ;
+	if (position < 0 || buffer == NULL)
+		return B_BAD_VALUE ;
+	if (position >= fSize)
+		return 0 ;
+
+	if ((off_t)numBytes > fSize - position)
+		numBytes = fSize - position ;
+
+	size_t copied = 0 ;
+	while (copied < numBytes) {
+		const char *data ;
+		size_t length = GetSpan(position + copied, &data) ;
+		if (length > numBytes - copied)
+			length = numBytes - copied ;
+		memcpy((char*)buffer + copied, data, length) ;
+		copied += length ;
+	}
+
+	return copied ;
 }
 
 
 off_t
 StringPositionIO::Seek(off_t position, uint32 mode)
 {
-	if (mode == SEEK_SET) {
-		if (position < content.Length())
-			offset = position ;
-		else
-			offset = content.Length() - 1 ;
-	}
-	else if (mode == SEEK_CUR) {
-		if ((offset + position) < content.Length()) 
-			offset += position ;
-		else
-			offset = content.Length() - 1 ;
-	}
-	else if (mode == SEEK_END) {
-		if ((content.Length() - position) < 0)
-			offset = 0 ;
-		else
-			offset = content.Length() - position - 1 ;
+	// Seeking past the end is fine, the next write fills the gap.
+	off_t newPosition ;
+	switch (mode) {
+		case SEEK_SET:
+			newPosition = position ;
+			break ;
+		case SEEK_CUR:
+			newPosition = fPosition + position ;
+			break ;
+		case SEEK_END:
+			newPosition = fSize + position ;
+			break ;
+		default:
+			return B_BAD_VALUE ;
 	}
 
-	return offset ;
+	if (newPosition < 0)
+		return B_BAD_VALUE ;
+
+	fPosition = newPosition ;
+	return fPosition ;
 }
 
 
 off_t
 StringPositionIO::Position() const
 {
-	return offset ;
+	return fPosition ;
 }
 
 
 status_t
 StringPositionIO::SetSize(off_t numBytes)
 {
-	content.Truncate(numBytes) ;
-	if (content.Length() < offset)
-		offset = content.Length() - 1 ;
-	
+	if (numBytes < 0)
+		return B_BAD_VALUE ;
+
+	if (numBytes > fSize) {
+		// Zeros, like a write past the end would leave.
+		status_t status = Reserve(numBytes) ;
+		if (status != B_OK)
+			return status ;
+
+		for (off_t position = fSize ; position < numBytes ; ) {
+			char *chunk = fChunks[position / kStringChunkSize] ;
+			size_t offset = position % kStringChunkSize ;
+			size_t length = kStringChunkSize - offset ;
+			if ((off_t)length > numBytes - position)
+				length = numBytes - position ;
+			memset(chunk + offset, 0, length) ;
+			position += length ;
+		}
+	} else
+		FreeChunks((numBytes + kStringChunkSize - 1) / kStringChunkSize) ;
+
+	fSize = numBytes ;
+	free(fFlat) ;
+	fFlat = NULL ;
+	return B_OK ;
+}
+
+
+status_t
+StringPositionIO::GetSize(off_t* size) const
+{
+	if (size == NULL)
+		return B_BAD_VALUE ;
+
+	*size = fSize ;
 	return B_OK ;
 }
 
@@ -79,27 +184,149 @@ StringPositionIO::SetSize(off_t numBytes)
 ssize_t
 StringPositionIO::Write(const void* buffer, size_t numBytes)
 {
-	content.Insert((char*)buffer, numBytes, offset) ;
-	offset += numBytes ;
+	ssize_t written = WriteAt(fPosition, buffer, numBytes) ;
+	if (written > 0)
+		fPosition += written ;
+
+	return written ;
 }
 
 
 ssize_t
 StringPositionIO::WriteAt(off_t position, const void* buffer, size_t numBytes)
 {
-	content.Insert((char*)buffer, numBytes, position) ;
+	if (position < 0 || buffer == NULL)
+		return B_BAD_VALUE ;
+	if (numBytes == 0)
+		return 0 ;
+
+	if (position > fSize) {
+		status_t status = SetSize(position) ;
+		if (status != B_OK)
+			return status ;
+	}
+
+	status_t status = Reserve(position + numBytes) ;
+	if (status != B_OK)
+		return status ;
+
+	size_t copied = 0 ;
+	while (copied < numBytes) {
+		off_t at = position + copied ;
+		size_t offset = at % kStringChunkSize ;
+		size_t length = kStringChunkSize - offset ;
+		if (length > numBytes - copied)
+			length = numBytes - copied ;
+		memcpy(fChunks[at / kStringChunkSize] + offset,
+			(const char*)buffer + copied, length) ;
+		copied += length ;
+	}
+
+	if (position + (off_t)numBytes > fSize)
+		fSize = position + numBytes ;
+	free(fFlat) ;
+	fFlat = NULL ;
+	return numBytes ;
+}
+
+
+size_t
+StringPositionIO::GetSpan(off_t position, const char** data) const
+{
+	if (position < 0 || position >= fSize) {
+		*data = NULL ;
+		return 0 ;
+	}
+
+	size_t offset = position % kStringChunkSize ;
+	size_t length = kStringChunkSize - offset ;
+	if ((off_t)length > fSize - position)
+		length = fSize - position ;
+
+	*data = fChunks[position / kStringChunkSize] + offset ;
+	return length ;
 }
 
 
 const char*
 StringPositionIO::Content()
 {
-	return content.String() ;
+	if (fSize == 0)
+		return "" ;
+
+	// The terminator fits behind the text as long as it is one chunk.
+	if (fSize < (off_t)kStringChunkSize) {
+		fChunks[0][fSize] = '\0' ;
+		return fChunks[0] ;
+	}
+
+	if (fFlat == NULL)
+		Flatten() ;
+	return fFlat ;
 }
 
 
 uint32
 StringPositionIO::Length()
 {
-	return content.Length() ;
+	return fSize ;
+}
+
+
+void
+StringPositionIO::EmptyPool()
+{
+	sPoolLocker.Lock() ;
+	while (sPoolCount > 0)
+		free(sPool[--sPoolCount]) ;
+	sPoolLocker.Unlock() ;
+}
+
+
+status_t
+StringPositionIO::Reserve(off_t size)
+{
+	int32 needed = (size + kStringChunkSize - 1) / kStringChunkSize ;
+	if (needed > fChunkCapacity) {
+		// The chunk table doubles, the chunks themselves never move.
+		int32 capacity = fChunkCapacity > 0 ? fChunkCapacity * 2 : 4 ;
+		if (capacity < needed)
+			capacity = needed ;
+		char **chunks = (char**)realloc(fChunks, capacity * sizeof(char*)) ;
+		if (chunks == NULL)
+			return B_NO_MEMORY ;
+
+		fChunks = chunks ;
+		fChunkCapacity = capacity ;
+	}
+
+	while (fChunkCount < needed) {
+		char *chunk = allocate_chunk() ;
+		if (chunk == NULL)
+			return B_NO_MEMORY ;
+
+		fChunks[fChunkCount++] = chunk ;
+	}
+
+	return B_OK ;
+}
+
+
+void
+StringPositionIO::FreeChunks(int32 first)
+{
+	while (fChunkCount > first)
+		free_chunk(fChunks[--fChunkCount]) ;
+}
+
+
+void
+StringPositionIO::Flatten()
+{
+	fFlat = (char*)malloc(fSize + 1) ;
+	if (fFlat == NULL)
+		return ;
+
+	ReadAt(0, fFlat, fSize) ;
+	fFlat[fSize] = '\0' ;
 }
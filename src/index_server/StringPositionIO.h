@@ -10,32 +10,62 @@
 #define _STRING_POSITION_IO_H
 
 #include <DataIO.h>
-#include <String.h>
+
+
+// Text a translator writes, kept in chunks of kStringChunkSize bytes so
+// that appending never moves what is already there. Freed chunks go back
+// to a pool shared by every stream, the next translation reuses them.
+//
+// Behaves like a BMallocIO: writing overwrites, writing past the end
+// fills the gap with zeros, and reading returns how much was read.
+// GetSpan() hands out the chunks themselves, so the text can be read
+// without copying it out; Content() makes it all one string, which costs
+// a copy once the stream grew past a chunk.
+const size_t kStringChunkSize = 64 * 1024 ;
 
 
 class StringPositionIO : public BPositionIO {
 	public:
 		StringPositionIO() ;
+		virtual ~StringPositionIO() ;
 
-		ssize_t Read(void* buffer, size_t numBytes) ;
-		ssize_t ReadAt(off_t position, void* buffer, size_t numBytes) ;
+		virtual ssize_t Read(void* buffer, size_t numBytes) ;
+		virtual ssize_t ReadAt(off_t position, void* buffer, size_t numBytes) ;
 
-		off_t Seek(off_t position, uint32 mode) ;
-		off_t Position() const ;
+		virtual off_t Seek(off_t position, uint32 mode) ;
+		virtual off_t Position() const ;
 
-		status_t SetSize(off_t numBytes) ;
+		virtual status_t SetSize(off_t numBytes) ;
+		virtual status_t GetSize(off_t* size) const ;
 
-		ssize_t Write(const void* buffer, size_t numBytes) ;
-		ssize_t WriteAt(off_t position, const void* buffer,
+		virtual ssize_t Write(const void* buffer, size_t numBytes) ;
+		virtual ssize_t WriteAt(off_t position, const void* buffer,
 			size_t numBytes) ;
 
+		// The bytes from position up to the end of their chunk, or of the
+		// stream. Valid until the stream is written to or resized.
+		size_t GetSpan(off_t position, const char** data) const ;
+
+		// Null terminated, valid until the stream is written to or
+		// resized.
 		const char* Content() ;
 		uint32 Length() ;
 
+		// Returns the pooled chunks to the heap.
+		static void EmptyPool() ;
+
 	private:
-		BString		content ;
-		off_t		offset ;
+		status_t Reserve(off_t size) ;
+		void FreeChunks(int32 first) ;
+		void Flatten() ;
+
+		char**		fChunks ;
+		int32		fChunkCount ;
+		int32		fChunkCapacity ;
+		off_t		fSize ;
+		off_t		fPosition ;
+		// Content() of a stream past one chunk, NULL once it changes.
+		char*		fFlat ;
 } ;
 
 #endif /* _STRING_POSITION_IO_H */
-
@@ -0,0 +1,399 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "TextCache.h"
+#include "DuplicateFinder.h"
+#include "StringPositionIO.h"
+#include "support.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <List.h>
+#include <String.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <zlib.h>
+
+
+// Eviction goes on until the cache is this much of its size, so that it
+// isn't needed again right after the next store.
+const int32 kEvictPercent = 90 ;
+
+const size_t kCopyBufferSize = 64 * 1024 ;
+
+
+struct cache_entry {
+	char		name[B_FILE_NAME_LENGTH] ;
+	time_t		used ;
+	off_t		size ;
+} ;
+
+
+static int
+compare_entries(const void *first, const void *second)
+{
+	const cache_entry *a = *(const cache_entry**)first ;
+	const cache_entry *b = *(const cache_entry**)second ;
+	if (a->used != b->used)
+		return a->used < b->used ? -1 : 1 ;
+	return strcmp(a->name, b->name) ;
+}
+
+
+// Keys are sorted by size, then the hash of the beginning, then the hash
+// of all of it.
+static int
+compare_keys(const text_cache_key *a, const text_cache_key *b,
+	bool wholeKey)
+{
+	if (a->size != b->size)
+		return a->size < b->size ? -1 : 1 ;
+	if (a->headHash != b->headHash)
+		return a->headHash < b->headHash ? -1 : 1 ;
+	if (wholeKey && a->hash != b->hash)
+		return a->hash < b->hash ? -1 : 1 ;
+	return 0 ;
+}
+
+
+static int
+sort_keys(const void *first, const void *second)
+{
+	return compare_keys((const text_cache_key*)first,
+		(const text_cache_key*)second, true) ;
+}
+
+
+static bool
+parse_name(const char *name, text_cache_key *key)
+{
+	unsigned long long size, headHash, hash ;
+	int length = 0 ;
+	if (sscanf(name, "c-%llx-%llx-%llx%n", &size, &headHash, &hash,
+			&length) != 3 || name[length] != '\0')
+		return false ;
+
+	key->size = size ;
+	key->headHash = headHash ;
+	key->hash = hash ;
+	key->hashed = true ;
+	return true ;
+}
+
+
+TextCache::TextCache(const char *directory, off_t maxSize)
+	: fDirectory(directory),
+	  fMaxSize(maxSize),
+	  fSize(0),
+	  fKeys(NULL),
+	  fKeyCount(0),
+	  fKeyCapacity(0)
+{
+	fStatus = create_directory(fDirectory.Path(), 0777) ;
+	if (fStatus != B_OK)
+		return ;
+
+	// Entries from before they were kept under the contents of files, and
+	// those a crash left half written, are of no use.
+	BDirectory dir(fDirectory.Path()) ;
+	BEntry entry ;
+	struct stat st ;
+	char name[B_FILE_NAME_LENGTH] ;
+	text_cache_key key ;
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		if (entry.GetName(name) != B_OK || entry.GetStat(&st) != B_OK)
+			continue ;
+
+		if (!parse_name(name, &key)) {
+			entry.Remove() ;
+			continue ;
+		}
+
+		// Sorted once they are all in.
+		if (fKeyCount == fKeyCapacity && !GrowKeys())
+			continue ;
+		fKeys[fKeyCount++] = key ;
+		fSize += st.st_size ;
+	}
+	qsort(fKeys, fKeyCount, sizeof(text_cache_key), sort_keys) ;
+
+	if (fSize > fMaxSize)
+		Evict() ;
+}
+
+
+TextCache::~TextCache()
+{
+	free(fKeys) ;
+}
+
+
+status_t
+TextCache::InitCheck()
+{
+	return fStatus ;
+}
+
+
+status_t
+TextCache::Fetch(const char *path, off_t size, text_cache_key *key,
+	StringPositionIO *text)
+{
+	if (fStatus != B_OK)
+		return fStatus ;
+
+	key->size = size ;
+	key->hashed = false ;
+	if (DuplicateFinder::HashContents(path, size, false, &key->headHash)
+			!= B_OK)
+		return B_ENTRY_NOT_FOUND ;
+	if (FindKey(key, false) < 0)
+		return B_ENTRY_NOT_FOUND ;
+
+	// Files no bigger than the beginning are hashed whole already.
+	if (DuplicateFinder::HashContents(path, size, true, &key->hash) != B_OK)
+		return B_ENTRY_NOT_FOUND ;
+	key->hashed = true ;
+	if (FindKey(key, true) < 0)
+		return B_ENTRY_NOT_FOUND ;
+
+	BPath entryPath ;
+	EntryPath(key, &entryPath) ;
+	gzFile in = gzopen(entryPath.Path(), "rb") ;
+	if (in == NULL) {
+		RemoveKey(key) ;
+		return B_ENTRY_NOT_FOUND ;
+	}
+
+	char *buffer = new char[kCopyBufferSize] ;
+	status_t status = B_OK ;
+	int length ;
+	while ((length = gzread(in, buffer, kCopyBufferSize)) > 0) {
+		if (text->Write(buffer, length) != length) {
+			status = B_NO_MEMORY ;
+			break ;
+		}
+	}
+	if (length < 0)
+		status = B_BAD_DATA ;
+
+	delete[] buffer ;
+	gzclose(in) ;
+
+	if (status == B_BAD_DATA) {
+		// Damaged, the file gets translated and stored again.
+		struct stat entrySt ;
+		if (stat(entryPath.Path(), &entrySt) == 0)
+			fSize -= entrySt.st_size ;
+		unlink(entryPath.Path()) ;
+		RemoveKey(key) ;
+		return B_ENTRY_NOT_FOUND ;
+	}
+
+	// The modification time of an entry is when it was last used.
+	if (status == B_OK)
+		utime(entryPath.Path(), NULL) ;
+
+	return status ;
+}
+
+
+status_t
+TextCache::Store(const char *path, text_cache_key *key,
+	StringPositionIO *text)
+{
+	if (fStatus != B_OK)
+		return fStatus ;
+
+	if (!key->hashed) {
+		if (DuplicateFinder::HashContents(path, key->size, true, &key->hash)
+				!= B_OK)
+			return B_IO_ERROR ;
+		key->hashed = true ;
+	}
+
+	// Written under another name first, so that a crash can't leave a
+	// partial entry behind for a file.
+	BPath entryPath ;
+	EntryPath(key, &entryPath) ;
+	BString tempPath(entryPath.Path()) ;
+	tempPath << ".tmp" ;
+
+	gzFile out = gzopen(tempPath.String(), "wb") ;
+	if (out == NULL)
+		return B_IO_ERROR ;
+
+	// Compressed straight from the chunks of the text.
+	status_t status = B_OK ;
+	off_t position = 0 ;
+	const char *data ;
+	size_t length ;
+	while ((length = text->GetSpan(position, &data)) > 0) {
+		if (gzwrite(out, data, length) != (int)length) {
+			status = B_IO_ERROR ;
+			break ;
+		}
+		position += length ;
+	}
+
+	if (gzclose(out) != Z_OK && status == B_OK)
+		status = B_IO_ERROR ;
+
+	struct stat entrySt, oldSt ;
+	bool replaced = stat(entryPath.Path(), &oldSt) == 0 ;
+	if (status == B_OK && (stat(tempPath.String(), &entrySt) != 0
+		|| rename(tempPath.String(), entryPath.Path()) != 0))
+		status = B_IO_ERROR ;
+	if (status != B_OK) {
+		unlink(tempPath.String()) ;
+		return status ;
+	}
+
+	if (replaced)
+		fSize -= oldSt.st_size ;
+	else
+		AddKey(key) ;
+	fSize += entrySt.st_size ;
+	if (fSize > fMaxSize)
+		Evict() ;
+
+	return B_OK ;
+}
+
+
+void
+TextCache::EntryPath(const text_cache_key *key, BPath *path)
+{
+	char name[B_FILE_NAME_LENGTH] ;
+	snprintf(name, sizeof(name), "c-%llx-%llx-%llx",
+		(unsigned long long)key->size, (unsigned long long)key->headHash,
+		(unsigned long long)key->hash) ;
+	path->SetTo(fDirectory.Path(), name) ;
+}
+
+
+int32
+TextCache::FindKey(const text_cache_key *key, bool wholeKey)
+{
+	int32 lower = 0, upper = fKeyCount ;
+	while (lower < upper) {
+		int32 middle = (lower + upper) / 2 ;
+		int compare = compare_keys(&fKeys[middle], key, wholeKey) ;
+		if (compare == 0)
+			return middle ;
+		if (compare < 0)
+			lower = middle + 1 ;
+		else
+			upper = middle ;
+	}
+
+	return -1 ;
+}
+
+
+void
+TextCache::AddKey(const text_cache_key *key)
+{
+	if (fKeyCount == fKeyCapacity && !GrowKeys())
+		return ;
+
+	int32 lower = 0, upper = fKeyCount ;
+	while (lower < upper) {
+		int32 middle = (lower + upper) / 2 ;
+		if (compare_keys(&fKeys[middle], key, true) < 0)
+			lower = middle + 1 ;
+		else
+			upper = middle ;
+	}
+
+	int32 index = lower ;
+	memmove(&fKeys[index + 1], &fKeys[index],
+		(fKeyCount - index) * sizeof(text_cache_key)) ;
+	fKeys[index] = *key ;
+	fKeyCount++ ;
+}
+
+
+bool
+TextCache::GrowKeys()
+{
+	int32 capacity = fKeyCapacity > 0 ? fKeyCapacity * 2 : 64 ;
+	text_cache_key *keys = (text_cache_key*)realloc(fKeys,
+		capacity * sizeof(text_cache_key)) ;
+	if (keys == NULL)
+		return false ;
+
+	fKeys = keys ;
+	fKeyCapacity = capacity ;
+	return true ;
+}
+
+
+void
+TextCache::RemoveKey(const text_cache_key *key)
+{
+	int32 index = FindKey(key, true) ;
+	if (index < 0)
+		return ;
+
+	memmove(&fKeys[index], &fKeys[index + 1],
+		(fKeyCount - index - 1) * sizeof(text_cache_key)) ;
+	fKeyCount-- ;
+}
+
+
+void
+TextCache::Evict()
+{
+	// Only needed once in a while, so the entries aren't kept in memory
+	// between times.
+	BList entries ;
+	BDirectory dir(fDirectory.Path()) ;
+	BEntry entry ;
+	struct stat st ;
+	fSize = 0 ;
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		cache_entry *cacheEntry = new cache_entry ;
+		if (entry.GetName(cacheEntry->name) != B_OK
+			|| entry.GetStat(&st) != B_OK) {
+			delete cacheEntry ;
+			continue ;
+		}
+
+		cacheEntry->used = st.st_mtime ;
+		cacheEntry->size = st.st_size ;
+		fSize += st.st_size ;
+		entries.AddItem(cacheEntry) ;
+	}
+
+	entries.SortItems(compare_entries) ;
+
+	off_t target = fMaxSize / 100 * kEvictPercent ;
+	int32 removed = 0 ;
+	text_cache_key key ;
+	for (int32 i = 0 ; i < entries.CountItems() ; i++) {
+		cache_entry *cacheEntry = (cache_entry*)entries.ItemAt(i) ;
+		if (fSize > target) {
+			BPath path(fDirectory.Path(), cacheEntry->name) ;
+			if (unlink(path.Path()) == 0) {
+				fSize -= cacheEntry->size ;
+				if (parse_name(cacheEntry->name, &key))
+					RemoveKey(&key) ;
+				removed++ ;
+			}
+		}
+		delete cacheEntry ;
+	}
+
+	BEACON_LOG_VERBOSE("Removed %d entries from the text cache in %s", removed,
+		fDirectory.Path()) ;
+}
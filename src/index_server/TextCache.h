@@ -0,0 +1,71 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _TEXT_CACHE_H_
+#define _TEXT_CACHE_H_
+
+#include <Path.h>
+#include <SupportDefs.h>
+
+class StringPositionIO ;
+
+
+// What a file's text is kept under: its contents.
+struct text_cache_key {
+	off_t		size ;
+	uint64		headHash ;
+	uint64		hash ;
+	bool		hashed ;
+} ;
+
+
+// Keeps the text translators got out of files, compressed with zlib, so
+// that indexing a file again, or any other file with the same contents,
+// doesn't mean translating it again. An entry belongs to the contents of
+// a file: its size, a hash of its beginning, and a hash of all of it. A
+// file is only read whole if an entry has the same size and beginning,
+// the way DuplicateFinder does it. Once the cache grows past its size,
+// the entries used longest ago are removed.
+//
+// There is one cache for each volume, in its index directory.
+class TextCache {
+	public:
+		TextCache(const char *directory, off_t maxSize) ;
+		~TextCache() ;
+
+		status_t InitCheck() ;
+
+		// Appends the cached text of the file to text. Returns
+		// B_ENTRY_NOT_FOUND if there is none, and key is then what to
+		// Store() the text under.
+		status_t Fetch(const char *path, off_t size, text_cache_key *key,
+			StringPositionIO *text) ;
+		// Keeps text as that of the file key was made for.
+		status_t Store(const char *path, text_cache_key *key,
+			StringPositionIO *text) ;
+
+	private:
+		void EntryPath(const text_cache_key *key, BPath *path) ;
+		int32 FindKey(const text_cache_key *key, bool wholeKey) ;
+		void AddKey(const text_cache_key *key) ;
+		bool GrowKeys() ;
+		void RemoveKey(const text_cache_key *key) ;
+		void Evict() ;
+
+		BPath			fDirectory ;
+		status_t		fStatus ;
+		off_t			fMaxSize ;
+		off_t			fSize ;
+		// What is in the cache, sorted, so that a file is only read whole
+		// when its size and beginning are.
+		text_cache_key	*fKeys ;
+		int32			fKeyCount ;
+		int32			fKeyCapacity ;
+} ;
+
+#endif /* _TEXT_CACHE_H_ */
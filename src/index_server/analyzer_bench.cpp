@@ -0,0 +1,175 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Runs StandardAnalyzer and ContentAnalyzer over the same files, checks
+// that they give the same tokens, at the same offsets, and reports how
+// fast each one is.
+//
+//	analyzer_bench file...
+//
+// analyzer_corpus/ holds the conformance corpus, run it after every change
+// to either analyzer:
+//
+//	analyzer_bench analyzer_corpus/*
+
+#include "ContentAnalyzer.h"
+#include "StringPositionIO.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+using namespace lucene::analysis ;
+using namespace lucene::util ;
+
+
+const int32 kRounds = 5 ;
+
+
+struct bench_token {
+	std::wstring	text ;
+	int32			start ;
+	int32			end ;
+
+	bool operator==(const bench_token& other) const
+	{
+		return text == other.text && start == other.start
+			&& end == other.end ;
+	}
+
+	bool operator!=(const bench_token& other) const
+	{
+		return !(*this == other) ;
+	}
+} ;
+
+
+static double
+now()
+{
+	struct timeval tv ;
+	gettimeofday(&tv, NULL) ;
+	return tv.tv_sec + tv.tv_usec / 1000000.0 ;
+}
+
+
+static bool
+read_file(const char *path, std::string *text)
+{
+	FILE *file = fopen(path, "rb") ;
+	if (file == NULL)
+		return false ;
+
+	char buffer[65536] ;
+	size_t bytesRead ;
+	text->clear() ;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text->append(buffer, bytesRead) ;
+
+	fclose(file) ;
+	return true ;
+}
+
+
+static void
+collect(TokenStream *stream, std::vector<bench_token> *tokens)
+{
+	Token token ;
+	bench_token collected ;
+	while (stream->next(&token)) {
+		collected.text = token.termText() ;
+		collected.start = token.startOffset() ;
+		collected.end = token.endOffset() ;
+		tokens->push_back(collected) ;
+	}
+	stream->close() ;
+	delete stream ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: analyzer_bench file...\n") ;
+		return 1 ;
+	}
+
+	ContentAnalyzer analyzer ;
+	double standardTime = 0, contentTime = 0 ;
+	uint64 bytes = 0, tokens = 0 ;
+	int32 skipped = 0, mismatches = 0 ;
+
+	for (int i = 1 ; i < argc ; i++) {
+		std::string text ;
+		if (!read_file(argv[i], &text)) {
+			fprintf(stderr, "%s: could not read\n", argv[i]) ;
+			skipped++ ;
+			continue ;
+		}
+
+		// In chunks, the way a translator leaves it.
+		StringPositionIO stream ;
+		stream.Write(text.data(), text.size()) ;
+		if (!analyzer.SetText(&stream)) {
+			// ContentAnalyzer wouldn't be used for this one.
+			skipped++ ;
+			continue ;
+		}
+
+		std::vector<bench_token> expected, actual ;
+		for (int32 round = 0 ; round < kRounds ; round++) {
+			expected.clear() ;
+			double start = now() ;
+			FileReader reader(argv[i], "UTF-8") ;
+			collect(analyzer.FallbackAnalyzer()->tokenStream(
+				_T("contents"), &reader), &expected) ;
+			standardTime += now() - start ;
+
+			actual.clear() ;
+			start = now() ;
+			collect(analyzer.tokenStream(_T("contents"), NULL), &actual) ;
+			contentTime += now() - start ;
+		}
+		analyzer.UnsetText() ;
+
+		bytes += text.size() ;
+		tokens += expected.size() ;
+
+		if (actual != expected) {
+			size_t index = 0 ;
+			while (index < actual.size() && index < expected.size()
+				&& actual[index] == expected[index])
+				index++ ;
+			bench_token none = { L"", -1, -1 } ;
+			const bench_token& got = index < actual.size()
+				? actual[index] : none ;
+			const bench_token& wanted = index < expected.size()
+				? expected[index] : none ;
+			fprintf(stderr, "%s: token %lu is \"%ls\" at %ld-%ld, should be "
+				"\"%ls\" at %ld-%ld\n", argv[i], (unsigned long)index,
+				got.text.c_str(), (long)got.start, (long)got.end,
+				wanted.text.c_str(), (long)wanted.start, (long)wanted.end) ;
+			mismatches++ ;
+		}
+	}
+
+	double megabytes = (double)bytes * kRounds / (1024 * 1024) ;
+	printf("%d files, %.1f MB, %llu tokens, %d skipped, %d different\n",
+		argc - 1 - skipped, (double)bytes / (1024 * 1024),
+		(unsigned long long)tokens, skipped, mismatches) ;
+	if (standardTime > 0 && contentTime > 0) {
+		printf("StandardAnalyzer %8.1f MB/s\n", megabytes / standardTime) ;
+		printf("ContentAnalyzer  %8.1f MB/s\n", megabytes / contentTime) ;
+	}
+
+	return mismatches == 0 ? 0 : 1 ;
+}
@@ -0,0 +1,540 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Builds a native index of a directory, or of a whole volume, on every
+// CPU, and swaps it in for what was indexed there before.
+//
+// Files are translated by one thread per CPU, each adding to an index of
+// its own, whose segments come out sorted by path and are never merged.
+// Once every file is in, the segments are merged into one. A running
+// index_server is then asked to take the result over, which it commits
+// all at once; if none runs, the index of the volume is changed directly.
+// Files modified while the build went on keep what index_server made of
+// them.
+//
+// Only native indexes can be built. On a volume that has a CLucene index,
+// delete it first, or name the volume in "native_volumes".
+//
+//	bulkindex [-j threads] directory
+
+#include "ChunkedFiles.h"
+#include "NameIndex.h"
+#include "NativeBackend.h"
+#include "StringPositionIO.h"
+#include "support.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <Messenger.h>
+#include <Node.h>
+#include <NodeInfo.h>
+#include <OS.h>
+#include <Path.h>
+#include <TranslatorFormats.h>
+#include <TranslatorRoster.h>
+#include <Volume.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+
+Logger *logger = NULL ;
+
+const int32 kDefaultExcerptLength = 8 * 1024 ;
+// Files are handed out this many at a time, neighbours in path order
+// tend to end up in the same segment.
+const int32 kFilesPerGrab = 32 ;
+// Never merge while building, the one merge at the end does it all.
+const int32 kNoMerging = 1 << 30 ;
+
+
+struct bulk_build {
+	std::vector<std::string>	files ;
+	int32						next ;
+	int32						excerptLength ;
+	int32						pathFilterBits ;
+} ;
+
+struct bulk_worker {
+	bulk_build		*build ;
+	std::string		indexPath ;
+	// What each file is translated into, reused for the next one.
+	StringPositionIO	text ;
+	NativeIndex		index ;
+	int32			indexed ;
+	int32			unsupported ;
+	int32			failed ;
+	off_t			bytesRead ;
+	status_t		status ;
+} ;
+
+
+static double
+seconds_since(bigtime_t start)
+{
+	return (system_time() - start) / 1000000.0 ;
+}
+
+
+static void
+remove_tree(const std::string& path)
+{
+	DIR *dir = opendir(path.c_str()) ;
+	if (dir == NULL) {
+		unlink(path.c_str()) ;
+		return ;
+	}
+
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0)
+			remove_tree(path + "/" + entry->d_name) ;
+	}
+
+	closedir(dir) ;
+	rmdir(path.c_str()) ;
+}
+
+
+static bool
+is_excluded(const std::string& path, const std::vector<std::string>& excluded)
+{
+	for (size_t i = 0 ; i < excluded.size() ; i++) {
+		const std::string& directory = excluded[i] ;
+		if (path.compare(0, directory.size(), directory) == 0
+			&& (path.size() == directory.size()
+				|| path[directory.size()] == '/'))
+			return true ;
+	}
+
+	return false ;
+}
+
+
+// Visits what index_server would: no hidden entries, no links, nothing
+// of the index itself and nothing excluded with indexutil -E.
+static void
+crawl(const std::string& path, const std::string& indexPath,
+	const std::vector<std::string>& excluded,
+	std::vector<std::string>* files, FILE* names)
+{
+	DIR *dir = opendir(path.c_str()) ;
+	if (dir == NULL)
+		return ;
+
+	struct dirent *entry ;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue ;
+
+		std::string child = path == "/" ? path + entry->d_name
+			: path + "/" + entry->d_name ;
+		struct stat st ;
+		if (lstat(child.c_str(), &st) != 0 || S_ISLNK(st.st_mode)
+			|| child == indexPath || is_excluded(child, excluded))
+			continue ;
+
+		fprintf(names, "%s\n", child.c_str()) ;
+		if (S_ISDIR(st.st_mode))
+			crawl(child, indexPath, excluded, files, names) ;
+		else if (S_ISREG(st.st_mode))
+			files->push_back(child) ;
+	}
+
+	closedir(dir) ;
+}
+
+
+static void
+index_file(bulk_worker* worker, BTranslatorRoster* roster, const char* path)
+{
+	BFile file(path, B_READ_ONLY) ;
+	translator_info info ;
+	if (file.InitCheck() != B_OK || roster->Identify(&file, NULL, &info, 0,
+			NULL, B_TRANSLATOR_TEXT) != B_OK) {
+		worker->unsupported++ ;
+		return ;
+	}
+
+	file.Seek(0, SEEK_SET) ;
+	StringPositionIO *text = &worker->text ;
+	text->SetSize(0) ;
+	text->Seek(0, SEEK_SET) ;
+	if (roster->Translate(&file, &info, NULL, text, B_TRANSLATOR_TEXT)
+			!= B_OK) {
+		worker->failed++ ;
+		return ;
+	}
+
+	struct stat st ;
+	char mimeType[B_MIME_TYPE_LENGTH] ;
+	BNodeInfo nodeInfo(&file) ;
+	if (file.GetStat(&st) != B_OK) {
+		worker->failed++ ;
+		return ;
+	}
+	if (nodeInfo.GetType(mimeType) != B_OK)
+		strcpy(mimeType, "application/octet-stream") ;
+	worker->bytesRead += st.st_size ;
+
+	index_document document ;
+	document.path = path ;
+	document.text = text ;
+	document.excerpt = read_excerpt(text, worker->build->excerptLength) ;
+	document.mimeType = mimeType ;
+	document.size = st.st_size ;
+	document.modified = st.st_mtime ;
+	if (NativeBackend::AddToIndex(&worker->index, &document) == B_OK)
+		worker->indexed++ ;
+	else
+		worker->failed++ ;
+
+	delete[] document.excerpt ;
+}
+
+
+static int32
+index_files(void* data)
+{
+	bulk_worker *worker = (bulk_worker*)data ;
+	bulk_build *build = worker->build ;
+
+	// Every thread has its own translators, they are not all safe to share.
+	BTranslatorRoster *roster = new BTranslatorRoster ;
+	roster->AddTranslators(NULL) ;
+
+	int32 count = build->files.size() ;
+	while (worker->status == B_OK) {
+		int32 first = atomic_add(&build->next, kFilesPerGrab) ;
+		if (first >= count)
+			break ;
+
+		int32 last = first + kFilesPerGrab < count
+			? first + kFilesPerGrab : count ;
+		for (int32 i = first ; i < last ; i++)
+			index_file(worker, roster, build->files[i].c_str()) ;
+	}
+
+	if (worker->status == B_OK)
+		worker->status = worker->index.Commit() ;
+
+	delete roster ;
+	worker->text.SetSize(0) ;
+	return worker->status ;
+}
+
+
+static void
+add_missing_path(const char* path, void* cookie)
+{
+	struct stat st ;
+	if (lstat(path, &st) != 0)
+		((std::vector<std::string>*)cookie)->push_back(path) ;
+}
+
+
+static void
+add_name(const char* path, void* cookie)
+{
+	// Every chunk of a file stands for the file itself.
+	const char *chunk = strstr(path, BEACON_CHUNK_SEPARATOR) ;
+	if (chunk != NULL)
+		((NameIndex*)cookie)->AddPath(std::string(path,
+			chunk - path).c_str()) ;
+	else
+		((NameIndex*)cookie)->AddPath(path) ;
+}
+
+
+// Does what index_server would have, for when it isn't running.
+static status_t
+swap_in(const char* path, const BPath& volumeIndexPath, const char* builtPath,
+	const char* namesPath, time_t since)
+{
+	const char *indexPath = volumeIndexPath.Path() ;
+	struct stat st ;
+	if (!NativeIndex::Exists(indexPath) && stat(indexPath, &st) == 0) {
+		fprintf(stderr, "%s is not a native index\n", indexPath) ;
+		return BEACON_NOT_SUPPORTED ;
+	}
+
+	NativeIndex index ;
+	index.SetRecovery(true) ;
+	status_t status = index.Open(indexPath, true) ;
+	if (status == B_OK)
+		status = index.ReplaceSubtree(path, builtPath, since) ;
+	if (status == B_OK)
+		status = index.Commit() ;
+	if (status != B_OK)
+		return status ;
+
+	// Without saved names, index_server would have started from the
+	// indexed paths.
+	NameIndex names ;
+	BPath savedNames(indexPath, "names") ;
+	if (names.ReadFrom(savedNames.Path()) != B_OK)
+		index.ForEachPath(add_name, &names) ;
+
+	FILE *file = fopen(namesPath, "r") ;
+	char line[B_PATH_NAME_LENGTH + 1] ;
+	while (file != NULL && fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strlen(line) ;
+		if (length > 0 && line[length - 1] == '\n')
+			line[length - 1] = '\0' ;
+		names.AddPath(line) ;
+	}
+	if (file != NULL)
+		fclose(file) ;
+	names.WriteTo(savedNames.Path()) ;
+
+	ChunkedFiles chunkedFiles ;
+	BPath chunksPath(indexPath, "chunks") ;
+	if (chunkedFiles.ReadFrom(chunksPath.Path()) == B_OK) {
+		chunkedFiles.RemoveSubtree(path) ;
+		if (chunkedFiles.IsDirty())
+			chunkedFiles.WriteTo(chunksPath.Path()) ;
+	}
+
+	return B_OK ;
+}
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: bulkindex [-j threads] directory\n") ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info systemInfo ;
+	int32 threads = get_system_info(&systemInfo) == B_OK
+		? systemInfo.cpu_count : 1 ;
+
+	int opt ;
+	while ((opt = getopt(argc, argv, "j:")) != -1) {
+		switch (opt) {
+			case 'j': threads = atoi(optarg) ; break ;
+			default:
+				usage() ;
+				return 1 ;
+		}
+	}
+	if (optind != argc - 1 || threads < 1) {
+		usage() ;
+		return 1 ;
+	}
+
+	BPath path(argv[optind], NULL, true) ;
+	entry_ref ref ;
+	if (path.InitCheck() != B_OK
+		|| get_ref_for_path(path.Path(), &ref) != B_OK
+		|| !BEntry(&ref).IsDirectory()) {
+		fprintf(stderr, "%s is not a directory\n", argv[optind]) ;
+		return 1 ;
+	}
+	if (is_hidden(&ref)) {
+		fprintf(stderr, "%s is hidden, it is never indexed\n", path.Path()) ;
+		return 1 ;
+	}
+
+	BVolume volume(ref.device) ;
+	BDirectory rootDirectory ;
+	BPath rootPath ;
+	if (volume.GetRootDirectory(&rootDirectory) != B_OK
+		|| rootPath.SetTo(&rootDirectory) != B_OK) {
+		fprintf(stderr, "Could not find the volume of %s\n", path.Path()) ;
+		return 1 ;
+	}
+	BPath volumeIndexPath(rootPath.Path(), "index") ;
+	BPath workPath(rootPath.Path(), BEACON_BULK_DIRECTORY) ;
+	BPath builtPath(workPath.Path(), "index") ;
+	BPath namesPath(workPath.Path(), BEACON_BULK_NAMES_FILE) ;
+
+	if (mkdir(workPath.Path(), 0755) != 0) {
+		fprintf(stderr, "Could not create %s: %s\n", workPath.Path(),
+			strerror(errno)) ;
+		if (errno == EEXIST)
+			fprintf(stderr, "Remove it if no other bulkindex is running\n") ;
+		return 1 ;
+	}
+
+	BMessage settings('sett') ;
+	bulk_build build ;
+	build.next = 0 ;
+	build.excerptLength = kDefaultExcerptLength ;
+	build.pathFilterBits = -1 ;
+	std::vector<std::string> excluded ;
+	if (load_settings(&settings) == B_OK) {
+		int32 excerptLength, bits ;
+		float rate ;
+		if (settings.FindInt32("excerpt_length", &excerptLength) == B_OK)
+			build.excerptLength = excerptLength ;
+		if (settings.FindInt32("path_filter_bits", &bits) == B_OK)
+			build.pathFilterBits = bits ;
+		else if (settings.FindFloat("path_filter_false_positives", &rate)
+				== B_OK)
+			build.pathFilterBits = bloom_bits_for_rate(rate) ;
+
+		// Directories excluded with indexutil -E, as the feeder reads
+		// them. Those that are gone don't matter any more.
+		const char *excludePath ;
+		for (int32 i = 0 ; settings.FindString("exclude", i, &excludePath)
+				== B_OK ; i++) {
+			BPath excludedPath(excludePath, NULL, true) ;
+			if (excludedPath.InitCheck() == B_OK)
+				excluded.push_back(excludedPath.Path()) ;
+		}
+	}
+	if (is_excluded(path.Path(), excluded)) {
+		fprintf(stderr, "%s is excluded, it is never indexed\n",
+			path.Path()) ;
+		remove_tree(workPath.Path()) ;
+		return 1 ;
+	}
+
+	// Anything modified from now on may be indexed by index_server too,
+	// and what it has is newer.
+	time_t since = time(NULL) ;
+	bigtime_t start = system_time() ;
+
+	FILE *names = fopen(namesPath.Path(), "w") ;
+	if (names == NULL) {
+		fprintf(stderr, "Could not create %s\n", namesPath.Path()) ;
+		remove_tree(workPath.Path()) ;
+		return 1 ;
+	}
+	fprintf(names, "%s\n", path.Path()) ;
+	crawl(path.Path(), volumeIndexPath.Path(), excluded, &build.files,
+		names) ;
+	fclose(names) ;
+	double crawlTime = seconds_since(start) ;
+	printf("Found %ld files in %.1f s\n", (long)build.files.size(),
+		crawlTime) ;
+
+	bigtime_t indexStart = system_time() ;
+	std::vector<bulk_worker*> workers ;
+	std::vector<thread_id> threadIDs ;
+	for (int32 i = 0 ; i < threads ; i++) {
+		bulk_worker *worker = new bulk_worker ;
+		char name[32] ;
+		snprintf(name, sizeof(name), "worker%ld", (long)i) ;
+		worker->build = &build ;
+		worker->indexPath = std::string(workPath.Path()) + "/" + name ;
+		worker->indexed = worker->unsupported = worker->failed = 0 ;
+		worker->bytesRead = 0 ;
+		worker->index.SetMergeFactor(kNoMerging) ;
+		if (build.pathFilterBits >= 0)
+			worker->index.SetPathFilterBits(build.pathFilterBits) ;
+		worker->status = worker->index.Open(worker->indexPath.c_str(), true) ;
+		workers.push_back(worker) ;
+
+		thread_id thread = spawn_thread(index_files, name, B_LOW_PRIORITY,
+			worker) ;
+		if (thread >= B_OK && resume_thread(thread) == B_OK)
+			threadIDs.push_back(thread) ;
+		else
+			index_files(worker) ;
+	}
+	for (size_t i = 0 ; i < threadIDs.size() ; i++) {
+		status_t exitValue ;
+		wait_for_thread(threadIDs[i], &exitValue) ;
+	}
+	double indexTime = seconds_since(indexStart) ;
+
+	status_t status = B_OK ;
+	int32 indexed = 0, unsupported = 0, failed = 0 ;
+	off_t bytesRead = 0 ;
+	for (size_t i = 0 ; i < workers.size() ; i++) {
+		indexed += workers[i]->indexed ;
+		unsupported += workers[i]->unsupported ;
+		failed += workers[i]->failed ;
+		bytesRead += workers[i]->bytesRead ;
+		if (workers[i]->status != B_OK)
+			status = workers[i]->status ;
+	}
+	printf("Indexed %ld files, %.1f MB, in %.1f s with %ld threads, "
+		"%.0f files/s\n", (long)indexed, bytesRead / 1048576.0, indexTime,
+		(long)threads, indexTime > 0 ? indexed / indexTime : 0) ;
+	if (unsupported > 0 || failed > 0) {
+		printf("%ld files have no translator, %ld could not be indexed\n",
+			(long)unsupported, (long)failed) ;
+	}
+
+	// One merge for everything, after leaving out what was removed while
+	// the build went on.
+	bigtime_t mergeStart = system_time() ;
+	NativeIndex built ;
+	if (build.pathFilterBits >= 0)
+		built.SetPathFilterBits(build.pathFilterBits) ;
+	if (status == B_OK)
+		status = built.Open(builtPath.Path(), true) ;
+	for (size_t i = 0 ; status == B_OK && i < workers.size() ; i++)
+		status = built.AddIndex(workers[i]->indexPath.c_str()) ;
+	if (status == B_OK) {
+		std::vector<std::string> missing ;
+		built.ForEachPath(add_missing_path, &missing) ;
+		for (size_t i = 0 ; i < missing.size() ; i++)
+			built.RemovePath(missing[i].c_str()) ;
+		status = built.Optimize() ;
+	}
+	if (status == B_OK)
+		status = built.Commit() ;
+	built.Close() ;
+	double mergeTime = seconds_since(mergeStart) ;
+
+	for (size_t i = 0 ; i < workers.size() ; i++)
+		delete workers[i] ;
+
+	if (status != B_OK) {
+		fprintf(stderr, "Could not build the index: %s\n", strerror(status)) ;
+		remove_tree(workPath.Path()) ;
+		return 1 ;
+	}
+	printf("Merged in %.1f s\n", mergeTime) ;
+
+	bigtime_t swapStart = system_time() ;
+	BMessenger server(APP_SIGNATURE) ;
+	if (server.IsValid()) {
+		BMessage swap(BEACON_SWAP_INDEX), reply ;
+		swap.AddString("path", path.Path()) ;
+		swap.AddString("index", builtPath.Path()) ;
+		swap.AddInt64("since", since) ;
+		status = server.SendMessage(&swap, &reply) ;
+		if (status == B_OK && reply.FindInt32("error", &status) != B_OK)
+			status = B_ERROR ;
+	} else
+		status = swap_in(path.Path(), volumeIndexPath, builtPath.Path(),
+			namesPath.Path(), since) ;
+
+	remove_tree(workPath.Path()) ;
+	if (status != B_OK) {
+		fprintf(stderr, "Could not swap the index in: %s\n",
+			status == BEACON_NOT_SUPPORTED
+				? "the volume has a CLucene index" : strerror(status)) ;
+		return 1 ;
+	}
+
+	printf("Swapped in%s in %.1f s, %.1f s in all\n", server.IsValid()
+		? " by index_server" : "", seconds_since(swapStart),
+		seconds_since(start)) ;
+	return 0 ;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Feeds an event trace, recorded by the Feeder when the "record_events"
+// setting names a file, to a running index_server, and reports how fast
+// it kept up, as JSON.
+//
+// Paths are replayed under the fixture directory: /boot/home/a becomes
+// fixture/boot/home/a. -p makes the fixture first, every directory the
+// trace mentions and every file it creates, with the size it had. Let the
+// server settle after that, replaying doesn't touch the files itself.
+//
+// Events are sent as fast as possible, or -s times as fast as they were
+// recorded. After every -b events, or a pause in the recording, the
+// server is asked to update its indexes and the time until that is done
+// counts as the latency of each event in the batch. Devices can't be
+// mounted again, node monitor events are skipped.
+//
+//	eventreplay [-p] [-s speed] [-b batch] fixture trace
+
+#include "EventTrace.h"
+#include "../constants.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <Messenger.h>
+#include <NodeMonitor.h>
+#include <OS.h>
+#include <Path.h>
+#include <Query.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+
+const int32 kDefaultBatch = 100 ;
+// The feeder's own flush delay, a longer pause ends a batch.
+const bigtime_t kBatchPause = 500000 ;
+
+
+static std::string
+fixture_path(const char* fixture, const char* path)
+{
+	std::string fixturePath = fixture ;
+	if (path[0] != '/')
+		fixturePath += '/' ;
+	return fixturePath + path ;
+}
+
+
+static std::string
+parent_path(const std::string& path)
+{
+	size_t slash = path.rfind('/') ;
+	return slash == 0 || slash == std::string::npos
+		? std::string("/") : path.substr(0, slash) ;
+}
+
+
+static status_t
+write_filler(const char* path, off_t size)
+{
+	BFile file(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) ;
+	status_t status = file.InitCheck() ;
+	if (status != B_OK)
+		return status ;
+
+	// Words rather than zeros, so that there is something to index.
+	static const char kText[] = "the quick brown fox jumps over the lazy "
+		"dog while the index server keeps up with it\n" ;
+	char buffer[4096] ;
+	for (size_t i = 0 ; i < sizeof(buffer) ; i++)
+		buffer[i] = kText[i % (sizeof(kText) - 1)] ;
+
+	for (off_t written = 0 ; written < size ; ) {
+		size_t length = size - written < (off_t)sizeof(buffer)
+			? size - written : sizeof(buffer) ;
+		ssize_t bytesWritten = file.Write(buffer, length) ;
+		if (bytesWritten < 0)
+			return bytesWritten ;
+		written += bytesWritten ;
+	}
+
+	return B_OK ;
+}
+
+
+static int
+prepare(const char* fixture, const char* tracePath)
+{
+	EventReader reader ;
+	status_t status = reader.Open(tracePath) ;
+	if (status != B_OK) {
+		fprintf(stderr, "%s: %s\n", tracePath, strerror(status)) ;
+		return 1 ;
+	}
+
+	recorded_event event ;
+	int32 files = 0, failed = 0 ;
+	while ((status = reader.Next(&event)) == B_OK) {
+		if (event.what != B_QUERY_UPDATE || event.path[0] == '\0')
+			continue ;
+
+		std::string path = fixture_path(fixture, event.path) ;
+		if (create_directory(parent_path(path).c_str(), 0755) != B_OK
+			|| (event.opcode == B_ENTRY_CREATED
+				&& write_filler(path.c_str(), event.size) != B_OK)) {
+			failed++ ;
+			continue ;
+		}
+		if (event.opcode == B_ENTRY_CREATED)
+			files++ ;
+	}
+	if (status != B_ENTRY_NOT_FOUND)
+		fprintf(stderr, "%s: damaged, stopped early\n", tracePath) ;
+
+	printf("Made %d files in %s, %d could not be made\n", (int)files,
+		fixture, (int)failed) ;
+	return failed == 0 ? 0 : 1 ;
+}
+
+
+static double
+percentile(const std::vector<bigtime_t>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0 ;
+
+	size_t index = (size_t)(fraction * sorted.size()) ;
+	return sorted[index < sorted.size() ? index : sorted.size() - 1] / 1000.0 ;
+}
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: eventreplay [-p] [-s speed] [-b batch] fixture "
+		"trace\n") ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	bool prepareOnly = false ;
+	double speed = 0 ;
+	int32 batch = kDefaultBatch ;
+
+	int opt ;
+	while ((opt = getopt(argc, argv, "ps:b:")) != -1) {
+		switch (opt) {
+			case 'p': prepareOnly = true ; break ;
+			case 's': speed = atof(optarg) ; break ;
+			case 'b': batch = atoi(optarg) ; break ;
+			default:
+				usage() ;
+				return 1 ;
+		}
+	}
+	if (optind != argc - 2 || speed < 0 || batch < 1) {
+		usage() ;
+		return 1 ;
+	}
+
+	const char *fixture = argv[optind] ;
+	const char *tracePath = argv[optind + 1] ;
+	if (prepareOnly)
+		return prepare(fixture, tracePath) ;
+
+	EventReader reader ;
+	status_t status = reader.Open(tracePath) ;
+	if (status != B_OK) {
+		fprintf(stderr, "%s: %s\n", tracePath, strerror(status)) ;
+		return 1 ;
+	}
+
+	BMessenger server(APP_SIGNATURE) ;
+	if (!server.IsValid()) {
+		fprintf(stderr, "index_server not running\n") ;
+		return 1 ;
+	}
+
+	// The server finds entries by the node of their directory, which is
+	// looked up once for each.
+	std::map<std::string, node_ref> directories ;
+	std::vector<bigtime_t> pending, latencies, batchTimes ;
+	int32 replayed = 0, skipped = 0 ;
+	bigtime_t lastEventTime = 0, lateness = 0 ;
+	bigtime_t start = system_time() ;
+
+	recorded_event event ;
+	bool more = true ;
+	while (more) {
+		more = (status = reader.Next(&event)) == B_OK ;
+
+		// Finish the batch before a pause, so that its latency doesn't
+		// include waiting for the next event.
+		if (!pending.empty() && (!more || (int32)pending.size() >= batch
+				|| event.time - lastEventTime > kBatchPause)) {
+			BMessage reply ;
+			bigtime_t batchStart = system_time() ;
+			if (server.SendMessage(BEACON_UPDATE_INDEX, &reply) != B_OK) {
+				fprintf(stderr, "index_server went away\n") ;
+				return 1 ;
+			}
+			bigtime_t done = system_time() ;
+			for (size_t i = 0 ; i < pending.size() ; i++)
+				latencies.push_back(done - pending[i]) ;
+			batchTimes.push_back(done - batchStart) ;
+			pending.clear() ;
+		}
+		if (!more)
+			break ;
+		lastEventTime = event.time ;
+
+		if (event.what != B_QUERY_UPDATE || event.path[0] == '\0') {
+			skipped++ ;
+			continue ;
+		}
+
+		std::string path = fixture_path(fixture, event.path) ;
+		std::string parent = parent_path(path) ;
+		std::map<std::string, node_ref>::iterator found
+			= directories.find(parent) ;
+		if (found == directories.end()) {
+			node_ref node ;
+			if (BDirectory(parent.c_str()).GetNodeRef(&node) != B_OK) {
+				skipped++ ;
+				continue ;
+			}
+			found = directories.insert(std::make_pair(parent, node)).first ;
+		}
+
+		if (speed > 0) {
+			bigtime_t due = start + (bigtime_t)(event.time / speed) ;
+			bigtime_t now = system_time() ;
+			if (due > now)
+				snooze(due - now) ;
+			else
+				lateness = std::max(lateness, now - due) ;
+		}
+
+		BMessage message(B_QUERY_UPDATE) ;
+		message.AddInt32("opcode", event.opcode) ;
+		message.AddInt32("device", found->second.device) ;
+		message.AddInt64("directory", found->second.node) ;
+		message.AddString("name", path.c_str() + parent.size()
+			+ (parent.size() > 1 ? 1 : 0)) ;
+
+		pending.push_back(system_time()) ;
+		if (server.SendMessage(&message) != B_OK) {
+			fprintf(stderr, "index_server went away\n") ;
+			return 1 ;
+		}
+		replayed++ ;
+	}
+	if (status != B_ENTRY_NOT_FOUND)
+		fprintf(stderr, "%s: damaged, stopped early\n", tracePath) ;
+
+	double seconds = (system_time() - start) / 1000000.0 ;
+	std::sort(latencies.begin(), latencies.end()) ;
+	std::sort(batchTimes.begin(), batchTimes.end()) ;
+
+	printf("{\n") ;
+	printf("  \"trace\": {\"path\": \"%s\", \"recorded_seconds\": %.3f, "
+		"\"speed\": %g},\n", tracePath, lastEventTime / 1000000.0, speed) ;
+	printf("  \"events\": {\"replayed\": %d, \"skipped\": %d, "
+		"\"batches\": %lu},\n", (int)replayed, (int)skipped,
+		(unsigned long)batchTimes.size()) ;
+	printf("  \"throughput\": {\"seconds\": %.3f, "
+		"\"events_per_second\": %.0f, \"max_lateness_ms\": %.3f},\n",
+		seconds, seconds > 0 ? replayed / seconds : 0, lateness / 1000.0) ;
+	printf("  \"event_latency_ms\": {\"p50\": %.3f, \"p99\": %.3f, "
+		"\"max\": %.3f},\n", percentile(latencies, 0.5),
+		percentile(latencies, 0.99), latencies.empty()
+			? 0 : latencies.back() / 1000.0) ;
+	printf("  \"update_ms\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}\n",
+		percentile(batchTimes, 0.5), percentile(batchTimes, 0.99),
+		batchTimes.empty() ? 0 : batchTimes.back() / 1000.0) ;
+	printf("}\n") ;
+
+	return 0 ;
+}
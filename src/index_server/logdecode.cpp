@@ -0,0 +1,148 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Prints a binary log as the text log it stands for, one line per
+// message. Has to run on a machine of the same byte order.
+//
+//	logdecode log.bin
+
+#include "BinaryLog.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+
+static bool
+read_value(FILE* file, void* data, size_t length)
+{
+	return length == 0 || fread(data, length, 1, file) == 1 ;
+}
+
+
+static void
+print_time(bigtime_t time)
+{
+	time_t unixTime = time / 1000000 ;
+	struct tm timeInfo ;
+	localtime_r(&unixTime, &timeInfo) ;
+	printf("[%02d:%02d:%02d] ", timeInfo.tm_hour, timeInfo.tm_min,
+		timeInfo.tm_sec) ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: logdecode log.bin\n") ;
+		return 1 ;
+	}
+
+	FILE *file = fopen(argv[1], "rb") ;
+	if (file == NULL) {
+		fprintf(stderr, "%s: could not open\n", argv[1]) ;
+		return 1 ;
+	}
+
+	std::vector<std::string> formats ;
+	bool inSession = false ;
+	const char *problem = NULL ;
+	char arguments[65536] ;
+	char message[65536] ;
+
+	uint8 type ;
+	while (problem == NULL && fread(&type, 1, 1, file) == 1) {
+		// A session starts with the magic, whose first byte isn't a record
+		// type in either byte order.
+		if (type != kBinaryLogFormat && type != kBinaryLogMessage
+			&& type != kBinaryLogDropped) {
+			uint32 magic = 0 ;
+			uint8 version ;
+			((uint8*)&magic)[0] = type ;
+			if (!read_value(file, (uint8*)&magic + 1, sizeof(magic) - 1)
+				|| !read_value(file, &version, sizeof(version))
+				|| magic != kBinaryLogMagic) {
+				problem = "not a binary log" ;
+			} else if (version != kBinaryLogVersion)
+				problem = "unknown version" ;
+			formats.clear() ;
+			inSession = true ;
+			continue ;
+		}
+
+		if (!inSession) {
+			problem = "not a binary log" ;
+			continue ;
+		}
+
+		if (type == kBinaryLogFormat) {
+			uint32 id ;
+			uint16 length ;
+			if (!read_value(file, &id, sizeof(id))
+				|| !read_value(file, &length, sizeof(length))
+				|| !read_value(file, arguments, length)) {
+				problem = "truncated" ;
+				continue ;
+			}
+			if (id != formats.size()) {
+				problem = "format ids out of order" ;
+				continue ;
+			}
+			formats.push_back(std::string(arguments, length)) ;
+		} else if (type == kBinaryLogMessage) {
+			uint32 id ;
+			bigtime_t time ;
+			uint8 logClass ;
+			uint16 length ;
+			if (!read_value(file, &id, sizeof(id))
+				|| !read_value(file, &time, sizeof(time))
+				|| !read_value(file, &logClass, sizeof(logClass))
+				|| !read_value(file, &length, sizeof(length))
+				|| !read_value(file, arguments, length)) {
+				problem = "truncated" ;
+				continue ;
+			}
+			if (id >= formats.size()) {
+				problem = "message with an unknown format" ;
+				continue ;
+			}
+
+			decode_log_message(formats[id].c_str(), arguments, length,
+				message, sizeof(message)) ;
+			print_time(time) ;
+			const char *name = log_class_name(logClass) ;
+			if (name != NULL)
+				printf("%s: ", name) ;
+			printf("%s\n", message) ;
+		} else {
+			bigtime_t time ;
+			uint32 count ;
+			if (!read_value(file, &time, sizeof(time))
+				|| !read_value(file, &count, sizeof(count))) {
+				problem = "truncated" ;
+				continue ;
+			}
+
+			print_time(time) ;
+			printf("%lu messages were dropped, the log couldn't keep up\n",
+				(unsigned long)count) ;
+		}
+	}
+
+	fclose(file) ;
+
+	if (problem != NULL) {
+		fprintf(stderr, "%s: %s\n", argv[1], problem) ;
+		return 1 ;
+	}
+
+	return 0 ;
+}
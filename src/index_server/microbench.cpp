@@ -0,0 +1,588 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+// Times the helpers that run for every file a crawl sees: is_hidden(),
+// Feeder::Excluded(), to_wchar(), StringPositionIO and Feeder::GetNextRef().
+// StringPositionIO is timed next to BMallocIO, doing the same.
+// Each case is warmed up, then timed in a number of samples, and the
+// median is reported. Medians can be saved as a baseline and later runs
+// checked against it, failing when a case got slower than allowed.
+//
+//	microbench [-n samples] [-s baseline] [-c baseline] [-t percent]
+//		[case...]
+
+#include "Feeder.h"
+#include "StringPositionIO.h"
+#include "support.h"
+
+#include <Application.h>
+#include <DataIO.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <OS.h>
+#include <Path.h>
+
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+
+Logger *logger = NULL ;
+
+const bigtime_t kWarmUpTime = 200000 ;
+const bigtime_t kMinSampleTime = 20000 ;
+const int32 kDefaultSamples = 15 ;
+const double kDefaultThreshold = 10.0 ;
+const int32 kDeepPathLevels = 32 ;
+const size_t kStreamSize = 1024 * 1024 ;
+const size_t kChunkSize = 4096 ;
+
+
+typedef void (*bench_function)(void* cookie, int32 iterations) ;
+
+struct bench_case {
+	const char		*name ;
+	bench_function	function ;
+	void			*cookie ;
+} ;
+
+struct bench_result {
+	int32			iterations ;
+	double			median ;
+	double			minimum ;
+	double			mean ;
+	double			deviation ;
+} ;
+
+
+static volatile int32 sSink ;
+
+
+// Grants the cases access to the parts of Feeder they time.
+class FeederBench {
+	public:
+		static bool Excluded(Feeder* feeder, entry_ref* ref)
+		{
+			return feeder->Excluded(ref) ;
+		}
+
+		static void Exclude(Feeder* feeder, const entry_ref& ref)
+		{
+			feeder->fExcludeList.AddItem(new entry_ref(ref)) ;
+		}
+
+		static void ClearExclusions(Feeder* feeder)
+		{
+			entry_ref *ref ;
+			while ((ref = (entry_ref*)feeder->fExcludeList.RemoveItem(
+					(int32)0)) != NULL)
+				delete ref ;
+		}
+
+		static BList* Queue(Feeder* feeder)
+		{
+			return &feeder->fDeleteQueue ;
+		}
+
+		static status_t GetNextRef(Feeder* feeder, entry_ref* ref)
+		{
+			return feeder->GetNextRef(&feeder->fDeleteQueue, ref) ;
+		}
+} ;
+
+
+// #pragma mark - Cases
+
+
+struct ref_cookie {
+	entry_ref		ref ;
+} ;
+
+struct exclusion_cookie {
+	Feeder			*feeder ;
+	entry_ref		ref ;
+	std::vector<entry_ref>	exclusions ;
+} ;
+
+struct string_cookie {
+	std::string		text ;
+} ;
+
+struct stream_cookie {
+	BPositionIO		*stream ;
+	bool			mallocIO ;
+	char			chunk[kChunkSize] ;
+	uint32			state ;
+} ;
+
+struct queue_cookie {
+	Feeder			*feeder ;
+	int32			depth ;
+	entry_ref		ref ;
+} ;
+
+
+static void
+bench_is_hidden(void* cookie, int32 iterations)
+{
+	ref_cookie *data = (ref_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++)
+		sSink += is_hidden(&data->ref) ;
+}
+
+
+static void
+bench_excluded(void* cookie, int32 iterations)
+{
+	static exclusion_cookie *sInstalled = NULL ;
+
+	exclusion_cookie *data = (exclusion_cookie*)cookie ;
+	if (sInstalled != data) {
+		FeederBench::ClearExclusions(data->feeder) ;
+		for (size_t i = 0 ; i < data->exclusions.size() ; i++)
+			FeederBench::Exclude(data->feeder, data->exclusions[i]) ;
+		sInstalled = data ;
+	}
+
+	for (int32 i = 0 ; i < iterations ; i++)
+		sSink += FeederBench::Excluded(data->feeder, &data->ref) ;
+}
+
+
+static void
+bench_to_wchar(void* cookie, int32 iterations)
+{
+	string_cookie *data = (string_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		wchar_t *text = to_wchar(data->text.c_str()) ;
+		sSink += text != NULL ;
+		delete[] text ;
+	}
+}
+
+
+static void
+bench_stream_write(void* cookie, int32 iterations)
+{
+	// One iteration fills a stream a chunk at a time, as translators do.
+	stream_cookie *data = (stream_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		BPositionIO *stream = data->mallocIO
+			? (BPositionIO*)new BMallocIO : new StringPositionIO ;
+		for (size_t written = 0 ; written < kStreamSize ;
+				written += kChunkSize)
+			stream->Write(data->chunk, kChunkSize) ;
+		sSink += stream->Position() ;
+		delete stream ;
+	}
+}
+
+
+static void
+bench_stream_read_at(void* cookie, int32 iterations)
+{
+	stream_cookie *data = (stream_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		data->state = data->state * 1103515245 + 12345 ;
+		off_t position = (data->state >> 1) % (kStreamSize - kChunkSize) ;
+		data->stream->ReadAt(position, data->chunk, kChunkSize) ;
+		sSink += data->chunk[0] ;
+	}
+}
+
+
+static void
+bench_stream_read(void* cookie, int32 iterations)
+{
+	stream_cookie *data = (stream_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		if (data->stream->Position() + (off_t)kChunkSize >= (off_t)kStreamSize)
+			data->stream->Seek(0, SEEK_SET) ;
+		data->stream->Read(data->chunk, kChunkSize) ;
+		sSink += data->chunk[0] ;
+	}
+}
+
+
+static void
+bench_stream_scan(void* cookie, int32 iterations)
+{
+	// Counts the lines in place, the way the analyzer would go through
+	// the text without copying it out.
+	stream_cookie *data = (stream_cookie*)cookie ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		const char *text ;
+		size_t length ;
+		for (off_t position = 0 ; position < (off_t)kStreamSize ;
+				position += length) {
+			if (data->mallocIO) {
+				BMallocIO *stream = (BMallocIO*)data->stream ;
+				text = (const char*)stream->Buffer() ;
+				length = stream->BufferLength() ;
+			} else {
+				length = ((StringPositionIO*)data->stream)->GetSpan(position,
+					&text) ;
+			}
+
+			for (const char *end = text + length ;
+					(text = (const char*)memchr(text, '\n', end - text))
+						!= NULL ; text++)
+				sSink++ ;
+		}
+	}
+}
+
+
+static void
+bench_get_next_ref(void* cookie, int32 iterations)
+{
+	// Keeps the queue at the same depth: one ref in, one out.
+	queue_cookie *data = (queue_cookie*)cookie ;
+	BList *queue = FeederBench::Queue(data->feeder) ;
+	while (queue->CountItems() < data->depth)
+		queue->AddItem(new entry_ref(data->ref)) ;
+
+	entry_ref ref ;
+	for (int32 i = 0 ; i < iterations ; i++) {
+		queue->AddItem(new entry_ref(data->ref)) ;
+		sSink += FeederBench::GetNextRef(data->feeder, &ref) ;
+	}
+}
+
+
+// #pragma mark - Harness
+
+
+static double
+run_timed(const bench_case& benchCase, int32 iterations)
+{
+	bigtime_t start = system_time() ;
+	benchCase.function(benchCase.cookie, iterations) ;
+	return system_time() - start ;
+}
+
+
+static bench_result
+run_case(const bench_case& benchCase, int32 samples)
+{
+	// Find how many iterations make a sample long enough for the clock,
+	// then keep going until the caches and the allocator have settled.
+	int32 iterations = 1 ;
+	while (run_timed(benchCase, iterations) < kMinSampleTime
+		&& iterations < (1 << 30))
+		iterations *= 2 ;
+
+	bigtime_t warmUpEnd = system_time() + kWarmUpTime ;
+	while (system_time() < warmUpEnd)
+		run_timed(benchCase, iterations) ;
+
+	std::vector<double> times ;
+	for (int32 i = 0 ; i < samples ; i++)
+		times.push_back(run_timed(benchCase, iterations) * 1000 / iterations) ;
+	std::sort(times.begin(), times.end()) ;
+
+	bench_result result ;
+	result.iterations = iterations ;
+	result.minimum = times.front() ;
+	result.median = samples % 2 != 0 ? times[samples / 2]
+		: (times[samples / 2 - 1] + times[samples / 2]) / 2 ;
+
+	double sum = 0, squares = 0 ;
+	for (int32 i = 0 ; i < samples ; i++)
+		sum += times[i] ;
+	result.mean = sum / samples ;
+	for (int32 i = 0 ; i < samples ; i++)
+		squares += (times[i] - result.mean) * (times[i] - result.mean) ;
+	result.deviation = samples > 1 ? sqrt(squares / (samples - 1)) : 0 ;
+	return result ;
+}
+
+
+static bool
+load_baseline(const char* path, std::map<std::string, double>* baseline)
+{
+	FILE *file = fopen(path, "r") ;
+	if (file == NULL)
+		return false ;
+
+	char name[256] ;
+	double median ;
+	while (fscanf(file, "%255s %lf", name, &median) == 2)
+		(*baseline)[name] = median ;
+
+	fclose(file) ;
+	return true ;
+}
+
+
+static bool
+selected(const char* name, int argc, char** argv)
+{
+	if (optind == argc)
+		return true ;
+
+	for (int i = optind ; i < argc ; i++) {
+		if (strstr(name, argv[i]) != NULL)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+// #pragma mark - Inputs
+
+
+static bool
+make_file(const BPath& path, entry_ref* ref)
+{
+	BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE) ;
+	return file.InitCheck() == B_OK
+		&& get_ref_for_path(path.Path(), ref) == B_OK ;
+}
+
+
+static std::string
+make_utf8(size_t length)
+{
+	// Latin, Cyrillic, CJK and an emoji, so that every sequence length
+	// turns up.
+	static const char *kWords[] = {
+		"index ", "caf\xc3\xa9 ", "\xd0\xbf\xd0\xbe\xd0\xb8\xd1\x81\xd0\xba ",
+		"\xe6\xa4\x9c\xe7\xb4\xa2 ", "\xf0\x9f\x94\x8d ", "server "
+	} ;
+
+	std::string text ;
+	for (int32 i = 0 ; text.size() < length ; i++)
+		text += kWords[i % (sizeof(kWords) / sizeof(kWords[0]))] ;
+	return text ;
+}
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: microbench [-n samples] [-s baseline] "
+		"[-c baseline] [-t percent]\n\t[case...]\n") ;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 samples = kDefaultSamples ;
+	const char *savePath = NULL, *comparePath = NULL ;
+	double threshold = kDefaultThreshold ;
+
+	int opt ;
+	while ((opt = getopt(argc, argv, "n:s:c:t:")) != -1) {
+		switch (opt) {
+			case 'n': samples = atoi(optarg) ; break ;
+			case 's': savePath = optarg ; break ;
+			case 'c': comparePath = optarg ; break ;
+			case 't': threshold = atof(optarg) ; break ;
+			default:
+				usage() ;
+				return 1 ;
+		}
+	}
+	if (samples < 1) {
+		usage() ;
+		return 1 ;
+	}
+
+	std::map<std::string, double> baseline ;
+	if (comparePath != NULL && !load_baseline(comparePath, &baseline)) {
+		fprintf(stderr, "Could not read %s\n", comparePath) ;
+		return 1 ;
+	}
+
+	setlocale(LC_CTYPE, "") ;
+	BApplication app("application/x-vnd.Haiku-BeaconMicroBench") ;
+	logger = new Logger("/dev/null", BEACON_DEBUG_NORMAL) ;
+
+	// A shallow file, a hidden one, and one at the bottom of a deep tree
+	// with many excluded directories beside it.
+	BPath root ;
+	if (find_directory(B_SYSTEM_TEMP_DIRECTORY, &root) != B_OK
+		|| root.Append("beacon_microbench") != B_OK
+		|| create_directory(root.Path(), 0755) != B_OK) {
+		fprintf(stderr, "Could not create the test files\n") ;
+		return 1 ;
+	}
+
+	ref_cookie shallow, hidden, deep ;
+	BPath path(root) ;
+	path.Append("file.txt") ;
+	bool created = make_file(path, &shallow.ref) ;
+	path.SetTo(root.Path(), ".file.txt") ;
+	created = created && make_file(path, &hidden.ref) ;
+
+	std::vector<entry_ref> exclusions ;
+	path = root ;
+	for (int32 level = 0 ; level < kDeepPathLevels ; level++) {
+		char name[32] ;
+		snprintf(name, sizeof(name), "excluded%d", (int)level) ;
+		BPath excluded(path.Path(), name) ;
+		entry_ref ref ;
+		if (create_directory(excluded.Path(), 0755) == B_OK
+			&& get_ref_for_path(excluded.Path(), &ref) == B_OK)
+			exclusions.push_back(ref) ;
+
+		snprintf(name, sizeof(name), "level%d", (int)level) ;
+		path.Append(name) ;
+	}
+	for (int32 i = kDeepPathLevels ; i < 256 ; i++) {
+		char name[32] ;
+		snprintf(name, sizeof(name), "excluded%d", (int)i) ;
+		BPath excluded(root.Path(), name) ;
+		entry_ref ref ;
+		if (create_directory(excluded.Path(), 0755) == B_OK
+			&& get_ref_for_path(excluded.Path(), &ref) == B_OK)
+			exclusions.push_back(ref) ;
+	}
+	created = created && create_directory(path.Path(), 0755) == B_OK ;
+	path.Append("file.txt") ;
+	created = created && make_file(path, &deep.ref) ;
+	if (!created || exclusions.size() < 256) {
+		fprintf(stderr, "Could not create the test files in %s\n",
+			root.Path()) ;
+		return 1 ;
+	}
+
+	Feeder *feeder = new Feeder(&app) ;
+	feeder->Lock() ;
+
+	exclusion_cookie excluded1, excluded16, excluded256 ;
+	excluded1.feeder = excluded16.feeder = excluded256.feeder = feeder ;
+	excluded1.ref = excluded16.ref = excluded256.ref = deep.ref ;
+	excluded1.exclusions.assign(exclusions.begin(), exclusions.begin() + 1) ;
+	excluded16.exclusions.assign(exclusions.begin(),
+		exclusions.begin() + 16) ;
+	excluded256.exclusions = exclusions ;
+
+	string_cookie ascii, utf8 ;
+	ascii.text = "/boot/home/Documents/notes/2009/summer/index_server.txt" ;
+	utf8.text = make_utf8(64 * 1024) ;
+
+	stream_cookie writer, reader, mallocWriter, mallocReader ;
+	memset(writer.chunk, 'x', kChunkSize) ;
+	memset(mallocWriter.chunk, 'x', kChunkSize) ;
+	writer.mallocIO = reader.mallocIO = false ;
+	mallocWriter.mallocIO = mallocReader.mallocIO = true ;
+	reader.stream = new StringPositionIO ;
+	mallocReader.stream = new BMallocIO ;
+	std::string content = make_utf8(kStreamSize) ;
+	reader.stream->Write(content.data(), kStreamSize) ;
+	reader.stream->Seek(0, SEEK_SET) ;
+	reader.state = 1 ;
+	mallocReader.stream->Write(content.data(), kStreamSize) ;
+	mallocReader.stream->Seek(0, SEEK_SET) ;
+	mallocReader.state = 1 ;
+
+	queue_cookie queue10, queue1000, queue20000 ;
+	queue10.feeder = queue1000.feeder = queue20000.feeder = feeder ;
+	queue10.ref = queue1000.ref = queue20000.ref = deep.ref ;
+	queue10.depth = 10 ;
+	queue1000.depth = 1000 ;
+	queue20000.depth = 20000 ;
+
+	bench_case cases[] = {
+		{ "is_hidden/shallow", bench_is_hidden, &shallow },
+		{ "is_hidden/dot_name", bench_is_hidden, &hidden },
+		{ "is_hidden/deep_32", bench_is_hidden, &deep },
+		{ "excluded/1", bench_excluded, &excluded1 },
+		{ "excluded/16", bench_excluded, &excluded16 },
+		{ "excluded/256", bench_excluded, &excluded256 },
+		{ "to_wchar/path", bench_to_wchar, &ascii },
+		{ "to_wchar/utf8_64k", bench_to_wchar, &utf8 },
+		{ "string_io/write_1m", bench_stream_write, &writer },
+		{ "string_io/read_at_4k", bench_stream_read_at, &reader },
+		{ "string_io/seek_read_4k", bench_stream_read, &reader },
+		{ "string_io/scan_1m", bench_stream_scan, &reader },
+		{ "malloc_io/write_1m", bench_stream_write, &mallocWriter },
+		{ "malloc_io/read_at_4k", bench_stream_read_at, &mallocReader },
+		{ "malloc_io/seek_read_4k", bench_stream_read, &mallocReader },
+		{ "malloc_io/scan_1m", bench_stream_scan, &mallocReader },
+		{ "get_next_ref/10", bench_get_next_ref, &queue10 },
+		{ "get_next_ref/1000", bench_get_next_ref, &queue1000 },
+		{ "get_next_ref/20000", bench_get_next_ref, &queue20000 },
+	} ;
+
+	FILE *save = NULL ;
+	if (savePath != NULL && (save = fopen(savePath, "w")) == NULL) {
+		fprintf(stderr, "Could not write %s\n", savePath) ;
+		return 1 ;
+	}
+
+	printf("%-24s %10s %12s %12s %12s %7s %9s\n", "case", "iterations",
+		"median ns", "min ns", "mean ns", "rsd %", "change %") ;
+
+	int32 regressions = 0 ;
+	for (size_t i = 0 ; i < sizeof(cases) / sizeof(cases[0]) ; i++) {
+		if (!selected(cases[i].name, argc, argv))
+			continue ;
+
+		// Each queue depth starts from an empty queue.
+		entry_ref ref ;
+		while (FeederBench::GetNextRef(feeder, &ref) == B_OK)
+			;
+
+		bench_result result = run_case(cases[i], samples) ;
+		printf("%-24s %10d %12.1f %12.1f %12.1f %7.1f", cases[i].name,
+			(int)result.iterations, result.median, result.minimum,
+			result.mean, result.mean > 0
+				? result.deviation * 100 / result.mean : 0) ;
+
+		std::map<std::string, double>::iterator previous
+			= baseline.find(cases[i].name) ;
+		if (previous != baseline.end() && previous->second > 0) {
+			double change = (result.median - previous->second) * 100
+				/ previous->second ;
+			printf(" %+9.1f", change) ;
+			if (change > threshold) {
+				printf("  REGRESSION") ;
+				regressions++ ;
+			}
+		}
+		printf("\n") ;
+
+		if (save != NULL)
+			fprintf(save, "%s %.1f\n", cases[i].name, result.median) ;
+	}
+
+	if (save != NULL)
+		fclose(save) ;
+
+	entry_ref ref ;
+	while (FeederBench::GetNextRef(feeder, &ref) == B_OK)
+		;
+	FeederBench::ClearExclusions(feeder) ;
+	feeder->Quit() ;
+	delete reader.stream ;
+	delete mallocReader.stream ;
+	logger->Close() ;
+
+	if (regressions > 0) {
+		fprintf(stderr, "%d cases are more than %g%% slower than %s\n",
+			(int)regressions, threshold, comparePath) ;
+		return 1 ;
+	}
+
+	return 0 ;
+}
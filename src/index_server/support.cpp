@@ -69,9 +69,22 @@ Logger* open_log(DebugLevel level, bool replace)
 	if(find_directory(B_USER_CONFIG_DIRECTORY, &logPath) == B_OK) {
 		logPath.Append("settings/index_server/") ;
 		if(create_directory(logPath.Path(), 0777) == B_OK) {
-			logPath.Append("log.txt") ;
-
-			logger = new Logger(logPath.Path(), level, replace) ;
+			BMessage settings ;
+			bool loaded = load_settings(&settings) == B_OK ;
+
+			// Read back with logdecode.
+			bool binary ;
+			if (!loaded || settings.FindBool("binary_log", &binary) != B_OK)
+				binary = false ;
+			logPath.Append(binary ? "log.bin" : "log.txt") ;
+
+			logger = new Logger(logPath.Path(), level, replace, binary) ;
+
+			// Losing a line beats holding up the indexer, unless asked.
+			bool blockWhenFull ;
+			if (loaded && settings.FindBool("log_block_when_full",
+					&blockWhenFull) == B_OK && blockWhenFull)
+				logger->SetOverflowPolicy(BEACON_LOG_BLOCK) ;
 		}
 	}
 
@@ -90,6 +103,30 @@ wchar_t* to_wchar(const char *str)
 		return wStr ;
 }
 
+// Reads up to maxLength bytes of text, less if that would cut a
+// multibyte character in half, with a NUL after them.
+char* read_excerpt(BPositionIO *text, int32 maxLength)
+{
+	if (maxLength <= 0)
+		return NULL ;
+
+	char *buffer = new char[maxLength + 1] ;
+	ssize_t length = text->ReadAt(0, buffer, maxLength) ;
+	if (length <= 0) {
+		delete[] buffer ;
+		return NULL ;
+	}
+
+	if (length == maxLength) {
+		while (length > 0 && (buffer[length - 1] & 0xc0) == 0x80)
+			length-- ;
+		if (length > 0 && (buffer[length - 1] & 0x80) != 0)
+			length-- ;
+	}
+	buffer[length] = '\0' ;
+	return buffer ;
+}
+
 bool is_hidden(entry_ref *ref)
 {	
 	if(ref->name[0] == '.')
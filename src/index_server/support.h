@@ -15,6 +15,7 @@
 #include <cstring>
 #include <cstdlib>
 
+#include <DataIO.h>
 #include <Message.h>
 
 
@@ -24,6 +25,7 @@ status_t load_settings(BMessage *message) ;
 status_t save_settings(BMessage *message) ;
 Logger* open_log(DebugLevel level, bool replace) ;
 wchar_t* to_wchar(const char *str) ;
+char* read_excerpt(BPositionIO *text, int32 maxLength) ;
 bool is_hidden(entry_ref *ref) ;
 
 #endif /* _SUPPORT_H */
@@ -7,12 +7,19 @@
  */
 
 #include "../constants.h"
+#include "../shared/Metrics.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <unistd.h>
 
+#include <Looper.h>
 #include <Message.h>
 #include <Messenger.h>
+#include <OS.h>
+#include <Path.h>
+#include <String.h>
 
 
 void usage()
@@ -23,9 +30,12 @@ void usage()
 		"  -call\t\t\tcall commit on all volumes\n"
 		"  -c <path-to-volume>\tcall commit on <path-to-volume>\n"
 		"  -rall\t\t\treindex all\n"
-		"  -r <path-to-volume>\treindex <path-to-volume>\n"
-		"  -e <path-to-volume>\texclude (for this session only)\n"
-		"  -E <path-to-volume>\texclude permanently\n"
+		"  -r <directory>\t\treindex everything under <directory>\n"
+		"  -e <directory>\t\texclude (for this session only)\n"
+		"  -E <directory>\t\texclude permanently\n"
+		"  -s [json]\t\tprint the indexer's and searchapp's metrics\n"
+		"  -T <n>\t\ttrace one in <n> documents and queries, 0 for none\n"
+		"  -t <directory>\twrite the traces to <directory>\n"
 		"  -h\t\t\tprint this message\n"
 	) ;
 }
@@ -57,56 +67,327 @@ void quitIndexer()
 }
 
 
-void reindex(const char* optarg)
+// Adds the path as "volume", made absolute with BPath, as the server's
+// current directory isn't ours. "all" goes as it is where it is allowed.
+status_t addPath(BMessage* message, const char* path, bool allowAll)
+{
+	if (allowAll && strcmp(path, "all") == 0)
+		return message->AddString("volume", path) ;
+
+	BPath absolutePath ;
+	status_t err = absolutePath.SetTo(path) ;
+	if (err != B_OK) {
+		fprintf(stderr, "%s: %s\n", path, strerror(err)) ;
+		return err ;
+	}
+
+	return message->AddString("volume", absolutePath.Path()) ;
+}
+
+
+// Returns what main() exits with, 0 if the request went through.
+int checkReply(status_t sendError, const BMessage* reply, const char* what,
+	const char* path)
+{
+	if (sendError == B_BAD_PORT_ID) {
+		fprintf(stderr, "index_server not running\n") ;
+		return 1 ;
+	}
+
+	int32 error = sendError ;
+	if (error == B_OK && reply->FindInt32("error", &error) != B_OK)
+		error = B_ERROR ;
+	if (error == B_OK)
+		return 0 ;
+
+	fprintf(stderr, "Could not %s %s: %s\n", what, path,
+		error == BEACON_FILE_EXCLUDED ? "it is excluded" : strerror(error)) ;
+	return 1 ;
+}
+
+
+// Prints the progress index_server reports while it reindexes, and
+// keeps the reply that comes once it is done.
+class ReindexWatcher : public BLooper {
+	public:
+		ReindexWatcher()
+			: BLooper("reindex watcher"),
+			  fDone(create_sem(0, "reindex done"))
+		{
+		}
+
+		virtual ~ReindexWatcher()
+		{
+			delete_sem(fDone) ;
+		}
+
+		virtual void MessageReceived(BMessage* message)
+		{
+			if (message->what != BEACON_REINDEX_PROGRESS) {
+				// The reply, or B_NO_REPLY if index_server went away.
+				fReply = *message ;
+				release_sem(fDone) ;
+				return ;
+			}
+
+			const char *path ;
+			int32 visited, queued, removed ;
+			if (message->FindString("path", &path) == B_OK
+				&& message->FindInt32("visited", &visited) == B_OK
+				&& message->FindInt32("queued", &queued) == B_OK
+				&& message->FindInt32("removed", &removed) == B_OK)
+				printf("%s: %ld files visited, %ld new or changed, %ld "
+					"removed\n", path, (long)visited, (long)queued,
+					(long)removed) ;
+		}
+
+		BMessage* WaitForReply()
+		{
+			while (acquire_sem(fDone) == B_INTERRUPTED)
+				;
+			return &fReply ;
+		}
+
+	private:
+		sem_id		fDone ;
+		BMessage	fReply ;
+} ;
+
+
+int reindex(const char* optarg)
 {	
 	BMessenger messenger(APP_SIGNATURE) ;
-	BMessage reindexMessage(BEACON_REINDEX), reply ;
-	status_t err ;
+	BMessage reindexMessage(BEACON_REINDEX) ;
 
-	if (optarg != NULL)
-		reindexMessage.AddString("volume", optarg) ;
-	
-	if ((err = messenger.SendMessage(&reindexMessage, &reply)) == B_OK)
-		printf("BEACON_REINDEX sent\n") ;
-	else if (err == B_BAD_PORT_ID)
-		printf("index_server not running\n") ;
+	if (addPath(&reindexMessage, optarg, true) != B_OK)
+		return 1 ;
+
+	// The reply comes once everything is indexed, which may take a while.
+	// Progress reports go to the same place until then.
+	ReindexWatcher *watcher = new ReindexWatcher ;
+	watcher->Run() ;
+	status_t err = messenger.SendMessage(&reindexMessage, watcher) ;
+	BMessage reply ;
+	if (err == B_OK)
+		reply = *watcher->WaitForReply() ;
+	watcher->Lock() ;
+	watcher->Quit() ;
+
+	int result = checkReply(err, &reply, "reindex", optarg) ;
+
+	const char *path ;
+	int32 indexed, previouslyIndexed, removed ;
+	int64 elapsed ;
+	for (int32 i = 0 ; reply.FindString("path", i, &path) == B_OK ; i++) {
+		if (reply.FindInt32("indexed", i, &indexed) != B_OK
+			|| reply.FindInt32("previously_indexed", i, &previouslyIndexed)
+				!= B_OK
+			|| reply.FindInt32("removed", i, &removed) != B_OK
+			|| reply.FindInt64("elapsed", i, &elapsed) != B_OK)
+			continue ;
+
+		printf("%s: %ld new or changed files indexed, %ld were indexed "
+			"before and %ld of those removed, in %.1f s\n", path,
+			(long)indexed, (long)previouslyIndexed, (long)removed,
+			elapsed / 1000000.0) ;
+	}
+
+	return result ;
 }
 
 
-void commit(const char* optarg)
+int commit(const char* optarg)
 {	
 	BMessenger messenger(APP_SIGNATURE) ;
 	BMessage commitMessage(BEACON_COMMIT), reply ;
-	status_t err ;
 
-	if (optarg != NULL)
-		commitMessage.AddString("volume", optarg) ;
-	
-	if ((err = messenger.SendMessage(&commitMessage, &reply)) == B_OK)
-		printf("BEACON_COMMIT sent\n") ;
-	else if (err == B_BAD_PORT_ID)
-		printf("index_server not running\n") ;
+	if (addPath(&commitMessage, optarg, true) != B_OK)
+		return 1 ;
+
+	int result = checkReply(messenger.SendMessage(&commitMessage, &reply),
+		&reply, "commit", optarg) ;
+
+	int64 elapsed ;
+	if (result == 0 && reply.FindInt64("elapsed", &elapsed) == B_OK)
+		printf("Committed %s in %.1f s\n", optarg, elapsed / 1000000.0) ;
+
+	return result ;
 }
 
 
-void exclude(const char* optarg, bool forever=false)
+int exclude(const char* optarg, bool forever=false)
 {	
 	BMessenger messenger(APP_SIGNATURE) ;
 	BMessage excludeMessage(BEACON_EXCLUDE), reply ;
-	status_t err ;
 
-	if (optarg != NULL)
-		excludeMessage.AddString("volume", optarg) ;
+	if (addPath(&excludeMessage, optarg, false) != B_OK)
+		return 1 ;
 	
 	if (forever == false)
 		excludeMessage.AddBool("forever", false) ;
 	else
 		excludeMessage.AddBool("forever", true) ;
 	
-	if ((err = messenger.SendMessage(&excludeMessage, &reply)) == B_OK)
-		printf("BEACON_EXCLUDE sent\n") ;
-	else if (err == B_BAD_PORT_ID)
-		printf("index_server not running\n") ;
+	int result = checkReply(messenger.SendMessage(&excludeMessage, &reply),
+		&reply, "exclude", optarg) ;
+	if (result == 0)
+		printf("Excluded %s%s\n", optarg,
+			forever ? "" : " until index_server restarts") ;
+
+	return result ;
+}
+
+
+void printJSONString(const char* string)
+{
+	putchar('"') ;
+	for (const char *c = string ; *c != '\0' ; c++) {
+		if (*c == '"' || *c == '\\')
+			printf("\\%c", *c) ;
+		else if ((unsigned char)*c < 0x20)
+			printf("\\u%04x", *c) ;
+		else
+			putchar(*c) ;
+	}
+	putchar('"') ;
+}
+
+
+void printMetrics(const BMessage* metrics, bool json)
+{
+	const char *histogramFields[] = { "count", "p50", "p90", "p99", "p999",
+		"max", "sum" } ;
+	int32 fieldCount = sizeof(histogramFields) / sizeof(histogramFields[0]) ;
+
+	bigtime_t uptime = 0 ;
+	metrics->FindInt64("uptime", &uptime) ;
+	if (json)
+		printf("{\"uptime\": %lld, \"metrics\": [", (long long)uptime) ;
+
+	BMessage metric ;
+	for (int32 i = 0 ; metrics->FindMessage("metric", i, &metric) == B_OK ;
+			i++) {
+		const char *name, *unit ;
+		int32 type ;
+		int64 value ;
+		if (metric.FindString("name", &name) != B_OK
+			|| metric.FindString("unit", &unit) != B_OK
+			|| metric.FindInt32("type", &type) != B_OK)
+			continue ;
+
+		if (json) {
+			printf(i > 0 ? ",\n  {\"name\": " : "\n  {\"name\": ") ;
+			printJSONString(name) ;
+			printf(", \"type\": \"%s\", \"unit\": ",
+				type == BEACON_METRIC_COUNTER ? "counter"
+					: type == BEACON_METRIC_GAUGE ? "gauge" : "histogram") ;
+			printJSONString(unit) ;
+			if (type == BEACON_METRIC_HISTOGRAM) {
+				for (int32 j = 0 ; j < fieldCount ; j++) {
+					if (metric.FindInt64(histogramFields[j], &value) == B_OK)
+						printf(", \"%s\": %lld", histogramFields[j],
+							(long long)value) ;
+				}
+			} else if (metric.FindInt64("value", &value) == B_OK)
+				printf(", \"value\": %lld", (long long)value) ;
+			printf("}") ;
+			continue ;
+		}
+
+		printf("  %-40s", name) ;
+		if (type == BEACON_METRIC_HISTOGRAM) {
+			// Sums of latencies mean little, leave them to the JSON.
+			for (int32 j = 0 ; j < fieldCount - 1 ; j++) {
+				if (metric.FindInt64(histogramFields[j], &value) == B_OK)
+					printf(" %s %lld", histogramFields[j], (long long)value) ;
+			}
+			printf(" %s\n", unit) ;
+		} else if (metric.FindInt64("value", &value) == B_OK) {
+			printf(" %12lld %s", (long long)value, unit) ;
+			if (type == BEACON_METRIC_COUNTER && uptime > 0)
+				printf(", %.1f/s", value * 1000000.0 / uptime) ;
+			printf("\n") ;
+		}
+	}
+
+	if (json)
+		printf("\n]}") ;
+}
+
+
+void dumpMetrics(bool json)
+{
+	const char *signatures[] = { APP_SIGNATURE, SEARCHAPP_SIGNATURE } ;
+	const char *names[] = { "index_server", "searchapp" } ;
+	bool printed = false ;
+
+	if (json)
+		printf("{") ;
+
+	for (int32 i = 0 ; i < 2 ; i++) {
+		BMessenger messenger(signatures[i]) ;
+		BMessage request(BEACON_METRICS), reply ;
+		if (!messenger.IsValid()) {
+			// searchapp is only there while someone is searching.
+			if (i == 0)
+				fprintf(stderr, "index_server not running\n") ;
+			continue ;
+		}
+		if (messenger.SendMessage(&request, &reply, 1000000, 1000000)
+				!= B_OK)
+			continue ;
+
+		if (json) {
+			printf(printed ? ",\n\"%s\": " : "\n\"%s\": ", names[i]) ;
+			printMetrics(&reply, true) ;
+		} else {
+			bigtime_t uptime = 0 ;
+			reply.FindInt64("uptime", &uptime) ;
+			printf("%s%s, up %lld s\n", printed ? "\n" : "", names[i],
+				(long long)(uptime / 1000000)) ;
+			printMetrics(&reply, false) ;
+		}
+		printed = true ;
+	}
+
+	if (json)
+		printf("\n}\n") ;
+}
+
+
+void trace(const char* directory, int32 sampleEvery)
+{
+	const char *signatures[] = { APP_SIGNATURE, SEARCHAPP_SIGNATURE } ;
+	const char *names[] = { "index_server", "searchapp" } ;
+
+	for (int32 i = 0 ; i < 2 ; i++) {
+		BMessenger messenger(signatures[i]) ;
+		BMessage traceMessage(BEACON_TRACE), reply ;
+		if (!messenger.IsValid()) {
+			if (i == 0)
+				printf("index_server not running\n") ;
+			continue ;
+		}
+
+		// BPath makes the path absolute, the server's current directory
+		// isn't ours.
+		BPath path ;
+		if (directory != NULL) {
+			BString name(names[i]) ;
+			name << ".json" ;
+			path.SetTo(directory, name.String()) ;
+			traceMessage.AddString("path", path.Path()) ;
+		} else
+			traceMessage.AddInt32("sample_every", sampleEvery) ;
+
+		int32 error ;
+		if (messenger.SendMessage(&traceMessage, &reply) != B_OK)
+			continue ;
+		if (reply.FindInt32("error", &error) == B_OK && error != B_OK)
+			printf("%s could not write %s\n", names[i], path.Path()) ;
+		else if (directory != NULL)
+			printf("wrote %s\n", path.Path()) ;
+	}
 }
 
 
@@ -117,8 +398,8 @@ int main(int argc, char **argv)
 		return 0 ;
 	}
 	
-	int opt ;
-	opt = getopt(argc, argv, "pqr:c:e:E:") ;
+	int opt, result = 0 ;
+	opt = getopt(argc, argv, "pqr:c:e:E:st:T:") ;
 	switch (opt) {
 		case 'p':
 			pauseIndexer() ;
@@ -127,16 +408,25 @@ int main(int argc, char **argv)
 			quitIndexer() ;
 			break ;
 		case 'r':
-			reindex(optarg) ;
+			result = reindex(optarg) ;
 			break ;
 		case 'c':
-			commit(optarg) ;
+			result = commit(optarg) ;
 			break ;
 		case 'e':
-			exclude(optarg) ;
+			result = exclude(optarg) ;
 			break ;
 		case 'E':
-			exclude(optarg, true) ;
+			result = exclude(optarg, true) ;
+			break ;
+		case 's':
+			dumpMetrics(optind < argc && strcmp(argv[optind], "json") == 0) ;
+			break ;
+		case 't':
+			trace(optarg, 0) ;
+			break ;
+		case 'T':
+			trace(NULL, atoi(optarg)) ;
 			break ;
 		case 'h':
 		default:
@@ -144,5 +434,5 @@ int main(int argc, char **argv)
 			break ;
 	}
 	
-	return 0 ;
+	return result ;
 }
@@ -7,44 +7,239 @@
  */
 
 #include "BeaconSearcher.h"
+#include "FuzzyExpander.h"
+#include "SnippetGenerator.h"
+#include "WandSearcher.h"
+#include "../constants.h"
+#include "../engine/WordTokenizer.h"
+#include "../shared/Metrics.h"
+#include "../shared/Trace.h"
 
+#include <cstdlib>
 #include <cstring>
 
 #include <Alert.h>
+#include <File.h>
+#include <Messenger.h>
+#include <OS.h>
 #include <VolumeRoster.h>
 
 using namespace lucene::document ;
 using namespace lucene::search ;
 using namespace lucene::index ;
 using namespace lucene::queryParser ;
+using namespace lucene::util ;
+using namespace lucene::analysis ;
+
+
+const int32 kMaxNameHits = 50 ;
+const int32 kMaxExpansions = 64 ;
+const int32 kSuggestionThreshold = 5 ;
+const int32 kMaxSnippets = 50 ;
+const int32 kMaxContentHits = 100 ;
+// Chunks of one file are one hit, an index is asked for more and more
+// hits, up to this many, until it gives kMaxContentHits files.
+const int32 kMaxFetchedHits = 16 * kMaxContentHits ;
+const int32 kMaxNativeClauses = 32 ;
+
+static MetricHistogram sQueryLatency("query_latency") ;
+
+
+static bool
+match_metadata(const stored_document* document, void* cookie)
+{
+	return ((MetadataFilter*)cookie)->Matches(document->path,
+		document->mimeType, document->size, document->modified) ;
+}
 
 
 BeaconSearcher::BeaconSearcher()
+	: fNameHits(0),
+	  fFuzzy(false)
+{
+	Refresh() ;
+}
+
+
+BeaconSearcher::~BeaconSearcher()
 {
+	IndexSearcher *indexSearcher ;
+	while(fSearcherList.CountItems() > 0) {
+		indexSearcher = (IndexSearcher*)fSearcherList.ItemAt(0) ;
+		CloseSearcher(indexSearcher) ;
+		fSearcherList.RemoveItem((int32)0) ;
+	}
+
+	for (int32 i = 0 ; i < fIndexes.CountItems() ; i++)
+		delete (index_info*)fIndexes.ItemAt(i) ;
+	for (int32 i = 0 ; i < fNativeIndexes.CountItems() ; i++)
+		delete (NativeIndex*)fNativeIndexes.ItemAt(i) ;
+
+	ClearHits() ;
+}
+
+
+void
+BeaconSearcher::Refresh()
+{
+	// Searchers stay open between searches. An index is only opened again
+	// when index_server has published a new version of it, and only if
+	// what we open is that version: half way through a batch, the old
+	// snapshot is kept and the next search tries again.
 	BVolumeRoster volumeRoster ;
 	BVolume volume ;
-	IndexSearcher *indexSearcher ;
-	char* indexPath ;
-	
+	BList searchers, indexes, nativeIndexes ;
+	char *indexPath ;
+
 	while(volumeRoster.GetNextVolume(&volume) == B_OK) {
 		indexPath = GetIndexPath(&volume) ;
-		
-		if(indexPath != NULL) {
-			indexSearcher = new IndexSearcher(indexPath) ;
-			fSearcherList.AddItem(indexSearcher) ;
+		if (indexPath == NULL)
+			continue ;
+
+		if (NativeIndex::Exists(indexPath)) {
+			RefreshNative(indexPath, &nativeIndexes) ;
+			delete[] indexPath ;
+			continue ;
 		}
+
+		IndexSearcher *indexSearcher = NULL ;
+		index_info *info = NULL ;
+		for (int32 i = 0 ; i < fIndexes.CountItems() ; i++) {
+			info = (index_info*)fIndexes.ItemAt(i) ;
+			if (info != NULL && strcmp(info->path, indexPath) == 0) {
+				indexSearcher = (IndexSearcher*)fSearcherList.ItemAt(i) ;
+				fSearcherList.ReplaceItem(i, NULL) ;
+				fIndexes.ReplaceItem(i, NULL) ;
+				break ;
+			}
+			info = NULL ;
+		}
+
+		// Indexes written before versions were published are checked
+		// against their segments file instead.
+		int64 published = ReadPublished(indexPath) ;
+		int64 current = published ;
+		if (current < 0)
+			current = IndexReader::getCurrentVersion(indexPath) ;
+
+		if (info == NULL || info->version != current) {
+			IndexSearcher *fresh = OpenSearcher(indexPath) ;
+
+			int64 version = fresh != NULL ? fresh->getReader()->getVersion()
+				: -1 ;
+			if (fresh != NULL && (indexSearcher == NULL || published < 0
+				|| version == published)) {
+				if (indexSearcher != NULL)
+					CloseSearcher(indexSearcher) ;
+				indexSearcher = fresh ;
+
+				if (info == NULL) {
+					info = new index_info ;
+					strcpy(info->path, indexPath) ;
+				}
+				info->version = version ;
+			} else if (fresh != NULL)
+				CloseSearcher(fresh) ;
+		}
+
+		if (indexSearcher != NULL) {
+			searchers.AddItem(indexSearcher) ;
+			indexes.AddItem(info) ;
+		}
+		delete[] indexPath ;
+	}
+
+	// Whatever is left belongs to volumes that have gone away.
+	for (int32 i = 0 ; i < fSearcherList.CountItems() ; i++) {
+		IndexSearcher *indexSearcher
+			= (IndexSearcher*)fSearcherList.ItemAt(i) ;
+		if (indexSearcher != NULL)
+			CloseSearcher(indexSearcher) ;
+		delete (index_info*)fIndexes.ItemAt(i) ;
 	}
+
+	fSearcherList.MakeEmpty() ;
+	fSearcherList.AddList(&searchers) ;
+	fIndexes.MakeEmpty() ;
+	fIndexes.AddList(&indexes) ;
+
+	for (int32 i = 0 ; i < fNativeIndexes.CountItems() ; i++)
+		delete (NativeIndex*)fNativeIndexes.ItemAt(i) ;
+	fNativeIndexes.MakeEmpty() ;
+	fNativeIndexes.AddList(&nativeIndexes) ;
 }
 
 
-BeaconSearcher::~BeaconSearcher()
+void
+BeaconSearcher::RefreshNative(const char* indexPath, BList* nativeIndexes)
 {
-	IndexSearcher *indexSearcher ;
-	while(fSearcherList.CountItems() > 0) {
-		indexSearcher = (IndexSearcher*)fSearcherList.ItemAt(0) ;
-		indexSearcher->close() ;
-		fSearcherList.RemoveItem((int32)0) ;
+	// A native index only ever shows whole commits, so it can move on to
+	// the latest one whenever it likes.
+	NativeIndex *index ;
+	for (int32 i = 0 ; (index = (NativeIndex*)fNativeIndexes.ItemAt(i))
+		!= NULL ; i++) {
+		if (strcmp(index->Directory(), indexPath) == 0) {
+			fNativeIndexes.RemoveItem(i) ;
+			index->Refresh() ;
+			nativeIndexes->AddItem(index) ;
+			return ;
+		}
 	}
+
+	index = new NativeIndex ;
+	if (index->Open(indexPath, false) == B_OK)
+		nativeIndexes->AddItem(index) ;
+	else
+		delete index ;
+}
+
+
+IndexSearcher*
+BeaconSearcher::OpenSearcher(const char* indexPath)
+{
+	IndexReader *reader = NULL ;
+	try {
+		reader = IndexReader::open(indexPath) ;
+	} catch (CLuceneError &error) {
+		// Most likely caught in the middle of a write.
+		return NULL ;
+	}
+
+	return new IndexSearcher(reader) ;
+}
+
+
+void
+BeaconSearcher::CloseSearcher(IndexSearcher* indexSearcher)
+{
+	// The searcher doesn't own a reader it was given.
+	IndexReader *reader = indexSearcher->getReader() ;
+	indexSearcher->close() ;
+	delete indexSearcher ;
+	reader->close() ;
+	delete reader ;
+}
+
+
+int64
+BeaconSearcher::ReadPublished(const char* indexPath)
+{
+	BPath path(indexPath, BEACON_PUBLISHED_FILE) ;
+	BFile file(path.Path(), B_READ_ONLY) ;
+	int64 version ;
+	if (file.Read(&version, sizeof(version)) != sizeof(version))
+		return -1 ;
+
+	return version ;
+}
+
+
+void
+BeaconSearcher::ClearHits()
+{
+	wchar_t *path ;
+	while ((path = GetNextHit()) != NULL)
+		delete[] path ;
 }
 
 
@@ -56,7 +251,8 @@ BeaconSearcher::GetIndexPath(BVolume *volume)
 	BPath path(&dir) ;
 	path.Append("index/") ;
 	
-	if(IndexReader::indexExists(path.Path())) {
+	if(IndexReader::indexExists(path.Path())
+		|| NativeIndex::Exists(path.Path())) {
 		char *indexPath = new char[B_PATH_NAME_LENGTH] ;
 		strcpy(indexPath, path.Path()) ;
 		return indexPath ;
@@ -69,18 +265,43 @@ BeaconSearcher::GetIndexPath(BVolume *volume)
 void
 BeaconSearcher::Search(const char* stringQuery)
 {
+	bigtime_t start = system_time() ;
+	TraceSpan span("search", stringQuery, TRACE_SAMPLE) ;
+
+	// Pull "type:", "size:", "modified:" and "sort:" out of the query,
+	// everything else is searched for in the contents.
+	TraceSpan refreshSpan("refresh") ;
+	Refresh() ;
+	refreshSpan.End() ;
+	ClearHits() ;
+
+	MetadataFilter filter ;
+	Sort *sort = NULL ;
+	BString contentQuery ;
+	ParseQuery(stringQuery, &contentQuery, &filter, &sort) ;
+
+	// Files whose names match come first, followed by content hits. Name
+	// hits know nothing about metadata, so they are left out of filtered
+	// searches.
+	fNameHits = 0 ;
+	if (filter.IsEmpty() && contentQuery.Length() > 0) {
+		TraceSpan namesSpan("search_names") ;
+		SearchNames(contentQuery.String()) ;
+	}
+	fSuggestion = "" ;
+
 	// CLucene expects wide characters everywhere.
-	int size = strlen(stringQuery) * sizeof(wchar_t) ;
+	int size = (contentQuery.Length() + 1) * sizeof(wchar_t) ;
 	wchar_t *wStringQuery = new wchar_t[size] ;
-	if (mbstowcs(wStringQuery, stringQuery, size) == -1)
+	if (mbstowcs(wStringQuery, contentQuery.String(), size) == (size_t)-1) {
+		delete[] wStringQuery ;
+		delete sort ;
 		return ;
+	}
 
 	IndexSearcher *indexSearcher ;
 	Hits *hits ;
 	Query *luceneQuery ;
-	Document doc ;
-	Field *field ;
-	wchar_t *path ;
 	
 	/*
 	luceneQuery = QueryParser::parse(wStringQuery, _T("contents"),
@@ -95,30 +316,547 @@ BeaconSearcher::Search(const char* stringQuery)
 		fHits.AddItem(path) ;
 	}*/
 	
+	BList tokens ;
+	AnalyzeQuery(wStringQuery, &tokens) ;
+	SnippetGenerator snippetGenerator(&tokens) ;
+
+	// Plain words make an OR of terms, which can skip over most of the
+	// documents that can't make it into the first page.
+	BList terms ;
+	bool topDocs = !fFuzzy && sort == NULL
+		&& PlainTerms(contentQuery.String(), &terms) ;
+
 	for(int i = 0 ; (indexSearcher = (IndexSearcher*)fSearcherList.ItemAt(i))
 		!= NULL ; i++) {
-		luceneQuery = QueryParser::parse(wStringQuery, _T("contents"),
-			&fStandardAnalyzer) ;
+		TraceSpan indexSpan("search_index",
+			((index_info*)fIndexes.ItemAt(i))->path) ;
+		if (topDocs) {
+			SearchTopDocs(indexSearcher->getReader(),
+				((index_info*)fIndexes.ItemAt(i))->path, &terms, &filter,
+				&snippetGenerator) ;
+			continue ;
+		}
+
+		if (contentQuery.Length() == 0) {
+			// Only metadata to go by: every document has a type, and the
+			// filter does the rest.
+			Term *term = new Term(_T("mime"), _T("")) ;
+			luceneQuery = new PrefixQuery(term) ;
+			_CLDECDELETE(term) ;
+		} else if (fFuzzy) {
+			luceneQuery = FuzzyQuery(indexSearcher->getReader(), &tokens) ;
+			if (luceneQuery == NULL)
+				continue ;
+		} else {
+			try {
+				luceneQuery = QueryParser::parse(wStringQuery, _T("contents"),
+					&fStandardAnalyzer) ;
+			} catch (CLuceneError &error) {
+				// Not a valid content query, e.g. a bare file name pattern.
+				break ;
+			}
+		}
+
+		// Each volume's hits come back sorted on their own, volume after
+		// volume.
+		hits = indexSearcher->search(luceneQuery,
+			filter.IsEmpty() ? NULL : &filter, sort) ;
+
+		int32 added = 0 ;
+		for(int j = 0 ; j < hits->length() && j < kMaxFetchedHits
+				&& added < kMaxContentHits ; j++) {
+			if (AddHit(&hits->doc(j), &snippetGenerator))
+				added++ ;
+		}
+
+		delete hits ;
+		delete luceneQuery ;
+	}
 
-		hits = indexSearcher->search(luceneQuery) ;
+	// Native indexes only know about plain words, in relevance order.
+	NativeIndex *nativeIndex ;
+	for (int32 i = 0 ; contentQuery.Length() > 0 && (nativeIndex
+		= (NativeIndex*)fNativeIndexes.ItemAt(i)) != NULL ; i++) {
+		TraceSpan nativeSpan("search_native") ;
+		SearchNative(nativeIndex, contentQuery.String(), &filter,
+			&snippetGenerator) ;
+	}
+
+	if (fHits.CountItems() - fNameHits < kSuggestionThreshold) {
+		TraceSpan suggestSpan("suggest") ;
+		Suggest(&tokens) ;
+	}
+
+	for (int32 i = 0 ; i < tokens.CountItems() ; i++)
+		delete[] (wchar_t*)tokens.ItemAt(i) ;
+	for (int32 i = 0 ; i < terms.CountItems() ; i++)
+		delete[] (wchar_t*)terms.ItemAt(i) ;
+	delete[] wStringQuery ;
+	delete sort ;
+
+	sQueryLatency.Record(system_time() - start) ;
+}
+
+
+bool
+BeaconSearcher::PlainTerms(const char* query, BList* terms)
+{
+	// Anything QueryParser would treat specially goes the long way round.
+	if (query[0] == '\0' || strpbrk(query, "+-\"():*?~^[]{}!\\") != NULL)
+		return false ;
+
+	const char *word = query ;
+	while (*word != '\0') {
+		int32 length = strcspn(word, " \t") ;
+		BString token(word, length) ;
+		if (token == "AND" || token == "OR" || token == "NOT")
+			return false ;
+
+		// Each word has to analyze to a single term, or none at all for
+		// stop words, otherwise QueryParser would make a phrase of it.
+		if (length > 0) {
+			wchar_t *wToken = new wchar_t[length + 1] ;
+			BList wordTerms ;
+			if (mbstowcs(wToken, token.String(), length + 1) != (size_t)-1)
+				AnalyzeQuery(wToken, &wordTerms) ;
+			delete[] wToken ;
+
+			bool single = wordTerms.CountItems() <= 1 ;
+			if (single)
+				terms->AddList(&wordTerms) ;
+			else {
+				for (int32 i = 0 ; i < wordTerms.CountItems() ; i++)
+					delete[] (wchar_t*)wordTerms.ItemAt(i) ;
+			}
+			if (!single)
+				return false ;
+		}
+
+		word += length ;
+		if (*word != '\0')
+			word++ ;
+	}
 
-		for(int j = 0 ; j < hits->length() ; j++) {
-			doc = hits->doc(j) ;
-			field = doc.getField(_T("path")) ;
-			path = new wchar_t[B_PATH_NAME_LENGTH * sizeof(wchar_t)] ;
-			wcscpy(path, field->stringValue()) ;
-			fHits.AddItem(path) ;
+	return !terms->IsEmpty() ;
+}
+
+
+void
+BeaconSearcher::SearchTopDocs(IndexReader* reader, const char* indexPath,
+	BList* terms, MetadataFilter* filter, SnippetGenerator* generator)
+{
+	BitSet *bits = filter->IsEmpty() ? NULL : filter->bits(reader) ;
+
+	// A search uses up its WandSearcher, each longer one starts over. Hits
+	// come in the same order every time, so only the new ones are added.
+	int32 wanted = kMaxContentHits ;
+	int32 seen = 0 ;
+	int32 added = 0 ;
+	while (true) {
+		WandSearcher searcher(reader, indexPath, _T("contents")) ;
+		for (int32 i = 0 ; i < terms->CountItems() ; i++) {
+			if (searcher.AddTerm((const wchar_t*)terms->ItemAt(i)) != B_OK)
+				break ;
+		}
+
+		wand_hit *hits = new wand_hit[wanted] ;
+		int32 count = searcher.Search(wanted, bits, hits) ;
+		for (int32 i = seen ; i < count && added < kMaxContentHits ; i++) {
+			Document *doc = reader->document(hits[i].doc) ;
+			if (AddHit(doc, generator))
+				added++ ;
+			delete doc ;
 		}
+		delete[] hits ;
+
+		seen = count ;
+		if (added >= kMaxContentHits || count < wanted
+			|| wanted >= kMaxFetchedHits)
+			break ;
+		wanted *= 2 ;
 	}
+
+	delete bits ;
+}
+
+
+void
+BeaconSearcher::SearchNative(NativeIndex* index, const char* query,
+	MetadataFilter* filter, SnippetGenerator* generator)
+{
+	// "+word" has to be there and "-word" must not, like with QueryParser.
+	// Each word may stand for several terms.
+	native_clause clauses[kMaxNativeClauses] ;
+	BList terms ;
+	const char *word = query ;
+	while (*word != '\0' && terms.CountItems() < kMaxNativeClauses) {
+		int32 length = strcspn(word, " \t") ;
+		int32 occur = NATIVE_SHOULD ;
+		if (length > 0 && (*word == '+' || *word == '-')) {
+			occur = *word == '+' ? NATIVE_MUST : NATIVE_MUST_NOT ;
+			word++ ;
+			length-- ;
+		}
+
+		WordTokenizer tokenizer(word, length) ;
+		const char *term ;
+		size_t termLength ;
+		while (terms.CountItems() < kMaxNativeClauses
+			&& (term = tokenizer.Next(&termLength)) != NULL) {
+			char *copy = strdup(term) ;
+			clauses[terms.CountItems()].term = copy ;
+			clauses[terms.CountItems()].occur = occur ;
+			terms.AddItem(copy) ;
+		}
+
+		word += length ;
+		if (*word != '\0')
+			word++ ;
+	}
+
+	// Like SearchTopDocs(), longer searches until there are enough files.
+	int32 wanted = kMaxContentHits ;
+	int32 seen = 0 ;
+	int32 added = 0 ;
+	while (true) {
+		native_hit *hits = new native_hit[wanted] ;
+		int32 count = index->Search(clauses, terms.CountItems(),
+			filter->IsEmpty() ? NULL : match_metadata, filter, hits, wanted) ;
+		for (int32 i = seen ; i < count && added < kMaxContentHits ; i++) {
+			stored_document document ;
+			if (index->GetDocument(&hits[i], &document) == B_OK
+				&& AddHit(&document, generator))
+				added++ ;
+		}
+		delete[] hits ;
+
+		seen = count ;
+		if (added >= kMaxContentHits || count < wanted
+			|| wanted >= kMaxFetchedHits)
+			break ;
+		wanted *= 2 ;
+	}
+
+	for (int32 i = 0 ; i < terms.CountItems() ; i++)
+		free(terms.ItemAt(i)) ;
+}
+
+
+bool
+BeaconSearcher::AddHit(Document* doc, SnippetGenerator* generator)
+{
+	Field *field = doc->getField(_T("path")) ;
+	if (field == NULL)
+		return false ;
+
+	return AddHit(field->stringValue(), doc->get(_T("excerpt")), generator) ;
+}
+
+
+bool
+BeaconSearcher::AddHit(const stored_document* document,
+	SnippetGenerator* generator)
+{
+	wchar_t path[B_PATH_NAME_LENGTH] ;
+	if (mbstowcs(path, document->path, B_PATH_NAME_LENGTH) == (size_t)-1)
+		return false ;
+	path[B_PATH_NAME_LENGTH - 1] = 0 ;
+
+	wchar_t *excerpt = NULL ;
+	size_t length = strlen(document->excerpt) ;
+	if (length > 0) {
+		excerpt = new wchar_t[length + 1] ;
+		if (mbstowcs(excerpt, document->excerpt, length + 1) == (size_t)-1) {
+			delete[] excerpt ;
+			excerpt = NULL ;
+		}
+	}
+
+	bool added = AddHit(path, excerpt, generator) ;
+	delete[] excerpt ;
+	return added ;
+}
+
+
+bool
+BeaconSearcher::AddHit(const wchar_t* hitPath, const wchar_t* excerpt,
+	SnippetGenerator* generator)
+{
+	// Chunks of a file, see BEACON_CHUNK_SEPARATOR, show up as the file.
+	// Hits come best first, so the snippet is from its best chunk.
+	wchar_t *path = new wchar_t[B_PATH_NAME_LENGTH] ;
+	wcscpy(path, hitPath) ;
+	wchar_t separator[sizeof(BEACON_CHUNK_SEPARATOR)] ;
+	mbstowcs(separator, BEACON_CHUNK_SEPARATOR, sizeof(separator)) ;
+	wchar_t *chunk = wcsstr(path, separator) ;
+	if (chunk != NULL)
+		*chunk = 0 ;
+
+	if (HasHit(path, chunk != NULL ? fHits.CountItems() : fNameHits)) {
+		delete[] path ;
+		return false ;
+	}
+
+	fHits.AddItem(path) ;
+
+	// Only the first page of results gets a snippet, each one within its
+	// own time budget.
+	BString snippet ;
+	char *hitSnippet = NULL ;
+	if (fHits.CountItems() - fNameHits <= kMaxSnippets
+		&& generator->Generate(excerpt, &snippet))
+		hitSnippet = strdup(snippet.String()) ;
+	fSnippets.AddItem(hitSnippet, fHits.CountItems() - 1) ;
+	return true ;
+}
+
+
+void
+BeaconSearcher::ParseQuery(const char* query, BString* contents,
+	MetadataFilter* filter, Sort** sort)
+{
+	const char *word = query ;
+	while (*word != '\0') {
+		int32 length = strcspn(word, " \t") ;
+		BString token(word, length) ;
+
+		if (token.IFindFirst("sort:") == 0) {
+			delete *sort ;
+			*sort = ParseSort(token.String() + 5) ;
+		} else if (length > 0 && !filter->ParseToken(token.String())) {
+			if (contents->Length() > 0)
+				*contents << " " ;
+			*contents << token ;
+		}
+
+		word += length ;
+		if (*word != '\0')
+			word++ ;
+	}
+}
+
+
+Sort*
+BeaconSearcher::ParseSort(const char* key)
+{
+	// "sort:size" sorts smallest first, "sort:-size" largest first.
+	bool reverse = (*key == '-') ;
+	if (reverse)
+		key++ ;
+
+	const TCHAR *field ;
+	if (strcasecmp(key, "size") == 0)
+		field = _T("size") ;
+	else if (strcasecmp(key, "modified") == 0)
+		field = _T("mtime") ;
+	else if (strcasecmp(key, "path") == 0 || strcasecmp(key, "name") == 0)
+		field = _T("path") ;
+	else
+		return NULL ;
+
+	// Numbers are fixed width hex, so sorting them as strings gives their
+	// numeric order, straight from the field cache.
+	SortField *fields[] = {
+		new SortField(field, SortField::STRING, reverse),
+		SortField::FIELD_SCORE,
+		NULL
+	} ;
+	return new Sort(fields) ;
+}
+
+
+void
+BeaconSearcher::SetFuzzy(bool fuzzy)
+{
+	fFuzzy = fuzzy ;
+}
+
+
+const char*
+BeaconSearcher::Suggestion()
+{
+	if (fSuggestion.Length() == 0)
+		return NULL ;
+
+	return fSuggestion.String() ;
+}
+
+
+void
+BeaconSearcher::AnalyzeQuery(const wchar_t* query, BList* tokens)
+{
+	StringReader reader(query) ;
+	TokenStream *stream = fStandardAnalyzer.tokenStream(_T("contents"),
+		&reader) ;
+
+	Token token ;
+	wchar_t *text ;
+	while (stream->next(&token)) {
+		text = new wchar_t[wcslen(token.termText()) + 1] ;
+		wcscpy(text, token.termText()) ;
+		tokens->AddItem(text) ;
+	}
+
+	stream->close() ;
+	delete stream ;
+}
+
+
+Query*
+BeaconSearcher::FuzzyQuery(IndexReader* reader, BList* tokens)
+{
+	if (tokens->IsEmpty())
+		return NULL ;
+
+	// The expansion cap is per query, shared by all of its terms.
+	int32 perToken = kMaxExpansions / tokens->CountItems() ;
+	FuzzyExpander expander(2, perToken > 0 ? perToken : 1) ;
+	BooleanQuery *query = new BooleanQuery ;
+	BList expansions ;
+	wchar_t *token ;
+
+	for (int32 i = 0 ; (token = (wchar_t*)tokens->ItemAt(i)) != NULL ; i++) {
+		expander.Expand(reader, _T("contents"), token, &expansions) ;
+
+		BooleanQuery *tokenQuery = new BooleanQuery ;
+		fuzzy_term *expansion ;
+		for (int32 j = 0 ; (expansion = (fuzzy_term*)expansions.ItemAt(j))
+			!= NULL ; j++) {
+			Term *term = new Term(_T("contents"), expansion->text) ;
+			TermQuery *termQuery = new TermQuery(term) ;
+			termQuery->setBoost(1.0f / (1 + expansion->distance)) ;
+			tokenQuery->add(termQuery, true, false, false) ;
+			_CLDECDELETE(term) ;
+		}
+
+		query->add(tokenQuery, true, false, false) ;
+		FuzzyExpander::FreeExpansions(&expansions) ;
+	}
+
+	return query ;
+}
+
+
+void
+BeaconSearcher::Suggest(BList* tokens)
+{
+	// Replace every word that appears nowhere with the closest, most
+	// common word any of the indexes knows about.
+	FuzzyExpander expander(2, 1) ;
+	IndexSearcher *indexSearcher ;
+	BList expansions ;
+	BString suggestion ;
+	bool changed = false ;
+	wchar_t *token ;
+	char word[B_FILE_NAME_LENGTH] ;
+
+	for (int32 i = 0 ; (token = (wchar_t*)tokens->ItemAt(i)) != NULL ; i++) {
+		const wchar_t *best = token ;
+		fuzzy_term *bestTerm = NULL ;
+		bool known = false ;
+
+		Term *term = new Term(_T("contents"), token) ;
+		for (int32 j = 0 ; (indexSearcher
+			= (IndexSearcher*)fSearcherList.ItemAt(j)) != NULL && !known ;
+			j++)
+			known = indexSearcher->getReader()->docFreq(term) > 0 ;
+		_CLDECDELETE(term) ;
+
+		for (int32 j = 0 ; !known && (indexSearcher
+			= (IndexSearcher*)fSearcherList.ItemAt(j)) != NULL ; j++) {
+			expander.Expand(indexSearcher->getReader(), _T("contents"),
+				token, &expansions) ;
+		}
+
+		// Every index contributed its best candidate, pick the overall one.
+		fuzzy_term *expansion ;
+		for (int32 j = 0 ; (expansion = (fuzzy_term*)expansions.ItemAt(j))
+			!= NULL ; j++) {
+			if (bestTerm == NULL || expansion->distance < bestTerm->distance
+				|| (expansion->distance == bestTerm->distance
+					&& expansion->docFreq > bestTerm->docFreq))
+				bestTerm = expansion ;
+		}
+
+		if (bestTerm != NULL && bestTerm->distance > 0) {
+			best = bestTerm->text ;
+			changed = true ;
+		}
+
+		if (wcstombs(word, best, sizeof(word)) == (size_t)-1)
+			word[0] = '\0' ;
+		if (i > 0)
+			suggestion << " " ;
+		suggestion << word ;
+
+		FuzzyExpander::FreeExpansions(&expansions) ;
+	}
+
+	if (changed)
+		fSuggestion = suggestion ;
+}
+
+
+void
+BeaconSearcher::SearchNames(const char* stringQuery)
+{
+	fNameHits = 0 ;
+
+	BMessenger messenger(APP_SIGNATURE) ;
+	BMessage query(BEACON_NAME_QUERY), reply ;
+	query.AddString("pattern", stringQuery) ;
+	query.AddInt32("limit", kMaxNameHits) ;
+	if (strpbrk(stringQuery, "*?[") != NULL)
+		query.AddInt32("mode", BEACON_MATCH_GLOB) ;
+	else
+		query.AddInt32("mode", BEACON_MATCH_SUBSTRING) ;
+
+	// index_server answers between commits. Better no names than a
+	// search that waits for a long commit.
+	if (messenger.SendMessage(&query, &reply, 1000000, 1000000) != B_OK)
+		return ;
+
+	const char *stringPath ;
+	wchar_t *path ;
+	for (int32 i = 0 ; reply.FindString("path", i, &stringPath) == B_OK ;
+		i++) {
+		path = new wchar_t[B_PATH_NAME_LENGTH] ;
+		if (mbstowcs(path, stringPath, B_PATH_NAME_LENGTH) == (size_t)-1) {
+			delete[] path ;
+			continue ;
+		}
+
+		fHits.AddItem(path) ;
+		fSnippets.AddItem(NULL, fHits.CountItems() - 1) ;
+		fNameHits++ ;
+	}
+}
+
+
+bool
+BeaconSearcher::HasHit(const wchar_t* path, int32 count)
+{
+	for (int32 i = 0 ; i < count ; i++) {
+		if (wcscmp((wchar_t*)fHits.ItemAt(i), path) == 0)
+			return true ;
+	}
+
+	return false ;
 }
 
 
 wchar_t*
-BeaconSearcher::GetNextHit()
+BeaconSearcher::GetNextHit(BString* snippet)
 {
 	if(fHits.CountItems() != 0) {
 		wchar_t* path = (wchar_t*)fHits.ItemAt(0) ;
 		fHits.RemoveItem((int32)0) ;
+
+		char *hitSnippet = (char*)fSnippets.RemoveItem((int32)0) ;
+		if (snippet != NULL)
+			snippet->SetTo(hitSnippet) ;
+		free(hitSnippet) ;
+
 		return path ;
 	}
 	
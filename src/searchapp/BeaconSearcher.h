@@ -9,11 +9,16 @@
 #ifndef _BEACON_SEARCHER_H_
 #define _BEACON_SEARCHER_H_
 
+#include "MetadataFilter.h"
+#include "SnippetGenerator.h"
+#include "../engine/NativeIndex.h"
+
 #include <CLucene.h>
 
 #include <Directory.h>
 #include <List.h>
 #include <Path.h>
+#include <String.h>
 #include <Volume.h>
 
 // #include <CLucene/search/MultiSearcher.h>
@@ -25,14 +30,55 @@ class BeaconSearcher {
 	public:
 		BeaconSearcher() ;
 		~BeaconSearcher() ;
-		wchar_t* GetNextHit() ;
+		wchar_t* GetNextHit(BString* snippet = NULL) ;
 		void Search(const char* query) ;
+		void SetFuzzy(bool fuzzy) ;
+		const char* Suggestion() ;
 	
 	private:
+		struct index_info {
+			char		path[B_PATH_NAME_LENGTH] ;
+			int64		version ;
+		} ;
+
+		void Refresh() ;
+		void RefreshNative(const char* indexPath, BList* nativeIndexes) ;
+		lucene::search::IndexSearcher* OpenSearcher(const char* indexPath) ;
+		void CloseSearcher(lucene::search::IndexSearcher* indexSearcher) ;
+		int64 ReadPublished(const char* indexPath) ;
+		void ClearHits() ;
 		char* GetIndexPath(BVolume *volume) ;
+		void ParseQuery(const char* query, BString* contents,
+			MetadataFilter* filter, lucene::search::Sort** sort) ;
+		lucene::search::Sort* ParseSort(const char* key) ;
+		bool PlainTerms(const char* query, BList* terms) ;
+		void SearchTopDocs(lucene::index::IndexReader* reader,
+			const char* indexPath, BList* terms, MetadataFilter* filter,
+			SnippetGenerator* generator) ;
+		void SearchNative(NativeIndex* index, const char* query,
+			MetadataFilter* filter, SnippetGenerator* generator) ;
+		// Return whether the hit was a file not in the results yet.
+		bool AddHit(lucene::document::Document* doc,
+			SnippetGenerator* generator) ;
+		bool AddHit(const stored_document* document,
+			SnippetGenerator* generator) ;
+		bool AddHit(const wchar_t* path, const wchar_t* excerpt,
+			SnippetGenerator* generator) ;
+		void SearchNames(const char* query) ;
+		bool HasHit(const wchar_t* path, int32 count) ;
+		void AnalyzeQuery(const wchar_t* query, BList* tokens) ;
+		lucene::search::Query* FuzzyQuery(lucene::index::IndexReader* reader,
+			BList* tokens) ;
+		void Suggest(BList* tokens) ;
 
 		BList				fSearcherList ;
+		BList				fIndexes ;
+		BList				fNativeIndexes ;
 		BList				fHits ;
+		BList				fSnippets ;
+		int32				fNameHits ;
+		bool				fFuzzy ;
+		BString				fSuggestion ;
 		StandardAnalyzer	fStandardAnalyzer ;
 //		MultiSearcher		*fMultiSearcher ;
 } ;
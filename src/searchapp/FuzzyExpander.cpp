@@ -0,0 +1,283 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "FuzzyExpander.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+
+
+// A dead prefix is usually followed by a few more terms sharing it, and
+// stepping over those is cheaper than seeking the term dictionary.
+const int32 kSeekThreshold = 8 ;
+
+
+LevenshteinAutomaton::LevenshteinAutomaton(const wchar_t* term,
+	int32 maxEdits)
+	: fMaxEdits(maxEdits)
+{
+	fLength = wcslen(term) ;
+	fTerm = new wchar_t[fLength + 1] ;
+	wcscpy(fTerm, term) ;
+}
+
+
+LevenshteinAutomaton::~LevenshteinAutomaton()
+{
+	delete[] fTerm ;
+}
+
+
+int32
+LevenshteinAutomaton::Length()
+{
+	return fLength ;
+}
+
+
+int32
+LevenshteinAutomaton::MaxEdits()
+{
+	return fMaxEdits ;
+}
+
+
+void
+LevenshteinAutomaton::SetMaxEdits(int32 maxEdits)
+{
+	// States built with a larger bound stay valid, their values are only
+	// ever capped from above.
+	if (maxEdits < fMaxEdits)
+		fMaxEdits = maxEdits ;
+}
+
+
+void
+LevenshteinAutomaton::Start(int32* state)
+{
+	for (int32 i = 0 ; i <= fLength ; i++)
+		state[i] = i <= fMaxEdits ? i : fMaxEdits + 1 ;
+}
+
+
+void
+LevenshteinAutomaton::Step(const int32* state, wchar_t c, int32* next)
+{
+	int32 cap = fMaxEdits + 1 ;
+
+	next[0] = state[0] + 1 < cap ? state[0] + 1 : cap ;
+	for (int32 i = 1 ; i <= fLength ; i++) {
+		int32 cost = fTerm[i - 1] == c ? 0 : 1 ;
+		int32 value = state[i - 1] + cost ;
+		if (state[i] + 1 < value)
+			value = state[i] + 1 ;
+		if (next[i - 1] + 1 < value)
+			value = next[i - 1] + 1 ;
+		next[i] = value < cap ? value : cap ;
+	}
+}
+
+
+bool
+LevenshteinAutomaton::IsMatch(const int32* state)
+{
+	return state[fLength] <= fMaxEdits ;
+}
+
+
+bool
+LevenshteinAutomaton::CanMatch(const int32* state)
+{
+	for (int32 i = 0 ; i <= fLength ; i++) {
+		if (state[i] <= fMaxEdits)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+int32
+LevenshteinAutomaton::Distance(const int32* state)
+{
+	return state[fLength] ;
+}
+
+
+FuzzyExpander::FuzzyExpander(int32 maxEdits, int32 maxExpansions)
+	: fMaxEdits(maxEdits),
+	  fMaxExpansions(maxExpansions)
+{
+}
+
+
+int32
+FuzzyExpander::Expand(IndexReader* reader, const wchar_t* field,
+	const wchar_t* term, BList* expansions)
+{
+	LevenshteinAutomaton automaton(term, EditsFor(wcslen(term))) ;
+	int32 length = automaton.Length() ;
+
+	// Nothing longer than this can be within reach of the query term.
+	int32 maxDepth = length + automaton.MaxEdits() + 1 ;
+	int32 width = length + 1 ;
+	int32 *states = new int32[(maxDepth + 1) * width] ;
+	wchar_t *previous = new wchar_t[maxDepth + 1] ;
+	wchar_t *seekText = new wchar_t[maxDepth + 1] ;
+	int32 validDepth = 0 ;
+
+	automaton.Start(states) ;
+
+	Term *seekTerm = new Term(field, _T("")) ;
+	TermEnum *terms = reader->terms(seekTerm) ;
+	_CLDECDELETE(seekTerm) ;
+
+	int32 skipped = 0 ;
+	int32 deadLength = 0 ;
+	bool valid = true ;
+
+	while (valid) {
+		Term *current = terms->term(false) ;
+		if (current == NULL || wcscmp(current->field(), field) != 0)
+			break ;
+
+		const wchar_t *text = current->text() ;
+		int32 textLength = wcslen(text) ;
+
+		// Still inside a prefix we already know to be dead.
+		if (deadLength > 0 && textLength >= deadLength
+			&& wcsncmp(text, previous, deadLength) == 0) {
+			if (++skipped < kSeekThreshold) {
+				valid = terms->next() ;
+				continue ;
+			}
+
+			// Seek to the first term after every term with the dead
+			// prefix, by bumping the last character of the prefix.
+			wcsncpy(seekText, previous, deadLength) ;
+			seekText[deadLength] = 0 ;
+			if (seekText[deadLength - 1] == WCHAR_MAX) {
+				valid = terms->next() ;
+				continue ;
+			}
+			seekText[deadLength - 1]++ ;
+
+			terms->close() ;
+			delete terms ;
+			seekTerm = new Term(field, seekText) ;
+			terms = reader->terms(seekTerm) ;
+			_CLDECDELETE(seekTerm) ;
+			deadLength = 0 ;
+			continue ;
+		}
+
+		skipped = 0 ;
+		deadLength = 0 ;
+
+		// Reuse the states of the prefix shared with the previous term.
+		int32 depth = 0 ;
+		while (depth < validDepth && depth < textLength
+			&& previous[depth] == text[depth])
+			depth++ ;
+
+		int32 limit = textLength < maxDepth ? textLength : maxDepth ;
+		for ( ; depth < limit ; depth++) {
+			previous[depth] = text[depth] ;
+			automaton.Step(states + depth * width, text[depth],
+				states + (depth + 1) * width) ;
+			if (!automaton.CanMatch(states + (depth + 1) * width)) {
+				deadLength = depth + 1 ;
+				break ;
+			}
+		}
+
+		validDepth = deadLength > 0 ? deadLength - 1 : limit ;
+
+		if (deadLength == 0 && textLength <= maxDepth) {
+			int32 *state = states + textLength * width ;
+			if (automaton.IsMatch(state)) {
+				AddCandidate(expansions, text, automaton.Distance(state),
+					terms->docFreq()) ;
+
+				// Once the list is full, nothing more distant than its worst
+				// entry can make it in.
+				if (expansions->CountItems() == fMaxExpansions) {
+					fuzzy_term *worst = (fuzzy_term*)expansions->LastItem() ;
+					automaton.SetMaxEdits(worst->distance) ;
+				}
+			}
+		}
+
+		valid = terms->next() ;
+	}
+
+	terms->close() ;
+	delete terms ;
+	delete[] states ;
+	delete[] previous ;
+	delete[] seekText ;
+
+	return expansions->CountItems() ;
+}
+
+
+void
+FuzzyExpander::FreeExpansions(BList* expansions)
+{
+	fuzzy_term *expansion ;
+	for (int32 i = 0 ; (expansion = (fuzzy_term*)expansions->ItemAt(i))
+		!= NULL ; i++) {
+		delete[] expansion->text ;
+		delete expansion ;
+	}
+
+	expansions->MakeEmpty() ;
+}
+
+
+int32
+FuzzyExpander::EditsFor(int32 length)
+{
+	// Two edits on a three letter word match almost anything.
+	int32 edits = length <= 2 ? 0 : (length <= 5 ? 1 : 2) ;
+	return edits < fMaxEdits ? edits : fMaxEdits ;
+}
+
+
+void
+FuzzyExpander::AddCandidate(BList* expansions, const wchar_t* text,
+	int32 distance, int32 docFreq)
+{
+	// Keep the list ordered by distance, then by how common the term is,
+	// and never longer than the expansion cap.
+	int32 index = 0 ;
+	fuzzy_term *item ;
+	for ( ; (item = (fuzzy_term*)expansions->ItemAt(index)) != NULL ;
+		index++) {
+		if (distance < item->distance
+			|| (distance == item->distance && docFreq > item->docFreq))
+			break ;
+	}
+
+	if (index >= fMaxExpansions)
+		return ;
+
+	fuzzy_term *expansion = new fuzzy_term ;
+	expansion->text = new wchar_t[wcslen(text) + 1] ;
+	wcscpy(expansion->text, text) ;
+	expansion->distance = distance ;
+	expansion->docFreq = docFreq ;
+	expansions->AddItem(expansion, index) ;
+
+	if (expansions->CountItems() > fMaxExpansions) {
+		item = (fuzzy_term*)expansions->RemoveItem(fMaxExpansions) ;
+		delete[] item->text ;
+		delete item ;
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _FUZZY_EXPANDER_H_
+#define _FUZZY_EXPANDER_H_
+
+#include <CLucene.h>
+
+#include <List.h>
+#include <SupportDefs.h>
+
+using namespace lucene::index ;
+
+
+struct fuzzy_term {
+	wchar_t		*text ;
+	int32		distance ;
+	int32		docFreq ;
+} ;
+
+
+// Matches words within a small edit distance of a query term. States of
+// the automaton are rows of the Levenshtein table, built one character at
+// a time, so terms sharing a prefix share their states.
+class LevenshteinAutomaton {
+	public:
+		LevenshteinAutomaton(const wchar_t* term, int32 maxEdits) ;
+		~LevenshteinAutomaton() ;
+
+		int32 Length() ;
+		int32 MaxEdits() ;
+		void SetMaxEdits(int32 maxEdits) ;
+
+		void Start(int32* state) ;
+		void Step(const int32* state, wchar_t c, int32* next) ;
+		bool IsMatch(const int32* state) ;
+		bool CanMatch(const int32* state) ;
+		int32 Distance(const int32* state) ;
+
+	private:
+		wchar_t		*fTerm ;
+		int32		fLength ;
+		int32		fMaxEdits ;
+} ;
+
+
+// Walks the sorted term dictionary of a field in step with the automaton.
+// Whenever a prefix can no longer lead to a match, every term below it is
+// skipped with a single seek instead of being visited.
+class FuzzyExpander {
+	public:
+		FuzzyExpander(int32 maxEdits = 2, int32 maxExpansions = 50) ;
+
+		int32 Expand(IndexReader* reader, const wchar_t* field,
+			const wchar_t* term, BList* expansions) ;
+		static void FreeExpansions(BList* expansions) ;
+
+	private:
+		int32 EditsFor(int32 length) ;
+		void AddCandidate(BList* expansions, const wchar_t* text,
+			int32 distance, int32 docFreq) ;
+
+		int32		fMaxEdits ;
+		int32		fMaxExpansions ;
+} ;
+
+#endif /* _FUZZY_EXPANDER_H_ */
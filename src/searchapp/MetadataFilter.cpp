@@ -0,0 +1,531 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "MetadataFilter.h"
+#include "../fields.h"
+
+#include <StorageDefs.h>
+#include <String.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace lucene::index ;
+using namespace lucene::util ;
+using namespace lucene::search ;
+
+
+const uint64 kMaxValue = ~(uint64)0 ;
+const int32 kMaxTypeLength = 256 ;
+
+
+MetadataFilter::MetadataFilter()
+	: fDirectory(NULL),
+	  fHasSize(false),
+	  fMinSize(0),
+	  fMaxSize(kMaxValue),
+	  fHasTime(false),
+	  fMinTime(0),
+	  fMaxTime(kMaxValue)
+{
+}
+
+
+MetadataFilter::MetadataFilter(const MetadataFilter& other)
+	: fDirectory(other.fDirectory != NULL ? wcsdup(other.fDirectory) : NULL),
+	  fHasSize(other.fHasSize),
+	  fMinSize(other.fMinSize),
+	  fMaxSize(other.fMaxSize),
+	  fHasTime(other.fHasTime),
+	  fMinTime(other.fMinTime),
+	  fMaxTime(other.fMaxTime)
+{
+	for (int32 i = 0 ; i < other.fTypes.CountItems() ; i++)
+		fTypes.AddItem(strdup((char*)other.fTypes.ItemAt(i))) ;
+}
+
+
+MetadataFilter::~MetadataFilter()
+{
+	for (int32 i = 0 ; i < fTypes.CountItems() ; i++)
+		free(fTypes.ItemAt(i)) ;
+	free(fDirectory) ;
+}
+
+
+bool
+MetadataFilter::ParseToken(const char* token)
+{
+	if (strncasecmp(token, "type:", 5) == 0)
+		return ParseTypes(token + 5) ;
+
+	if (strncasecmp(token, "in:", 3) == 0)
+		return ParseDirectory(token + 3) ;
+
+	uint64 min, max ;
+	if (strncasecmp(token, "size:", 5) == 0) {
+		if (!ParseRange(token + 5, false, &min, &max))
+			return false ;
+		fHasSize = true ;
+		fMinSize = min ;
+		fMaxSize = max ;
+		return true ;
+	}
+
+	if (strncasecmp(token, "modified:", 9) == 0) {
+		if (!ParseRange(token + 9, true, &min, &max))
+			return false ;
+		fHasTime = true ;
+		fMinTime = min ;
+		fMaxTime = max ;
+		return true ;
+	}
+
+	return false ;
+}
+
+
+bool
+MetadataFilter::IsEmpty() const
+{
+	return fTypes.IsEmpty() && fDirectory == NULL && !fHasSize && !fHasTime ;
+}
+
+
+BitSet*
+MetadataFilter::bits(IndexReader* reader)
+{
+	BitSet *result = NULL ;
+
+	if (fDirectory != NULL)
+		Intersect(&result, DirectoryBits(reader)) ;
+	if (!fTypes.IsEmpty())
+		Intersect(&result, TypeBits(reader)) ;
+	if (fHasSize)
+		Intersect(&result, RangeBits(reader, _T("size"), fMinSize, fMaxSize)) ;
+	if (fHasTime)
+		Intersect(&result, RangeBits(reader, _T("mtime"), fMinTime, fMaxTime)) ;
+
+	if (result == NULL) {
+		result = new BitSet(reader->maxDoc()) ;
+		for (int32 i = 0 ; i < reader->maxDoc() ; i++)
+			result->set(i) ;
+	}
+
+	return result ;
+}
+
+
+bool
+MetadataFilter::Matches(const char* path, const char* mimeType, uint64 size,
+	uint64 modified)
+{
+	if (fHasSize && (size < fMinSize || size > fMaxSize))
+		return false ;
+	if (fHasTime && (modified < fMinTime || modified > fMaxTime))
+		return false ;
+
+	if (!fTypes.IsEmpty()) {
+		wchar_t wMimeType[kMaxTypeLength] ;
+		if (mbstowcs(wMimeType, mimeType, kMaxTypeLength) == (size_t)-1)
+			return false ;
+		wMimeType[kMaxTypeLength - 1] = 0 ;
+		if (!MatchesType(wMimeType))
+			return false ;
+	}
+
+	if (fDirectory != NULL) {
+		wchar_t wPath[B_PATH_NAME_LENGTH] ;
+		if (mbstowcs(wPath, path, B_PATH_NAME_LENGTH) == (size_t)-1)
+			return false ;
+		wPath[B_PATH_NAME_LENGTH - 1] = 0 ;
+
+		// Only "/" itself ends in a slash.
+		int32 length = wcslen(fDirectory) ;
+		if (wcsncmp(wPath, fDirectory, length) != 0
+			|| (wPath[length] != L'/' && fDirectory[length - 1] != L'/'))
+			return false ;
+	}
+
+	return true ;
+}
+
+
+Filter*
+MetadataFilter::clone() const
+{
+	return new MetadataFilter(*this) ;
+}
+
+
+TCHAR*
+MetadataFilter::toString()
+{
+	const TCHAR *name = _T("MetadataFilter") ;
+	TCHAR *string = new TCHAR[_tcslen(name) + 1] ;
+	_tcscpy(string, name) ;
+	return string ;
+}
+
+
+bool
+MetadataFilter::ParseTypes(const char* types)
+{
+	// A comma separated list, any one of which may match.
+	while (*types != '\0') {
+		int32 length = strcspn(types, ",") ;
+		if (length > 0 && length < kMaxTypeLength) {
+			char *type = strndup(types, length) ;
+			for (char *c = type ; *c != '\0' ; c++)
+				*c = tolower(*c) ;
+			fTypes.AddItem(type) ;
+		}
+
+		types += length ;
+		if (*types == ',')
+			types++ ;
+	}
+
+	return !fTypes.IsEmpty() ;
+}
+
+
+bool
+MetadataFilter::ParseDirectory(const char* directory)
+{
+	BString path ;
+	if (directory[0] == '~') {
+		const char *home = getenv("HOME") ;
+		if (home == NULL)
+			return false ;
+		path << home << directory + 1 ;
+	} else
+		path << directory ;
+
+	if (path.Length() == 0 || path[0] != '/')
+		return false ;
+
+	// "/boot/home/" and "/boot/home" are the same directory.
+	while (path.Length() > 1 && path[path.Length() - 1] == '/')
+		path.Truncate(path.Length() - 1) ;
+
+	wchar_t *wPath = new wchar_t[path.Length() + 1] ;
+	if (mbstowcs(wPath, path.String(), path.Length() + 1) == (size_t)-1) {
+		delete[] wPath ;
+		return false ;
+	}
+
+	free(fDirectory) ;
+	fDirectory = wcsdup(wPath) ;
+	delete[] wPath ;
+	return true ;
+}
+
+
+bool
+MetadataFilter::ParseRange(const char* range, bool age, uint64* min,
+	uint64* max)
+{
+	uint64 low = 0, high = kMaxValue, value ;
+
+	if (range[0] == '>' || range[0] == '<') {
+		bool greater = (range[0] == '>') ;
+		bool inclusive = (range[1] == '=') ;
+		range += inclusive ? 2 : 1 ;
+		if (!ParseNumber(&range, age, &value) || *range != '\0')
+			return false ;
+
+		if (greater)
+			low = (inclusive || value == kMaxValue) ? value : value + 1 ;
+		else
+			high = (inclusive || value == 0) ? value : value - 1 ;
+	} else {
+		if (!ParseNumber(&range, age, &low))
+			return false ;
+
+		if (strncmp(range, "..", 2) == 0) {
+			range += 2 ;
+			if (!ParseNumber(&range, age, &high))
+				return false ;
+		} else if (!age)
+			high = low ;
+		else {
+			// "modified:7d" reads as "in the last seven days".
+			high = low ;
+			low = 0 ;
+		}
+
+		if (*range != '\0' || low > high)
+			return false ;
+	}
+
+	if (!age) {
+		*min = low ;
+		*max = high ;
+		return true ;
+	}
+
+	// Ages count back from now, so the bounds swap around. Anything
+	// younger than the lower bound includes files dated in the future.
+	uint64 now = time(NULL) ;
+	*min = high >= now ? 0 : now - high ;
+	*max = low == 0 ? kMaxValue : (low >= now ? 0 : now - low) ;
+	return true ;
+}
+
+
+bool
+MetadataFilter::ParseNumber(const char** string, bool age, uint64* value)
+{
+	char *end ;
+	double number = strtod(*string, &end) ;
+	if (end == *string || number < 0)
+		return false ;
+
+	double unit = 1 ;
+	if (age) {
+		// Ages are in days unless told otherwise.
+		unit = 24 * 60 * 60 ;
+		switch (tolower(*end)) {
+			case 'h':	unit = 60 * 60 ; end++ ;			break ;
+			case 'd':	end++ ;								break ;
+			case 'w':	unit *= 7 ; end++ ;					break ;
+			case 'm':	unit *= 30 ; end++ ;				break ;
+			case 'y':	unit *= 365 ; end++ ;				break ;
+		}
+	} else {
+		switch (tolower(*end)) {
+			case 'k':	unit = 1024.0 ; end++ ;					break ;
+			case 'm':	unit = 1024.0 * 1024 ; end++ ;			break ;
+			case 'g':	unit = 1024.0 * 1024 * 1024 ; end++ ;	break ;
+			case 't':	unit = 1024.0 * 1024 * 1024 * 1024 ; end++ ;
+				break ;
+		}
+		if (tolower(*end) == 'b')
+			end++ ;
+	}
+
+	number *= unit ;
+	*value = number >= (double)kMaxValue ? kMaxValue : (uint64)number ;
+	*string = end ;
+	return true ;
+}
+
+
+bool
+MetadataFilter::MatchesType(const TCHAR* mimeType)
+{
+	char type[kMaxTypeLength] ;
+	if (wcstombs(type, mimeType, sizeof(type)) == (size_t)-1)
+		return false ;
+	type[kMaxTypeLength - 1] = '\0' ;
+
+	const char *slash = strchr(type, '/') ;
+	const char *subtype = slash != NULL ? slash + 1 : type ;
+	int32 superLength = slash != NULL ? slash - type : strlen(type) ;
+	int32 subLength = strlen(subtype) ;
+
+	// A full type matches exactly and "image/*" matches a supertype. A bare
+	// word matches a supertype ("image"), a subtype ("pdf") or the end of
+	// one ("zip" for "x-zip", "xml" for "rss+xml").
+	const char *filter ;
+	for (int32 i = 0 ; (filter = (const char*)fTypes.ItemAt(i)) != NULL ;
+		i++) {
+		int32 length = strlen(filter) ;
+		if (strchr(filter, '/') != NULL) {
+			if (strcasecmp(filter, type) == 0)
+				return true ;
+			if (length > 2 && strcmp(filter + length - 2, "/*") == 0
+				&& strncasecmp(filter, type, length - 1) == 0)
+				return true ;
+			continue ;
+		}
+
+		if ((length == superLength && strncasecmp(filter, type, length) == 0)
+			|| strcasecmp(filter, subtype) == 0)
+			return true ;
+
+		if (length < subLength
+			&& strchr("-.+", subtype[subLength - length - 1]) != NULL
+			&& strcasecmp(filter, subtype + subLength - length) == 0)
+			return true ;
+	}
+
+	return false ;
+}
+
+
+BitSet*
+MetadataFilter::TypeBits(IndexReader* reader)
+{
+	// There are only ever a few hundred distinct types, so walking all of
+	// them is cheap.
+	BitSet *bits = new BitSet(reader->maxDoc()) ;
+	Term *start = new Term(_T("mime"), _T("")) ;
+	TermEnum *terms = reader->terms(start) ;
+	TermDocs *docs = reader->termDocs() ;
+	_CLDECDELETE(start) ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), _T("mime")) != 0)
+			break ;
+		if (!MatchesType(term->text()))
+			continue ;
+
+		docs->seek(term) ;
+		while (docs->next())
+			bits->set(docs->doc()) ;
+	} while (terms->next()) ;
+
+	docs->close() ;
+	_CLDELETE(docs) ;
+	terms->close() ;
+	_CLDELETE(terms) ;
+
+	return bits ;
+}
+
+
+BitSet*
+MetadataFilter::DirectoryBits(IndexReader* reader)
+{
+	// Each document carries its parent directory as a "dir" term, and the
+	// directories under fDirectory are exactly the terms starting with it.
+	// Only the subtree's own postings are read, and since documents are
+	// added in path order they come in long runs of document numbers.
+	BitSet *bits = new BitSet(reader->maxDoc()) ;
+	int32 length = wcslen(fDirectory) ;
+	if (length == 1)
+		length = 0 ;
+
+	Term *start = new Term(_T("dir"), fDirectory) ;
+	TermEnum *terms = reader->terms(start) ;
+	TermDocs *docs = reader->termDocs() ;
+	_CLDECDELETE(start) ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), _T("dir")) != 0
+			|| wcsncmp(term->text(), fDirectory, length) != 0)
+			break ;
+
+		const wchar_t *rest = term->text() + length ;
+		if (*rest != 0 && *rest != L'/')
+			continue ;
+
+		docs->seek(term) ;
+		while (docs->next())
+			bits->set(docs->doc()) ;
+	} while (terms->next()) ;
+
+	docs->close() ;
+	_CLDELETE(docs) ;
+	terms->close() ;
+	_CLDELETE(terms) ;
+
+	return bits ;
+}
+
+
+BitSet*
+MetadataFilter::RangeBits(IndexReader* reader, const TCHAR* field,
+	uint64 min, uint64 max)
+{
+	BitSet *bits = new BitSet(reader->maxDoc()) ;
+
+	// Cover [min, max] with as few terms as possible: full precision terms
+	// only at the ragged ends, coarser and coarser ones towards the middle.
+	for (int32 shift = 0 ; ; shift += kPrecisionStep) {
+		uint64 mask = (((uint64)1 << kPrecisionStep) - 1) << shift ;
+		bool hasLower = (min & mask) != 0 ;
+		bool hasUpper = (max & mask) != mask ;
+
+		if (shift + kPrecisionStep >= 64) {
+			AddRange(reader, bits, field, min, max, shift) ;
+			break ;
+		}
+
+		uint64 step = (uint64)1 << (shift + kPrecisionStep) ;
+		uint64 nextMin = (hasLower ? min + step : min) & ~mask ;
+		uint64 nextMax = (hasUpper ? max - step : max) & ~mask ;
+
+		if (nextMin > nextMax || nextMin < min || nextMax > max) {
+			AddRange(reader, bits, field, min, max, shift) ;
+			break ;
+		}
+
+		if (hasLower)
+			AddRange(reader, bits, field, min, min | mask, shift) ;
+		if (hasUpper)
+			AddRange(reader, bits, field, max & ~mask, max, shift) ;
+
+		min = nextMin ;
+		max = nextMax ;
+	}
+
+	return bits ;
+}
+
+
+void
+MetadataFilter::AddRange(IndexReader* reader, BitSet* bits,
+	const TCHAR* field, uint64 min, uint64 max, int32 shift)
+{
+	wchar_t lower[kEncodedNumberLength], upper[kEncodedNumberLength] ;
+	encode_number(min, shift, lower) ;
+	encode_number(max, shift, upper) ;
+
+	// Full precision terms are kept in the field itself, the coarser ones
+	// in its "_trie" companion.
+	wchar_t trieField[32] ;
+	if (shift > 0) {
+		swprintf(trieField, 32, L"%ls_trie", field) ;
+		field = trieField ;
+	}
+
+	Term *start = new Term(field, lower) ;
+	TermEnum *terms = reader->terms(start) ;
+	TermDocs *docs = reader->termDocs() ;
+	_CLDECDELETE(start) ;
+
+	do {
+		Term *term = terms->term(false) ;
+		if (term == NULL || _tcscmp(term->field(), field) != 0
+			|| _tcscmp(term->text(), upper) > 0)
+			break ;
+
+		docs->seek(term) ;
+		while (docs->next())
+			bits->set(docs->doc()) ;
+	} while (terms->next()) ;
+
+	docs->close() ;
+	_CLDELETE(docs) ;
+	terms->close() ;
+	_CLDELETE(terms) ;
+}
+
+
+void
+MetadataFilter::Intersect(BitSet** result, BitSet* bits)
+{
+	if (*result == NULL) {
+		*result = bits ;
+		return ;
+	}
+
+	for (int32 i = 0 ; i < bits->size() ; i++) {
+		if (!bits->get(i))
+			(*result)->set(i, false) ;
+	}
+
+	delete bits ;
+}
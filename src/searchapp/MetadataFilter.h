@@ -0,0 +1,72 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _METADATA_FILTER_H_
+#define _METADATA_FILTER_H_
+
+#include <CLucene.h>
+
+#include <List.h>
+#include <SupportDefs.h>
+
+
+// Restricts a search to documents of some MIME types, sizes and
+// modification times, or to those under a directory. The bits are worked
+// out from the term dictionary once per reader, so no file is ever looked
+// at while filtering.
+class MetadataFilter : public lucene::search::Filter {
+	public:
+		MetadataFilter() ;
+		MetadataFilter(const MetadataFilter& other) ;
+		virtual ~MetadataFilter() ;
+
+		// Takes "type:pdf,image", "size:>1M", "size:10k..2M",
+		// "modified:<7d" or "in:~/projects". Returns false for anything
+		// else.
+		bool ParseToken(const char* token) ;
+		bool IsEmpty() const ;
+
+		// The same test for a single document, for indexes that keep
+		// these values with each document instead.
+		bool Matches(const char* path, const char* mimeType, uint64 size,
+			uint64 modified) ;
+
+		virtual lucene::util::BitSet* bits(lucene::index::IndexReader* reader) ;
+		virtual lucene::search::Filter* clone() const ;
+		virtual TCHAR* toString() ;
+
+	private:
+		bool ParseTypes(const char* types) ;
+		bool ParseRange(const char* range, bool age, uint64* min,
+			uint64* max) ;
+		bool ParseNumber(const char** string, bool age, uint64* value) ;
+		bool ParseDirectory(const char* directory) ;
+		bool MatchesType(const TCHAR* mimeType) ;
+
+		lucene::util::BitSet* TypeBits(lucene::index::IndexReader* reader) ;
+		lucene::util::BitSet* DirectoryBits(
+			lucene::index::IndexReader* reader) ;
+		lucene::util::BitSet* RangeBits(lucene::index::IndexReader* reader,
+			const TCHAR* field, uint64 min, uint64 max) ;
+		void AddRange(lucene::index::IndexReader* reader,
+			lucene::util::BitSet* bits, const TCHAR* field, uint64 min,
+			uint64 max, int32 shift) ;
+		void Intersect(lucene::util::BitSet** result,
+			lucene::util::BitSet* bits) ;
+
+		BList			fTypes ;
+		wchar_t			*fDirectory ;
+		bool			fHasSize ;
+		uint64			fMinSize ;
+		uint64			fMaxSize ;
+		bool			fHasTime ;
+		uint64			fMinTime ;
+		uint64			fMaxTime ;
+} ;
+
+#endif /* _METADATA_FILTER_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "ResultItem.h"
+#include "SnippetGenerator.h"
+
+#include <View.h>
+
+#include <cstring>
+
+
+ResultItem::ResultItem(const char* path, const char* snippet)
+	: BStringItem(path),
+	  fSnippet(snippet),
+	  fLineHeight(0),
+	  fAscent(0)
+{
+}
+
+
+void
+ResultItem::Update(BView* owner, const BFont* font)
+{
+	BStringItem::Update(owner, font) ;
+
+	font_height height ;
+	font->GetHeight(&height) ;
+	fAscent = height.ascent ;
+	fLineHeight = height.ascent + height.descent + height.leading ;
+
+	if (fSnippet.Length() > 0)
+		SetHeight(Height() + fLineHeight) ;
+}
+
+
+void
+ResultItem::DrawItem(BView* owner, BRect frame, bool complete)
+{
+	if (fSnippet.Length() == 0) {
+		BStringItem::DrawItem(owner, frame, complete) ;
+		return ;
+	}
+
+	rgb_color background = IsSelected()
+		? ui_color(B_LIST_SELECTED_BACKGROUND_COLOR)
+		: ui_color(B_LIST_BACKGROUND_COLOR) ;
+	rgb_color text = IsSelected()
+		? ui_color(B_LIST_SELECTED_ITEM_TEXT_COLOR)
+		: ui_color(B_LIST_ITEM_TEXT_COLOR) ;
+
+	if (IsSelected() || complete) {
+		owner->SetHighColor(background) ;
+		owner->FillRect(frame) ;
+	}
+	owner->SetLowColor(background) ;
+	owner->SetHighColor(text) ;
+
+	BFont font ;
+	owner->GetFont(&font) ;
+
+	float x = frame.left + 4 ;
+	float y = frame.top + 2 + fAscent ;
+	owner->DrawString(Text(), BPoint(x, y)) ;
+
+	// Second line: the snippet, switching to bold between the highlight
+	// marks.
+	y += fLineHeight ;
+	owner->SetHighColor(tint_color(text, B_LIGHTEN_1_TINT)) ;
+	owner->MovePenTo(BPoint(x, y)) ;
+
+	const char *segment = fSnippet.String() ;
+	while (*segment != '\0') {
+		bool bold = (*segment == kHighlightStart) ;
+		if (bold || *segment == kHighlightEnd)
+			segment++ ;
+
+		int32 length = strcspn(segment, "\x01\x02") ;
+		owner->SetFont(bold ? be_bold_font : &font) ;
+		owner->DrawString(segment, length) ;
+		segment += length ;
+	}
+
+	owner->SetFont(&font) ;
+}
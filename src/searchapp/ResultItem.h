@@ -0,0 +1,32 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _RESULT_ITEM_H_
+#define _RESULT_ITEM_H_
+
+#include <ListItem.h>
+#include <String.h>
+
+
+// A search result: the path on the first line, and if there is one, the
+// snippet below it with the matching words in bold. Text() is the path.
+class ResultItem : public BStringItem {
+	public:
+		ResultItem(const char* path, const char* snippet = NULL) ;
+
+		virtual void DrawItem(BView* owner, BRect frame,
+			bool complete = false) ;
+		virtual void Update(BView* owner, const BFont* font) ;
+
+	private:
+		BString		fSnippet ;
+		float		fLineHeight ;
+		float		fAscent ;
+} ;
+
+#endif /* _RESULT_ITEM_H_ */
@@ -7,6 +7,8 @@
  */
 
 #include "SearchApp.h"
+#include "../shared/Metrics.h"
+#include "../shared/Trace.h"
 
 #include <Entry.h>
 #include <Roster.h>
@@ -26,6 +28,28 @@ SearchApp::MessageReceived(BMessage *message)
 	switch (message->what) {
 		case 'lnch':
 			LaunchFile(message) ;
+			break ;
+		case BEACON_METRICS:
+		{
+			BMessage reply(B_REPLY) ;
+			archive_metrics(&reply) ;
+			message->SendReply(&reply) ;
+			break ;
+		}
+		case BEACON_TRACE:
+		{
+			BMessage reply(B_REPLY) ;
+			status_t status = B_OK ;
+			int32 sampleEvery ;
+			const char *path ;
+			if (message->FindInt32("sample_every", &sampleEvery) == B_OK)
+				set_trace_sampling(sampleEvery) ;
+			if (message->FindString("path", &path) == B_OK)
+				status = write_trace(path) ;
+			reply.AddInt32("error", status) ;
+			message->SendReply(&reply) ;
+			break ;
+		}
 		default :
 			BApplication::MessageReceived(message) ;
 	}
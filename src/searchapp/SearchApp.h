@@ -10,11 +10,12 @@
 #define _SEARCH_APP_H_
 
 #include "SearchWindow.h"
+#include "../constants.h"
 
 #include <Application.h>
 
 
-const char* kAppSignature = "application/x-vnd.Haiku-ContentSearch" ;
+const char* kAppSignature = SEARCHAPP_SIGNATURE ;
 
 class SearchApp : public BApplication {
 	public:
@@ -7,6 +7,7 @@
  */
 
 #include "BeaconSearcher.h"
+#include "ResultItem.h"
 #include "SearchWindow.h"
 
 #include <Alert.h>
@@ -28,6 +29,9 @@ SearchWindow::CreateWindow()
 {
 	fSearchButton = new BButton("Search", new BMessage('srch')) ;
 	fSearchField = new BTextControl("", "", new BMessage('srch')) ;
+	fFuzzyCheckBox = new BCheckBox("Fuzzy", new BMessage('srch')) ;
+	fSuggestionButton = new BButton("", new BMessage('sugg')) ;
+	fSuggestionButton->Hide() ;
 	
 	fSearchResults = new BListView() ;
 	fSearchResults->SetInvocationMessage(new BMessage('lnch')) ;
@@ -41,9 +45,11 @@ SearchWindow::CreateWindow()
 	AddChild(BGroupLayoutBuilder(B_VERTICAL, 10)
 		.Add(BGroupLayoutBuilder(B_HORIZONTAL, 10)
 			.Add(fSearchField)
+			.Add(fFuzzyCheckBox)
 			.Add(fSearchButton)
 			.SetInsets(5, 5, 5, 5)
 		)
+	.Add(fSuggestionButton)
 	.Add(fScrollView)
 	.SetInsets(5, 5, 5, 5)
 	) ;
@@ -59,6 +65,9 @@ SearchWindow::MessageReceived(BMessage *message)
 		case 'srch':
 			Search() ;
 			break ;
+		case 'sugg':
+			UseSuggestion() ;
+			break ;
 		default:
 			BWindow::MessageReceived(message) ;
 	}
@@ -69,14 +78,33 @@ void
 SearchWindow::Search()
 {
 	fSearchResults->MakeEmpty() ;
-	BeaconSearcher searcher ;
-	searcher.Search(fSearchField->Text()) ;
+	fSearcher.SetFuzzy(fFuzzyCheckBox->Value() == B_CONTROL_ON) ;
+	fSearcher.Search(fSearchField->Text()) ;
 	wchar_t *wPath ;
 	char *path ;
-	while((wPath = searcher.GetNextHit()) != NULL) {
+	BString snippet ;
+	while((wPath = fSearcher.GetNextHit(&snippet)) != NULL) {
 		path = new char[wcslen(wPath)*sizeof(wchar_t)] ;
 		wcstombs(path, wPath, wcslen(wPath)*sizeof(wchar_t)) ;
-		fSearchResults->AddItem(new BStringItem(path)) ;
+		fSearchResults->AddItem(new ResultItem(path, snippet.String())) ;
 	}
+
+	const char *suggestion = fSearcher.Suggestion() ;
+	if (suggestion != NULL) {
+		fSuggestion = suggestion ;
+		BString label("Did you mean: ") ;
+		label << suggestion << "?" ;
+		fSuggestionButton->SetLabel(label.String()) ;
+		if (fSuggestionButton->IsHidden())
+			fSuggestionButton->Show() ;
+	} else if (!fSuggestionButton->IsHidden())
+		fSuggestionButton->Hide() ;
 }
 
+
+void
+SearchWindow::UseSuggestion()
+{
+	fSearchField->SetText(fSuggestion.String()) ;
+	Search() ;
+}
@@ -9,9 +9,13 @@
 #ifndef _SEARCH_WINDOW_H_
 #define _SEARCH_WINDOW_H
 
+#include "BeaconSearcher.h"
+
 #include <Button.h>
+#include <CheckBox.h>
 #include <ListView.h>
 #include <ScrollView.h>
+#include <String.h>
 #include <TextControl.h>
 #include <Window.h>
 
@@ -24,12 +28,18 @@ class SearchWindow : public BWindow {
 		void CreateWindow() ;
 		void MessageReceived(BMessage *message) ;
 		void Search() ;
+		void UseSuggestion() ;
 
 		// Window controls.
 		BButton			*fSearchButton ;
 		BTextControl	*fSearchField ;
+		BCheckBox		*fFuzzyCheckBox ;
+		BButton			*fSuggestionButton ;
 		BListView		*fSearchResults ;
 		BScrollView		*fScrollView ;
+
+		BString			fSuggestion ;
+		BeaconSearcher	fSearcher ;
 } ;
 
 #endif /* _SEARCH_WINDOW_H_ */
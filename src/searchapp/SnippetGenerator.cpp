@@ -0,0 +1,183 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "SnippetGenerator.h"
+
+#include <OS.h>
+
+#include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <cwchar>
+#include <cwctype>
+
+
+const int32 kMaxMatches = 256 ;
+const int32 kMaxWordLength = 64 ;
+
+
+SnippetGenerator::SnippetGenerator(BList* terms, int32 length,
+	bigtime_t budget)
+	: fTerms(terms),
+	  fLength(length),
+	  fBudget(budget)
+{
+}
+
+
+bool
+SnippetGenerator::Generate(const wchar_t* text, BString* snippet)
+{
+	if (text == NULL || snippet == NULL)
+		return false ;
+
+	bigtime_t deadline = system_time() + fBudget ;
+	snippet_match matches[kMaxMatches] ;
+	int32 matchCount = 0 ;
+	int32 textLength = wcslen(text) ;
+
+	// Find every query term in the text. Words are compared lowercased,
+	// the same way the analyzer saw them at indexing time.
+	wchar_t word[kMaxWordLength] ;
+	int32 words = 0 ;
+	for (int32 i = 0 ; i < textLength && matchCount < kMaxMatches ; ) {
+		if (!iswalnum(text[i])) {
+			i++ ;
+			continue ;
+		}
+
+		int32 start = i ;
+		int32 length = 0 ;
+		for ( ; i < textLength && iswalnum(text[i]) ; i++) {
+			if (length < kMaxWordLength - 1)
+				word[length++] = towlower(text[i]) ;
+		}
+		word[length] = 0 ;
+
+		int32 term = FindTerm(word, length) ;
+		if (term >= 0) {
+			matches[matchCount].start = start ;
+			matches[matchCount].end = i ;
+			matches[matchCount].term = term ;
+			matchCount++ ;
+		}
+
+		// Stay within the time budget for this hit, the best window found
+		// so far is good enough.
+		if ((++words & 0xff) == 0 && system_time() > deadline)
+			break ;
+	}
+
+	// Slide a window over the matches, preferring windows with more
+	// distinct terms and then more matches overall.
+	int32 bestFirst = 0, bestLast = -1, bestScore = -1 ;
+	for (int32 first = 0, last = 0 ; first < matchCount ; first++) {
+		if (last < first)
+			last = first ;
+		while (last + 1 < matchCount
+			&& matches[last + 1].end - matches[first].start <= fLength)
+			last++ ;
+
+		uint32 seen = 0 ;
+		int32 distinct = 0 ;
+		for (int32 i = first ; i <= last ; i++) {
+			uint32 bit = 1 << (matches[i].term & 31) ;
+			if ((seen & bit) == 0) {
+				seen |= bit ;
+				distinct++ ;
+			}
+		}
+
+		int32 score = distinct * kMaxMatches + (last - first + 1) ;
+		if (score > bestScore) {
+			bestScore = score ;
+			bestFirst = first ;
+			bestLast = last ;
+		}
+	}
+
+	// Center the window on the matches and start it on a word boundary.
+	int32 start = 0 ;
+	if (bestLast >= 0) {
+		int32 span = matches[bestLast].end - matches[bestFirst].start ;
+		start = matches[bestFirst].start - (fLength - span) / 2 ;
+		if (start < 0)
+			start = 0 ;
+		while (start > 0 && start < matches[bestFirst].start
+			&& !iswspace(text[start - 1]))
+			start++ ;
+	}
+
+	int32 end = start + fLength ;
+	if (end > textLength)
+		end = textLength ;
+	while (end < textLength && end > start && iswalnum(text[end]))
+		end-- ;
+
+	snippet->SetTo("") ;
+	if (start > 0)
+		*snippet << "..." ;
+
+	int32 position = start ;
+	for (int32 i = bestFirst ; i <= bestLast ; i++) {
+		if (matches[i].start < start || matches[i].end > end)
+			continue ;
+
+		Append(snippet, text, position, matches[i].start) ;
+		*snippet << kHighlightStart ;
+		Append(snippet, text, matches[i].start, matches[i].end) ;
+		*snippet << kHighlightEnd ;
+		position = matches[i].end ;
+	}
+	Append(snippet, text, position, end) ;
+
+	if (end < textLength)
+		*snippet << "..." ;
+
+	return bestLast >= 0 ;
+}
+
+
+int32
+SnippetGenerator::FindTerm(const wchar_t* word, int32 length)
+{
+	const wchar_t *term ;
+	for (int32 i = 0 ; (term = (const wchar_t*)fTerms->ItemAt(i)) != NULL ;
+		i++) {
+		if (wcsncmp(term, word, length) == 0 && term[length] == 0)
+			return i ;
+	}
+
+	return -1 ;
+}
+
+
+void
+SnippetGenerator::Append(BString* snippet, const wchar_t* text, int32 start,
+	int32 end)
+{
+	char buffer[MB_LEN_MAX] ;
+	mbstate_t state ;
+	memset(&state, 0, sizeof(state)) ;
+
+	bool space = false ;
+	for (int32 i = start ; i < end ; i++) {
+		// Line breaks and runs of blanks read better as a single space.
+		if (iswspace(text[i])) {
+			if (!space)
+				*snippet << ' ' ;
+			space = true ;
+			continue ;
+		}
+		space = false ;
+
+		size_t length = wcrtomb(buffer, text[i], &state) ;
+		if (length != (size_t)-1)
+			snippet->Append(buffer, length) ;
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _SNIPPET_GENERATOR_H_
+#define _SNIPPET_GENERATOR_H_
+
+#include <List.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+
+// Marks around highlighted words in a generated snippet.
+const char kHighlightStart = '\x01' ;
+const char kHighlightEnd = '\x02' ;
+
+
+// Picks the part of a stored excerpt that best explains a hit: the window
+// of text holding the most distinct query terms. Only the excerpt is read,
+// the translators are never run again.
+class SnippetGenerator {
+	public:
+		SnippetGenerator(BList* terms, int32 length = 160,
+			bigtime_t budget = 2000) ;
+
+		bool Generate(const wchar_t* text, BString* snippet) ;
+
+	private:
+		struct snippet_match {
+			int32	start ;
+			int32	end ;
+			int32	term ;
+		} ;
+
+		int32 FindTerm(const wchar_t* word, int32 length) ;
+		void Append(BString* snippet, const wchar_t* text, int32 start,
+			int32 end) ;
+
+		BList			*fTerms ;
+		int32			fLength ;
+		bigtime_t		fBudget ;
+} ;
+
+#endif /* _SNIPPET_GENERATOR_H_ */
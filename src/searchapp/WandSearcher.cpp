@@ -0,0 +1,527 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "WandSearcher.h"
+#include "../shared/SegmentsFile.h"
+
+#include <List.h>
+#include <Locker.h>
+#include <String.h>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace lucene::index ;
+using namespace lucene::search ;
+using namespace lucene::util ;
+
+
+const int32 kMaxTerms = 64 ;
+const int32 kMaxCachedBounds = 4096 ;
+const int32 kReadSize = 128 ;
+
+// Bounds are summed in a different order than scores are, allow for the
+// rounding.
+const float kBoundSlack = 1.0001f ;
+
+
+// The highest frequency of each term we've looked at, per segment.
+// Working it out means reading the term's postings in the segment. A
+// segment is written once and never changes, save for deletions, which
+// can only leave the bound higher than it has to be. So a segment's
+// bounds are kept for as long as it is in the index, and after a commit
+// only the postings in new segments are read.
+struct term_bound {
+	TCHAR		*text ;
+	int32		maxFreq ;
+} ;
+
+struct segment_bounds {
+	BString		name ;
+	int32		firstDocument ;
+	int32		documents ;
+	BList		terms ;
+} ;
+
+struct index_bounds {
+	char		*path ;
+	int64		version ;
+	uint8		maxNorm ;
+	// The segments, in the order the reader numbers their documents.
+	// Unless the index changed again before its segments file could be
+	// read, then they are the newer index's.
+	BList		segments ;
+	bool		segmentsKnown ;
+} ;
+
+static BList sIndexBounds ;
+static BLocker sIndexBoundsLocker("wand bounds") ;
+
+
+static void
+clear_bounds(segment_bounds* segment)
+{
+	term_bound *bound ;
+	for (int32 i = 0 ; (bound = (term_bound*)segment->terms.ItemAt(i))
+		!= NULL ; i++) {
+		delete[] bound->text ;
+		delete bound ;
+	}
+	segment->terms.MakeEmpty() ;
+}
+
+
+static void
+update_segments(index_bounds* bounds, int64 version)
+{
+	BList listed ;
+	int64 listedVersion ;
+	int32 counter ;
+	if (read_segments(bounds->path, &listed, &listedVersion, &counter) != B_OK)
+		listedVersion = -1 ;
+
+	// Segments that are still there keep what is known about them, even
+	// while the reader's own list can't be told.
+	BList segments ;
+	segment_entry *entry ;
+	for (int32 i = 0 ; (entry = (segment_entry*)listed.ItemAt(i)) != NULL ;
+		i++) {
+		segment_bounds *segment = NULL ;
+		for (int32 j = 0 ; j < bounds->segments.CountItems() ; j++) {
+			segment_bounds *known
+				= (segment_bounds*)bounds->segments.ItemAt(j) ;
+			if (known->name == entry->name) {
+				segment = known ;
+				bounds->segments.RemoveItem(j) ;
+				break ;
+			}
+		}
+
+		if (segment == NULL) {
+			segment = new segment_bounds ;
+			segment->name = entry->name ;
+		}
+		segment->firstDocument = entry->firstDocument ;
+		segment->documents = entry->documents ;
+		segments.AddItem(segment) ;
+	}
+	free_segments(&listed) ;
+
+	segment_bounds *segment ;
+	for (int32 i = 0 ; (segment = (segment_bounds*)bounds->segments.ItemAt(i))
+		!= NULL ; i++) {
+		clear_bounds(segment) ;
+		delete segment ;
+	}
+	bounds->segments.MakeEmpty() ;
+	bounds->segments.AddList(&segments) ;
+	bounds->segmentsKnown = listedVersion == version ;
+}
+
+
+static index_bounds*
+find_bounds(IndexReader* reader, const char* path, const TCHAR* field)
+{
+	int64 version = reader->getVersion() ;
+	index_bounds *bounds ;
+	for (int32 i = 0 ; (bounds = (index_bounds*)sIndexBounds.ItemAt(i))
+		!= NULL ; i++) {
+		if (strcmp(bounds->path, path) == 0)
+			break ;
+	}
+
+	if (bounds == NULL) {
+		bounds = new index_bounds ;
+		bounds->path = strdup(path) ;
+		bounds->version = -1 ;
+		bounds->segmentsKnown = false ;
+		sIndexBounds.AddItem(bounds) ;
+	}
+
+	if (bounds->version != version) {
+		update_segments(bounds, version) ;
+		bounds->version = version ;
+
+		// Norms only ever get smaller as fields get longer, the highest
+		// byte is the highest norm. A byte per document, this is cheap.
+		bounds->maxNorm = 0 ;
+		uint8 *norms = reader->norms(field) ;
+		for (int32 i = 0 ; norms != NULL && i < reader->maxDoc() ; i++) {
+			if (norms[i] > bounds->maxNorm)
+				bounds->maxNorm = norms[i] ;
+		}
+		if (norms == NULL)
+			bounds->maxNorm = 255 ;
+	}
+
+	return bounds ;
+}
+
+
+static int32
+find_max_freq(IndexReader* reader, index_bounds* bounds, Term* term)
+{
+	TermDocs *termDocs = reader->termDocs(term) ;
+	int32 maxFreq = 0 ;
+
+	if (!bounds->segmentsKnown) {
+		// Not knowing where segments start, there's nothing to keep.
+		int32 docs[kReadSize], freqs[kReadSize], count ;
+		while ((count = termDocs->read(docs, freqs, kReadSize)) > 0) {
+			for (int32 i = 0 ; i < count ; i++) {
+				if (freqs[i] > maxFreq)
+					maxFreq = freqs[i] ;
+			}
+		}
+		termDocs->close() ;
+		_CLDELETE(termDocs) ;
+		return maxFreq ;
+	}
+
+	// termDocs only ever moves forward, skipping over the segments whose
+	// bound is known.
+	bool positioned = false ;
+	bool exhausted = false ;
+	segment_bounds *segment ;
+	for (int32 i = 0 ; (segment = (segment_bounds*)bounds->segments.ItemAt(i))
+		!= NULL ; i++) {
+		term_bound *bound = NULL ;
+		for (int32 j = 0 ; (bound = (term_bound*)segment->terms.ItemAt(j))
+			!= NULL ; j++) {
+			if (_tcscmp(bound->text, term->text()) == 0)
+				break ;
+		}
+
+		if (bound == NULL) {
+			int32 segmentMaxFreq = 0 ;
+			int32 end = segment->firstDocument + segment->documents ;
+			if (!exhausted && (!positioned
+					|| termDocs->doc() < segment->firstDocument))
+				exhausted = !termDocs->skipTo(segment->firstDocument) ;
+			while (!exhausted && termDocs->doc() < end) {
+				if (termDocs->freq() > segmentMaxFreq)
+					segmentMaxFreq = termDocs->freq() ;
+				exhausted = !termDocs->next() ;
+			}
+			positioned = true ;
+
+			if (segment->terms.CountItems() >= kMaxCachedBounds)
+				clear_bounds(segment) ;
+
+			bound = new term_bound ;
+			bound->text = new TCHAR[_tcslen(term->text()) + 1] ;
+			_tcscpy(bound->text, term->text()) ;
+			bound->maxFreq = segmentMaxFreq ;
+			segment->terms.AddItem(bound) ;
+		}
+
+		if (bound->maxFreq > maxFreq)
+			maxFreq = bound->maxFreq ;
+	}
+
+	termDocs->close() ;
+	_CLDELETE(termDocs) ;
+	return maxFreq ;
+}
+
+
+static int
+compare_hits(const void* first, const void* second)
+{
+	const wand_hit *a = (const wand_hit*)first ;
+	const wand_hit *b = (const wand_hit*)second ;
+
+	if (a->score != b->score)
+		return a->score > b->score ? -1 : 1 ;
+	return a->doc - b->doc ;
+}
+
+
+// Whether a is a worse hit than b. Like CLucene, ties go to the lower
+// document number.
+static inline bool
+worse_hit(const wand_hit& a, const wand_hit& b)
+{
+	return a.score < b.score || (a.score == b.score && a.doc > b.doc) ;
+}
+
+
+WandSearcher::WandSearcher(IndexReader* reader, const char* indexPath,
+	const TCHAR* field)
+	: fReader(reader),
+	  fIndexPath(indexPath),
+	  fField(field),
+	  fTermCount(0),
+	  fActiveCount(0),
+	  fNorms(NULL),
+	  fMaxNorm(0)
+{
+	fCursors = new wand_cursor[kMaxTerms] ;
+	fActive = new wand_cursor*[kMaxTerms] ;
+	fCoord = new float[kMaxTerms + 1] ;
+	fContributions = new float[kMaxTerms] ;
+}
+
+
+WandSearcher::~WandSearcher()
+{
+	for (int32 i = 0 ; i < fTermCount ; i++) {
+		if (fCursors[i].docs != NULL) {
+			fCursors[i].docs->close() ;
+			_CLDELETE(fCursors[i].docs) ;
+		}
+	}
+
+	delete[] fCursors ;
+	delete[] fActive ;
+	delete[] fCoord ;
+	delete[] fContributions ;
+}
+
+
+status_t
+WandSearcher::AddTerm(const TCHAR* text)
+{
+	if (fTermCount >= kMaxTerms)
+		return B_NO_MEMORY ;
+
+	// Terms missing from this index still count, they are part of the
+	// query's norm and its coordination factor.
+	Term *term = new Term(fField, text) ;
+	wand_cursor *cursor = &fCursors[fTermCount] ;
+	cursor->clause = fTermCount ;
+	cursor->docs = fReader->termDocs(term) ;
+	cursor->doc = -1 ;
+
+	sIndexBoundsLocker.Lock() ;
+	index_bounds *bounds = find_bounds(fReader, fIndexPath, fField) ;
+	cursor->maxFreq = find_max_freq(fReader, bounds, term) ;
+	fMaxNorm = Similarity::decodeNorm(bounds->maxNorm) ;
+	sIndexBoundsLocker.Unlock() ;
+
+	// Stash the idf in value until Prepare() can normalize it.
+	cursor->value = Similarity::getDefault()->idf(fReader->docFreq(term),
+		fReader->maxDoc()) ;
+
+	_CLDECDELETE(term) ;
+	fTermCount++ ;
+	return B_OK ;
+}
+
+
+int32
+WandSearcher::CountTerms() const
+{
+	return fTermCount ;
+}
+
+
+int32
+WandSearcher::Search(int32 count, BitSet* filter, wand_hit* hits)
+{
+	if (fTermCount == 0 || count <= 0)
+		return 0 ;
+
+	Prepare() ;
+
+	// hits is a heap with the worst hit kept on top. Until it is full,
+	// any document with a score counts.
+	int32 size = 0 ;
+	float threshold = 0 ;
+
+	while (fActiveCount > 0) {
+		// The pivot is the first document whose terms, all together,
+		// could beat the threshold. Nothing before it can.
+		float bound = 0 ;
+		int32 pivot = -1 ;
+		for (int32 i = 0 ; i < fActiveCount ; i++) {
+			bound += fActive[i]->bound ;
+			if (bound * fCoord[i + 1] * kBoundSlack > threshold) {
+				pivot = i ;
+				break ;
+			}
+		}
+
+		if (pivot < 0)
+			break ;
+
+		int32 pivotDoc = fActive[pivot]->doc ;
+		if (fActive[0]->doc == pivotDoc) {
+			if (filter == NULL || filter->get(pivotDoc)) {
+				int32 matches ;
+				float score = Score(pivotDoc, &matches) ;
+				if (score > threshold) {
+					Insert(hits, count, size, pivotDoc, score) ;
+					if (size < count)
+						size++ ;
+					if (size == count)
+						threshold = hits[0].score ;
+				}
+			}
+
+			for (int32 i = fActiveCount - 1 ; i >= 0 ; i--) {
+				if (fActive[i]->doc == pivotDoc && Advance(i, -1))
+					Reposition(i) ;
+			}
+		} else {
+			// Move the most valuable term ahead of the pivot up to it,
+			// it rules out the most documents.
+			int32 best = 0 ;
+			for (int32 i = 1 ; i < pivot ; i++) {
+				if (fActive[i]->doc < pivotDoc
+					&& fActive[i]->bound > fActive[best]->bound)
+					best = i ;
+			}
+
+			if (Advance(best, pivotDoc))
+				Reposition(best) ;
+		}
+	}
+
+	qsort(hits, size, sizeof(wand_hit), compare_hits) ;
+	return size ;
+}
+
+
+void
+WandSearcher::Prepare()
+{
+	// Weigh the terms the way BooleanQuery and TermQuery would.
+	Similarity *similarity = Similarity::getDefault() ;
+	float sumOfSquares = 0 ;
+	for (int32 i = 0 ; i < fTermCount ; i++) {
+		float queryWeight = fCursors[i].value * 1.0f ;
+		sumOfSquares += queryWeight * queryWeight ;
+	}
+
+	float queryNorm = similarity->queryNorm(sumOfSquares) ;
+	for (int32 i = 0 ; i <= fTermCount ; i++)
+		fCoord[i] = similarity->coord(i, fTermCount) ;
+
+	fNorms = fReader->norms(fField) ;
+	fActiveCount = 0 ;
+
+	for (int32 i = 0 ; i < fTermCount ; i++) {
+		wand_cursor *cursor = &fCursors[i] ;
+		float idf = cursor->value ;
+		cursor->value = (idf * 1.0f * queryNorm) * idf ;
+		cursor->bound = similarity->tf(cursor->maxFreq) * cursor->value
+			* fMaxNorm ;
+
+		fActive[fActiveCount] = cursor ;
+		if (!Advance(fActiveCount, -1))
+			continue ;
+
+		// Keep the cursors ordered by document.
+		int32 index = fActiveCount++ ;
+		while (index > 0 && fActive[index - 1]->doc > cursor->doc) {
+			fActive[index] = fActive[index - 1] ;
+			index-- ;
+		}
+		fActive[index] = cursor ;
+	}
+}
+
+
+bool
+WandSearcher::Advance(int32 index, int32 target)
+{
+	wand_cursor *cursor = fActive[index] ;
+
+	// TermDocs::skipTo() always moves at least one document.
+	bool more = target < 0 ? cursor->docs->next()
+		: cursor->docs->skipTo(target) ;
+	if (more) {
+		cursor->doc = cursor->docs->doc() ;
+		return true ;
+	}
+
+	if (index < fActiveCount) {
+		memmove(&fActive[index], &fActive[index + 1],
+			(fActiveCount - index - 1) * sizeof(wand_cursor*)) ;
+		fActiveCount-- ;
+	}
+
+	return false ;
+}
+
+
+void
+WandSearcher::Reposition(int32 index)
+{
+	// Cursors only move forward, so this one can only need to move right.
+	wand_cursor *cursor = fActive[index] ;
+	while (index + 1 < fActiveCount && fActive[index + 1]->doc < cursor->doc) {
+		fActive[index] = fActive[index + 1] ;
+		index++ ;
+	}
+	fActive[index] = cursor ;
+}
+
+
+float
+WandSearcher::Score(int32 doc, int32* matches)
+{
+	Similarity *similarity = Similarity::getDefault() ;
+	float norm = fNorms != NULL ? Similarity::decodeNorm(fNorms[doc]) : 1.0f ;
+
+	for (int32 i = 0 ; i < fTermCount ; i++)
+		fContributions[i] = 0 ;
+
+	*matches = 0 ;
+	for (int32 i = 0 ; i < fActiveCount && fActive[i]->doc == doc ; i++) {
+		wand_cursor *cursor = fActive[i] ;
+		int32 freq = cursor->docs->freq() ;
+		fContributions[cursor->clause]
+			= similarity->tf(freq) * cursor->value * norm ;
+		(*matches)++ ;
+	}
+
+	// Sum in clause order, the same as BooleanScorer, so that the scores
+	// come out bit for bit the same.
+	float score = 0 ;
+	for (int32 i = 0 ; i < fTermCount ; i++)
+		score += fContributions[i] ;
+
+	return score * fCoord[*matches] ;
+}
+
+
+void
+WandSearcher::Insert(wand_hit* heap, int32 count, int32 size, int32 doc,
+	float score)
+{
+	wand_hit hit = { doc, score } ;
+	int32 index ;
+
+	if (size < count) {
+		// Sift up from the end.
+		index = size ;
+		while (index > 0 && worse_hit(hit, heap[(index - 1) / 2])) {
+			heap[index] = heap[(index - 1) / 2] ;
+			index = (index - 1) / 2 ;
+		}
+		heap[index] = hit ;
+		return ;
+	}
+
+	// Replace the worst hit and sift down.
+	index = 0 ;
+	while (true) {
+		int32 child = 2 * index + 1 ;
+		if (child >= size)
+			break ;
+		if (child + 1 < size && worse_hit(heap[child + 1], heap[child]))
+			child++ ;
+		if (!worse_hit(heap[child], hit))
+			break ;
+		heap[index] = heap[child] ;
+		index = child ;
+	}
+	heap[index] = hit ;
+}
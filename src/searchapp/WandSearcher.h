@@ -0,0 +1,72 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _WAND_SEARCHER_H_
+#define _WAND_SEARCHER_H_
+
+#include <CLucene.h>
+
+#include <SupportDefs.h>
+
+
+struct wand_hit {
+	int32		doc ;
+	float		score ;
+} ;
+
+
+// Finds the best few documents for an OR of plain terms without scoring
+// every document that contains one of them. Each term has an upper bound
+// on what it can add to a score, and documents that can't beat the worst
+// hit kept so far are skipped over (the WAND algorithm). Scores and their
+// order are exactly what a BooleanQuery of TermQuerys would give.
+class WandSearcher {
+	public:
+		WandSearcher(lucene::index::IndexReader* reader,
+			const char* indexPath, const TCHAR* field) ;
+		~WandSearcher() ;
+
+		status_t AddTerm(const TCHAR* text) ;
+		int32 CountTerms() const ;
+
+		// Fills hits with up to count documents, best first. Documents
+		// not set in filter, if there is one, are left out.
+		int32 Search(int32 count, lucene::util::BitSet* filter,
+			wand_hit* hits) ;
+
+	private:
+		struct wand_cursor {
+			lucene::index::TermDocs	*docs ;
+			int32					doc ;
+			int32					clause ;
+			int32					maxFreq ;
+			float					value ;
+			float					bound ;
+		} ;
+
+		void Prepare() ;
+		bool Advance(int32 index, int32 target) ;
+		void Reposition(int32 index) ;
+		float Score(int32 doc, int32* matches) ;
+		void Insert(wand_hit* heap, int32 count, int32 size, int32 doc,
+			float score) ;
+
+		lucene::index::IndexReader	*fReader ;
+		const char					*fIndexPath ;
+		const TCHAR					*fField ;
+		wand_cursor					*fCursors ;
+		wand_cursor					**fActive ;
+		int32						fTermCount ;
+		int32						fActiveCount ;
+		float						*fCoord ;
+		float						*fContributions ;
+		uint8						*fNorms ;
+		float						fMaxNorm ;
+} ;
+
+#endif /* _WAND_SEARCHER_H_ */
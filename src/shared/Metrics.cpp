@@ -0,0 +1,307 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "Metrics.h"
+
+#include <OS.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+const int32 kMaxMetrics = 256 ;
+
+// Plain data, so metrics constructed before anything else still find it
+// ready.
+static Metric *sMetrics[kMaxMetrics] ;
+static int32 sMetricCount = 0 ;
+static int32 sCreatingHistogram = 0 ;
+static bigtime_t sStartTime = 0 ;
+
+
+static int32
+bucket_for(int64 value)
+{
+	if (value < 2 * kHistogramSubBuckets)
+		return value < 0 ? 0 : (int32)value ;
+
+	int32 shift = 0 ;
+	while ((value >> shift) >= 2 * kHistogramSubBuckets)
+		shift++ ;
+
+	return (shift + 1) * kHistogramSubBuckets
+		+ (int32)(value >> shift) - kHistogramSubBuckets ;
+}
+
+
+static int64
+bucket_maximum(int32 bucket)
+{
+	if (bucket < 2 * kHistogramSubBuckets)
+		return bucket ;
+
+	int32 shift = bucket / kHistogramSubBuckets - 1 ;
+	int64 mantissa = bucket % kHistogramSubBuckets + kHistogramSubBuckets ;
+	// In this order so that the last bucket ends at the largest int64.
+	return (mantissa << shift) - 1 + ((int64)1 << shift) ;
+}
+
+
+static Metric*
+find_metric(const char* name)
+{
+	int32 count = atomic_get(&sMetricCount) ;
+	if (count > kMaxMetrics)
+		count = kMaxMetrics ;
+
+	for (int32 i = 0 ; i < count ; i++) {
+		if (sMetrics[i] != NULL && strcmp(sMetrics[i]->Name(), name) == 0)
+			return sMetrics[i] ;
+	}
+
+	return NULL ;
+}
+
+
+Metric::Metric(const char* name, const char* unit, MetricType type)
+	: fName(name),
+	  fUnit(unit),
+	  fType(type)
+{
+	// One too many is still counted, it just can't be read.
+	int32 index = atomic_add(&sMetricCount, 1) ;
+	if (index == 0)
+		sStartTime = system_time() ;
+	if (index < kMaxMetrics)
+		sMetrics[index] = this ;
+}
+
+
+Metric::~Metric()
+{
+}
+
+
+const char*
+Metric::Name() const
+{
+	return fName ;
+}
+
+
+MetricType
+Metric::Type() const
+{
+	return fType ;
+}
+
+
+void
+Metric::Archive(BMessage* archive) const
+{
+	archive->AddString("name", fName) ;
+	archive->AddString("unit", fUnit) ;
+	archive->AddInt32("type", fType) ;
+}
+
+
+MetricCounter::MetricCounter(const char* name, const char* unit)
+	: Metric(name, unit, BEACON_METRIC_COUNTER)
+{
+	memset(fShards, 0, sizeof(fShards)) ;
+}
+
+
+void
+MetricCounter::Add(int64 amount)
+{
+	// Thread ids are handed out in order, so threads that run at the same
+	// time mostly get different shards.
+	int32 shard = find_thread(NULL) & (kCounterShards - 1) ;
+	atomic_add64(&fShards[shard].value, amount) ;
+}
+
+
+int64
+MetricCounter::Value() const
+{
+	int64 value = 0 ;
+	for (int32 i = 0 ; i < kCounterShards ; i++)
+		value += atomic_get64((int64*)&fShards[i].value) ;
+
+	return value ;
+}
+
+
+void
+MetricCounter::Archive(BMessage* archive) const
+{
+	Metric::Archive(archive) ;
+	archive->AddInt64("value", Value()) ;
+}
+
+
+MetricGauge::MetricGauge(const char* name, const char* unit)
+	: Metric(name, unit, BEACON_METRIC_GAUGE),
+	  fValue(0)
+{
+}
+
+
+void
+MetricGauge::Set(int64 value)
+{
+	atomic_set64(&fValue, value) ;
+}
+
+
+void
+MetricGauge::Add(int64 amount)
+{
+	atomic_add64(&fValue, amount) ;
+}
+
+
+int64
+MetricGauge::Value() const
+{
+	return atomic_get64((int64*)&fValue) ;
+}
+
+
+void
+MetricGauge::Archive(BMessage* archive) const
+{
+	Metric::Archive(archive) ;
+	archive->AddInt64("value", Value()) ;
+}
+
+
+MetricHistogram::MetricHistogram(const char* name, const char* unit)
+	: Metric(name, unit, BEACON_METRIC_HISTOGRAM),
+	  fCount(0),
+	  fSum(0),
+	  fMax(0)
+{
+	memset(fBuckets, 0, sizeof(fBuckets)) ;
+}
+
+
+void
+MetricHistogram::Record(int64 value)
+{
+	atomic_add64(&fBuckets[bucket_for(value)], 1) ;
+	atomic_add64(&fCount, 1) ;
+	atomic_add64(&fSum, value) ;
+
+	int64 max = atomic_get64(&fMax) ;
+	while (value > max) {
+		int64 previous = atomic_test_and_set64(&fMax, value, max) ;
+		if (previous == max)
+			break ;
+		max = previous ;
+	}
+}
+
+
+int64
+MetricHistogram::Count() const
+{
+	return atomic_get64((int64*)&fCount) ;
+}
+
+
+int64
+MetricHistogram::Percentile(double fraction) const
+{
+	// The buckets may be a few values ahead of the count, or behind it,
+	// when values are recorded while this runs.
+	int64 count = Count() ;
+	if (count == 0)
+		return 0 ;
+
+	int64 target = (int64)(count * fraction + 0.5) ;
+	if (target < 1)
+		target = 1 ;
+
+	int64 seen = 0 ;
+	int64 max = atomic_get64((int64*)&fMax) ;
+	for (int32 i = 0 ; i < kHistogramBuckets ; i++) {
+		seen += atomic_get64((int64*)&fBuckets[i]) ;
+		if (seen >= target) {
+			int64 value = bucket_maximum(i) ;
+			return value < max ? value : max ;
+		}
+	}
+
+	return max ;
+}
+
+
+void
+MetricHistogram::Archive(BMessage* archive) const
+{
+	Metric::Archive(archive) ;
+	archive->AddInt64("count", Count()) ;
+	archive->AddInt64("sum", atomic_get64((int64*)&fSum)) ;
+	archive->AddInt64("max", atomic_get64((int64*)&fMax)) ;
+	archive->AddInt64("p50", Percentile(0.5)) ;
+	archive->AddInt64("p90", Percentile(0.9)) ;
+	archive->AddInt64("p99", Percentile(0.99)) ;
+	archive->AddInt64("p999", Percentile(0.999)) ;
+}
+
+
+MetricHistogram*
+find_histogram(const char* name, const char* unit)
+{
+	Metric *metric = find_metric(name) ;
+	if (metric != NULL)
+		return metric->Type() == BEACON_METRIC_HISTOGRAM
+			? (MetricHistogram*)metric : NULL ;
+
+	// Two threads mustn't both make the same one. This only happens the
+	// first time a name comes up.
+	while (atomic_test_and_set(&sCreatingHistogram, 1, 0) != 0)
+		snooze(100) ;
+
+	MetricHistogram *histogram = NULL ;
+	metric = find_metric(name) ;
+	if (metric == NULL)
+		histogram = new MetricHistogram(strdup(name), unit) ;
+	else if (metric->Type() == BEACON_METRIC_HISTOGRAM)
+		histogram = (MetricHistogram*)metric ;
+
+	atomic_set(&sCreatingHistogram, 0) ;
+	return histogram ;
+}
+
+
+status_t
+archive_metrics(BMessage* archive)
+{
+	if (archive == NULL)
+		return B_BAD_VALUE ;
+
+	archive->AddInt64("uptime", system_time() - sStartTime) ;
+
+	int32 count = atomic_get(&sMetricCount) ;
+	if (count > kMaxMetrics)
+		count = kMaxMetrics ;
+
+	for (int32 i = 0 ; i < count ; i++) {
+		if (sMetrics[i] == NULL)
+			continue ;
+
+		BMessage metric ;
+		sMetrics[i]->Archive(&metric) ;
+		archive->AddMessage("metric", &metric) ;
+	}
+
+	return B_OK ;
+}
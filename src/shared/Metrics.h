@@ -0,0 +1,113 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <Message.h>
+#include <SupportDefs.h>
+
+
+// Counters, gauges and histograms that any thread can update without
+// locking. Every metric adds itself to the program's list when it is
+// constructed, and archive_metrics() copies the list into a message for
+// indexutil -s. Metrics are never taken off the list, so they have to
+// live as long as the program: make them globals, or get them from
+// find_histogram().
+
+const int32 kCounterShards = 8 ;
+
+// Values below 16 have a bucket each. Above that, each power of two is
+// split into 16 buckets, so a value is known to within 6%.
+const int32 kHistogramSubBuckets = 16 ;
+const int32 kHistogramBuckets = 60 * kHistogramSubBuckets ;
+
+typedef enum _MetricType {
+	BEACON_METRIC_COUNTER,
+	BEACON_METRIC_GAUGE,
+	BEACON_METRIC_HISTOGRAM
+} MetricType ;
+
+
+class Metric {
+	public:
+		Metric(const char* name, const char* unit, MetricType type) ;
+		virtual ~Metric() ;
+
+		const char* Name() const ;
+		MetricType Type() const ;
+		virtual void Archive(BMessage* archive) const ;
+
+	protected:
+		const char	*fName ;
+		const char	*fUnit ;
+		MetricType	fType ;
+} ;
+
+
+// Each thread adds to one of a few counters on cache lines of their own,
+// so threads counting the same thing don't slow each other down.
+class MetricCounter : public Metric {
+	public:
+		MetricCounter(const char* name, const char* unit = "") ;
+
+		void Add(int64 amount = 1) ;
+		int64 Value() const ;
+		virtual void Archive(BMessage* archive) const ;
+
+	private:
+		struct counter_shard {
+			int64	value ;
+			int64	padding[7] ;
+		} ;
+
+		counter_shard	fShards[kCounterShards] ;
+} ;
+
+
+class MetricGauge : public Metric {
+	public:
+		MetricGauge(const char* name, const char* unit = "") ;
+
+		void Set(int64 value) ;
+		void Add(int64 amount) ;
+		int64 Value() const ;
+		virtual void Archive(BMessage* archive) const ;
+
+	private:
+		int64		fValue ;
+} ;
+
+
+class MetricHistogram : public Metric {
+	public:
+		MetricHistogram(const char* name, const char* unit = "us") ;
+
+		void Record(int64 value) ;
+		int64 Count() const ;
+		// The highest value of the bucket the given fraction of all values
+		// are in or below.
+		int64 Percentile(double fraction) const ;
+		virtual void Archive(BMessage* archive) const ;
+
+	private:
+		int64		fBuckets[kHistogramBuckets] ;
+		int64		fCount ;
+		int64		fSum ;
+		int64		fMax ;
+} ;
+
+
+// Returns the histogram called name, making it the first time, for
+// metrics whose names are only known as the program runs.
+MetricHistogram* find_histogram(const char* name, const char* unit = "us") ;
+
+// Adds a "metric" message per metric, and "uptime", to archive.
+status_t archive_metrics(BMessage* archive) ;
+
+#endif /* _METRICS_H_ */
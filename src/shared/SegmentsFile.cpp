@@ -0,0 +1,164 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "SegmentsFile.h"
+
+#include <DataIO.h>
+#include <File.h>
+#include <Path.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+
+// CLucene's segments file holds this format, the only one it writes.
+const int32 kSegmentsFormat = -1 ;
+const off_t kMaxSegmentsFileSize = 1024 * 1024 ;
+
+
+// The segments file, big endian like all of CLucene's.
+struct segments_data {
+	const uint8		*data ;
+	size_t			length ;
+	size_t			position ;
+	bool			failed ;
+} ;
+
+
+static uint64
+read_bytes(segments_data *segments, int32 count)
+{
+	if (segments->position + count > segments->length) {
+		segments->failed = true ;
+		return 0 ;
+	}
+
+	uint64 value = 0 ;
+	for (int32 i = 0 ; i < count ; i++)
+		value = value << 8 | segments->data[segments->position++] ;
+	return value ;
+}
+
+
+static void
+write_bytes(BMallocIO *output, uint64 value, int32 count)
+{
+	uint8 bytes[8] ;
+	for (int32 i = count - 1 ; i >= 0 ; i--) {
+		bytes[i] = value & 0xff ;
+		value >>= 8 ;
+	}
+	output->Write(bytes, count) ;
+}
+
+
+status_t
+read_segments(const char *directory, BList *segments, int64 *version,
+	int32 *counter)
+{
+	BPath path(directory, "segments") ;
+	BFile file(path.Path(), B_READ_ONLY) ;
+	off_t size ;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK)
+		return B_ENTRY_NOT_FOUND ;
+	if (size > kMaxSegmentsFileSize)
+		return B_BAD_DATA ;
+
+	uint8 *data = new uint8[size] ;
+	if (file.ReadAt(0, data, size) != size) {
+		delete[] data ;
+		return B_IO_ERROR ;
+	}
+
+	segments_data input = { data, (size_t)size, 0, false } ;
+	int32 format = (int32)read_bytes(&input, 4) ;
+	if (format < 0) {
+		if (format != kSegmentsFormat)
+			input.failed = true ;
+		*version = (int64)read_bytes(&input, 8) ;
+		*counter = (int32)read_bytes(&input, 4) ;
+	} else
+		*counter = format ;
+
+	// Segment names are "_" and a number in base 36, one byte a character.
+	int32 count = (int32)read_bytes(&input, 4) ;
+	int32 firstDocument = 0 ;
+	for (int32 i = 0 ; i < count && !input.failed ; i++) {
+		int32 length = (int32)read_bytes(&input, 1) ;
+		if (length > 0x7f || input.position + length > input.length) {
+			input.failed = true ;
+			break ;
+		}
+
+		segment_entry *segment = new segment_entry ;
+		segment->name.SetTo((const char*)data + input.position, length) ;
+		input.position += length ;
+		segment->documents = (int32)read_bytes(&input, 4) ;
+		segment->firstDocument = firstDocument ;
+		firstDocument += segment->documents ;
+		segments->AddItem(segment) ;
+	}
+
+	// The oldest format has its version last, if at all.
+	if (format >= 0)
+		*version = input.position < input.length
+			? (int64)read_bytes(&input, 8) : 0 ;
+
+	delete[] data ;
+	if (input.failed || count < 0) {
+		free_segments(segments) ;
+		return B_BAD_DATA ;
+	}
+
+	return B_OK ;
+}
+
+
+status_t
+write_segments(const char *directory, const BList *segments, int64 version,
+	int32 counter)
+{
+	// The way CLucene writes it: a new file renamed over the old one.
+	BMallocIO output ;
+	write_bytes(&output, (uint32)kSegmentsFormat, 4) ;
+	write_bytes(&output, version, 8) ;
+	write_bytes(&output, counter, 4) ;
+	write_bytes(&output, segments->CountItems(), 4) ;
+	for (int32 i = 0 ; i < segments->CountItems() ; i++) {
+		segment_entry *segment = (segment_entry*)segments->ItemAt(i) ;
+		write_bytes(&output, segment->name.Length(), 1) ;
+		output.Write(segment->name.String(), segment->name.Length()) ;
+		write_bytes(&output, segment->documents, 4) ;
+	}
+
+	BPath path(directory, "segments") ;
+	BPath tempPath(directory, "segments.new") ;
+	BFile file(tempPath.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) ;
+	if (file.InitCheck() != B_OK
+		|| file.Write(output.Buffer(), output.BufferLength())
+			!= (ssize_t)output.BufferLength()
+		|| file.Sync() != B_OK) {
+		unlink(tempPath.Path()) ;
+		return B_IO_ERROR ;
+	}
+	file.Unset() ;
+
+	if (rename(tempPath.Path(), path.Path()) != 0)
+		return B_IO_ERROR ;
+
+	return B_OK ;
+}
+
+
+void
+free_segments(BList *segments)
+{
+	for (int32 i = 0 ; i < segments->CountItems() ; i++)
+		delete (segment_entry*)segments->ItemAt(i) ;
+	segments->MakeEmpty() ;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _SEGMENTS_FILE_H_
+#define _SEGMENTS_FILE_H_
+
+#include <List.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+
+// CLucene's "segments" file, which lists the segments of an index. The
+// index_server rewrites it to set damaged segments aside, the searcher
+// reads it to tell which segments a reader is made of.
+
+// A segment as the segments file lists it. The reader numbers documents
+// a segment after another, in that order.
+struct segment_entry {
+	BString		name ;
+	int32		documents ;
+	int32		firstDocument ;
+} ;
+
+// Fills segments with segment_entrys, which free_segments() deletes.
+status_t read_segments(const char *directory, BList *segments,
+	int64 *version, int32 *counter) ;
+status_t write_segments(const char *directory, const BList *segments,
+	int64 version, int32 counter) ;
+void free_segments(BList *segments) ;
+
+#endif /* _SEGMENTS_FILE_H_ */
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#include "Trace.h"
+
+#include <TLS.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+struct trace_event {
+	// One past the event's number once it is complete, 0 while it is
+	// being written.
+	int32		sequence ;
+	const char	*name ;
+	bigtime_t	start ;
+	bigtime_t	duration ;
+	char		detail[kTraceDetailLength] ;
+} ;
+
+
+struct trace_buffer {
+	trace_buffer	*next ;
+	thread_id		thread ;
+	char			threadName[B_OS_NAME_LENGTH] ;
+	int32			count ;
+	trace_event		events[kTraceBufferEvents] ;
+} ;
+
+
+static int32 sSampleEvery = 0 ;
+static int32 sSampleCount = 0 ;
+static int32 sBufferSlot = -1 ;
+// Non-NULL while a span of the thread records.
+static int32 sRecordingSlot = -1 ;
+static int32 sBuffersLock = 0 ;
+// A buffer stays when its thread is gone, its spans are still worth
+// seeing, until another thread needs one.
+static trace_buffer *sBuffers = NULL ;
+
+
+static void
+lock_buffers()
+{
+	while (atomic_test_and_set(&sBuffersLock, 1, 0) != 0)
+		snooze(100) ;
+}
+
+
+static void
+unlock_buffers()
+{
+	atomic_set(&sBuffersLock, 0) ;
+}
+
+
+static trace_buffer*
+thread_buffer()
+{
+	trace_buffer *buffer = (trace_buffer*)tls_get(sBufferSlot) ;
+	if (buffer != NULL)
+		return buffer ;
+
+	// Only threads that record get one, and the buffers of those that are
+	// gone are taken over. write_trace() holds the lock while it reads
+	// them.
+	thread_info info ;
+	lock_buffers() ;
+	for (buffer = sBuffers ; buffer != NULL ; buffer = buffer->next) {
+		if (get_thread_info(buffer->thread, &info) != B_OK)
+			break ;
+	}
+	if (buffer == NULL) {
+		buffer = new trace_buffer ;
+		buffer->next = sBuffers ;
+		sBuffers = buffer ;
+	}
+
+	buffer->thread = find_thread(NULL) ;
+	if (get_thread_info(buffer->thread, &info) == B_OK)
+		snprintf(buffer->threadName, B_OS_NAME_LENGTH, "%s", info.name) ;
+	else
+		snprintf(buffer->threadName, B_OS_NAME_LENGTH, "thread %ld",
+			(long)buffer->thread) ;
+	buffer->count = 0 ;
+	for (int32 i = 0 ; i < kTraceBufferEvents ; i++)
+		buffer->events[i].sequence = 0 ;
+	unlock_buffers() ;
+
+	tls_set(sBufferSlot, buffer) ;
+	return buffer ;
+}
+
+
+// Taking every nth span would always miss the same kind when spans that
+// sample come in a fixed pattern, a commit and its one document say. The
+// count is mixed like the end of MurmurHash3, which makes it look random
+// and is shared by all threads without a state of their own.
+static bool
+sample()
+{
+	int32 every = atomic_get(&sSampleEvery) ;
+	if (every <= 0)
+		return false ;
+
+	uint32 x = (uint32)atomic_add(&sSampleCount, 1) ;
+	x ^= x >> 16 ;
+	x *= 0x85ebca6b ;
+	x ^= x >> 13 ;
+	x *= 0xc2b2ae35 ;
+	x ^= x >> 16 ;
+	return x % (uint32)every == 0 ;
+}
+
+
+static void
+write_json_string(FILE* file, const char* string)
+{
+	fputc('"', file) ;
+	for (const char *c = string ; *c != '\0' ; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c) ;
+		else if ((unsigned char)*c < 0x20)
+			fprintf(file, "\\u%04x", *c) ;
+		else
+			fputc(*c, file) ;
+	}
+	fputc('"', file) ;
+}
+
+
+TraceSpan::TraceSpan(const char* name, const char* detail, trace_mode mode)
+	: fName(name),
+	  fRecording(false),
+	  fStartedRecording(false)
+{
+	if (sSampleEvery <= 0)
+		return ;
+
+	if (tls_get(sRecordingSlot) != NULL)
+		fRecording = true ;
+	else if (mode == TRACE_RECORD || (mode == TRACE_SAMPLE && sample())) {
+		fRecording = true ;
+		fStartedRecording = true ;
+		tls_set(sRecordingSlot, (void*)1) ;
+	}
+
+	if (!fRecording)
+		return ;
+
+	fDetail[0] = '\0' ;
+	if (detail != NULL) {
+		size_t length = strlen(detail) ;
+		if (length >= (size_t)kTraceDetailLength) {
+			detail += length - (kTraceDetailLength - 1) ;
+			while ((*detail & 0xc0) == 0x80)
+				detail++ ;
+		}
+		strcpy(fDetail, detail) ;
+	}
+
+	fStart = system_time() ;
+}
+
+
+TraceSpan::~TraceSpan()
+{
+	End() ;
+}
+
+
+void
+TraceSpan::End()
+{
+	if (!fRecording)
+		return ;
+
+	trace_buffer *buffer = thread_buffer() ;
+	int32 index = buffer->count ;
+	trace_event *event = &buffer->events[index & (kTraceBufferEvents - 1)] ;
+
+	atomic_set(&event->sequence, 0) ;
+	event->name = fName ;
+	event->start = fStart ;
+	event->duration = system_time() - fStart ;
+	strcpy(event->detail, fDetail) ;
+	atomic_set(&event->sequence, index + 1) ;
+	atomic_set(&buffer->count, index + 1) ;
+
+	if (fStartedRecording)
+		tls_set(sRecordingSlot, NULL) ;
+	fRecording = false ;
+}
+
+
+void
+set_trace_sampling(int32 every)
+{
+	lock_buffers() ;
+	if (every > 0 && sBufferSlot < 0) {
+		sBufferSlot = tls_allocate() ;
+		sRecordingSlot = tls_allocate() ;
+	}
+	unlock_buffers() ;
+
+	if (sBufferSlot >= 0)
+		atomic_set(&sSampleEvery, every > 0 ? every : 0) ;
+}
+
+
+int32
+trace_sampling()
+{
+	return atomic_get(&sSampleEvery) ;
+}
+
+
+bool
+sample_trace()
+{
+	if (atomic_get(&sSampleEvery) <= 0)
+		return false ;
+
+	return tls_get(sRecordingSlot) != NULL || sample() ;
+}
+
+
+status_t
+write_trace(const char* path)
+{
+	FILE *file = fopen(path, "w") ;
+	if (file == NULL)
+		return B_ERROR ;
+
+	// Buffers are only taken over by another thread with the lock held.
+	// Threads that already have one go on recording meanwhile, only
+	// those that need one wait.
+	lock_buffers() ;
+	trace_buffer *buffers = sBuffers ;
+
+	long team = getpid() ;
+	bool first = true ;
+	fprintf(file, "{\"traceEvents\": [") ;
+	for (trace_buffer *buffer = buffers ; buffer != NULL
+			; buffer = buffer->next) {
+		fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+			"\"pid\": %ld, \"tid\": %ld, \"args\": {\"name\": ",
+			first ? "" : ",", team, (long)buffer->thread) ;
+		write_json_string(file, buffer->threadName) ;
+		fprintf(file, "}}") ;
+		first = false ;
+
+		int32 count = atomic_get(&buffer->count) ;
+		int32 index = count > kTraceBufferEvents
+			? count - kTraceBufferEvents : 0 ;
+		for (; index < count ; index++) {
+			// Skip events that are overwritten while they are copied.
+			trace_event *event
+				= &buffer->events[index & (kTraceBufferEvents - 1)] ;
+			if (atomic_get(&event->sequence) != index + 1)
+				continue ;
+			trace_event copy = *event ;
+			if (atomic_get(&event->sequence) != index + 1)
+				continue ;
+			copy.detail[kTraceDetailLength - 1] = '\0' ;
+
+			fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"beacon\", "
+				"\"ph\": \"X\", \"pid\": %ld, \"tid\": %ld, \"ts\": %lld, "
+				"\"dur\": %lld", copy.name, team, (long)buffer->thread,
+				(long long)copy.start, (long long)copy.duration) ;
+			if (copy.detail[0] != '\0') {
+				fprintf(file, ", \"args\": {\"detail\": ") ;
+				write_json_string(file, copy.detail) ;
+				fprintf(file, "}") ;
+			}
+			fprintf(file, "}") ;
+		}
+	}
+	fprintf(file, "\n]}\n") ;
+	unlock_buffers() ;
+
+	status_t status = ferror(file) ? B_IO_ERROR : B_OK ;
+	fclose(file) ;
+	return status ;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2009 Haiku, Inc.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Ankur Sethi (get.me.ankur@gmail.com)
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <OS.h>
+#include <SupportDefs.h>
+
+
+// Spans of time spent in named stages, kept in a buffer per thread and
+// written out for chrome://tracing or Perfetto. Spans are only recorded
+// inside a sampled one, so a rate of 1 in a few hundred costs next to
+// nothing, and with tracing off a span is a single test.
+//
+// A thread gets a buffer the first time one of its spans is recorded, and
+// keeps its last kTraceBufferEvents spans in it.
+const int32 kTraceBufferEvents = 4096 ;
+const int32 kTraceDetailLength = 64 ;
+
+
+// What a span does when no span around it is recording.
+enum trace_mode {
+	// It doesn't record either.
+	TRACE_NESTED,
+	// It decides for itself, one in every trace_sampling() at random.
+	TRACE_SAMPLE,
+	// It records, the work it covers was chosen by sample_trace() when it
+	// was queued.
+	TRACE_RECORD
+} ;
+
+
+class TraceSpan {
+	public:
+		// Everything inside a span that records is recorded along with
+		// it. Names must be string literals. Only the end of detail is
+		// kept, which for a path is the part that matters.
+		TraceSpan(const char* name, const char* detail = NULL,
+			trace_mode mode = TRACE_NESTED) ;
+		~TraceSpan() ;
+
+		// Ends the span before it goes out of scope.
+		void End() ;
+
+	private:
+		const char	*fName ;
+		bigtime_t	fStart ;
+		bool		fRecording ;
+		bool		fStartedRecording ;
+		char		fDetail[kTraceDetailLength] ;
+} ;
+
+
+// Records about one in every sampled spans, chosen at random, none at
+// all for 0.
+void set_trace_sampling(int32 every) ;
+int32 trace_sampling() ;
+
+// Decides whether work that is queued for later, maybe for another
+// thread, is recorded when it is done: always when queued inside a span
+// that records, otherwise like a TRACE_SAMPLE span. That way the work
+// shows up in the same trace as what queued it.
+bool sample_trace() ;
+
+// Writes what the buffers hold as a Chrome trace.
+status_t write_trace(const char* path) ;
+
+#endif /* _TRACE_H_ */